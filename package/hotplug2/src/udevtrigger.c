@@ -28,13 +28,23 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <syslog.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #define PATH_SIZE 512
+#define QUEUE_SIZE 64
+#define MAX_JOBS 32
+#define UEVENT_BUFFER_SIZE 2048
+#define UEVENT_RCVBUF_SIZE (1024 * 1024)
 
 static int verbose;
 static int dry_run;
+static int jobs = 4;
 
 void log_message(int priority, const char *format, ...)
 {
@@ -68,14 +78,108 @@ void log_message(int priority, const char *format, ...)
 #endif
 
 
-static void trigger_uevent(const char *devpath)
+/*
+ * Opened uevent files are handed to a pool of workers which do the actual
+ * write, so a slow uevent (e.g. one that waits for the uevent helper to be
+ * spawned) does not hold up the directory walk.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	int fds[QUEUE_SIZE];
+	int head;
+	int count;
+	int done;
+} queue = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.not_empty = PTHREAD_COND_INITIALIZER,
+	.not_full = PTHREAD_COND_INITIALIZER,
+};
+
+static void write_uevent(int fd)
+{
+	if (write(fd, "add", 3) < 0)
+		info("error on triggering uevent: %s\n", strerror(errno));
+
+	close(fd);
+}
+
+static void *trigger_worker(void *arg)
 {
-	char filename[PATH_SIZE];
 	int fd;
 
-	strlcpy(filename, "/sys", sizeof(filename));
-	strlcat(filename, devpath, sizeof(filename));
-	strlcat(filename, "/uevent", sizeof(filename));
+	while (1) {
+		pthread_mutex_lock(&queue.lock);
+		while (!queue.count && !queue.done)
+			pthread_cond_wait(&queue.not_empty, &queue.lock);
+
+		if (!queue.count) {
+			pthread_mutex_unlock(&queue.lock);
+			break;
+		}
+
+		fd = queue.fds[queue.head];
+		queue.head = (queue.head + 1) % QUEUE_SIZE;
+		queue.count--;
+		pthread_cond_signal(&queue.not_full);
+		pthread_mutex_unlock(&queue.lock);
+
+		write_uevent(fd);
+	}
+
+	return NULL;
+}
+
+static void queue_uevent(int fd)
+{
+	if (jobs <= 1) {
+		write_uevent(fd);
+		return;
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	while (queue.count == QUEUE_SIZE)
+		pthread_cond_wait(&queue.not_full, &queue.lock);
+
+	queue.fds[(queue.head + queue.count) % QUEUE_SIZE] = fd;
+	queue.count++;
+	pthread_cond_signal(&queue.not_empty);
+	pthread_mutex_unlock(&queue.lock);
+}
+
+static int start_workers(pthread_t *workers)
+{
+	int i, ret;
+
+	for (i = 0; i < jobs; i++) {
+		ret = pthread_create(&workers[i], NULL, trigger_worker, NULL);
+		if (ret != 0) {
+			err("unable to start worker: %s\n", strerror(ret));
+			break;
+		}
+	}
+
+	return i;
+}
+
+static void stop_workers(pthread_t *workers, int n)
+{
+	int i;
+
+	pthread_mutex_lock(&queue.lock);
+	queue.done = 1;
+	pthread_cond_broadcast(&queue.not_empty);
+	pthread_mutex_unlock(&queue.lock);
+
+	for (i = 0; i < n; i++)
+		pthread_join(workers[i], NULL);
+}
+
+static void trigger_uevent(int dfd, const char *name, const char *devpath)
+{
+	char filename[PATH_SIZE];
+	int fd;
 
 	if (verbose)
 		printf("%s\n", devpath);
@@ -83,29 +187,26 @@ static void trigger_uevent(const char *devpath)
 	if (dry_run)
 		return;
 
-	fd = open(filename, O_WRONLY);
+	strlcpy(filename, name, sizeof(filename));
+	strlcat(filename, "/uevent", sizeof(filename));
+
+	fd = openat(dfd, filename, O_WRONLY | O_CLOEXEC);
 	if (fd < 0) {
-		dbg("error on opening %s: %s\n", filename, strerror(errno));
+		dbg("error on opening %s/uevent: %s\n", devpath, strerror(errno));
 		return;
 	}
 
-	if (write(fd, "add", 3) < 0)
-		info("error on triggering %s: %s\n", filename, strerror(errno));
-
-	close(fd);
+	queue_uevent(fd);
 }
 
-static int sysfs_resolve_link(char *devpath, size_t size)
+static int sysfs_resolve_link(int dfd, const char *name, char *devpath, size_t size)
 {
-	char link_path[PATH_SIZE];
 	char link_target[PATH_SIZE];
 	int len;
 	int i;
 	int back;
 
-	strlcpy(link_path, "/sys", sizeof(link_path));
-	strlcat(link_path, devpath, sizeof(link_path));
-	len = readlink(link_path, link_target, sizeof(link_target));
+	len = readlinkat(dfd, name, link_target, sizeof(link_target) - 1);
 	if (len <= 0)
 		return -1;
 	link_target[len] = '\0';
@@ -127,74 +228,99 @@ static int sysfs_resolve_link(char *devpath, size_t size)
 	return 0;
 }
 
+static DIR *opendirat(int dfd, const char *name)
+{
+	DIR *dir;
+	int fd;
+
+	fd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	dir = fdopendir(fd);
+	if (dir == NULL)
+		close(fd);
+
+	return dir;
+}
 
-static int device_list_insert(const char *path)
+/*
+ * Trigger the device "name" found in the directory dfd, which is the
+ * sysfs directory "path". All lookups are done relative to dfd, so
+ * the kernel does not have to walk the full path again for every device.
+ */
+static int device_list_insert(int dfd, const char *path, struct dirent *dent)
 {
 	char filename[PATH_SIZE];
 	char devpath[PATH_SIZE];
 	struct stat statbuf;
+	int is_link;
 
-	dbg("add '%s'" , path);
+	dbg("add '%s/%s'" , path, dent->d_name);
 
 	/* we only have a device, if we have an uevent file */
-	strlcpy(filename, path, sizeof(filename));
+	strlcpy(filename, dent->d_name, sizeof(filename));
 	strlcat(filename, "/uevent", sizeof(filename));
-	if (stat(filename, &statbuf) < 0)
+	if (fstatat(dfd, filename, &statbuf, 0) < 0)
 		return -1;
 	if (!(statbuf.st_mode & S_IWUSR))
 		return -1;
 
-	strlcpy(devpath, &path[4], sizeof(devpath));
+	strlcpy(devpath, path, sizeof(devpath));
+	strlcat(devpath, "/", sizeof(devpath));
+	strlcat(devpath, dent->d_name, sizeof(devpath));
+
+	/* sysfs fills in d_type, only fall back to lstat if it did not */
+	if (dent->d_type == DT_UNKNOWN) {
+		if (fstatat(dfd, dent->d_name, &statbuf, AT_SYMLINK_NOFOLLOW) < 0)
+			return -1;
+		is_link = S_ISLNK(statbuf.st_mode);
+	} else {
+		is_link = (dent->d_type == DT_LNK);
+	}
 
 	/* resolve possible link to real target */
-	if (lstat(path, &statbuf) < 0)
-		return -1;
-	if (S_ISLNK(statbuf.st_mode))
-		if (sysfs_resolve_link(devpath, sizeof(devpath)) != 0)
+	if (is_link)
+		if (sysfs_resolve_link(dfd, dent->d_name, devpath, sizeof(devpath)) != 0)
 			return -1;
 
-	trigger_uevent(devpath);
+	trigger_uevent(dfd, dent->d_name, devpath);
 	return 0;
 }
 
 
-static void scan_subsystem(const char *subsys)
+static void scan_subsystem(int sysfd, const char *subsys)
 {
-	char base[PATH_SIZE];
 	DIR *dir;
 	struct dirent *dent;
 
-	strlcpy(base, "/sys/", sizeof(base));
-	strlcat(base, subsys, sizeof(base));
-
-	dir = opendir(base);
+	dir = opendirat(sysfd, subsys);
 	if (dir != NULL) {
 		for (dent = readdir(dir); dent != NULL; dent = readdir(dir)) {
 			char dirname[PATH_SIZE];
+			char path[PATH_SIZE];
 			DIR *dir2;
 			struct dirent *dent2;
 
 			if (dent->d_name[0] == '.')
 				continue;
 
-			strlcpy(dirname, base, sizeof(dirname));
-			strlcat(dirname, "/", sizeof(dirname));
-			strlcat(dirname, dent->d_name, sizeof(dirname));
+			strlcpy(dirname, dent->d_name, sizeof(dirname));
 			strlcat(dirname, "/devices", sizeof(dirname));
 
+			strlcpy(path, "/", sizeof(path));
+			strlcat(path, subsys, sizeof(path));
+			strlcat(path, "/", sizeof(path));
+			strlcat(path, dirname, sizeof(path));
+
 			/* look for devices */
-			dir2 = opendir(dirname);
+			dir2 = opendirat(dirfd(dir), dirname);
 			if (dir2 != NULL) {
 				for (dent2 = readdir(dir2); dent2 != NULL; dent2 = readdir(dir2)) {
-					char dirname2[PATH_SIZE];
-
 					if (dent2->d_name[0] == '.')
 						continue;
 
-					strlcpy(dirname2, dirname, sizeof(dirname2));
-					strlcat(dirname2, "/", sizeof(dirname2));
-					strlcat(dirname2, dent2->d_name, sizeof(dirname2));
-					device_list_insert(dirname2);
+					device_list_insert(dirfd(dir2), path, dent2);
 				}
 				closedir(dir2);
 			}
@@ -203,46 +329,38 @@ static void scan_subsystem(const char *subsys)
 	}
 }
 
-static void scan_block(void)
+static void scan_block(int sysfd)
 {
-	char base[PATH_SIZE];
 	DIR *dir;
 	struct dirent *dent;
 
-	strlcpy(base, "/sys/block", sizeof(base));
-
-	dir = opendir(base);
+	dir = opendirat(sysfd, "block");
 	if (dir != NULL) {
 		for (dent = readdir(dir); dent != NULL; dent = readdir(dir)) {
-			char dirname[PATH_SIZE];
+			char path[PATH_SIZE];
 			DIR *dir2;
 			struct dirent *dent2;
 
 			if (dent->d_name[0] == '.')
 				continue;
 
-			strlcpy(dirname, base, sizeof(dirname));
-			strlcat(dirname, "/", sizeof(dirname));
-			strlcat(dirname, dent->d_name, sizeof(dirname));
-			if (device_list_insert(dirname) != 0)
+			if (device_list_insert(dirfd(dir), "/block", dent) != 0)
 				continue;
 
+			strlcpy(path, "/block/", sizeof(path));
+			strlcat(path, dent->d_name, sizeof(path));
+
 			/* look for partitions */
-			dir2 = opendir(dirname);
+			dir2 = opendirat(dirfd(dir), dent->d_name);
 			if (dir2 != NULL) {
 				for (dent2 = readdir(dir2); dent2 != NULL; dent2 = readdir(dir2)) {
-					char dirname2[PATH_SIZE];
-
 					if (dent2->d_name[0] == '.')
 						continue;
 
 					if (!strcmp(dent2->d_name,"device"))
 						continue;
 
-					strlcpy(dirname2, dirname, sizeof(dirname2));
-					strlcat(dirname2, "/", sizeof(dirname2));
-					strlcat(dirname2, dent2->d_name, sizeof(dirname2));
-					device_list_insert(dirname2);
+					device_list_insert(dirfd(dir2), path, dent2);
 				}
 				closedir(dir2);
 			}
@@ -251,42 +369,34 @@ static void scan_block(void)
 	}
 }
 
-static void scan_class(void)
+static void scan_class(int sysfd)
 {
-	char base[PATH_SIZE];
 	DIR *dir;
 	struct dirent *dent;
 
-	strlcpy(base, "/sys/class", sizeof(base));
-
-	dir = opendir(base);
+	dir = opendirat(sysfd, "class");
 	if (dir != NULL) {
 		for (dent = readdir(dir); dent != NULL; dent = readdir(dir)) {
-			char dirname[PATH_SIZE];
+			char path[PATH_SIZE];
 			DIR *dir2;
 			struct dirent *dent2;
 
 			if (dent->d_name[0] == '.')
 				continue;
 
-			strlcpy(dirname, base, sizeof(dirname));
-			strlcat(dirname, "/", sizeof(dirname));
-			strlcat(dirname, dent->d_name, sizeof(dirname));
-			dir2 = opendir(dirname);
+			strlcpy(path, "/class/", sizeof(path));
+			strlcat(path, dent->d_name, sizeof(path));
+
+			dir2 = opendirat(dirfd(dir), dent->d_name);
 			if (dir2 != NULL) {
 				for (dent2 = readdir(dir2); dent2 != NULL; dent2 = readdir(dir2)) {
-					char dirname2[PATH_SIZE];
-
 					if (dent2->d_name[0] == '.')
 						continue;
 
 					if (!strcmp(dent2->d_name, "device"))
 						continue;
 
-					strlcpy(dirname2, dirname, sizeof(dirname2));
-					strlcat(dirname2, "/", sizeof(dirname2));
-					strlcat(dirname2, dent2->d_name, sizeof(dirname2));
-					device_list_insert(dirname2);
+					device_list_insert(dirfd(dir2), path, dent2);
 				}
 				closedir(dir2);
 			}
@@ -295,17 +405,131 @@ static void scan_class(void)
 	}
 }
 
+static int uevent_open(void)
+{
+	struct sockaddr_nl nls;
+	int size = UEVENT_RCVBUF_SIZE;
+	int fd;
+
+	fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0) {
+		err("error getting uevent socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* we may be triggering a lot of events, try not to drop any */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	memset(&nls, 0, sizeof(nls));
+	nls.nl_family = AF_NETLINK;
+	nls.nl_groups = 1;
+
+	if (bind(fd, (struct sockaddr *) &nls, sizeof(nls)) < 0) {
+		err("error binding uevent socket: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static unsigned long long uevent_seqnum(void)
+{
+	unsigned long long seqnum = 0;
+	FILE *fp;
+
+	fp = fopen("/sys/kernel/uevent_seqnum", "r");
+	if (fp != NULL) {
+		if (fscanf(fp, "%llu", &seqnum) != 1)
+			seqnum = 0;
+		fclose(fp);
+	}
+
+	return seqnum;
+}
+
+static long long time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Wait until the event carrying seqnum "last" has been seen on the uevent
+ * socket. Every event up to it was triggered by us or raced with us, so
+ * once it went by, all of our events have been delivered.
+ */
+static int uevent_settle(int fd, unsigned long long last, int timeout)
+{
+	char buf[UEVENT_BUFFER_SIZE];
+	unsigned long long seqnum;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	long long deadline = time_ms() + timeout * 1000LL;
+	long long now;
+	ssize_t len;
+	int i;
+
+	while ((now = time_ms()) < deadline) {
+		if (poll(&pfd, 1, deadline - now) <= 0)
+			continue;
+
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len < 0) {
+			/*
+			 * The socket overflowed and we lost events. The kernel
+			 * sends them from within the uevent write, so all of
+			 * ours have gone out by now.
+			 */
+			if (errno == ENOBUFS) {
+				dbg("uevent socket overflow\n");
+				return 0;
+			}
+			continue;
+		}
+		buf[len] = '\0';
+
+		for (i = 0; i < len; i += strlen(&buf[i]) + 1) {
+			if (strncmp(&buf[i], "SEQNUM=", 7))
+				continue;
+
+			seqnum = strtoull(&buf[i + 7], NULL, 10);
+			dbg("seen event %llu, waiting for %llu\n", seqnum, last);
+			if (seqnum >= last)
+				return 0;
+		}
+	}
+
+	return -1;
+}
+
 int main(int argc, char *argv[], char *envp[])
 {
-	char base[PATH_SIZE];
+	static const struct option options[] = {
+		{ "verbose", 0, NULL, 'v' },
+		{ "dry-run", 0, NULL, 'n' },
+		{ "jobs", 1, NULL, 'j' },
+		{ "settle", 2, NULL, 's' },
+		{ "help", 0, NULL, 'h' },
+		{}
+	};
+	pthread_t workers[MAX_JOBS];
 	struct stat statbuf;
+	unsigned long long seqnum = 0;
+	unsigned long long start_seqnum = 0;
+	int settle_timeout = 0;
+	int uevent_fd = -1;
+	int nworkers = 0;
 	int failed = 0;
+	int sysfd;
 	int option;
 
 	openlog("udevtrigger", LOG_PID | LOG_CONS, LOG_DAEMON);
 
 	while (1) {
-		option = getopt(argc, argv, "vnh");
+		option = getopt_long(argc, argv, "vnj:h", options, NULL);
 		if (option == -1)
 			break;
 
@@ -316,10 +540,25 @@ int main(int argc, char *argv[], char *envp[])
 		case 'n':
 			dry_run = 1;
 			break;
+		case 'j':
+			jobs = atoi(optarg);
+			if (jobs < 1)
+				jobs = 1;
+			if (jobs > MAX_JOBS)
+				jobs = MAX_JOBS;
+			break;
+		case 's':
+			settle_timeout = optarg ? atoi(optarg) : 30;
+			if (settle_timeout < 1)
+				settle_timeout = 1;
+			break;
 		case 'h':
 			printf("Usage: udevtrigger OPTIONS\n"
 			       "  -v                     print the list of devices while running\n"
 			       "  -n                     do not actually trigger the events\n"
+			       "  -j <jobs>              number of parallel trigger workers (default 4)\n"
+			       "  --settle[=<seconds>]   wait until all triggered events were sent\n"
+			       "                         (default timeout 30 seconds)\n"
 			       "  -h                     print this text\n"
 			       "\n");
 			goto exit;
@@ -328,18 +567,53 @@ int main(int argc, char *argv[], char *envp[])
 		}
 	}
 
+	sysfd = open("/sys", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (sysfd < 0) {
+		err("unable to open /sys: %s\n", strerror(errno));
+		failed = 1;
+		goto exit;
+	}
+
+	/* listen before triggering, so no event can slip by */
+	if (settle_timeout && !dry_run) {
+		uevent_fd = uevent_open();
+		if (uevent_fd < 0)
+			failed = 1;
+		start_seqnum = uevent_seqnum();
+	}
+
+	if (jobs > 1 && !dry_run)
+		nworkers = start_workers(workers);
+	if (!nworkers)
+		jobs = 1;
 
 	/* if we have /sys/subsystem, forget all the old stuff */
-	scan_subsystem("bus");
-	scan_class();
+	scan_subsystem(sysfd, "bus");
+	scan_class(sysfd);
 
 	/* scan "block" if it isn't a "class" */
-	strlcpy(base, "/sys/class/block", sizeof(base));
-	if (stat(base, &statbuf) != 0)
-		scan_block();
+	if (fstatat(sysfd, "class/block", &statbuf, 0) != 0)
+		scan_block(sysfd);
+
+	if (nworkers)
+		stop_workers(workers, nworkers);
+
+	close(sysfd);
+
+	if (uevent_fd >= 0) {
+		/* every write has returned, so this covers all our events */
+		seqnum = uevent_seqnum();
+
+		if (seqnum > start_seqnum && uevent_settle(uevent_fd, seqnum, settle_timeout) != 0) {
+			err("timeout waiting for event %llu\n", seqnum);
+			failed = 1;
+		}
+
+		close(uevent_fd);
+	}
 
 exit:
 
 	closelog();
-	return 0;
+	return failed;
 }
@@ -45,6 +45,7 @@
 #include <netlink/cache.h>
 #include <netlink/object.h>
 #include <netlink/utils.h>
+#include <netlink/hashtable.h>
 
 /**
  * @name Access Functions
@@ -183,6 +184,15 @@ struct nl_cache *nl_cache_alloc(struct nl_cache_ops *ops)
 	nl_init_list_head(&cache->c_items);
 	cache->c_ops = ops;
 
+	/* Index the objects if their type knows how to generate a key */
+	if (ops->co_obj_ops->oo_keygen) {
+		cache->c_hashtable = nl_hash_table_alloc(NL_HASH_MIN_SIZE);
+		if (!cache->c_hashtable) {
+			free(cache);
+			return NULL;
+		}
+	}
+
 	NL_DBG(2, "Allocated cache %p <%s>.\n", cache, nl_cache_name(cache));
 
 	return cache;
@@ -292,6 +302,7 @@ void nl_cache_free(struct nl_cache *cache)
 
 	nl_cache_clear(cache);
 	NL_DBG(1, "Freeing cache %p <%s>...\n", cache, nl_cache_name(cache));
+	nl_hash_table_free(cache->c_hashtable);
 	free(cache);
 }
 
@@ -304,6 +315,14 @@ void nl_cache_free(struct nl_cache *cache)
 
 static int __cache_add(struct nl_cache *cache, struct nl_object *obj)
 {
+	int err;
+
+	if (cache->c_hashtable) {
+		err = nl_hash_table_add(cache->c_hashtable, obj);
+		if (err < 0)
+			return err;
+	}
+
 	obj->ce_cache = cache;
 
 	nl_list_add_tail(&obj->ce_list, &cache->c_items);
@@ -328,6 +347,7 @@ static int __cache_add(struct nl_cache *cache, struct nl_object *obj)
 int nl_cache_add(struct nl_cache *cache, struct nl_object *obj)
 {
 	struct nl_object *new;
+	int err;
 
 	if (cache->c_ops->co_obj_ops != obj->ce_ops)
 		return -NLE_OBJ_MISMATCH;
@@ -341,10 +361,13 @@ int nl_cache_add(struct nl_cache *cache, struct nl_object *obj)
 		new = obj;
 	}
 
-	return __cache_add(cache, new);
+	err = __cache_add(cache, new);
+	if (err < 0)
+		nl_object_put(new);
+
+	return err;
 }
 
-#ifdef disabled
 /**
  * Move object from one cache to another
  * @arg cache		Cache to move object to.
@@ -357,6 +380,8 @@ int nl_cache_add(struct nl_cache *cache, struct nl_object *obj)
  */
 int nl_cache_move(struct nl_cache *cache, struct nl_object *obj)
 {
+	int err;
+
 	if (cache->c_ops->co_obj_ops != obj->ce_ops)
 		return -NLE_OBJ_MISMATCH;
 
@@ -369,9 +394,12 @@ int nl_cache_move(struct nl_cache *cache, struct nl_object *obj)
 	if (!nl_list_empty(&obj->ce_list))
 		nl_cache_remove(obj);
 
-	return __cache_add(cache, obj);
+	err = __cache_add(cache, obj);
+	if (err < 0)
+		nl_object_put(obj);
+
+	return err;
 }
-#endif
 
 /**
  * Removes an object from a cache.
@@ -388,6 +416,9 @@ void nl_cache_remove(struct nl_object *obj)
 	if (cache == NULL)
 		return;
 
+	if (cache->c_hashtable)
+		nl_hash_table_del(cache->c_hashtable, obj);
+
 	nl_list_del(&obj->ce_list);
 	obj->ce_cache = NULL;
 	nl_object_put(obj);
@@ -397,14 +428,14 @@ void nl_cache_remove(struct nl_object *obj)
 	       obj, cache, nl_cache_name(cache));
 }
 
-#ifdef disabled
 /**
  * Search for an object in a cache
  * @arg cache		Cache to search in.
  * @arg needle		Object to look for.
  *
- * Iterates over the cache and looks for an object with identical
- * identifiers as the needle.
+ * Looks for an object with identical identifiers as the needle, through
+ * the hash index if the cache has one and by iterating over the cache
+ * otherwise.
  *
  * @return Reference to object or NULL if not found.
  * @note The returned object must be returned via nl_object_put().
@@ -414,6 +445,14 @@ struct nl_object *nl_cache_search(struct nl_cache *cache,
 {
 	struct nl_object *obj;
 
+	if (cache->c_hashtable) {
+		obj = nl_hash_table_lookup(cache->c_hashtable, needle);
+		if (obj)
+			nl_object_get(obj);
+
+		return obj;
+	}
+
 	nl_list_for_each_entry(obj, &cache->c_items, ce_list) {
 		if (nl_object_identical(obj, needle)) {
 			nl_object_get(obj);
@@ -423,7 +462,6 @@ struct nl_object *nl_cache_search(struct nl_cache *cache,
 
 	return NULL;
 }
-#endif
 
 /** @} */
 
@@ -523,7 +561,6 @@ int nl_cache_pickup(struct nl_sock *sk, struct nl_cache *cache)
 	return __cache_pickup(sk, cache, &p);
 }
 
-#ifdef disabled
 static int cache_include(struct nl_cache *cache, struct nl_object *obj,
 			 struct nl_msgtype *type, change_func_t cb)
 {
@@ -623,7 +660,6 @@ int nl_cache_resync(struct nl_sock *sk, struct nl_cache *cache,
 errout:
 	return err;
 }
-#endif
 
 /** @} */
 
@@ -702,7 +738,6 @@ int nl_cache_refill(struct nl_sock *sk, struct nl_cache *cache)
 }
 
 /** @} */
-#ifdef disabled
 
 /**
  * @name Utillities
@@ -725,6 +760,7 @@ void nl_cache_mark_all(struct nl_cache *cache)
 }
 
 /** @} */
+#ifdef disabled
 
 /**
  * @name Dumping
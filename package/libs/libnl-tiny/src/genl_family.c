@@ -22,6 +22,7 @@
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
 #include <netlink/utils.h>
+#include <netlink/hashtable.h>
 
 struct nl_object_ops genl_family_ops;
 /** @endcond */
@@ -83,6 +84,13 @@ static int family_compare(struct nl_object *_a, struct nl_object *_b,
 	return diff;
 }
 
+static uint32_t family_keygen(struct nl_object *_obj)
+{
+	struct genl_family *family = (struct genl_family *) _obj;
+	uint32_t id = family->gf_id;
+
+	return nl_hash(&id, sizeof(id), 0);
+}
 
 /**
  * @name Family Object
@@ -129,6 +137,7 @@ struct nl_object_ops genl_family_ops = {
 	.oo_free_data		= family_free_data,
 	.oo_clone		= family_clone,
 	.oo_compare		= family_compare,
+	.oo_keygen		= family_keygen,
 	.oo_id_attrs		= FAMILY_ATTR_ID,
 };
 /** @endcond */
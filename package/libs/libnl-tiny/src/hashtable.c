@@ -0,0 +1,263 @@
+/*
+ * lib/hashtable.c		Netlink hashtable Utilities
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+/**
+ * @ingroup cache
+ * @defgroup hashtable Hashtable
+ *
+ * Index of cached objects keyed on their identity attributes. The key
+ * of an object is provided by nl_object_ops::oo_keygen and must only
+ * depend on the attributes listed in oo_id_attrs, so that objects
+ * considered identical by nl_object_identical() end up in the same
+ * bucket. Objects of types without a key generator, or lacking some of
+ * their identity attributes, are not indexed.
+ *
+ * @{
+ */
+
+#include <netlink-local.h>
+#include <netlink/object.h>
+#include <netlink/hashtable.h>
+
+/**
+ * Hash a block of memory
+ * @arg data		data to hash
+ * @arg len		length of data in bytes
+ * @arg seed		initial value, allows chaining several blocks
+ *
+ * Bob Jenkins' one-at-a-time hash.
+ *
+ * @return 32 bit hash value.
+ */
+uint32_t nl_hash(const void *data, size_t len, uint32_t seed)
+{
+	const unsigned char *p = data;
+	uint32_t h = seed;
+
+	while (len--) {
+		h += *p++;
+		h += h << 10;
+		h ^= h >> 6;
+	}
+
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+
+	return h;
+}
+
+/**
+ * Allocate a hashtable
+ * @arg size		initial number of buckets, rounded up to a power of 2
+ *
+ * @return A new hashtable or NULL.
+ */
+struct nl_hash_table *nl_hash_table_alloc(unsigned int size)
+{
+	struct nl_hash_table *ht;
+	unsigned int n = NL_HASH_MIN_SIZE;
+
+	while (n < size)
+		n <<= 1;
+
+	ht = calloc(1, sizeof(*ht));
+	if (!ht)
+		return NULL;
+
+	ht->nodes = calloc(n, sizeof(*ht->nodes));
+	if (!ht->nodes) {
+		free(ht);
+		return NULL;
+	}
+
+	ht->size = n;
+
+	return ht;
+}
+
+/**
+ * Free a hashtable
+ * @arg ht		hashtable
+ *
+ * Only the index is freed, the objects are not touched.
+ */
+void nl_hash_table_free(struct nl_hash_table *ht)
+{
+	struct nl_hash_node *node, *next;
+	unsigned int i;
+
+	if (!ht)
+		return;
+
+	for (i = 0; i < ht->size; i++) {
+		for (node = ht->nodes[i]; node; node = next) {
+			next = node->next;
+			free(node);
+		}
+	}
+
+	free(ht->nodes);
+	free(ht);
+}
+
+static int nl_object_keygen(struct nl_object *obj, uint32_t *key)
+{
+	struct nl_object_ops *ops = obj->ce_ops;
+
+	if (!ops->oo_keygen ||
+	    (obj->ce_mask & ops->oo_id_attrs) != ops->oo_id_attrs)
+		return -NLE_OPNOTSUPP;
+
+	*key = ops->oo_keygen(obj);
+
+	return 0;
+}
+
+static void hash_table_grow(struct nl_hash_table *ht)
+{
+	struct nl_hash_node **nodes, **tail, *node, *next;
+	unsigned int size = ht->size << 1;
+	unsigned int i;
+
+	/* Keep the old table if we can't get a bigger one, lookups
+	 * just get slower */
+	nodes = calloc(size, sizeof(*nodes));
+	if (!nodes)
+		return;
+
+	for (i = 0; i < ht->size; i++) {
+		for (node = ht->nodes[i]; node; node = next) {
+			next = node->next;
+
+			/* append to preserve the insertion order */
+			tail = &nodes[node->key & (size - 1)];
+			while (*tail)
+				tail = &(*tail)->next;
+			node->next = NULL;
+			*tail = node;
+		}
+	}
+
+	free(ht->nodes);
+	ht->nodes = nodes;
+	ht->size = size;
+
+	NL_DBG(2, "Grew hashtable %p to %u buckets\n", ht, size);
+}
+
+/**
+ * Add an object to a hashtable
+ * @arg ht		hashtable
+ * @arg obj		object to index
+ *
+ * Objects with identical identifiers may be added more than once, a
+ * lookup returns the one added first.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int nl_hash_table_add(struct nl_hash_table *ht, struct nl_object *obj)
+{
+	struct nl_hash_node *node, **tail;
+	uint32_t key;
+
+	if (nl_object_keygen(obj, &key) < 0)
+		return 0;
+
+	node = malloc(sizeof(*node));
+	if (!node)
+		return -NLE_NOMEM;
+
+	node->key = key;
+	node->obj = obj;
+	node->next = NULL;
+	obj->ce_flags |= NL_OBJ_HASHED;
+
+	if (ht->nitems >= ht->size)
+		hash_table_grow(ht);
+
+	tail = &ht->nodes[key & (ht->size - 1)];
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = node;
+	ht->nitems++;
+
+	return 0;
+}
+
+static int hash_table_unlink(struct nl_hash_table *ht, unsigned int bucket,
+			     struct nl_object *obj)
+{
+	struct nl_hash_node **pos, *node;
+
+	for (pos = &ht->nodes[bucket]; (node = *pos); pos = &node->next) {
+		if (node->obj == obj) {
+			*pos = node->next;
+			free(node);
+			ht->nitems--;
+			obj->ce_flags &= ~NL_OBJ_HASHED;
+			return 0;
+		}
+	}
+
+	return -NLE_OBJ_NOTFOUND;
+}
+
+/**
+ * Remove an object from a hashtable
+ * @arg ht		hashtable
+ * @arg obj		object to remove
+ *
+ * @return 0 on success or a negative error code.
+ */
+int nl_hash_table_del(struct nl_hash_table *ht, struct nl_object *obj)
+{
+	unsigned int i;
+	uint32_t key;
+
+	if (!(obj->ce_flags & NL_OBJ_HASHED))
+		return -NLE_OBJ_NOTFOUND;
+
+	if (nl_object_keygen(obj, &key) == 0 &&
+	    hash_table_unlink(ht, key & (ht->size - 1), obj) == 0)
+		return 0;
+
+	/* The identifiers of the object may have been modified while
+	 * it was in the cache, don't leave a stale node behind. */
+	for (i = 0; i < ht->size; i++)
+		if (hash_table_unlink(ht, i, obj) == 0)
+			return 0;
+
+	return -NLE_OBJ_NOTFOUND;
+}
+
+/**
+ * Look up an object with identical identifiers
+ * @arg ht		hashtable
+ * @arg needle		object to look for
+ *
+ * @return The indexed object or NULL, no reference is taken.
+ */
+struct nl_object *nl_hash_table_lookup(struct nl_hash_table *ht,
+				       struct nl_object *needle)
+{
+	struct nl_hash_node *node;
+	uint32_t key;
+
+	if (nl_object_keygen(needle, &key) < 0)
+		return NULL;
+
+	for (node = ht->nodes[key & (ht->size - 1)]; node; node = node->next)
+		if (node->key == key && nl_object_identical(node->obj, needle))
+			return node->obj;
+
+	return NULL;
+}
+
+/** @} */
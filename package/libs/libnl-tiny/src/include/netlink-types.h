@@ -17,6 +17,7 @@
 struct nl_cache_ops;
 struct nl_sock;
 struct nl_object;
+struct nl_hash_table;
 
 struct nl_cache
 {
@@ -25,6 +26,7 @@ struct nl_cache
 	int                     c_iarg1;
 	int                     c_iarg2;
 	struct nl_cache_ops *   c_ops;
+	struct nl_hash_table *	c_hashtable;
 };
 
 struct nl_cache_assoc
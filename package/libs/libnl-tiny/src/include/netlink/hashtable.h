@@ -0,0 +1,54 @@
+/*
+ * netlink/hashtable.h		Netlink hashtable Utilities
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#ifndef NETLINK_HASHTABLE_H_
+#define NETLINK_HASHTABLE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nl_object;
+
+struct nl_hash_node
+{
+	uint32_t		key;
+	struct nl_object *	obj;
+	struct nl_hash_node *	next;
+};
+
+struct nl_hash_table
+{
+	unsigned int		size;
+	unsigned int		nitems;
+	struct nl_hash_node **	nodes;
+};
+
+/* Minimum number of buckets, the table doubles as it fills up */
+#define NL_HASH_MIN_SIZE	16
+
+extern struct nl_hash_table *	nl_hash_table_alloc(unsigned int);
+extern void			nl_hash_table_free(struct nl_hash_table *);
+
+extern int			nl_hash_table_add(struct nl_hash_table *,
+						  struct nl_object *);
+extern int			nl_hash_table_del(struct nl_hash_table *,
+						  struct nl_object *);
+extern struct nl_object *	nl_hash_table_lookup(struct nl_hash_table *,
+						     struct nl_object *);
+
+extern uint32_t			nl_hash(const void *, size_t, uint32_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
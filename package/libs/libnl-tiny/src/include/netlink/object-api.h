@@ -318,6 +318,15 @@ struct nl_object_ops
 	int   (*oo_compare)(struct nl_object *, struct nl_object *,
 			    uint32_t, int);
 
+	/**
+	 * Hash key generator
+	 *
+	 * Optional, enables the hash index of caches holding objects
+	 * of this type. Must only depend on the attributes listed in
+	 * oo_id_attrs, it is not called for objects lacking any of them.
+	 */
+	uint32_t (*oo_keygen)(struct nl_object *);
+
 
 	char *(*oo_attrs2str)(int, char *, size_t);
 };
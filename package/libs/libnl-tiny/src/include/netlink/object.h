@@ -21,6 +21,7 @@ extern "C" {
 #endif
 
 #define NL_OBJ_MARK		1
+#define NL_OBJ_HASHED		2
 
 struct nl_cache;
 struct nl_object;
@@ -38,6 +39,11 @@ extern struct nl_object *	nl_object_alloc(struct nl_object_ops *);
 extern void			nl_object_free(struct nl_object *);
 extern struct nl_object *	nl_object_clone(struct nl_object *obj);
 
+extern uint32_t			nl_object_diff(struct nl_object *,
+					       struct nl_object *);
+extern int			nl_object_identical(struct nl_object *,
+						    struct nl_object *);
+
 #ifdef disabled
 
 extern int			nl_object_alloc_name(const char *,
@@ -45,12 +51,8 @@ extern int			nl_object_alloc_name(const char *,
 extern void			nl_object_dump(struct nl_object *,
 					       struct nl_dump_params *);
 
-extern uint32_t			nl_object_diff(struct nl_object *,
-					       struct nl_object *);
 extern int			nl_object_match_filter(struct nl_object *,
 						       struct nl_object *);
-extern int			nl_object_identical(struct nl_object *,
-						    struct nl_object *);
 extern char *			nl_object_attrs2str(struct nl_object *,
 						    uint32_t attrs, char *buf,
 						    size_t);
@@ -24,6 +24,8 @@ extern "C" {
 #define NL_OWN_PORT		(1<<2)
 #define NL_MSG_PEEK		(1<<3)
 #define NL_NO_AUTO_ACK		(1<<4)
+#define NL_NO_RX_ARENA		(1<<5)
+#define NL_SOCK_RX_BUSY		(1<<6)
 
 struct nl_cb;
 struct nl_sock
@@ -36,6 +38,9 @@ struct nl_sock
 	unsigned int		s_seq_expect;
 	int			s_flags;
 	struct nl_cb *		s_cb;
+	unsigned char *		s_rx_buf;
+	size_t			s_rx_bufsize;
+	struct nl_msg *		s_rx_msg;
 };
 
 
@@ -97,6 +102,30 @@ static inline void nl_socket_enable_auto_ack(struct nl_sock *sk)
 	sk->s_flags &= ~NL_NO_AUTO_ACK;
 }
 
+/**
+ * Disable the receive arena
+ * @arg sk		Netlink socket.
+ *
+ * By default nl_recvmsgs() keeps its receive buffer attached to the
+ * socket and hands callbacks a message that points into it instead of
+ * a private copy. This function restores the old behaviour of one
+ * buffer per read and one allocated message per netlink message.
+ */
+static inline void nl_socket_disable_rx_arena(struct nl_sock *sk)
+{
+	sk->s_flags |= NL_NO_RX_ARENA;
+}
+
+/**
+ * Enable the receive arena (default)
+ * @arg sk		Netlink socket.
+ * @see nl_socket_disable_rx_arena
+ */
+static inline void nl_socket_enable_rx_arena(struct nl_sock *sk)
+{
+	sk->s_flags &= ~NL_NO_RX_ARENA;
+}
+
 /**
  * @name Source Idenficiation
  * @{
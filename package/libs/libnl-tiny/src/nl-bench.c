@@ -0,0 +1,426 @@
+/*
+ * nl-bench - replay a netlink dump through nl_recvmsgs()
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ *
+ * Feeds a recorded multipart dump to nl_recvmsgs() by standing in for
+ * recvmsg(), once with the receive arena and once without it, and reports
+ * the time and number of heap allocations made by the library. The
+ * allocation counters rely on linking with --wrap=malloc,calloc,realloc.
+ *
+ * A recording is a sequence of datagrams, each prefixed with its length
+ * as a 32 bit value in host byte order. Without -f a scan-like dump of
+ * generic netlink messages is synthesized; -w saves it for later runs.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/genl/genl.h>
+
+#define DEFAULT_MSGS	16384
+#define DEFAULT_LOOPS	8
+
+/* roughly NLMSG_GOODSIZE on a 4k page kernel */
+#define DGRAM_SIZE	3584
+
+#define BENCH_FAMILY	0x20
+
+enum {
+	BENCH_ATTR_UNSPEC,
+	BENCH_ATTR_IFINDEX,
+	BENCH_ATTR_BSS,
+	__BENCH_ATTR_MAX,
+};
+#define BENCH_ATTR_MAX (__BENCH_ATTR_MAX - 1)
+
+enum {
+	BENCH_BSS_UNSPEC,
+	BENCH_BSS_BSSID,
+	BENCH_BSS_FREQ,
+	BENCH_BSS_SIGNAL,
+	BENCH_BSS_IES,
+	__BENCH_BSS_MAX,
+};
+#define BENCH_BSS_MAX (__BENCH_BSS_MAX - 1)
+
+struct dgram {
+	uint32_t len;
+	unsigned char *data;
+};
+
+static struct dgram *dgrams;
+static int n_dgrams;
+static int replay_pos;
+static size_t replay_bytes;
+
+static unsigned long n_alloc;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	n_alloc++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	n_alloc++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	n_alloc++;
+	return __real_realloc(ptr, size);
+}
+
+/* replaces the libc version for the library objects linked in */
+ssize_t recvmsg(int fd, struct msghdr *msg, int flags)
+{
+	struct sockaddr_nl *nla = msg->msg_name;
+	struct dgram *d;
+	size_t len;
+
+	if (replay_pos >= n_dgrams) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	d = &dgrams[replay_pos];
+	len = d->len;
+	msg->msg_flags = 0;
+	if (len > msg->msg_iov[0].iov_len) {
+		len = msg->msg_iov[0].iov_len;
+		msg->msg_flags |= MSG_TRUNC;
+	}
+	memcpy(msg->msg_iov[0].iov_base, d->data, len);
+
+	memset(nla, 0, sizeof(*nla));
+	nla->nl_family = AF_NETLINK;
+	msg->msg_namelen = sizeof(*nla);
+	msg->msg_controllen = 0;
+
+	if (!(flags & MSG_PEEK))
+		replay_pos++;
+
+	return (flags & MSG_TRUNC) ? d->len : len;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int add_dgram(const void *data, uint32_t len)
+{
+	struct dgram *d;
+
+	if (!(n_dgrams % 256)) {
+		d = realloc(dgrams, (n_dgrams + 256) * sizeof(*dgrams));
+		if (!d)
+			return -1;
+		dgrams = d;
+	}
+
+	d = &dgrams[n_dgrams];
+	d->data = malloc(len);
+	if (!d->data)
+		return -1;
+
+	memcpy(d->data, data, len);
+	d->len = len;
+	replay_bytes += len;
+	n_dgrams++;
+
+	return 0;
+}
+
+static int synthesize(int msgs)
+{
+	unsigned char buf[DGRAM_SIZE];
+	unsigned char ies[320];
+	unsigned char bssid[6];
+	struct nlmsghdr *nlh;
+	struct nl_msg *msg;
+	struct nlattr *bss;
+	size_t len = 0;
+	int i, type;
+
+	srand(1);
+	for (i = 0; i < sizeof(ies); i++)
+		ies[i] = rand();
+
+	for (i = 0; i <= msgs; i++) {
+		type = (i < msgs) ? BENCH_FAMILY : NLMSG_DONE;
+		msg = nlmsg_alloc_simple(type, NLM_F_MULTI);
+		if (!msg)
+			return -1;
+
+		nlmsg_hdr(msg)->nlmsg_seq = 1;
+		if (i < msgs) {
+			genlmsg_put(msg, 0, 1, type, 0, NLM_F_MULTI, 1, 0);
+			NLA_PUT_U32(msg, BENCH_ATTR_IFINDEX, 3);
+
+			bss = nla_nest_start(msg, BENCH_ATTR_BSS);
+			memset(bssid, i, sizeof(bssid));
+			NLA_PUT(msg, BENCH_BSS_BSSID, sizeof(bssid), bssid);
+			NLA_PUT_U32(msg, BENCH_BSS_FREQ, 2412 + (i % 13) * 5);
+			NLA_PUT_U32(msg, BENCH_BSS_SIGNAL, -4000 - (i % 50) * 100);
+			NLA_PUT(msg, BENCH_BSS_IES, 64 + rand() % 256, ies);
+			nla_nest_end(msg, bss);
+		} else {
+			nlmsg_append(msg, &i, sizeof(int), NLMSG_ALIGNTO);
+		}
+
+		nlh = nlmsg_hdr(msg);
+		if (len + NLMSG_ALIGN(nlh->nlmsg_len) > sizeof(buf)) {
+			if (add_dgram(buf, len))
+				goto nla_put_failure;
+			len = 0;
+		}
+
+		memcpy(buf + len, nlh, nlh->nlmsg_len);
+		len += NLMSG_ALIGN(nlh->nlmsg_len);
+		nlmsg_free(msg);
+	}
+
+	return add_dgram(buf, len);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -1;
+}
+
+static int load(const char *file)
+{
+	unsigned char *buf = NULL;
+	uint32_t len;
+	FILE *f;
+	int ret = -1;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror("fopen");
+		return -1;
+	}
+
+	while (fread(&len, sizeof(len), 1, f) == 1) {
+		buf = realloc(buf, len);
+		if (!buf || fread(buf, 1, len, f) != len)
+			goto out;
+		if (add_dgram(buf, len))
+			goto out;
+	}
+	ret = n_dgrams ? 0 : -1;
+
+out:
+	free(buf);
+	fclose(f);
+	return ret;
+}
+
+static int save(const char *file)
+{
+	FILE *f;
+	int i;
+
+	f = fopen(file, "w");
+	if (!f) {
+		perror("fopen");
+		return -1;
+	}
+
+	for (i = 0; i < n_dgrams; i++) {
+		fwrite(&dgrams[i].len, sizeof(dgrams[i].len), 1, f);
+		fwrite(dgrams[i].data, 1, dgrams[i].len, f);
+	}
+
+	return fclose(f);
+}
+
+struct bench_state {
+	unsigned long msgs;
+	unsigned long sum;
+	struct nl_msg *kept;
+};
+
+static int valid_handler(struct nl_msg *msg, void *arg)
+{
+	struct bench_state *st = arg;
+	struct nlattr *tb[BENCH_ATTR_MAX + 1];
+	struct nlattr *bss[BENCH_BSS_MAX + 1];
+
+	st->msgs++;
+
+	/* hold on to one message to check it survives the buffer reuse */
+	if (!st->kept) {
+		nlmsg_get(msg);
+		st->kept = msg;
+	}
+
+	if (genlmsg_parse(nlmsg_hdr(msg), 0, tb, BENCH_ATTR_MAX, NULL) < 0)
+		return NL_SKIP;
+
+	if (tb[BENCH_ATTR_IFINDEX])
+		st->sum += nla_get_u32(tb[BENCH_ATTR_IFINDEX]);
+
+	if (!tb[BENCH_ATTR_BSS] ||
+	    nla_parse_nested(bss, BENCH_BSS_MAX, tb[BENCH_ATTR_BSS], NULL))
+		return NL_SKIP;
+
+	if (bss[BENCH_BSS_FREQ])
+		st->sum += nla_get_u32(bss[BENCH_BSS_FREQ]);
+	if (bss[BENCH_BSS_SIGNAL])
+		st->sum += nla_get_u32(bss[BENCH_BSS_SIGNAL]);
+	if (bss[BENCH_BSS_IES])
+		st->sum += nla_len(bss[BENCH_BSS_IES]);
+
+	return NL_SKIP;
+}
+
+static int no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+static int check_kept(struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh;
+	int i;
+
+	for (i = 0; i < n_dgrams; i++) {
+		nlh = (struct nlmsghdr *) dgrams[i].data;
+		if (nlmsg_ok(nlh, dgrams[i].len) &&
+		    nlh->nlmsg_len == nlmsg_hdr(msg)->nlmsg_len &&
+		    !memcmp(nlh, nlmsg_hdr(msg), nlh->nlmsg_len))
+			return 0;
+	}
+
+	return -1;
+}
+
+static int bench(const char *name, int loops, int arena)
+{
+	struct bench_state st;
+	struct nl_sock *sk;
+	struct nl_cb *cb;
+	unsigned long allocs;
+	double t;
+	int i, err = 0;
+
+	sk = nl_socket_alloc();
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if (!sk || !cb)
+		return -1;
+
+	if (!arena)
+		nl_socket_disable_rx_arena(sk);
+
+	memset(&st, 0, sizeof(st));
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, valid_handler, &st);
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
+
+	allocs = n_alloc;
+	t = now();
+	for (i = 0; i < loops && !err; i++) {
+		replay_pos = 0;
+		err = nl_recvmsgs(sk, cb);
+
+		if (st.kept) {
+			if (check_kept(st.kept)) {
+				fprintf(stderr, "%s: retained message corrupted\n",
+					name);
+				err = -1;
+			}
+			nlmsg_free(st.kept);
+			st.kept = NULL;
+		}
+	}
+	t = now() - t;
+	allocs = n_alloc - allocs;
+
+	if (err < 0)
+		fprintf(stderr, "%s: nl_recvmsgs failed: %d\n", name, err);
+	else
+		printf("%-10s %8lu msgs %10lu allocs %8.1f MB/s  (sum %lu)\n",
+		       name, st.msgs, allocs,
+		       (double) replay_bytes * loops / (1024 * 1024) / t,
+		       st.sum);
+
+	nl_cb_put(cb);
+	nl_socket_free(sk);
+
+	return err;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-f <recording>] [-w <recording>] "
+		"[-n <msgs>] [-l <loops>]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	const char *in = NULL, *out = NULL;
+	int msgs = DEFAULT_MSGS;
+	int loops = DEFAULT_LOOPS;
+	int c;
+
+	while ((c = getopt(argc, argv, "f:w:n:l:")) != -1) {
+		switch (c) {
+		case 'f':
+			in = optarg;
+			break;
+		case 'w':
+			out = optarg;
+			break;
+		case 'n':
+			msgs = atoi(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (msgs < 1 || loops < 1)
+		usage(argv[0]);
+
+	if (in ? load(in) : synthesize(msgs)) {
+		fprintf(stderr, "Failed to set up the dump\n");
+		return EXIT_FAILURE;
+	}
+
+	if (out && save(out))
+		return EXIT_FAILURE;
+
+	printf("%zu bytes in %d datagrams, %d loops\n",
+	       replay_bytes, n_dgrams, loops);
+
+	if (bench("copy", loops, 0) || bench("arena", loops, 1))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -356,27 +356,8 @@ errout:
  * @{
  */
 
-/**
- * Receive data from netlink socket
- * @arg sk		Netlink socket.
- * @arg nla		Destination pointer for peer's netlink address.
- * @arg buf		Destination pointer for message content.
- * @arg creds		Destination pointer for credentials.
- *
- * Receives a netlink message, allocates a buffer in \c *buf and
- * stores the message content. The peer's netlink address is stored
- * in \c *nla. The caller is responsible for freeing the buffer allocated
- * in \c *buf if a positive value is returned.  Interruped system calls
- * are handled by repeating the read. The input buffer size is determined
- * by peeking before the actual read is done.
- *
- * A non-blocking sockets causes the function to return immediately with
- * a return value of 0 if no data is available.
- *
- * @return Number of octets read, 0 on EOF or a negative error code.
- */
-int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
-	    unsigned char **buf, struct ucred **creds)
+static int __nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+		     unsigned char **buf, size_t *size, struct ucred **creds)
 {
 	int n;
 	int flags = 0;
@@ -392,6 +373,7 @@ int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
 		.msg_flags = 0,
 	};
 	struct cmsghdr *cmsg;
+	void *tmp;
 
 	if (sk->s_flags & NL_MSG_PEEK)
 		flags |= MSG_PEEK;
@@ -399,8 +381,15 @@ int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
 	if (page_size == 0)
 		page_size = getpagesize();
 
-	iov.iov_len = page_size;
-	iov.iov_base = *buf = malloc(iov.iov_len);
+	if (!*buf) {
+		*size = page_size;
+		*buf = malloc(*size);
+		if (!*buf)
+			return -NLE_NOMEM;
+	}
+
+	iov.iov_len = *size;
+	iov.iov_base = *buf;
 
 	if (sk->s_flags & NL_SOCK_PASSCRED) {
 		msg.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
@@ -420,7 +409,6 @@ retry:
 			goto abort;
 		} else {
 			free(msg.msg_control);
-			free(*buf);
 			return -nl_syserr2nlerr(errno);
 		}
 	}
@@ -429,8 +417,14 @@ retry:
 	    msg.msg_flags & MSG_TRUNC) {
 		/* Provided buffer is not long enough, enlarge it
 		 * and try again. */
+		tmp = realloc(*buf, iov.iov_len * 2);
+		if (!tmp) {
+			free(msg.msg_control);
+			return -NLE_NOMEM;
+		}
 		iov.iov_len *= 2;
-		iov.iov_base = *buf = realloc(*buf, iov.iov_len);
+		iov.iov_base = *buf = tmp;
+		*size = iov.iov_len;
 		goto retry;
 	} else if (msg.msg_flags & MSG_CTRUNC) {
 		msg.msg_controllen *= 2;
@@ -444,7 +438,6 @@ retry:
 
 	if (msg.msg_namelen != sizeof(struct sockaddr_nl)) {
 		free(msg.msg_control);
-		free(*buf);
 		return -NLE_NOADDR;
 	}
 
@@ -462,7 +455,111 @@ retry:
 
 abort:
 	free(msg.msg_control);
-	free(*buf);
+	return 0;
+}
+
+/**
+ * Receive data from netlink socket
+ * @arg sk		Netlink socket.
+ * @arg nla		Destination pointer for peer's netlink address.
+ * @arg buf		Destination pointer for message content.
+ * @arg creds		Destination pointer for credentials.
+ *
+ * Receives a netlink message, allocates a buffer in \c *buf and
+ * stores the message content. The peer's netlink address is stored
+ * in \c *nla. The caller is responsible for freeing the buffer allocated
+ * in \c *buf if a positive value is returned.  Interruped system calls
+ * are handled by repeating the read. The input buffer size is determined
+ * by peeking before the actual read is done.
+ *
+ * A non-blocking sockets causes the function to return immediately with
+ * a return value of 0 if no data is available.
+ *
+ * @return Number of octets read, 0 on EOF or a negative error code.
+ */
+int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+	    unsigned char **buf, struct ucred **creds)
+{
+	size_t size;
+	int n;
+
+	*buf = NULL;
+	n = __nl_recv(sk, nla, buf, &size, creds);
+	if (n <= 0) {
+		free(*buf);
+		*buf = NULL;
+	}
+
+	return n;
+}
+
+/*
+ * Messages handed to the callbacks by recvmsgs() are views: the nl_msg
+ * is owned by the socket and nm_nlh points into the receive buffer, so
+ * parsing a dump costs no allocation per message. A callback that wants
+ * to keep the message past its return takes a reference with
+ * nlmsg_get(), in which case the view is turned into a regular message
+ * with a private copy of the header before the buffer is reused.
+ */
+static struct nl_msg *rx_msg_get(struct nl_sock *sk, struct nlmsghdr *hdr,
+				 int view)
+{
+	struct nl_msg *nm;
+
+	if (!view)
+		return nlmsg_convert(hdr);
+
+	nm = sk->s_rx_msg;
+	if (!nm) {
+		nm = malloc(sizeof(*nm));
+		if (!nm)
+			return NULL;
+		sk->s_rx_msg = nm;
+	}
+
+	memset(nm, 0, sizeof(*nm));
+	nm->nm_protocol = -1;
+	nm->nm_flags = NL_MSG_VIEW;
+	nm->nm_nlh = hdr;
+	nm->nm_size = hdr->nlmsg_len;
+	nm->nm_refcnt = 1;
+
+	return nm;
+}
+
+static int rx_msg_put(struct nl_sock *sk, struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh;
+
+	if (!msg)
+		return 0;
+
+	if (!(msg->nm_flags & NL_MSG_VIEW)) {
+		nlmsg_free(msg);
+		return 0;
+	}
+
+	if (msg->nm_refcnt == 1)
+		return 0;
+
+	/* The message outlives the buffer, detach it from the socket */
+	sk->s_rx_msg = NULL;
+	msg->nm_flags &= ~NL_MSG_VIEW;
+	msg->nm_refcnt--;
+
+	nlh = malloc(NLMSG_ALIGN(msg->nm_nlh->nlmsg_len));
+	if (!nlh) {
+		msg->nm_nlh = NULL;
+		msg->nm_size = 0;
+		return -NLE_NOMEM;
+	}
+
+	memcpy(nlh, msg->nm_nlh, msg->nm_nlh->nlmsg_len);
+	msg->nm_nlh = nlh;
+	msg->nm_size = NLMSG_ALIGN(nlh->nlmsg_len);
+
+	NL_DBG(2, "msg %p: Detached from receive buffer\n", msg);
+
 	return 0;
 }
 
@@ -484,22 +581,35 @@ do { \
 
 static int recvmsgs(struct nl_sock *sk, struct nl_cb *cb)
 {
-	int n, err = 0, multipart = 0;
+	int n, err = 0, multipart = 0, arena;
 	unsigned char *buf = NULL;
 	struct nlmsghdr *hdr;
 	struct sockaddr_nl nla = {0};
 	struct nl_msg *msg = NULL;
 	struct ucred *creds = NULL;
 
+	/* A callback reading from the same socket again must not reuse
+	 * the buffer or the view of the outer call. */
+	arena = !(sk->s_flags & (NL_NO_RX_ARENA | NL_SOCK_RX_BUSY));
+	if (arena)
+		sk->s_flags |= NL_SOCK_RX_BUSY;
+
 continue_reading:
 	NL_DBG(3, "Attempting to read from %p\n", sk);
 	if (cb->cb_recv_ow)
 		n = cb->cb_recv_ow(sk, &nla, &buf, &creds);
-	else
+	else if (arena) {
+		n = __nl_recv(sk, &nla, &sk->s_rx_buf, &sk->s_rx_bufsize,
+			      &creds);
+		buf = sk->s_rx_buf;
+	} else
 		n = nl_recv(sk, &nla, &buf, &creds);
 
-	if (n <= 0)
-		return n;
+	if (n <= 0) {
+		err = n;
+		buf = NULL;
+		goto done;
+	}
 
 	NL_DBG(3, "recvmsgs(%p): Read %d bytes\n", sk, n);
 
@@ -507,9 +617,9 @@ continue_reading:
 	while (nlmsg_ok(hdr, n)) {
 		NL_DBG(3, "recgmsgs(%p): Processing valid message...\n", sk);
 
-		nlmsg_free(msg);
-		msg = nlmsg_convert(hdr);
-		if (!msg) {
+		err = rx_msg_put(sk, msg);
+		msg = rx_msg_get(sk, hdr, arena);
+		if (err < 0 || !msg) {
 			err = -NLE_NOMEM;
 			goto out;
 		}
@@ -641,13 +751,17 @@ skip:
 		hdr = nlmsg_next(hdr, &n);
 	}
 	
-	nlmsg_free(msg);
-	free(buf);
+	err = rx_msg_put(sk, msg);
+	if (buf != sk->s_rx_buf)
+		free(buf);
 	free(creds);
 	buf = NULL;
 	msg = NULL;
 	creds = NULL;
 
+	if (err < 0)
+		goto done;
+
 	if (multipart) {
 		/* Multipart message not yet complete, continue reading */
 		goto continue_reading;
@@ -655,9 +769,14 @@ skip:
 stop:
 	err = 0;
 out:
-	nlmsg_free(msg);
-	free(buf);
+	if (rx_msg_put(sk, msg) < 0 && !err)
+		err = -NLE_NOMEM;
+	if (buf != sk->s_rx_buf)
+		free(buf);
 	free(creds);
+done:
+	if (arena)
+		sk->s_flags &= ~NL_SOCK_RX_BUSY;
 
 	return err;
 }
@@ -675,6 +794,11 @@ out:
  * A non-blocking sockets causes the function to return immediately if
  * no data is available.
  *
+ * Unless the receive arena is disabled with nl_socket_disable_rx_arena(),
+ * the message passed to the callbacks is only valid until the callback
+ * returns. Callbacks that keep it around must take a reference using
+ * nlmsg_get().
+ *
  * @return 0 on success or a negative error code from nl_recv().
  */
 int nl_recvmsgs(struct nl_sock *sk, struct nl_cb *cb)
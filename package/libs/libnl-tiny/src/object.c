@@ -163,17 +163,6 @@ void nl_object_free(struct nl_object *obj)
  * @{
  */
 
-#ifdef disabled
-/**
- * Dump this object according to the specified parameters
- * @arg obj		object to dump
- * @arg params		dumping parameters
- */
-void nl_object_dump(struct nl_object *obj, struct nl_dump_params *params)
-{
-	dump_from_ops(obj, params);
-}
-
 /**
  * Check if the identifiers of two objects are identical 
  * @arg a		an object
@@ -227,6 +216,17 @@ uint32_t nl_object_diff(struct nl_object *a, struct nl_object *b)
 	return ops->oo_compare(a, b, ~0, 0);
 }
 
+#ifdef disabled
+/**
+ * Dump this object according to the specified parameters
+ * @arg obj		object to dump
+ * @arg params		dumping parameters
+ */
+void nl_object_dump(struct nl_object *obj, struct nl_dump_params *params)
+{
+	dump_from_ops(obj, params);
+}
+
 /**
  * Match a filter against an object
  * @arg obj		object to check
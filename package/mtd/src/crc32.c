@@ -38,6 +38,7 @@
  */
 
 #include <stdint.h>
+#include "crc32.h"
 
 const uint32_t crc32_table[256] = {
 	0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
@@ -93,3 +94,123 @@ const uint32_t crc32_table[256] = {
 	0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
 	0x2d02ef8dL
 };
+
+/*
+ * Slice-by-8: crc32_slice[k][n] is the CRC of byte n followed by k zero
+ * bytes, so eight input bytes can be folded with independent lookups
+ * instead of a serial chain of eight.  The words are assembled from
+ * single bytes to stay independent of host endianness and alignment.
+ */
+static uint32_t crc32_slice[8][256];
+static int crc32_slice_ready;
+
+static void
+crc32_slice_init(void)
+{
+	uint32_t val;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		val = crc32_table[i];
+		crc32_slice[0][i] = val;
+		for (k = 1; k < 8; k++) {
+			val = crc32_table[val & 0xff] ^ (val >> 8);
+			crc32_slice[k][i] = val;
+		}
+	}
+	crc32_slice_ready = 1;
+}
+
+uint32_t
+crc32(uint32_t val, const void *ss, int len)
+{
+	const unsigned char *s = ss;
+	uint32_t lo, hi;
+
+	if (!crc32_slice_ready)
+		crc32_slice_init();
+
+	while (len >= 8) {
+		lo = val ^ (s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t) s[3] << 24));
+		hi = s[4] | (s[5] << 8) | (s[6] << 16) | ((uint32_t) s[7] << 24);
+		val = crc32_slice[7][lo & 0xff] ^
+		      crc32_slice[6][(lo >> 8) & 0xff] ^
+		      crc32_slice[5][(lo >> 16) & 0xff] ^
+		      crc32_slice[4][lo >> 24] ^
+		      crc32_slice[3][hi & 0xff] ^
+		      crc32_slice[2][(hi >> 8) & 0xff] ^
+		      crc32_slice[1][(hi >> 16) & 0xff] ^
+		      crc32_slice[0][hi >> 24];
+		s += 8;
+		len -= 8;
+	}
+
+	while (--len >= 0)
+		val = crc32_table[(val ^ *s++) & 0xff] ^ (val >> 8);
+
+	return val;
+}
+
+/* multiply the 32x32 GF(2) matrix mat by the vector vec */
+static uint32_t
+gf2_matrix_times(const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	while (vec) {
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+
+	return sum;
+}
+
+static void
+gf2_matrix_square(uint32_t *square, const uint32_t *mat)
+{
+	int n;
+
+	for (n = 0; n < 32; n++)
+		square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+uint32_t
+crc32_combine(uint32_t val1, uint32_t val2, size_t len2)
+{
+	uint32_t even[32], odd[32];
+	uint32_t row = 1;
+	int n;
+
+	if (!len2)
+		return val1;
+
+	/* operator for one zero bit */
+	odd[0] = 0xedb88320;
+	for (n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+
+	/* two and four zero bits */
+	gf2_matrix_square(even, odd);
+	gf2_matrix_square(odd, even);
+
+	/* apply len2 zero bytes to val1, squaring the operator as we go */
+	do {
+		gf2_matrix_square(even, odd);
+		if (len2 & 1)
+			val1 = gf2_matrix_times(even, val1);
+		len2 >>= 1;
+		if (!len2)
+			break;
+
+		gf2_matrix_square(odd, even);
+		if (len2 & 1)
+			val1 = gf2_matrix_times(odd, val1);
+		len2 >>= 1;
+	} while (len2);
+
+	return val1 ^ val2;
+}
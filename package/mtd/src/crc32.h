@@ -2,19 +2,20 @@
 #define CRC32_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 extern const uint32_t crc32_table[256];
 
 /* Return a 32-bit CRC of the contents of the buffer. */
 
-static inline uint32_t
-crc32(uint32_t val, const void *ss, int len)
-{
-	const unsigned char *s = ss;
-	while (--len >= 0)
-		val = crc32_table[(val ^ *s++) & 0xff] ^ (val >> 8);
-	return val;
-}
+extern uint32_t crc32(uint32_t val, const void *ss, int len);
+
+/*
+ * Given val1 = crc32(x, A, len1) and val2 = crc32(0, B, len2), return
+ * crc32(x, AB, len1 + len2) without touching the data again.
+ */
+
+extern uint32_t crc32_combine(uint32_t val1, uint32_t val2, size_t len2);
 
 static inline unsigned int crc32buf(char *buf, size_t len)
 {
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <signal.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <fcntl.h>
@@ -38,6 +39,7 @@
 #include <sys/param.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/reboot.h>
 #include <linux/reboot.h>
 #include <mtd/mtd-user.h>
@@ -57,6 +59,7 @@ static char *jffs2file = NULL, *jffs2dir = JFFS2_DEFAULT_DIR;
 static int buflen = 0;
 int quiet;
 int no_erase;
+int compare;
 int mtdsize = 0;
 int erasesize = 0;
 
@@ -285,16 +288,226 @@ indicate_writing(const char *mtd)
 		fprintf(stderr, " [ ]");
 }
 
+/*
+ * Image reader stage: a helper thread fills one erase block sized slot
+ * while the main loop erases and writes the previous one. Full slots are
+ * handed over by swapping buffers. Data already read by image_check (e.g.
+ * the trx header) is moved to the start of the first slot, so every block
+ * after it is still handed over whole.
+ */
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int threaded;
+	int fd;
+	int size;
+	char *slot[2];
+	int len[2];
+	int full[2];
+	int rd;
+	int pos;
+	int prefill;
+	int eof;
+} reader;
+
+static int
+image_read_fill(int fd, char *dst, int len)
+{
+	int n = 0;
+	ssize_t r;
+
+	while (n < len) {
+		r = read(fd, dst + n, len - n);
+		if (r < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+
+			perror("read");
+			break;
+		}
+
+		if (r == 0)
+			break;
+
+		n += r;
+	}
+
+	return n;
+}
+
+static void *
+image_reader_thread(void *arg)
+{
+	int n, slot = 0;
+	int pre = reader.prefill;
+
+	do {
+		pthread_mutex_lock(&reader.lock);
+		while (reader.full[slot])
+			pthread_cond_wait(&reader.cond, &reader.lock);
+		pthread_mutex_unlock(&reader.lock);
+
+		n = pre + image_read_fill(reader.fd, reader.slot[slot] + pre,
+					  reader.size - pre);
+		pre = 0;
+
+		pthread_mutex_lock(&reader.lock);
+		reader.len[slot] = n;
+		reader.full[slot] = 1;
+		if (n < reader.size)
+			reader.eof = 1;
+		pthread_cond_broadcast(&reader.cond);
+		pthread_mutex_unlock(&reader.lock);
+
+		slot ^= 1;
+	} while (n == reader.size);
+
+	return NULL;
+}
+
+/* takes over the *len bytes already in buf if the thread could be started */
+static void
+image_reader_start(int fd, int size, const char *buf, int *len)
+{
+	memset(&reader, 0, sizeof(reader));
+	reader.fd = fd;
+	reader.size = size;
+
+	reader.slot[0] = malloc(size);
+	reader.slot[1] = malloc(size);
+	if (!reader.slot[0] || !reader.slot[1])
+		return;
+
+	if (*len > 0 && *len < size) {
+		memcpy(reader.slot[0], buf, *len);
+		reader.prefill = *len;
+	}
+
+	pthread_mutex_init(&reader.lock, NULL);
+	pthread_cond_init(&reader.cond, NULL);
+	if (pthread_create(&reader.thread, NULL, image_reader_thread, NULL) == 0) {
+		reader.threaded = 1;
+		if (reader.prefill)
+			*len = 0;
+	}
+}
+
+static void
+image_reader_stop(void)
+{
+	if (!reader.threaded)
+		goto out;
+
+	/* unblock the reader if we stopped consuming early */
+	pthread_mutex_lock(&reader.lock);
+	while (!reader.eof) {
+		reader.full[0] = reader.full[1] = 0;
+		pthread_cond_broadcast(&reader.cond);
+		pthread_cond_wait(&reader.cond, &reader.lock);
+	}
+	reader.full[0] = reader.full[1] = 0;
+	pthread_cond_broadcast(&reader.cond);
+	pthread_mutex_unlock(&reader.lock);
+
+	pthread_join(reader.thread, NULL);
+	reader.threaded = 0;
+
+out:
+	free(reader.slot[0]);
+	free(reader.slot[1]);
+	reader.slot[0] = reader.slot[1] = NULL;
+}
+
+/* fill *bufp up to erasesize bytes, returns the number of bytes added */
+static int
+image_read_block(char **bufp, int *len)
+{
+	int added = 0;
+	int n, slot;
+	char *tmp;
+
+	if (!reader.threaded) {
+		n = image_read_fill(reader.fd, *bufp + *len, erasesize - *len);
+		*len += n;
+		return n;
+	}
+
+	pthread_mutex_lock(&reader.lock);
+	while (*len < erasesize) {
+		slot = reader.rd;
+		while (!reader.full[slot] && !reader.eof)
+			pthread_cond_wait(&reader.cond, &reader.lock);
+
+		if (!reader.full[slot])
+			break;
+
+		n = reader.len[slot] - reader.pos;
+		if (*len == 0 && reader.pos == 0 && n == erasesize) {
+			/* whole block available, swap it in */
+			tmp = *bufp;
+			*bufp = reader.slot[slot];
+			reader.slot[slot] = tmp;
+		} else {
+			if (n > erasesize - *len)
+				n = erasesize - *len;
+			memcpy(*bufp + *len, reader.slot[slot] + reader.pos, n);
+		}
+
+		*len += n;
+		added += n;
+		reader.pos += n;
+
+		if (reader.pos >= reader.len[slot]) {
+			reader.full[slot] = 0;
+			reader.pos = 0;
+			reader.rd ^= 1;
+			pthread_cond_broadcast(&reader.cond);
+			if (reader.len[slot] < reader.size)
+				break;
+		}
+	}
+	pthread_mutex_unlock(&reader.lock);
+
+	return added;
+}
+
+/* check whether a full block at the current write position already holds buf */
+static int
+mtd_block_unchanged(int fd, const char *buf, int len)
+{
+	static char *cmpbuf;
+	off_t pos;
+
+	if (!cmpbuf)
+		cmpbuf = malloc(erasesize);
+	if (!cmpbuf)
+		return 0;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos < 0)
+		return 0;
+
+	if (pread(fd, cmpbuf, len, pos) != len)
+		return 0;
+
+	return !memcmp(cmpbuf, buf, len);
+}
+
 static int
 mtd_write(int imagefd, const char *mtd, char *fis_layout, size_t part_offset)
 {
 	char *next = NULL;
 	char *str = NULL;
 	int fd, result;
-	ssize_t r, w, e;
+	ssize_t w, e;
 	ssize_t skip = 0;
 	uint32_t offset = 0;
 	int jffs2_replaced = 0;
+	int written = 0, skipped = 0;
+	unsigned long long total = 0;
+	struct timeval start, end;
+	unsigned long msec;
 
 #ifdef FIS_SUPPORT
 	static struct fis_part new_parts[MAX_ARGS];
@@ -356,7 +569,8 @@ next:
 		mtd = str;
 	}
 
-	r = 0;
+	gettimeofday(&start, NULL);
+	image_reader_start(imagefd, erasesize, buf, &buflen);
 
 resume:
 	next = strchr(mtd, ':');
@@ -381,22 +595,8 @@ resume:
 	w = e = 0;
 	for (;;) {
 		/* buffer may contain data already (from trx check or last mtd partition write attempt) */
-		while (buflen < erasesize) {
-			r = read(imagefd, buf + buflen, erasesize - buflen);
-			if (r < 0) {
-				if ((errno == EINTR) || (errno == EAGAIN))
-					continue;
-				else {
-					perror("read");
-					break;
-				}
-			}
-
-			if (r == 0)
-				break;
-
-			buflen += r;
-		}
+		if (buflen < erasesize)
+			image_read_block(&buf, &buflen);
 
 		if (buflen == 0)
 			break;
@@ -435,6 +635,23 @@ resume:
 			mtd_parse_jffs2data(buf, jffs2dir);
 		}
 
+		/* leave blocks alone that already contain the right data */
+		if (compare && !offset && buflen == erasesize &&
+		    !(w % erasesize) && w >= e &&
+		    mtd_block_unchanged(fd, buf, buflen)) {
+			if (!quiet)
+				fprintf(stderr, "\b\b\b[s]");
+
+			lseek(fd, buflen, SEEK_CUR);
+			w += buflen;
+			if (!no_erase)
+				e = w;
+			total += buflen;
+			skipped++;
+			buflen = 0;
+			continue;
+		}
+
 		/* need to erase the next block before writing data to it */
 		if(!no_erase)
 		{
@@ -479,11 +696,15 @@ resume:
 			}
 		}
 		w += buflen;
+		total += buflen;
+		written++;
 
 		buflen = 0;
 		offset = 0;
 	}
 
+	image_reader_stop();
+
 	if (jffs2_replaced && trx_fixup) {
 		trx_fixup(fd, mtd);
 	}
@@ -492,8 +713,17 @@ resume:
 		fprintf(stderr, "\b\b\b\b    ");
 
 done:
-	if (quiet < 2)
-		fprintf(stderr, "\n");
+	if (quiet < 2) {
+		gettimeofday(&end, NULL);
+		msec = (end.tv_sec - start.tv_sec) * 1000 +
+			(end.tv_usec - start.tv_usec) / 1000;
+		if (!msec)
+			msec = 1;
+
+		fprintf(stderr, "\n%d blocks written, %d unchanged blocks skipped, "
+			"%lu bytes/sec\n", written, skipped,
+			(unsigned long) (total * 1000 / msec));
+	}
 
 #ifdef FIS_SUPPORT
 	if (fis_layout) {
@@ -529,6 +759,8 @@ static void usage(void)
 	"        -q                      quiet mode (once: no [w] on writing,\n"
 	"                                           twice: no status messages)\n"
 	"        -n                      write without first erasing the blocks\n"
+	"        -c                      compare with the flash contents first and\n"
+	"                                skip erasing/writing unchanged blocks\n"
 	"        -r                      reboot after successful command\n"
 	"        -f                      force write without trx checks\n"
 	"        -e <device>             erase <device> before executing the command\n"
@@ -587,12 +819,13 @@ int main (int argc, char **argv)
 	buflen = 0;
 	quiet = 0;
 	no_erase = 0;
+	compare = 0;
 
 	while ((ch = getopt(argc, argv,
 #ifdef FIS_SUPPORT
 			"F:"
 #endif
-			"frnqe:d:j:p:o:")) != -1)
+			"frncqe:d:j:p:o:")) != -1)
 		switch (ch) {
 			case 'f':
 				force = 1;
@@ -603,6 +836,9 @@ int main (int argc, char **argv)
 			case 'n':
 				no_erase = 1;
 				break;
+			case 'c':
+				compare = 1;
+				break;
 			case 'j':
 				jffs2file = optarg;
 				break;
@@ -108,13 +108,154 @@ print_attr_val(const struct switch_attr *attr, const struct switch_val *val)
 	}
 }
 
+/*
+ * attribute values prefetched with swlib_get_all(), indexed by attribute
+ * group and port/vlan number; the values of one port or vlan are chained
+ * through next[]
+ */
+#define SHOW_CACHE_GROUPS	(SWLIB_ATTR_GROUP_PORT + 1)
+
+struct show_cache {
+	struct switch_val *vals;
+	int *next;
+	int n_vals;
+	int size;
+	int *head[SHOW_CACHE_GROUPS];
+	int n_head[SHOW_CACHE_GROUPS];
+};
+
+static void *
+show_cache_alloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (!ptr) {
+		fprintf(stderr, "Out of memory!\n");
+		exit(1);
+	}
+	return ptr;
+}
+
+static void
+show_cache_init(struct switch_dev *dev, struct show_cache *c)
+{
+	int i, j;
+
+	memset(c, 0, sizeof(*c));
+	c->n_head[SWLIB_ATTR_GROUP_GLOBAL] = 1;
+	c->n_head[SWLIB_ATTR_GROUP_PORT] = dev->ports;
+	c->n_head[SWLIB_ATTR_GROUP_VLAN] = dev->vlans;
+	for (i = 0; i < SHOW_CACHE_GROUPS; i++) {
+		c->head[i] = show_cache_alloc(NULL, (c->n_head[i] + 1) * sizeof(int));
+		for (j = 0; j < c->n_head[i]; j++)
+			c->head[i][j] = -1;
+	}
+}
+
+static int *
+show_cache_head(struct show_cache *c, struct switch_attr *attr, int port_vlan)
+{
+	if (attr->atype < 0 || attr->atype >= SHOW_CACHE_GROUPS)
+		return NULL;
+
+	if (attr->atype == SWLIB_ATTR_GROUP_GLOBAL)
+		port_vlan = 0;
+	else if (port_vlan < 0 || port_vlan >= c->n_head[attr->atype])
+		return NULL;
+
+	return &c->head[attr->atype][port_vlan];
+}
+
 static void
-show_attrs(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *val)
+show_cache_add(struct switch_dev *dev, struct switch_attr *attr,
+		struct switch_val *val, void *arg)
+{
+	struct show_cache *c = arg;
+	struct switch_val *v;
+	int *head;
+
+	head = show_cache_head(c, attr, val->port_vlan);
+	if (!head)
+		return;
+
+	if (c->n_vals == c->size) {
+		c->size = c->size ? 2 * c->size : 64;
+		c->vals = show_cache_alloc(c->vals, c->size * sizeof(*c->vals));
+		c->next = show_cache_alloc(c->next, c->size * sizeof(*c->next));
+	}
+
+	c->next[c->n_vals] = *head;
+	*head = c->n_vals;
+	v = &c->vals[c->n_vals++];
+	*v = *val;
+	switch (attr->type) {
+	case SWITCH_TYPE_STRING:
+		v->value.s = strdup(val->value.s);
+		break;
+	case SWITCH_TYPE_PORTS:
+		v->value.ports = malloc(sizeof(struct switch_port) * (val->len + 1));
+		if (v->value.ports)
+			memcpy(v->value.ports, val->value.ports,
+				sizeof(struct switch_port) * val->len);
+		else
+			v->len = 0;
+		break;
+	}
+}
+
+static void
+show_cache_free(struct show_cache *c)
+{
+	int i;
+
+	for (i = 0; i < c->n_vals; i++) {
+		switch (c->vals[i].attr->type) {
+		case SWITCH_TYPE_STRING:
+			free((char *) c->vals[i].value.s);
+			break;
+		case SWITCH_TYPE_PORTS:
+			free(c->vals[i].value.ports);
+			break;
+		}
+	}
+	free(c->vals);
+	free(c->next);
+	for (i = 0; i < SHOW_CACHE_GROUPS; i++)
+		free(c->head[i]);
+}
+
+static int
+show_get_attr(struct switch_dev *dev, struct show_cache *c,
+		struct switch_attr *attr, struct switch_val *val)
+{
+	int *head;
+	int i;
+
+	if (!c)
+		return swlib_get_attr(dev, attr, val);
+
+	head = show_cache_head(c, attr, val->port_vlan);
+	if (!head)
+		return -1;
+
+	for (i = *head; i >= 0; i = c->next[i]) {
+		if (c->vals[i].attr != attr)
+			continue;
+
+		*val = c->vals[i];
+		return 0;
+	}
+
+	return -1;
+}
+
+static void
+show_attrs(struct switch_dev *dev, struct show_cache *c,
+		struct switch_attr *attr, struct switch_val *val)
 {
 	while (attr) {
 		if (attr->type != SWITCH_TYPE_NOVAL) {
 			printf("\t%s: ", attr->name);
-			if (swlib_get_attr(dev, attr, val) < 0)
+			if (show_get_attr(dev, c, attr, val) < 0)
 				printf("???");
 			else
 				print_attr_val(attr, val);
@@ -125,26 +266,27 @@ show_attrs(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *
 }
 
 static void
-show_global(struct switch_dev *dev)
+show_global(struct switch_dev *dev, struct show_cache *c)
 {
 	struct switch_val val;
 
 	printf("Global attributes:\n");
-	show_attrs(dev, dev->ops, &val);
+	val.port_vlan = 0;
+	show_attrs(dev, c, dev->ops, &val);
 }
 
 static void
-show_port(struct switch_dev *dev, int port)
+show_port(struct switch_dev *dev, struct show_cache *c, int port)
 {
 	struct switch_val val;
 
 	printf("Port %d:\n", port);
 	val.port_vlan = port;
-	show_attrs(dev, dev->port_ops, &val);
+	show_attrs(dev, c, dev->port_ops, &val);
 }
 
 static void
-show_vlan(struct switch_dev *dev, int vlan, bool all)
+show_vlan(struct switch_dev *dev, struct show_cache *c, int vlan, bool all)
 {
 	struct switch_val val;
 	struct switch_attr *attr;
@@ -153,7 +295,7 @@ show_vlan(struct switch_dev *dev, int vlan, bool all)
 
 	if (all) {
 		attr = swlib_lookup_attr(dev, SWLIB_ATTR_GROUP_VLAN, "ports");
-		if (swlib_get_attr(dev, attr, &val) < 0)
+		if (show_get_attr(dev, c, attr, &val) < 0)
 			return;
 
 		if (!val.len)
@@ -161,7 +303,7 @@ show_vlan(struct switch_dev *dev, int vlan, bool all)
 	}
 
 	printf("VLAN %d:\n", vlan);
-	show_attrs(dev, dev->vlan_ops, &val);
+	show_attrs(dev, c, dev->vlan_ops, &val);
 }
 
 static void
@@ -204,6 +346,7 @@ int main(int argc, char **argv)
 	struct switch_dev *dev;
 	struct switch_attr *a;
 	struct switch_val val;
+	struct show_cache cache, *c;
 	int err;
 	int i;
 
@@ -319,18 +462,34 @@ int main(int argc, char **argv)
 		list_attributes(dev);
 		break;
 	case CMD_SHOW:
+		show_cache_init(dev, &cache);
+		if (cport >= 0)
+			err = swlib_get_all(dev, SWITCH_DUMP_PORT, cport, cport,
+					show_cache_add, &cache);
+		else if (cvlan >= 0)
+			err = swlib_get_all(dev, SWITCH_DUMP_VLAN, cvlan, cvlan,
+					show_cache_add, &cache);
+		else
+			err = swlib_get_all(dev, SWITCH_DUMP_GLOBAL |
+					SWITCH_DUMP_PORT | SWITCH_DUMP_VLAN,
+					0, -1, show_cache_add, &cache);
+
+		/* older kernels: query the attributes one by one */
+		c = (err < 0) ? NULL : &cache;
+
 		if (cport >= 0 || cvlan >= 0) {
 			if (cport >= 0)
-				show_port(dev, cport);
+				show_port(dev, c, cport);
 			else
-				show_vlan(dev, cvlan, false);
+				show_vlan(dev, c, cvlan, false);
 		} else {
-			show_global(dev);
+			show_global(dev, c);
 			for (i=0; i < dev->ports; i++)
-				show_port(dev, i);
+				show_port(dev, c, i);
 			for (i=0; i < dev->vlans; i++)
-				show_vlan(dev, i, true);
+				show_vlan(dev, c, i, true);
 		}
+		show_cache_free(&cache);
 		break;
 	}
 
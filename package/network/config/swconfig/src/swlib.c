@@ -71,8 +71,8 @@ wait_handler(struct nl_msg *msg, void *arg)
 
 /* helper function for performing netlink requests */
 static int
-swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
-		int (*data)(struct nl_msg *, void *), void *arg)
+__swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
+		int (*data)(struct nl_msg *, void *), void *arg, int dump)
 {
 	struct nl_msg *msg;
 	struct nl_cb *cb = NULL;
@@ -86,7 +86,7 @@ swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
 		exit(1);
 	}
 
-	if (!data)
+	if (dump)
 		flags |= NLM_F_DUMP;
 
 	genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, genl_family_get_id(family), 0, flags, cmd, 0);
@@ -112,10 +112,10 @@ swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
 	if (call)
 		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, call, arg);
 
-	if (data)
-		nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, wait_handler, &finished);
-	else
+	if (dump)
 		nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, wait_handler, &finished);
+	else
+		nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, wait_handler, &finished);
 
 	err = nl_recvmsgs(handle, cb);
 	if (err < 0) {
@@ -133,6 +133,13 @@ nla_put_failure:
 	return err;
 }
 
+static int
+swlib_call(int cmd, int (*call)(struct nl_msg *, void *),
+		int (*data)(struct nl_msg *, void *), void *arg)
+{
+	return __swlib_call(cmd, call, data, arg, !data);
+}
+
 static int
 send_attr(struct nl_msg *msg, void *arg)
 {
@@ -323,6 +330,129 @@ nla_put_failure:
 	return -1;
 }
 
+struct getall_arg {
+	struct switch_dev *dev;
+	int groups;
+	int first;
+	int last;
+	swlib_val_cb cb;
+	void *arg;
+	struct switch_port *ports;
+	struct switch_val val;
+};
+
+static int
+send_getall(struct nl_msg *msg, void *arg)
+{
+	struct getall_arg *ga = arg;
+
+	NLA_PUT_U32(msg, SWITCH_ATTR_ID, ga->dev->id);
+	NLA_PUT_U32(msg, SWITCH_ATTR_DUMP_GROUPS, ga->groups);
+	NLA_PUT_U32(msg, SWITCH_ATTR_OP_PORT, ga->first);
+	NLA_PUT_U32(msg, SWITCH_ATTR_OP_VLAN, ga->first);
+	if (ga->last >= 0) {
+		NLA_PUT_U32(msg, SWITCH_ATTR_OP_PORT_LAST, ga->last);
+		NLA_PUT_U32(msg, SWITCH_ATTR_OP_VLAN_LAST, ga->last);
+	}
+
+	return 0;
+
+nla_put_failure:
+	return -1;
+}
+
+static struct switch_attr *
+swlib_find_attr_by_id(struct switch_attr *head, int id)
+{
+	while (head) {
+		if (head->id == id)
+			return head;
+		head = head->next;
+	}
+
+	return NULL;
+}
+
+static int
+store_getall_val(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct getall_arg *ga = arg;
+	struct switch_val *val = &ga->val;
+	struct switch_attr *head;
+
+	if (nla_parse(tb, SWITCH_ATTR_MAX - 1, genlmsg_attrdata(gnlh, 0),
+			genlmsg_attrlen(gnlh, 0), NULL) < 0)
+		goto done;
+
+	if (!tb[SWITCH_ATTR_OP_ID])
+		goto done;
+
+	if (tb[SWITCH_ATTR_OP_PORT]) {
+		head = ga->dev->port_ops;
+		val->port_vlan = nla_get_u32(tb[SWITCH_ATTR_OP_PORT]);
+	} else if (tb[SWITCH_ATTR_OP_VLAN]) {
+		head = ga->dev->vlan_ops;
+		val->port_vlan = nla_get_u32(tb[SWITCH_ATTR_OP_VLAN]);
+	} else {
+		head = ga->dev->ops;
+		val->port_vlan = 0;
+	}
+
+	val->attr = swlib_find_attr_by_id(head,
+			nla_get_u32(tb[SWITCH_ATTR_OP_ID]));
+	if (!val->attr)
+		goto done;
+
+	val->len = 0;
+	val->err = 0;
+	if (tb[SWITCH_ATTR_OP_VALUE_INT]) {
+		val->value.i = nla_get_u32(tb[SWITCH_ATTR_OP_VALUE_INT]);
+	} else if (tb[SWITCH_ATTR_OP_VALUE_STR]) {
+		val->value.s = nla_get_string(tb[SWITCH_ATTR_OP_VALUE_STR]);
+	} else if (tb[SWITCH_ATTR_OP_VALUE_PORTS]) {
+		val->value.ports = ga->ports;
+		val->err = store_port_val(msg, tb[SWITCH_ATTR_OP_VALUE_PORTS], val);
+	}
+
+	if (!val->err)
+		ga->cb(ga->dev, val->attr, val, ga->arg);
+
+done:
+	return NL_SKIP;
+}
+
+int
+swlib_get_all(struct switch_dev *dev, int groups, int first, int last,
+		swlib_val_cb cb, void *arg)
+{
+	struct getall_arg ga;
+	struct switch_port *ports;
+	int err;
+
+	if (!dev->ops && !dev->port_ops && !dev->vlan_ops)
+		swlib_scan(dev);
+
+	ports = swlib_alloc(sizeof(struct switch_port) * (dev->ports + 1));
+	if (!ports)
+		return -ENOMEM;
+
+	memset(&ga, 0, sizeof(ga));
+	ga.dev = dev;
+	ga.groups = groups;
+	ga.first = first;
+	ga.last = last;
+	ga.cb = cb;
+	ga.arg = arg;
+	ga.ports = ports;
+
+	err = __swlib_call(SWITCH_CMD_GET_ALL, store_getall_val, send_getall,
+			&ga, 1);
+
+	free(ports);
+	return err;
+}
+
 int
 swlib_set_attr(struct switch_dev *dev, struct switch_attr *attr, struct switch_val *val)
 {
@@ -52,6 +52,10 @@ Usage of the library functions:
   switch_set_attr() and switch_get_attr() can alter or request the values
   of attributes.
 
+  swlib_get_all() fetches the values of all attributes of a switch (or of a
+  range of ports/vlans) with a single netlink dump instead of one request
+  per attribute.
+
 Usage of the switch_attr struct:
 
   ->atype: attribute group, one of:
@@ -224,6 +228,33 @@ int swlib_set_attr_string(struct switch_dev *dev, struct switch_attr *attr,
 int swlib_get_attr(struct switch_dev *dev, struct switch_attr *attr,
 		struct switch_val *val);
 
+/**
+ * swlib_val_cb: callback for swlib_get_all
+ * @dev: switch device struct
+ * @attr: switch attribute struct
+ * @val: attribute value, port_vlan holds the port or vlan (if applicable)
+ *
+ * string and port list values are only valid during the call
+ */
+typedef void (*swlib_val_cb)(struct switch_dev *dev, struct switch_attr *attr,
+		struct switch_val *val, void *arg);
+
+/**
+ * swlib_get_all: get the values of all attributes with a single request
+ * @dev: switch device struct
+ * @groups: mask of SWITCH_DUMP_GLOBAL, SWITCH_DUMP_PORT and SWITCH_DUMP_VLAN
+ * @first: first port and vlan to fetch
+ * @last: last port and vlan to fetch, -1 for all
+ * @cb: called for every attribute value received
+ * @arg: passed on to the callback
+ * returns 0 on success, a negative value if the request failed (e.g. on
+ * kernels without SWITCH_CMD_GET_ALL)
+ *
+ * attributes which cannot be read are skipped
+ */
+int swlib_get_all(struct switch_dev *dev, int groups, int first, int last,
+		swlib_val_cb cb, void *arg);
+
 /**
  * swlib_apply_from_uci: set up the switch from a uci configuration
  * @dev: switch device struct
@@ -26,14 +26,18 @@
 #include <signal.h>
 #include <syslog.h>
 #include <errno.h>
+#include <poll.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <linux/if_packet.h>
+#include <linux/filter.h>
 
 #define ARPHRD_IEEE80211_RADIOTAP	803
 
@@ -44,6 +48,9 @@
 #define FRAMETYPE_BEACON			0x80
 #define FRAMETYPE_DATA				0x08
 
+#define STREAM_SNAPLEN				8192
+#define STREAM_BATCH				512  /* two iovecs each, IOV_MAX is 1024 */
+
 #if __BYTE_ORDER == __BIG_ENDIAN
 #define le16(x) __bswap_16(x)
 #else
@@ -56,6 +63,7 @@ uint8_t run_daemon = 0;
 
 uint32_t frames_captured = 0;
 uint32_t frames_filtered = 0;
+uint32_t frames_dropped  = 0;
 
 int capture_sock = -1;
 const char *ifname = NULL;
@@ -75,6 +83,18 @@ struct ringbuf_entry {
 	uint32_t usec;			 /* epoch microseconds */
 };
 
+struct mmap_ring {
+	uint8_t *map;            /* PACKET_RX_RING mapping */
+	size_t size;             /* mapping size */
+	uint32_t block_size;     /* ring block size */
+	uint32_t frame_size;     /* ring frame size */
+	uint32_t frame_nr;       /* number of frames */
+	uint32_t frames_per_block;
+	uint32_t cur;            /* next frame to be filled by the kernel */
+	uint32_t held;           /* frames kept back for dumping */
+	uint32_t hold;           /* max frames to keep back */
+};
+
 typedef struct pcap_hdr_s {
 	uint32_t magic_number;   /* magic number */
 	uint16_t version_major;  /* major version number */
@@ -253,6 +273,214 @@ void ringbuf_free(struct ringbuf *r)
 }
 
 
+/*
+ * The mmap ring uses TPACKET_V2: frames have a fixed size, so the kernel
+ * truncates them to the snap length for us, and they are handed back one
+ * at a time. In ring buffer mode the most recent frames are simply not
+ * returned to the kernel until newer ones arrive, which makes the mapped
+ * ring the capture history and lets the dump write straight out of it.
+ */
+struct mmap_ring * mmap_ring_init(uint32_t ringsz, uint32_t snaplen, int keep)
+{
+	static struct mmap_ring r;
+	struct tpacket_req req;
+	int ver = TPACKET_V2;
+	uint32_t reserve;
+
+	memset(&r, 0, sizeof(r));
+
+	if (setsockopt(capture_sock, SOL_PACKET, PACKET_VERSION,
+	               &ver, sizeof(ver)) < 0)
+		return NULL;
+
+	r.frame_size = TPACKET_ALIGN(TPACKET2_HDRLEN + 16 + snaplen);
+	r.block_size = getpagesize();
+
+	/* frames don't span blocks, keep the unused tail of each one small */
+	while (r.block_size / r.frame_size < 8)
+		r.block_size <<= 1;
+
+	r.frames_per_block = r.block_size / r.frame_size;
+
+	req.tp_block_size = r.block_size;
+	req.tp_frame_size = r.frame_size;
+	req.tp_block_nr   = ringsz / r.block_size;
+
+	if (req.tp_block_nr < 2)
+		req.tp_block_nr = 2;
+
+	req.tp_frame_nr = req.tp_block_nr * r.frames_per_block;
+
+	if (setsockopt(capture_sock, SOL_PACKET, PACKET_RX_RING,
+	               &req, sizeof(req)) < 0)
+		return NULL;
+
+	r.size = (size_t)req.tp_block_nr * req.tp_block_size;
+	r.map = mmap(NULL, r.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	             capture_sock, 0);
+
+	if (r.map == MAP_FAILED)
+	{
+		req.tp_block_nr = 0;
+		req.tp_frame_nr = 0;
+		setsockopt(capture_sock, SOL_PACKET, PACKET_RX_RING,
+		           &req, sizeof(req));
+		return NULL;
+	}
+
+	r.frame_nr = req.tp_frame_nr;
+
+	/* leave the kernel some room to fill while we sleep */
+	if (keep)
+	{
+		reserve = r.frame_nr / 8;
+		r.hold = r.frame_nr - (reserve ? reserve : 1);
+	}
+
+	return &r;
+}
+
+struct tpacket2_hdr * mmap_ring_frame(struct mmap_ring *r, uint32_t i)
+{
+	return (struct tpacket2_hdr *)(r->map +
+		(i / r->frames_per_block) * r->block_size +
+		(i % r->frames_per_block) * r->frame_size);
+}
+
+struct tpacket2_hdr * mmap_ring_next(struct mmap_ring *r)
+{
+	struct tpacket2_hdr *h = mmap_ring_frame(r, r->cur);
+
+	if (!(h->tp_status & TP_STATUS_USER))
+		return NULL;
+
+	__sync_synchronize();
+
+	return h;
+}
+
+void mmap_ring_release(struct mmap_ring *r, uint32_t i)
+{
+	__sync_synchronize();
+	mmap_ring_frame(r, i)->tp_status = TP_STATUS_KERNEL;
+}
+
+/* consume the current frame, returning the oldest kept one if needed */
+void mmap_ring_advance(struct mmap_ring *r)
+{
+	if (r->held < r->hold)
+		r->held++;
+	else
+		mmap_ring_release(r, (r->cur + r->frame_nr - r->held) % r->frame_nr);
+
+	r->cur = (r->cur + 1) % r->frame_nr;
+}
+
+void mmap_ring_free(struct mmap_ring *r)
+{
+	munmap(r->map, r->size);
+	memset(r, 0, sizeof(*r));
+}
+
+
+void update_drops(void)
+{
+	struct tpacket_stats st;
+	socklen_t len = sizeof(st);
+
+	/* the kernel resets the counters on every read */
+	if (!getsockopt(capture_sock, SOL_PACKET, PACKET_STATISTICS, &st, &len))
+		frames_dropped += st.tp_drops;
+}
+
+int check_filter(const uint8_t *buf, size_t len,
+                 uint8_t filter_data, uint8_t filter_beacon)
+{
+	const radiotap_hdr_t *rhdr = (const radiotap_hdr_t *)buf;
+	uint8_t frametype;
+
+	if (len <= sizeof(radiotap_hdr_t) || le16(rhdr->it_len) >= len)
+		return 1;
+
+	frametype = buf[le16(rhdr->it_len)];
+
+	return ((filter_data   && (frametype & FRAMETYPE_MASK) == FRAMETYPE_DATA) ||
+	        (filter_beacon && (frametype & FRAMETYPE_MASK) == FRAMETYPE_BEACON));
+}
+
+/*
+ * The same test as check_filter() as a socket filter, so frames we don't
+ * want never take up a slot of the capture ring.
+ */
+int attach_filter(uint8_t filter_data, uint8_t filter_beacon)
+{
+	struct sock_filter code[] = {
+		/* drop frames too short for a radiotap header */
+		BPF_STMT(BPF_LD  | BPF_W   | BPF_LEN, 0),
+		BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, sizeof(radiotap_hdr_t), 0, 11),
+
+		/* X = it_len, little endian */
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 3),
+		BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 2),
+		BPF_STMT(BPF_ALU | BPF_OR  | BPF_X, 0),
+		BPF_STMT(BPF_MISC | BPF_TAX, 0),
+
+		/* frame control, reading past the end drops the frame */
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_IND, 0),
+		BPF_STMT(BPF_ALU | BPF_AND | BPF_K, FRAMETYPE_MASK),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, FRAMETYPE_DATA,
+		         filter_data ? 2 : 1, 0),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, FRAMETYPE_BEACON,
+		         filter_beacon ? 1 : 0, 0),
+
+		BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),
+		BPF_STMT(BPF_RET | BPF_K, 0)
+	};
+	struct sock_fprog prog = {
+		.len    = sizeof(code) / sizeof(code[0]),
+		.filter = code
+	};
+
+	return setsockopt(capture_sock, SOL_SOCKET, SO_ATTACH_FILTER,
+	                  &prog, sizeof(prog));
+}
+
+int writev_all(int fd, struct iovec *iov, int cnt)
+{
+	ssize_t n;
+
+	while (cnt > 0)
+	{
+		n = writev(fd, iov, cnt);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return -1;
+		}
+
+		while (cnt > 0 && n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+
+		if (cnt > 0)
+		{
+			iov->iov_base = (uint8_t *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return 0;
+}
+
+
 void msg(const char *fmt, ...)
 {
 	va_list ap;
@@ -267,11 +495,91 @@ void msg(const char *fmt, ...)
 }
 
 
+int dump_mmap_ring(FILE *o, struct mmap_ring *r, uint16_t pktcap,
+                   uint8_t filter_data, uint8_t filter_beacon)
+{
+	struct tpacket2_hdr *h;
+	uint32_t i, len, sec, usec;
+	uint8_t *data;
+	int n = 0;
+
+	for (i = 0; i < r->held; i++)
+	{
+		h = mmap_ring_frame(r, (r->cur + r->frame_nr - r->held + i) % r->frame_nr);
+		data = (uint8_t *)h + h->tp_mac;
+
+		if (check_filter(data, h->tp_snaplen, filter_data, filter_beacon))
+			continue;
+
+		len  = (h->tp_snaplen > pktcap) ? pktcap : h->tp_snaplen;
+		sec  = h->tp_sec;
+		usec = h->tp_nsec / 1000;
+
+		write_pcap_frame(o, &sec, &usec, len, h->tp_len);
+		fwrite(data, 1, len, o);
+		n++;
+	}
+
+	return n;
+}
+
+/* write out everything the kernel has filled so far, returns frames seen */
+int stream_mmap_ring(struct mmap_ring *r,
+                     uint8_t filter_data, uint8_t filter_beacon)
+{
+	static struct iovec iov[2 * STREAM_BATCH];
+	static pcaprec_hdr_t fhdr[STREAM_BATCH];
+	struct tpacket2_hdr *h;
+	uint32_t start = r->cur;
+	uint8_t *data;
+	int i, n, cnt = 0;
+
+	for (n = 0; n < STREAM_BATCH && (h = mmap_ring_next(r)) != NULL; n++)
+	{
+		data = (uint8_t *)h + h->tp_mac;
+		frames_captured++;
+
+		r->cur = (r->cur + 1) % r->frame_nr;
+
+		if (check_filter(data, h->tp_snaplen, filter_data, filter_beacon))
+		{
+			frames_filtered++;
+			continue;
+		}
+
+		fhdr[cnt].ts_sec   = h->tp_sec;
+		fhdr[cnt].ts_usec  = h->tp_nsec / 1000;
+		fhdr[cnt].incl_len = h->tp_snaplen;
+		fhdr[cnt].orig_len = h->tp_len;
+
+		iov[2 * cnt].iov_base     = &fhdr[cnt];
+		iov[2 * cnt].iov_len      = sizeof(fhdr[cnt]);
+		iov[2 * cnt + 1].iov_base = data;
+		iov[2 * cnt + 1].iov_len  = h->tp_snaplen;
+		cnt++;
+	}
+
+	if (cnt > 0 && writev_all(1, iov, 2 * cnt))
+	{
+		msg("Unable to write to stdout: %s\n", strerror(errno));
+		run_stop = 1;
+	}
+
+	for (i = 0; i < n; i++)
+		mmap_ring_release(r, (start + i) % r->frame_nr);
+
+	return n;
+}
+
+
 int main(int argc, char **argv)
 {
 	int i, n;
-	struct ringbuf *ring;
+	struct ringbuf *ring = NULL;
 	struct ringbuf_entry *e;
+	struct mmap_ring *mring = NULL;
+	struct tpacket2_hdr *h;
+	struct pollfd pfd;
 	struct sockaddr_ll local = {
 		.sll_family   = AF_PACKET,
 		.sll_protocol = htons(ETH_P_ALL)
@@ -293,6 +601,7 @@ int main(int argc, char **argv)
 	uint8_t filter_data    = 0;
 	uint8_t filter_beacon  = 0;
 	uint8_t header_written = 0;
+	uint8_t no_mmap        = 0;
 
 	uint32_t ringsz   = 1024 * 1024; /* 1 Mbyte ring buffer */
 	uint16_t pktcap   = 256;		 /* truncate frames after 265KB */
@@ -300,7 +609,7 @@ int main(int argc, char **argv)
 	const char *output = NULL;
 
 
-	while ((opt = getopt(argc, argv, "i:r:c:o:sfhBD")) != -1)
+	while ((opt = getopt(argc, argv, "i:r:c:o:sfhBDN")) != -1)
 	{
 		switch (opt)
 		{
@@ -354,6 +663,10 @@ int main(int argc, char **argv)
 			foreground = 1;
 			break;
 
+		case 'N':
+			no_mmap = 1;
+			break;
+
 		case 'h':
 			msg(
 				"Usage:\n"
@@ -380,6 +693,9 @@ int main(int argc, char **argv)
 				"    Don't store data frames in ring, default is keep.\n\n"
 				"  -f\n"
 				"    Do not daemonize but keep running in foreground.\n\n"
+				"  -N\n"
+				"    Read frames with recvfrom() instead of using a memory\n"
+				"    mapped capture ring.\n\n"
 				"  -h\n"
 				"    Display this help.\n\n",
 				argv[0], argv[0], ringsz, pktcap);
@@ -432,6 +748,29 @@ int main(int argc, char **argv)
 		return 7;
 	}
 
+	/*
+	 * Frames the filter rejects would otherwise take up history slots in
+	 * the capture ring, stay with the copying ring buffer if the kernel
+	 * can't filter for us.
+	 */
+	if (!no_mmap && !streaming && attach_filter(filter_data, filter_beacon))
+	{
+		msg("Unable to attach socket filter, using recvfrom(): %s\n",
+			strerror(errno));
+		no_mmap = 1;
+	}
+
+	if (!no_mmap)
+	{
+		mring = mmap_ring_init(ringsz,
+		                       streaming ? STREAM_SNAPLEN : pktcap,
+		                       !streaming);
+
+		if (!mring)
+			msg("Unable to set up capture ring, using recvfrom(): %s\n",
+				strerror(errno));
+	}
+
 	if (!streaming)
 	{
 		if (!foreground)
@@ -459,14 +798,23 @@ int main(int argc, char **argv)
 
 		msg("Monitoring interface %s ...\n", ifname);
 
-		if (!(ring = ringbuf_init(ringsz / pktcap, pktcap)))
+		if (mring)
+		{
+			msg(" * Using %d bytes mmap ring with %d slots\n",
+				(int)mring->size, mring->hold);
+		}
+		else if (!(ring = ringbuf_init(ringsz / pktcap, pktcap)))
 		{
 			msg("Unable to allocate ring buffer: %s\n",
 				strerror(errno));
 			return 5;
 		}
+		else
+		{
+			msg(" * Using %d bytes ringbuffer with %d slots\n",
+				ringsz, ring->len);
+		}
 
-		msg(" * Using %d bytes ringbuffer with %d slots\n", ringsz, ring->len);
 		msg(" * Truncating frames at %d bytes\n", pktcap);
 		msg(" * Dumping data to file %s\n", output);
 
@@ -476,6 +824,10 @@ int main(int argc, char **argv)
 	{
 		msg("Monitoring interface %s ...\n", ifname);
 		msg(" * Streaming data to stdout\n");
+
+		if (mring)
+			msg(" * Using %d bytes mmap ring, truncating frames at %d bytes\n",
+				(int)mring->size, STREAM_SNAPLEN);
 	}
 
 	msg(" * Beacon frames are %sfiltered\n", filter_beacon ? "" : "not ");
@@ -493,12 +845,20 @@ int main(int argc, char **argv)
 		{
 			msg("Shutting down ...\n");
 
+			update_drops();
+			msg(" * %d frames captured\n", frames_captured);
+			msg(" * %d frames filtered\n", frames_filtered);
+			msg(" * %d frames dropped\n", frames_dropped);
+
 			if (promisc)
 				set_promisc(0);
 
 			if (ring)
 				ringbuf_free(ring);
 
+			if (mring)
+				mmap_ring_free(mring);
+
 			return 0;
 		}
 		else if (run_dump)
@@ -515,26 +875,71 @@ int main(int argc, char **argv)
 				write_pcap_header(o);
 
 				/* sig_dump packet buffer */
-				for (i = 0, n = 0; i < ring->len; i++)
+				if (mring)
 				{
-					if (!(e = ringbuf_get(ring, i)))
-						continue;
-
-					write_pcap_frame(o, &(e->sec), &(e->usec), e->len, e->olen);
-					fwrite((void *)e + sizeof(*e), 1, e->len, o);
-					n++;
+					n = dump_mmap_ring(o, mring, pktcap,
+					                   filter_data, filter_beacon);
+				}
+				else
+				{
+					for (i = 0, n = 0; i < ring->len; i++)
+					{
+						if (!(e = ringbuf_get(ring, i)))
+							continue;
+
+						write_pcap_frame(o, &(e->sec), &(e->usec), e->len, e->olen);
+						fwrite((void *)e + sizeof(*e), 1, e->len, o);
+						n++;
+					}
 				}
 
 				fclose(o);
 
+				update_drops();
 				msg(" * %d frames captured\n", frames_captured);
 				msg(" * %d frames filtered\n", frames_filtered);
+				msg(" * %d frames dropped\n", frames_dropped);
 				msg(" * %d frames dumped\n", n);
 			}
 
 			run_dump = 0;
 		}
 
+		if (mring)
+		{
+			if (streaming)
+			{
+				if (!header_written)
+				{
+					write_pcap_header(stdout);
+					fflush(stdout);
+					header_written = 1;
+				}
+
+				if (stream_mmap_ring(mring, filter_data, filter_beacon))
+					continue;
+			}
+			else if ((h = mmap_ring_next(mring)) != NULL)
+			{
+				frames_captured++;
+
+				if (check_filter((uint8_t *)h + h->tp_mac, h->tp_snaplen,
+				                 filter_data, filter_beacon))
+					frames_filtered++;
+
+				/* the socket filter keeps these out, skipped on dump anyway */
+				mmap_ring_advance(mring);
+				continue;
+			}
+
+			pfd.fd = capture_sock;
+			pfd.events = POLLIN | POLLERR;
+			pfd.revents = 0;
+
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
 		pktlen = recvfrom(capture_sock, pktbuf, sizeof(pktbuf), 0, NULL, 0);
 		frames_captured++;
 
@@ -141,6 +141,55 @@ extern const struct iwinfo_iso3166_label IWINFO_ISO3166_NAMES[];
 extern const struct iwinfo_hardware_entry IWINFO_HARDWARE_ENTRIES[];
 
 
+#define IWINFO_SNAPSHOT_MODE             (1 << 0)
+#define IWINFO_SNAPSHOT_CHANNEL          (1 << 1)
+#define IWINFO_SNAPSHOT_FREQUENCY        (1 << 2)
+#define IWINFO_SNAPSHOT_FREQUENCY_OFFSET (1 << 3)
+#define IWINFO_SNAPSHOT_TXPOWER          (1 << 4)
+#define IWINFO_SNAPSHOT_TXPOWER_OFFSET   (1 << 5)
+#define IWINFO_SNAPSHOT_BITRATE          (1 << 6)
+#define IWINFO_SNAPSHOT_SIGNAL           (1 << 7)
+#define IWINFO_SNAPSHOT_NOISE            (1 << 8)
+#define IWINFO_SNAPSHOT_QUALITY          (1 << 9)
+#define IWINFO_SNAPSHOT_QUALITY_MAX      (1 << 10)
+#define IWINFO_SNAPSHOT_HWMODELIST       (1 << 11)
+#define IWINFO_SNAPSHOT_SSID             (1 << 12)
+#define IWINFO_SNAPSHOT_BSSID            (1 << 13)
+#define IWINFO_SNAPSHOT_COUNTRY          (1 << 14)
+#define IWINFO_SNAPSHOT_HARDWARE_ID      (1 << 15)
+#define IWINFO_SNAPSHOT_HARDWARE_NAME    (1 << 16)
+#define IWINFO_SNAPSHOT_ENCRYPTION       (1 << 17)
+
+/* Default maximum age of a cached snapshot in milliseconds */
+#define IWINFO_SNAPSHOT_TTL	2000
+
+/*
+ * All scalar interface state, gathered in one pass. Only the fields
+ * flagged in valid could be obtained.
+ */
+struct iwinfo_snapshot {
+	uint32_t valid;
+	int mode;
+	int channel;
+	int frequency;
+	int frequency_offset;
+	int txpower;
+	int txpower_offset;
+	int bitrate;
+	int signal;
+	int noise;
+	int quality;
+	int quality_max;
+	int hwmodelist;
+	char ssid[IWINFO_ESSID_MAX_SIZE+1];
+	char bssid[18];
+	char country[4];
+	char hardware_name[128];
+	struct iwinfo_hardware_id hardware_id;
+	struct iwinfo_crypto_entry encryption;
+};
+
+
 struct iwinfo_ops {
 	int (*mode)(const char *, int *);
 	int (*channel)(const char *, int *);
@@ -167,10 +216,12 @@ struct iwinfo_ops {
 	int (*freqlist)(const char *, char *, int *);
 	int (*countrylist)(const char *, char *, int *);
 	void (*close)(void);
+	int (*snapshot)(const char *, struct iwinfo_snapshot *);
 };
 
 const char * iwinfo_type(const char *ifname);
 const struct iwinfo_ops * iwinfo_backend(const char *ifname);
+int iwinfo_snapshot(const char *ifname, struct iwinfo_snapshot *snap, int ttl);
 void iwinfo_finish(void);
 
 #include "iwinfo/wext.h"
@@ -92,6 +92,7 @@ int nl80211_get_hwmodelist(const char *ifname, int *buf);
 int nl80211_get_mbssid_support(const char *ifname, int *buf);
 int nl80211_get_hardware_id(const char *ifname, char *buf);
 int nl80211_get_hardware_name(const char *ifname, char *buf);
+int nl80211_get_snapshot(const char *ifname, struct iwinfo_snapshot *s);
 void nl80211_close(void);
 
 static const struct iwinfo_ops nl80211_ops = {
@@ -119,7 +120,8 @@ static const struct iwinfo_ops nl80211_ops = {
 	.scanlist         = nl80211_get_scanlist,
 	.freqlist         = nl80211_get_freqlist,
 	.countrylist      = nl80211_get_countrylist,
-	.close            = nl80211_close
+	.close            = nl80211_close,
+	.snapshot         = nl80211_get_snapshot
 };
 
 #endif
@@ -311,16 +311,16 @@ static const char * print_type(const struct iwinfo_ops *iw, const char *ifname)
 	return type ? type : "unknown";
 }
 
-static char * print_hardware_id(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_hardware_id(const struct iwinfo_snapshot *s)
 {
 	static char buf[20];
-	struct iwinfo_hardware_id ids;
 
-	if (!iw->hardware_id(ifname, (char *)&ids))
+	if (s->valid & IWINFO_SNAPSHOT_HARDWARE_ID)
 	{
 		snprintf(buf, sizeof(buf), "%04X:%04X %04X:%04X",
-			ids.vendor_id, ids.device_id,
-			ids.subsystem_vendor_id, ids.subsystem_device_id);
+			s->hardware_id.vendor_id, s->hardware_id.device_id,
+			s->hardware_id.subsystem_vendor_id,
+			s->hardware_id.subsystem_device_id);
 	}
 	else
 	{
@@ -330,172 +330,153 @@ static char * print_hardware_id(const struct iwinfo_ops *iw, const char *ifname)
 	return buf;
 }
 
-static char * print_hardware_name(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_hardware_name(const struct iwinfo_snapshot *s)
 {
 	static char buf[128];
 
-	if (iw->hardware_name(ifname, buf))
+	if (s->valid & IWINFO_SNAPSHOT_HARDWARE_NAME)
+		snprintf(buf, sizeof(buf), "%s", s->hardware_name);
+	else
 		snprintf(buf, sizeof(buf), "unknown");
 
 	return buf;
 }
 
-static char * print_txpower_offset(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_txpower_offset(const struct iwinfo_snapshot *s)
 {
-	int off;
 	static char buf[12];
 
-	if (iw->txpower_offset(ifname, &off))
+	if (!(s->valid & IWINFO_SNAPSHOT_TXPOWER_OFFSET))
 		snprintf(buf, sizeof(buf), "unknown");
-	else if (off != 0)
-		snprintf(buf, sizeof(buf), "%d dB", off);
+	else if (s->txpower_offset != 0)
+		snprintf(buf, sizeof(buf), "%d dB", s->txpower_offset);
 	else
 		snprintf(buf, sizeof(buf), "none");
 
 	return buf;
 }
 
-static char * print_frequency_offset(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_frequency_offset(const struct iwinfo_snapshot *s)
 {
-	int off;
 	static char buf[12];
 
-	if (iw->frequency_offset(ifname, &off))
+	if (!(s->valid & IWINFO_SNAPSHOT_FREQUENCY_OFFSET))
 		snprintf(buf, sizeof(buf), "unknown");
-	else if (off != 0)
-		snprintf(buf, sizeof(buf), "%.3f GHz", ((float)off / 1000.0));
+	else if (s->frequency_offset != 0)
+		snprintf(buf, sizeof(buf), "%.3f GHz",
+			((float)s->frequency_offset / 1000.0));
 	else
 		snprintf(buf, sizeof(buf), "none");
 
 	return buf;
 }
 
-static char * print_ssid(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_ssid(const struct iwinfo_snapshot *s)
 {
 	char buf[IWINFO_ESSID_MAX_SIZE+1] = { 0 };
 
-	if (iw->ssid(ifname, buf))
-		memset(buf, 0, sizeof(buf));
+	if (s->valid & IWINFO_SNAPSHOT_SSID)
+		memcpy(buf, s->ssid, sizeof(buf));
 
 	return format_ssid(buf);
 }
 
-static char * print_bssid(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_bssid(const struct iwinfo_snapshot *s)
 {
 	static char buf[18] = { 0 };
 
-	if (iw->bssid(ifname, buf))
+	if (s->valid & IWINFO_SNAPSHOT_BSSID)
+		snprintf(buf, sizeof(buf), "%s", s->bssid);
+	else
 		snprintf(buf, sizeof(buf), "00:00:00:00:00:00");
 
 	return buf;
 }
 
-static char * print_mode(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_mode(const struct iwinfo_snapshot *s)
 {
-	int mode;
+	int mode = IWINFO_OPMODE_UNKNOWN;
 	static char buf[128];
 
-	if (iw->mode(ifname, &mode))
-		mode = IWINFO_OPMODE_UNKNOWN;
+	if (s->valid & IWINFO_SNAPSHOT_MODE)
+		mode = s->mode;
 
 	snprintf(buf, sizeof(buf), "%s", IWINFO_OPMODE_NAMES[mode]);
 
 	return buf;
 }
 
-static char * print_channel(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_channel(const struct iwinfo_snapshot *s)
 {
-	int ch;
-	if (iw->channel(ifname, &ch))
-		ch = -1;
-
-	return format_channel(ch);
+	return format_channel((s->valid & IWINFO_SNAPSHOT_CHANNEL)
+		? s->channel : -1);
 }
 
-static char * print_frequency(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_frequency(const struct iwinfo_snapshot *s)
 {
-	int freq;
-	if (iw->frequency(ifname, &freq))
-		freq = -1;
-
-	return format_frequency(freq);
+	return format_frequency((s->valid & IWINFO_SNAPSHOT_FREQUENCY)
+		? s->frequency : -1);
 }
 
-static char * print_txpower(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_txpower(const struct iwinfo_snapshot *s)
 {
-	int pwr, off;
-	if (iw->txpower_offset(ifname, &off))
-		off = 0;
+	int pwr = -1;
 
-	if (iw->txpower(ifname, &pwr))
-		pwr = -1;
-	else
-		pwr += off;
+	if (s->valid & IWINFO_SNAPSHOT_TXPOWER)
+	{
+		pwr = s->txpower;
+
+		if (s->valid & IWINFO_SNAPSHOT_TXPOWER_OFFSET)
+			pwr += s->txpower_offset;
+	}
 
 	return format_txpower(pwr);
 }
 
-static char * print_quality(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_quality(const struct iwinfo_snapshot *s)
 {
-	int qual;
-	if (iw->quality(ifname, &qual))
-		qual = -1;
-
-	return format_quality(qual);
+	return format_quality((s->valid & IWINFO_SNAPSHOT_QUALITY)
+		? s->quality : -1);
 }
 
-static char * print_quality_max(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_quality_max(const struct iwinfo_snapshot *s)
 {
-	int qmax;
-	if (iw->quality_max(ifname, &qmax))
-		qmax = -1;
-
-	return format_quality_max(qmax);
+	return format_quality_max((s->valid & IWINFO_SNAPSHOT_QUALITY_MAX)
+		? s->quality_max : -1);
 }
 
-static char * print_signal(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_signal(const struct iwinfo_snapshot *s)
 {
-	int sig;
-	if (iw->signal(ifname, &sig))
-		sig = 0;
-
-	return format_signal(sig);
+	return format_signal((s->valid & IWINFO_SNAPSHOT_SIGNAL)
+		? s->signal : 0);
 }
 
-static char * print_noise(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_noise(const struct iwinfo_snapshot *s)
 {
-	int noise;
-	if (iw->noise(ifname, &noise))
-		noise = 0;
-
-	return format_noise(noise);
+	return format_noise((s->valid & IWINFO_SNAPSHOT_NOISE)
+		? s->noise : 0);
 }
 
-static char * print_rate(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_rate(const struct iwinfo_snapshot *s)
 {
-	int rate;
-	if (iw->bitrate(ifname, &rate))
-		rate = -1;
-
-	return format_rate(rate);
+	return format_rate((s->valid & IWINFO_SNAPSHOT_BITRATE)
+		? s->bitrate : -1);
 }
 
-static char * print_encryption(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_encryption(const struct iwinfo_snapshot *s)
 {
-	struct iwinfo_crypto_entry c = { 0 };
-	if (iw->encryption(ifname, (char *)&c))
+	struct iwinfo_crypto_entry c = s->encryption;
+
+	if (!(s->valid & IWINFO_SNAPSHOT_ENCRYPTION))
 		return format_encryption(NULL);
 
 	return format_encryption(&c);
 }
 
-static char * print_hwmodes(const struct iwinfo_ops *iw, const char *ifname)
+static char * print_hwmodes(const struct iwinfo_snapshot *s)
 {
-	int modes;
-	if (iw->hwmodelist(ifname, &modes))
-		modes = -1;
-
-	return format_hwmodes(modes);
+	return format_hwmodes((s->valid & IWINFO_SNAPSHOT_HWMODELIST)
+		? s->hwmodelist : -1);
 }
 
 static char * print_mbssid_supp(const struct iwinfo_ops *iw, const char *ifname)
@@ -514,36 +495,41 @@ static char * print_mbssid_supp(const struct iwinfo_ops *iw, const char *ifname)
 
 static void print_info(const struct iwinfo_ops *iw, const char *ifname)
 {
+	struct iwinfo_snapshot s;
+
+	if (iwinfo_snapshot(ifname, &s, 0))
+		memset(&s, 0, sizeof(s));
+
 	printf("%-9s ESSID: %s\n",
 		ifname,
-		print_ssid(iw, ifname));
+		print_ssid(&s));
 	printf("          Access Point: %s\n",
-		print_bssid(iw, ifname));
+		print_bssid(&s));
 	printf("          Mode: %s  Channel: %s (%s)\n",
-		print_mode(iw, ifname),
-		print_channel(iw, ifname),
-		print_frequency(iw, ifname));
+		print_mode(&s),
+		print_channel(&s),
+		print_frequency(&s));
 	printf("          Tx-Power: %s  Link Quality: %s/%s\n",
-		print_txpower(iw, ifname),
-		print_quality(iw, ifname),
-		print_quality_max(iw, ifname));
+		print_txpower(&s),
+		print_quality(&s),
+		print_quality_max(&s));
 	printf("          Signal: %s  Noise: %s\n",
-		print_signal(iw, ifname),
-		print_noise(iw, ifname));
+		print_signal(&s),
+		print_noise(&s));
 	printf("          Bit Rate: %s\n",
-		print_rate(iw, ifname));
+		print_rate(&s));
 	printf("          Encryption: %s\n",
-		print_encryption(iw, ifname));
+		print_encryption(&s));
 	printf("          Type: %s  HW Mode(s): %s\n",
 		print_type(iw, ifname),
-		print_hwmodes(iw, ifname));
+		print_hwmodes(&s));
 	printf("          Hardware: %s [%s]\n",
-		print_hardware_id(iw, ifname),
-		print_hardware_name(iw, ifname));
+		print_hardware_id(&s),
+		print_hardware_name(&s));
 	printf("          TX power offset: %s\n",
-		print_txpower_offset(iw, ifname));
+		print_txpower_offset(&s));
 	printf("          Frequency offset: %s\n",
-		print_frequency_offset(iw, ifname));
+		print_frequency_offset(&s));
 	printf("          Supports VAPs: %s\n",
 		print_mbssid_supp(iw, ifname));
 }
@@ -16,6 +16,8 @@
  * with the iwinfo library. If not, see http://www.gnu.org/licenses/.
  */
 
+#include <sys/time.h>
+
 #include "iwinfo.h"
 
 
@@ -437,8 +439,124 @@ const struct iwinfo_ops * iwinfo_backend(const char *ifname)
 	return NULL;
 }
 
+/*
+ * interface snapshots
+ */
+
+#define IWINFO_SNAPSHOT_SLOTS	8
+
+struct iwinfo_snapshot_slot {
+	char ifname[IFNAMSIZ];
+	struct timeval stamp;
+	struct iwinfo_snapshot snap;
+};
+
+static struct iwinfo_snapshot_slot iwinfo_snapshots[IWINFO_SNAPSHOT_SLOTS];
+
+#define SNAPSHOT_INT(iw, ifname, s, op, flag) \
+	if ((iw)->op && !(iw)->op(ifname, &(s)->op)) (s)->valid |= (flag)
+
+#define SNAPSHOT_BUF(iw, ifname, s, op, flag) \
+	if ((iw)->op && !(iw)->op(ifname, (char *)&(s)->op)) (s)->valid |= (flag)
+
+/* Fallback for backends without a batched snapshot, one call per value */
+static void iwinfo_snapshot_generic(const struct iwinfo_ops *iw,
+                                    const char *ifname,
+                                    struct iwinfo_snapshot *s)
+{
+	SNAPSHOT_INT(iw, ifname, s, mode,             IWINFO_SNAPSHOT_MODE);
+	SNAPSHOT_INT(iw, ifname, s, channel,          IWINFO_SNAPSHOT_CHANNEL);
+	SNAPSHOT_INT(iw, ifname, s, frequency,        IWINFO_SNAPSHOT_FREQUENCY);
+	SNAPSHOT_INT(iw, ifname, s, frequency_offset, IWINFO_SNAPSHOT_FREQUENCY_OFFSET);
+	SNAPSHOT_INT(iw, ifname, s, txpower,          IWINFO_SNAPSHOT_TXPOWER);
+	SNAPSHOT_INT(iw, ifname, s, txpower_offset,   IWINFO_SNAPSHOT_TXPOWER_OFFSET);
+	SNAPSHOT_INT(iw, ifname, s, bitrate,          IWINFO_SNAPSHOT_BITRATE);
+	SNAPSHOT_INT(iw, ifname, s, signal,           IWINFO_SNAPSHOT_SIGNAL);
+	SNAPSHOT_INT(iw, ifname, s, noise,            IWINFO_SNAPSHOT_NOISE);
+	SNAPSHOT_INT(iw, ifname, s, quality,          IWINFO_SNAPSHOT_QUALITY);
+	SNAPSHOT_INT(iw, ifname, s, quality_max,      IWINFO_SNAPSHOT_QUALITY_MAX);
+	SNAPSHOT_INT(iw, ifname, s, hwmodelist,       IWINFO_SNAPSHOT_HWMODELIST);
+	SNAPSHOT_BUF(iw, ifname, s, ssid,             IWINFO_SNAPSHOT_SSID);
+	SNAPSHOT_BUF(iw, ifname, s, bssid,            IWINFO_SNAPSHOT_BSSID);
+	SNAPSHOT_BUF(iw, ifname, s, country,          IWINFO_SNAPSHOT_COUNTRY);
+	SNAPSHOT_BUF(iw, ifname, s, hardware_id,      IWINFO_SNAPSHOT_HARDWARE_ID);
+	SNAPSHOT_BUF(iw, ifname, s, hardware_name,    IWINFO_SNAPSHOT_HARDWARE_NAME);
+	SNAPSHOT_BUF(iw, ifname, s, encryption,       IWINFO_SNAPSHOT_ENCRYPTION);
+}
+
+static int iwinfo_snapshot_age(const struct timeval *now,
+                               const struct timeval *then)
+{
+	return (now->tv_sec - then->tv_sec) * 1000 +
+	       (now->tv_usec - then->tv_usec) / 1000;
+}
+
+/*
+ * Fill snap with the state of ifname. A cached snapshot younger than ttl
+ * milliseconds is returned as-is, a ttl of zero always refreshes.
+ */
+int iwinfo_snapshot(const char *ifname, struct iwinfo_snapshot *snap, int ttl)
+{
+	int i, age;
+	struct timeval now;
+	struct iwinfo_snapshot_slot *slot = NULL, *e;
+	const struct iwinfo_ops *iw;
+
+	gettimeofday(&now, NULL);
+
+	/* Find the cached entry, else an empty or the oldest slot */
+	for (i = 0; i < IWINFO_SNAPSHOT_SLOTS; i++)
+	{
+		e = &iwinfo_snapshots[i];
+
+		if (!strcmp(e->ifname, ifname))
+		{
+			slot = e;
+			break;
+		}
+
+		if (!slot || (slot->ifname[0] && (!e->ifname[0] ||
+		              timercmp(&e->stamp, &slot->stamp, <))))
+			slot = e;
+	}
+
+	if (ttl > 0 && !strcmp(slot->ifname, ifname))
+	{
+		/* A negative age means the clock was set back, refresh then */
+		age = iwinfo_snapshot_age(&now, &slot->stamp);
+
+		if (age >= 0 && age < ttl)
+		{
+			memcpy(snap, &slot->snap, sizeof(*snap));
+			return 0;
+		}
+	}
+
+	iw = iwinfo_backend(ifname);
+	if (!iw)
+		return -1;
+
+	memset(snap, 0, sizeof(*snap));
+
+	if (iw->snapshot)
+		iw->snapshot(ifname, snap);
+	else
+		iwinfo_snapshot_generic(iw, ifname, snap);
+
+	if (strlen(ifname) < sizeof(slot->ifname))
+	{
+		strcpy(slot->ifname, ifname);
+		slot->stamp = now;
+		memcpy(&slot->snap, snap, sizeof(*snap));
+	}
+
+	return 0;
+}
+
 void iwinfo_finish(void)
 {
+	memset(iwinfo_snapshots, 0, sizeof(iwinfo_snapshots));
+
 #ifdef USE_WL
 	wl_close();
 #endif
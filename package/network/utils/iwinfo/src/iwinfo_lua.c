@@ -477,6 +477,24 @@ static int iwinfo_L_encryption(lua_State *L, int (*func)(const char *, char *))
 	return 1;
 }
 
+/* Build Lua table from hwmode flags */
+static void iwinfo_L_hwmodetable(lua_State *L, int hwmodes)
+{
+	lua_newtable(L);
+
+	lua_pushboolean(L, hwmodes & IWINFO_80211_A);
+	lua_setfield(L, -2, "a");
+
+	lua_pushboolean(L, hwmodes & IWINFO_80211_B);
+	lua_setfield(L, -2, "b");
+
+	lua_pushboolean(L, hwmodes & IWINFO_80211_G);
+	lua_setfield(L, -2, "g");
+
+	lua_pushboolean(L, hwmodes & IWINFO_80211_N);
+	lua_setfield(L, -2, "n");
+}
+
 /* Wrapper for hwmode list */
 static int iwinfo_L_hwmodelist(lua_State *L, int (*func)(const char *, int *))
 {
@@ -485,20 +503,7 @@ static int iwinfo_L_hwmodelist(lua_State *L, int (*func)(const char *, int *))
 
 	if (!(*func)(ifname, &hwmodes))
 	{
-		lua_newtable(L);
-
-		lua_pushboolean(L, hwmodes & IWINFO_80211_A);
-		lua_setfield(L, -2, "a");
-
-		lua_pushboolean(L, hwmodes & IWINFO_80211_B);
-		lua_setfield(L, -2, "b");
-
-		lua_pushboolean(L, hwmodes & IWINFO_80211_G);
-		lua_setfield(L, -2, "g");
-
-		lua_pushboolean(L, hwmodes & IWINFO_80211_N);
-		lua_setfield(L, -2, "n");
-
+		iwinfo_L_hwmodetable(L, hwmodes);
 		return 1;
 	}
 
@@ -522,6 +527,24 @@ static int iwinfo_L_mbssid_support(lua_State *L, int (*func)(const char *, int *
 	return 1;
 }
 
+/* Build Lua table from hardware ids */
+static void iwinfo_L_hardwaretable(lua_State *L, struct iwinfo_hardware_id *ids)
+{
+	lua_newtable(L);
+
+	lua_pushnumber(L, ids->vendor_id);
+	lua_setfield(L, -2, "vendor_id");
+
+	lua_pushnumber(L, ids->device_id);
+	lua_setfield(L, -2, "device_id");
+
+	lua_pushnumber(L, ids->subsystem_vendor_id);
+	lua_setfield(L, -2, "subsystem_vendor_id");
+
+	lua_pushnumber(L, ids->subsystem_device_id);
+	lua_setfield(L, -2, "subsystem_device_id");
+}
+
 /* Wrapper for hardware_id */
 static int iwinfo_L_hardware_id(lua_State *L, int (*func)(const char *, char *))
 {
@@ -530,19 +553,7 @@ static int iwinfo_L_hardware_id(lua_State *L, int (*func)(const char *, char *))
 
 	if (!(*func)(ifname, (char *)&ids))
 	{
-		lua_newtable(L);
-
-		lua_pushnumber(L, ids.vendor_id);
-		lua_setfield(L, -2, "vendor_id");
-
-		lua_pushnumber(L, ids.device_id);
-		lua_setfield(L, -2, "device_id");
-
-		lua_pushnumber(L, ids.subsystem_vendor_id);
-		lua_setfield(L, -2, "subsystem_vendor_id");
-
-		lua_pushnumber(L, ids.subsystem_device_id);
-		lua_setfield(L, -2, "subsystem_device_id");
+		iwinfo_L_hardwaretable(L, &ids);
 	}
 	else
 	{
@@ -841,9 +852,82 @@ static const luaL_reg R_wext[] = {
 	{ NULL, NULL }
 };
 
+/* Snapshot of all scalar values */
+static int iwinfo_L_snapshot(lua_State *L)
+{
+	const char *ifname = luaL_checkstring(L, 1);
+	int ttl = luaL_optint(L, 2, IWINFO_SNAPSHOT_TTL);
+	struct iwinfo_snapshot s;
+
+	if (iwinfo_snapshot(ifname, &s, ttl))
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_newtable(L);
+
+#define SNAPSHOT_NUMBER(field, flag)			\
+	if (s.valid & (flag))				\
+	{						\
+		lua_pushnumber(L, s.field);		\
+		lua_setfield(L, -2, #field);		\
+	}
+
+#define SNAPSHOT_STRING(field, flag)			\
+	if (s.valid & (flag))				\
+	{						\
+		lua_pushstring(L, s.field);		\
+		lua_setfield(L, -2, #field);		\
+	}
+
+	SNAPSHOT_NUMBER(channel,          IWINFO_SNAPSHOT_CHANNEL);
+	SNAPSHOT_NUMBER(frequency,        IWINFO_SNAPSHOT_FREQUENCY);
+	SNAPSHOT_NUMBER(frequency_offset, IWINFO_SNAPSHOT_FREQUENCY_OFFSET);
+	SNAPSHOT_NUMBER(txpower,          IWINFO_SNAPSHOT_TXPOWER);
+	SNAPSHOT_NUMBER(txpower_offset,   IWINFO_SNAPSHOT_TXPOWER_OFFSET);
+	SNAPSHOT_NUMBER(bitrate,          IWINFO_SNAPSHOT_BITRATE);
+	SNAPSHOT_NUMBER(signal,           IWINFO_SNAPSHOT_SIGNAL);
+	SNAPSHOT_NUMBER(noise,            IWINFO_SNAPSHOT_NOISE);
+	SNAPSHOT_NUMBER(quality,          IWINFO_SNAPSHOT_QUALITY);
+	SNAPSHOT_NUMBER(quality_max,      IWINFO_SNAPSHOT_QUALITY_MAX);
+	SNAPSHOT_STRING(ssid,             IWINFO_SNAPSHOT_SSID);
+	SNAPSHOT_STRING(bssid,            IWINFO_SNAPSHOT_BSSID);
+	SNAPSHOT_STRING(country,          IWINFO_SNAPSHOT_COUNTRY);
+	SNAPSHOT_STRING(hardware_name,    IWINFO_SNAPSHOT_HARDWARE_NAME);
+
+#undef SNAPSHOT_NUMBER
+#undef SNAPSHOT_STRING
+
+	lua_pushstring(L, IWINFO_OPMODE_NAMES[(s.valid & IWINFO_SNAPSHOT_MODE)
+		? s.mode : IWINFO_OPMODE_UNKNOWN]);
+	lua_setfield(L, -2, "mode");
+
+	if (s.valid & IWINFO_SNAPSHOT_HWMODELIST)
+	{
+		iwinfo_L_hwmodetable(L, s.hwmodelist);
+		lua_setfield(L, -2, "hwmodelist");
+	}
+
+	if (s.valid & IWINFO_SNAPSHOT_HARDWARE_ID)
+	{
+		iwinfo_L_hardwaretable(L, &s.hardware_id);
+		lua_setfield(L, -2, "hardware_id");
+	}
+
+	if (s.valid & IWINFO_SNAPSHOT_ENCRYPTION)
+	{
+		iwinfo_L_cryptotable(L, &s.encryption);
+		lua_setfield(L, -2, "encryption");
+	}
+
+	return 1;
+}
+
 /* Common */
 static const luaL_reg R_common[] = {
 	{ "type", iwinfo_L_type },
+	{ "snapshot", iwinfo_L_snapshot },
 	{ "__gc", iwinfo_L__gc  },
 	{ NULL, NULL }
 };
@@ -446,29 +446,64 @@ static char * nl80211_ifname2phy(const char *ifname)
 	return phy[0] ? phy : NULL;
 }
 
-static char * nl80211_hostapd_info(const char *ifname)
+static char * nl80211_hostapd_info_phy(const char *phy)
 {
-	char *phy;
 	char path[32] = { 0 };
 	static char buf[4096] = { 0 };
 	FILE *conf;
 
-	if ((phy = nl80211_ifname2phy(ifname)) != NULL)
-	{
-		snprintf(path, sizeof(path), "/var/run/hostapd-%s.conf", phy);
+	snprintf(path, sizeof(path), "/var/run/hostapd-%s.conf", phy);
 
-		if ((conf = fopen(path, "r")) != NULL)
-		{
-			fread(buf, sizeof(buf) - 1, 1, conf);
-			fclose(conf);
+	if ((conf = fopen(path, "r")) != NULL)
+	{
+		fread(buf, sizeof(buf) - 1, 1, conf);
+		fclose(conf);
 
-			return buf;
-		}
+		return buf;
 	}
 
 	return NULL;
 }
 
+static char * nl80211_hostapd_info(const char *ifname)
+{
+	char *phy;
+
+	if ((phy = nl80211_ifname2phy(ifname)) != NULL)
+		return nl80211_hostapd_info_phy(phy);
+
+	return NULL;
+}
+
+static int nl80211_hostapd_freq(const char *res)
+{
+	int channel;
+	char *val;
+
+	if (!(val = nl80211_getval(NULL, res, "channel")))
+		return -1;
+
+	/* nl80211_getval() reuses its buffer, convert before the next lookup */
+	channel = atoi(val);
+
+	return nl80211_channel2freq(channel, nl80211_getval(NULL, res, "hw_mode"));
+}
+
+static void nl80211_format_bssid(const char *bssid, char *buf)
+{
+	unsigned char mac[6];
+
+	mac[0] = strtol(&bssid[0],  NULL, 16);
+	mac[1] = strtol(&bssid[3],  NULL, 16);
+	mac[2] = strtol(&bssid[6],  NULL, 16);
+	mac[3] = strtol(&bssid[9],  NULL, 16);
+	mac[4] = strtol(&bssid[12], NULL, 16);
+	mac[5] = strtol(&bssid[15], NULL, 16);
+
+	sprintf(buf, "%02X:%02X:%02X:%02X:%02X:%02X",
+	        mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
 static inline int nl80211_wpactl_recv(int sock, char *buf, int blen)
 {
 	fd_set rfds;
@@ -742,7 +777,6 @@ int nl80211_get_ssid(const char *ifname, char *buf)
 int nl80211_get_bssid(const char *ifname, char *buf)
 {
 	char *bssid;
-	unsigned char mac[6];
 
 	if (!wext_get_bssid(ifname, buf))
 	{
@@ -751,16 +785,7 @@ int nl80211_get_bssid(const char *ifname, char *buf)
 	else if ((bssid = nl80211_hostapd_info(ifname)) &&
 	         (bssid = nl80211_getval(ifname, bssid, "bssid")))
 	{
-		mac[0] = strtol(&bssid[0],  NULL, 16);
-		mac[1] = strtol(&bssid[3],  NULL, 16);
-		mac[2] = strtol(&bssid[6],  NULL, 16);
-		mac[3] = strtol(&bssid[9],  NULL, 16);
-		mac[4] = strtol(&bssid[12], NULL, 16);
-		mac[5] = strtol(&bssid[15], NULL, 16);
-
-		sprintf(buf, "%02X:%02X:%02X:%02X:%02X:%02X",
-		        mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-
+		nl80211_format_bssid(bssid, buf);
 		return 0;
 	}
 
@@ -789,29 +814,32 @@ static int nl80211_get_frequency_cb(struct nl_msg *msg, void *arg)
 	return NL_SKIP;
 }
 
-int nl80211_get_frequency(const char *ifname, int *buf)
+static void nl80211_get_frequency_scan(const char *ifname, int *buf)
 {
-	char *res, *channel;
+	char *res;
 	struct nl80211_msg_conveyor *req;
 
-	*buf = 0;
+	res = nl80211_phy2ifname(ifname);
+	req = nl80211_msg(res ? res : ifname, NL80211_CMD_GET_SCAN, NLM_F_DUMP);
 
-	if ((res = nl80211_hostapd_info(ifname)) &&
-	    (channel = nl80211_getval(NULL, res, "channel")))
+	if (req)
 	{
-		*buf = nl80211_channel2freq(atoi(channel),
-		                            nl80211_getval(NULL, res, "hw_mode"));
+		nl80211_send(req, nl80211_get_frequency_cb, buf);
+		nl80211_free(req);
 	}
-	else
-	{
-		res = nl80211_phy2ifname(ifname);
-		req = nl80211_msg(res ? res : ifname, NL80211_CMD_GET_SCAN, NLM_F_DUMP);
+}
 
-		if (req)
-		{
-			nl80211_send(req, nl80211_get_frequency_cb, buf);
-			nl80211_free(req);
-		}
+int nl80211_get_frequency(const char *ifname, int *buf)
+{
+	char *res;
+
+	*buf = 0;
+
+	if (!(res = nl80211_hostapd_info(ifname)) ||
+	    (*buf = nl80211_hostapd_freq(res)) < 0)
+	{
+		*buf = 0;
+		nl80211_get_frequency_scan(ifname, buf);
 	}
 
 	return (*buf == 0) ? -1 : 0;
@@ -991,29 +1019,52 @@ static int nl80211_get_noise_cb(struct nl_msg *msg, void *arg)
 }
 
 
-int nl80211_get_noise(const char *ifname, int *buf)
+static int8_t nl80211_get_noise_survey(const char *ifname)
 {
-	int8_t noise;
+	int8_t noise = 0;
 	struct nl80211_msg_conveyor *req;
 
 	req = nl80211_msg(ifname, NL80211_CMD_GET_SURVEY, NLM_F_DUMP);
 	if (req)
 	{
-		noise = 0;
-
 		nl80211_send(req, nl80211_get_noise_cb, &noise);
 		nl80211_free(req);
+	}
 
-		if (noise)
-		{
-			*buf = noise;
-			return 0;
-		}
+	return noise;
+}
+
+int nl80211_get_noise(const char *ifname, int *buf)
+{
+	int8_t noise = nl80211_get_noise_survey(ifname);
+
+	if (noise)
+	{
+		*buf = noise;
+		return 0;
 	}
 
 	return -1;
 }
 
+static int nl80211_signal2quality(int signal)
+{
+	/* A positive signal level is usually just a quality
+	 * value, pass through as-is */
+	if (signal >= 0)
+		return signal;
+
+	/* The cfg80211 wext compat layer assumes a signal range
+	 * of -110 dBm to -40 dBm, the quality value is derived
+	 * by adding 110 to the signal level */
+	if (signal < -110)
+		signal = -110;
+	else if (signal > -40)
+		signal = -40;
+
+	return (signal + 110);
+}
+
 int nl80211_get_quality(const char *ifname, int *buf)
 {
 	int signal;
@@ -1023,27 +1074,7 @@ int nl80211_get_quality(const char *ifname, int *buf)
 		*buf = 0;
 
 		if (!nl80211_get_signal(ifname, &signal))
-		{
-			/* A positive signal level is usually just a quality
-			 * value, pass through as-is */
-			if (signal >= 0)
-			{
-				*buf = signal;
-			}
-
-			/* The cfg80211 wext compat layer assumes a signal range
-			 * of -110 dBm to -40 dBm, the quality value is derived
-			 * by adding 110 to the signal level */
-			else
-			{
-				if (signal < -110)
-					signal = -110;
-				else if (signal > -40)
-					signal = -40;
-
-				*buf = (signal + 110);
-			}
-		}
+			*buf = nl80211_signal2quality(signal);
 	}
 
 	return 0;
@@ -1059,163 +1090,175 @@ int nl80211_get_quality_max(const char *ifname, int *buf)
 	return 0;
 }
 
-int nl80211_get_encryption(const char *ifname, char *buf)
+static void nl80211_wpactl_crypto(const char *res, char *val,
+                                  struct iwinfo_crypto_entry *c)
 {
-	int i;
-	char k[9];
-	char *val, *res;
-	struct iwinfo_crypto_entry *c = (struct iwinfo_crypto_entry *)buf;
+	/* WEP */
+	if (strstr(val, "WEP"))
+	{
+		if (strstr(val, "WEP-40"))
+			c->pair_ciphers |= IWINFO_CIPHER_WEP40;
 
-	/* WPA supplicant */
-	if ((res = nl80211_wpactl_info(ifname, "STATUS", NULL)) &&
-	    (val = nl80211_getval(NULL, res, "pairwise_cipher")))
+		else if (strstr(val, "WEP-104"))
+			c->pair_ciphers |= IWINFO_CIPHER_WEP104;
+
+		c->enabled       = 1;
+		c->group_ciphers = c->pair_ciphers;
+
+		c->auth_suites |= IWINFO_KMGMT_NONE;
+		c->auth_algs   |= IWINFO_AUTH_OPEN; /* XXX: assumption */
+	}
+
+	/* WPA */
+	else
 	{
-		/* WEP */
-		if (strstr(val, "WEP"))
-		{
-			if (strstr(val, "WEP-40"))
-				c->pair_ciphers |= IWINFO_CIPHER_WEP40;
+		if (strstr(val, "TKIP"))
+			c->pair_ciphers |= IWINFO_CIPHER_TKIP;
 
-			else if (strstr(val, "WEP-104"))
-				c->pair_ciphers |= IWINFO_CIPHER_WEP104;
+		else if (strstr(val, "CCMP"))
+			c->pair_ciphers |= IWINFO_CIPHER_CCMP;
 
-			c->enabled       = 1;
-			c->group_ciphers = c->pair_ciphers;
+		else if (strstr(val, "NONE"))
+			c->pair_ciphers |= IWINFO_CIPHER_NONE;
 
-			c->auth_suites |= IWINFO_KMGMT_NONE;
-			c->auth_algs   |= IWINFO_AUTH_OPEN; /* XXX: assumption */
-		}
+		else if (strstr(val, "WEP-40"))
+			c->pair_ciphers |= IWINFO_CIPHER_WEP40;
 
-		/* WPA */
-		else
+		else if (strstr(val, "WEP-104"))
+			c->pair_ciphers |= IWINFO_CIPHER_WEP104;
+
+
+		if ((val = nl80211_getval(NULL, res, "group_cipher")))
 		{
 			if (strstr(val, "TKIP"))
-				c->pair_ciphers |= IWINFO_CIPHER_TKIP;
+				c->group_ciphers |= IWINFO_CIPHER_TKIP;
 
 			else if (strstr(val, "CCMP"))
-				c->pair_ciphers |= IWINFO_CIPHER_CCMP;
+				c->group_ciphers |= IWINFO_CIPHER_CCMP;
 
 			else if (strstr(val, "NONE"))
-				c->pair_ciphers |= IWINFO_CIPHER_NONE;
+				c->group_ciphers |= IWINFO_CIPHER_NONE;
 
 			else if (strstr(val, "WEP-40"))
-				c->pair_ciphers |= IWINFO_CIPHER_WEP40;
+				c->group_ciphers |= IWINFO_CIPHER_WEP40;
 
 			else if (strstr(val, "WEP-104"))
-				c->pair_ciphers |= IWINFO_CIPHER_WEP104;
-
+				c->group_ciphers |= IWINFO_CIPHER_WEP104;
+		}
 
-			if ((val = nl80211_getval(NULL, res, "group_cipher")))
-			{
-				if (strstr(val, "TKIP"))
-					c->group_ciphers |= IWINFO_CIPHER_TKIP;
 
-				else if (strstr(val, "CCMP"))
-					c->group_ciphers |= IWINFO_CIPHER_CCMP;
+		if ((val = nl80211_getval(NULL, res, "key_mgmt")))
+		{
+			if (strstr(val, "WPA2"))
+				c->wpa_version = 2;
 
-				else if (strstr(val, "NONE"))
-					c->group_ciphers |= IWINFO_CIPHER_NONE;
+			else if (strstr(val, "WPA"))
+				c->wpa_version = 1;
 
-				else if (strstr(val, "WEP-40"))
-					c->group_ciphers |= IWINFO_CIPHER_WEP40;
 
-				else if (strstr(val, "WEP-104"))
-					c->group_ciphers |= IWINFO_CIPHER_WEP104;
-			}
+			if (strstr(val, "PSK"))
+				c->auth_suites |= IWINFO_KMGMT_PSK;
 
+			else if (strstr(val, "EAP") || strstr(val, "802.1X"))
+				c->auth_suites |= IWINFO_KMGMT_8021x;
 
-			if ((val = nl80211_getval(NULL, res, "key_mgmt")))
-			{
-				if (strstr(val, "WPA2"))
-					c->wpa_version = 2;
+			else if (strstr(val, "NONE"))
+				c->auth_suites |= IWINFO_KMGMT_NONE;
+		}
 
-				else if (strstr(val, "WPA"))
-					c->wpa_version = 1;
+		c->enabled = (c->wpa_version && c->auth_suites) ? 1 : 0;
+	}
+}
 
+static void nl80211_hostapd_crypto(const char *ifname, const char *res,
+                                   struct iwinfo_crypto_entry *c)
+{
+	int i;
+	char k[9];
+	char *val;
 
-				if (strstr(val, "PSK"))
-					c->auth_suites |= IWINFO_KMGMT_PSK;
+	if ((val = nl80211_getval(ifname, res, "wpa")) != NULL)
+		c->wpa_version = atoi(val);
 
-				else if (strstr(val, "EAP") || strstr(val, "802.1X"))
-					c->auth_suites |= IWINFO_KMGMT_8021x;
+	val = nl80211_getval(ifname, res, "wpa_key_mgmt");
 
-				else if (strstr(val, "NONE"))
-					c->auth_suites |= IWINFO_KMGMT_NONE;
-			}
+	if (!val || strstr(val, "PSK"))
+		c->auth_suites |= IWINFO_KMGMT_PSK;
 
-			c->enabled = (c->wpa_version && c->auth_suites) ? 1 : 0;
-		}
+	if (val && strstr(val, "EAP"))
+		c->auth_suites |= IWINFO_KMGMT_8021x;
 
-		return 0;
-	}
+	if (val && strstr(val, "NONE"))
+		c->auth_suites |= IWINFO_KMGMT_NONE;
 
-	/* Hostapd */
-	else if ((res = nl80211_hostapd_info(ifname)))
+	if ((val = nl80211_getval(ifname, res, "wpa_pairwise")) != NULL)
 	{
-		if ((val = nl80211_getval(ifname, res, "wpa")) != NULL)
-			c->wpa_version = atoi(val);
-
-		val = nl80211_getval(ifname, res, "wpa_key_mgmt");
+		if (strstr(val, "TKIP"))
+			c->pair_ciphers |= IWINFO_CIPHER_TKIP;
 
-		if (!val || strstr(val, "PSK"))
-			c->auth_suites |= IWINFO_KMGMT_PSK;
+		if (strstr(val, "CCMP"))
+			c->pair_ciphers |= IWINFO_CIPHER_CCMP;
 
-		if (val && strstr(val, "EAP"))
-			c->auth_suites |= IWINFO_KMGMT_8021x;
+		if (strstr(val, "NONE"))
+			c->pair_ciphers |= IWINFO_CIPHER_NONE;
+	}
 
-		if (val && strstr(val, "NONE"))
-			c->auth_suites |= IWINFO_KMGMT_NONE;
+	if ((val = nl80211_getval(ifname, res, "auth_algs")) != NULL)
+	{
+		switch(atoi(val)) {
+			case 1:
+				c->auth_algs |= IWINFO_AUTH_OPEN;
+				break;
 
-		if ((val = nl80211_getval(ifname, res, "wpa_pairwise")) != NULL)
-		{
-			if (strstr(val, "TKIP"))
-				c->pair_ciphers |= IWINFO_CIPHER_TKIP;
+			case 2:
+				c->auth_algs |= IWINFO_AUTH_SHARED;
+				break;
 
-			if (strstr(val, "CCMP"))
-				c->pair_ciphers |= IWINFO_CIPHER_CCMP;
+			case 3:
+				c->auth_algs |= IWINFO_AUTH_OPEN;
+				c->auth_algs |= IWINFO_AUTH_SHARED;
+				break;
 
-			if (strstr(val, "NONE"))
-				c->pair_ciphers |= IWINFO_CIPHER_NONE;
+			default:
+				break;
 		}
 
-		if ((val = nl80211_getval(ifname, res, "auth_algs")) != NULL)
+		for (i = 0; i < 4; i++)
 		{
-			switch(atoi(val)) {
-				case 1:
-					c->auth_algs |= IWINFO_AUTH_OPEN;
-					break;
-
-				case 2:
-					c->auth_algs |= IWINFO_AUTH_SHARED;
-					break;
-
-				case 3:
-					c->auth_algs |= IWINFO_AUTH_OPEN;
-					c->auth_algs |= IWINFO_AUTH_SHARED;
-					break;
-
-				default:
-					break;
-			}
+			snprintf(k, sizeof(k), "wep_key%d", i);
 
-			for (i = 0; i < 4; i++)
+			if ((val = nl80211_getval(ifname, res, k)))
 			{
-				snprintf(k, sizeof(k), "wep_key%d", i);
-
-				if ((val = nl80211_getval(ifname, res, k)))
-				{
-					if ((strlen(val) == 5) || (strlen(val) == 10))
-						c->pair_ciphers |= IWINFO_CIPHER_WEP40;
+				if ((strlen(val) == 5) || (strlen(val) == 10))
+					c->pair_ciphers |= IWINFO_CIPHER_WEP40;
 
-					else if ((strlen(val) == 13) || (strlen(val) == 26))
-						c->pair_ciphers |= IWINFO_CIPHER_WEP104;
-				}
+				else if ((strlen(val) == 13) || (strlen(val) == 26))
+					c->pair_ciphers |= IWINFO_CIPHER_WEP104;
 			}
 		}
+	}
 
-		c->group_ciphers = c->pair_ciphers;
-		c->enabled = (c->wpa_version || c->pair_ciphers) ? 1 : 0;
+	c->group_ciphers = c->pair_ciphers;
+	c->enabled = (c->wpa_version || c->pair_ciphers) ? 1 : 0;
+}
 
+int nl80211_get_encryption(const char *ifname, char *buf)
+{
+	char *val, *res;
+	struct iwinfo_crypto_entry *c = (struct iwinfo_crypto_entry *)buf;
+
+	/* WPA supplicant */
+	if ((res = nl80211_wpactl_info(ifname, "STATUS", NULL)) &&
+	    (val = nl80211_getval(NULL, res, "pairwise_cipher")))
+	{
+		nl80211_wpactl_crypto(res, val, c);
+		return 0;
+	}
+
+	/* Hostapd */
+	else if ((res = nl80211_hostapd_info(ifname)))
+	{
+		nl80211_hostapd_crypto(ifname, res, c);
 		return 0;
 	}
 
@@ -2080,3 +2123,166 @@ int nl80211_get_frequency_offset(const char *ifname, int *buf)
 	*buf = hw->frequency_offset;
 	return 0;
 }
+
+struct nl80211_snapshot_wiphy {
+	char phy[32];
+	int hwmodes;
+};
+
+static int nl80211_get_snapshot_wiphy_cb(struct nl_msg *msg, void *arg)
+{
+	struct nl80211_snapshot_wiphy *w = arg;
+
+	nl80211_ifname2phy_cb(msg, w->phy);
+	return nl80211_get_hwmodelist_cb(msg, &w->hwmodes);
+}
+
+int nl80211_get_snapshot(const char *ifname, struct iwinfo_snapshot *s)
+{
+	int8_t noise;
+	char *conf, *res, *val;
+	struct nl80211_snapshot_wiphy w;
+	struct nl80211_rssi_rate rr = { 0 };
+	struct nl80211_msg_conveyor *req;
+	const struct iwinfo_hardware_entry *hw;
+
+	memset(&w, 0, sizeof(w));
+
+	/* A single wiphy request yields both the phy name and the hw modes */
+	req = nl80211_msg(ifname, NL80211_CMD_GET_WIPHY, 0);
+	if (req)
+	{
+		nl80211_send(req, nl80211_get_snapshot_wiphy_cb, &w);
+		nl80211_free(req);
+	}
+
+	if (w.hwmodes)
+	{
+		s->hwmodelist = w.hwmodes;
+		s->valid |= IWINFO_SNAPSHOT_HWMODELIST;
+	}
+
+	/* The hostapd config is read once and used for all lookups below,
+	 * values from nl80211_getval() must be consumed before the next call */
+	conf = w.phy[0] ? nl80211_hostapd_info_phy(w.phy) : NULL;
+
+	if (!wext_get_mode(ifname, &s->mode))
+		s->valid |= IWINFO_SNAPSHOT_MODE;
+
+	if (!wext_get_ssid(ifname, s->ssid))
+		s->valid |= IWINFO_SNAPSHOT_SSID;
+	else if (conf && (val = nl80211_getval(ifname, conf, "ssid")))
+	{
+		snprintf(s->ssid, sizeof(s->ssid), "%s", val);
+		s->valid |= IWINFO_SNAPSHOT_SSID;
+	}
+
+	if (!wext_get_bssid(ifname, s->bssid))
+		s->valid |= IWINFO_SNAPSHOT_BSSID;
+	else if (conf && (val = nl80211_getval(ifname, conf, "bssid")))
+	{
+		nl80211_format_bssid(val, s->bssid);
+		s->valid |= IWINFO_SNAPSHOT_BSSID;
+	}
+
+	if (!conf || (s->frequency = nl80211_hostapd_freq(conf)) < 0)
+	{
+		s->frequency = 0;
+		nl80211_get_frequency_scan(ifname, &s->frequency);
+	}
+
+	if (s->frequency)
+	{
+		s->channel = nl80211_freq2channel(s->frequency);
+		s->valid |= IWINFO_SNAPSHOT_FREQUENCY | IWINFO_SNAPSHOT_CHANNEL;
+	}
+
+	if (!wext_get_txpower(ifname, &s->txpower))
+		s->valid |= IWINFO_SNAPSHOT_TXPOWER;
+
+	/* One station dump serves bitrate, signal and quality */
+	if (!wext_get_bitrate(ifname, &s->bitrate))
+		s->valid |= IWINFO_SNAPSHOT_BITRATE;
+
+	if (!wext_get_signal(ifname, &s->signal))
+		s->valid |= IWINFO_SNAPSHOT_SIGNAL;
+
+	if (!(s->valid & IWINFO_SNAPSHOT_BITRATE) ||
+	    !(s->valid & IWINFO_SNAPSHOT_SIGNAL))
+	{
+		nl80211_fill_signal(ifname, &rr);
+
+		if (!(s->valid & IWINFO_SNAPSHOT_BITRATE) && rr.rate)
+		{
+			s->bitrate = (rr.rate * 100);
+			s->valid |= IWINFO_SNAPSHOT_BITRATE;
+		}
+
+		if (!(s->valid & IWINFO_SNAPSHOT_SIGNAL) && rr.rssi)
+		{
+			s->signal = rr.rssi;
+			s->valid |= IWINFO_SNAPSHOT_SIGNAL;
+		}
+	}
+
+	if (wext_get_quality(ifname, &s->quality))
+		s->quality = (s->valid & IWINFO_SNAPSHOT_SIGNAL)
+			? nl80211_signal2quality(s->signal) : 0;
+
+	if (wext_get_quality_max(ifname, &s->quality_max))
+		s->quality_max = 70;
+
+	s->valid |= IWINFO_SNAPSHOT_QUALITY | IWINFO_SNAPSHOT_QUALITY_MAX;
+
+	if ((noise = nl80211_get_noise_survey(ifname)) != 0)
+	{
+		s->noise = noise;
+		s->valid |= IWINFO_SNAPSHOT_NOISE;
+	}
+
+	if (!nl80211_get_country(ifname, s->country))
+		s->valid |= IWINFO_SNAPSHOT_COUNTRY;
+
+	if ((val = nl80211_wpactl_info(ifname, "STATUS", NULL)) &&
+	    (res = nl80211_getval(NULL, val, "pairwise_cipher")))
+	{
+		nl80211_wpactl_crypto(val, res, &s->encryption);
+		s->valid |= IWINFO_SNAPSHOT_ENCRYPTION;
+	}
+	else if (conf)
+	{
+		nl80211_hostapd_crypto(ifname, conf, &s->encryption);
+		s->valid |= IWINFO_SNAPSHOT_ENCRYPTION;
+	}
+
+	/* Hardware ids and offsets are resolved once */
+	if (!nl80211_get_hardware_id(ifname, (char *)&s->hardware_id))
+	{
+		s->valid |= IWINFO_SNAPSHOT_HARDWARE_ID;
+		hw = iwinfo_hardware(&s->hardware_id);
+	}
+	else
+	{
+		hw = NULL;
+	}
+
+	if (hw)
+	{
+		snprintf(s->hardware_name, sizeof(s->hardware_name), "%s %s",
+		         hw->vendor_name, hw->device_name);
+
+		s->txpower_offset   = hw->txpower_offset;
+		s->frequency_offset = hw->frequency_offset;
+		s->valid |= IWINFO_SNAPSHOT_TXPOWER_OFFSET |
+		            IWINFO_SNAPSHOT_FREQUENCY_OFFSET;
+	}
+	else
+	{
+		snprintf(s->hardware_name, sizeof(s->hardware_name),
+		         "Generic MAC80211");
+	}
+
+	s->valid |= IWINFO_SNAPSHOT_HARDWARE_NAME;
+
+	return 0;
+}
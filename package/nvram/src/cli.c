@@ -100,6 +100,59 @@ static int do_set(nvram_handle_t *nvram, const char *pair)
 	return stat;
 }
 
+static int do_batch(nvram_handle_t *nvram, int *commit)
+{
+	static char line[NVRAM_SPACE];
+	char *nl;
+	int lineno = 0;
+	int err = 0;
+
+	/* One command per line, applied to the same handle and committed once */
+	while( fgets(line, sizeof(line), stdin) != NULL )
+	{
+		lineno++;
+
+		if( (nl = strchr(line, '\n')) != NULL )
+			*nl = '\0';
+
+		if( line[0] == '\0' || line[0] == '#' )
+			continue;
+
+		if( !strncmp(line, "set ", 4) )
+		{
+			err = do_set(nvram, line + 4);
+		}
+		else if( !strncmp(line, "unset ", 6) )
+		{
+			err = do_unset(nvram, line + 6);
+		}
+		else if( !strcmp(line, "commit") )
+		{
+			*commit = 1;
+		}
+		else
+		{
+			fprintf(stderr, "Invalid batch command on line %d: %s\n", lineno, line);
+			err = 1;
+			break;
+		}
+
+		if( err )
+		{
+			fprintf(stderr, "Failed batch command on line %d: %s\n", lineno, line);
+			break;
+		}
+	}
+
+	if( !err && ferror(stdin) )
+	{
+		fprintf(stderr, "Error reading batch commands after line %d\n", lineno);
+		err = 1;
+	}
+
+	return err;
+}
+
 static int do_info(nvram_handle_t *nvram)
 {
 	nvram_header_t *hdr = nvram_header(nvram);
@@ -143,7 +196,7 @@ int main( int argc, const char *argv[] )
 	for( i = 1; i < argc; i++ )
 		if( ( !strcmp(argv[i], "set")   && ++i < argc ) ||
 			( !strcmp(argv[i], "unset") && ++i < argc ) ||
-			!strcmp(argv[i], "commit") )
+			!strcmp(argv[i], "commit") || !strcmp(argv[i], "batch") )
 		{
 			write = 1;
 			break;
@@ -198,6 +251,18 @@ int main( int argc, const char *argv[] )
 				commit = 1;
 				done++;
 			}
+			else if( !strcmp(argv[i], "batch") )
+			{
+				done++;
+
+				/* Discard the whole batch on error */
+				if( (stat = do_batch(nvram, &commit)) != 0 )
+				{
+					write = 0;
+					commit = 0;
+					break;
+				}
+			}
 			else
 			{
 				fprintf(stderr, "Unknown option '%s' !\n", argv[i]);
@@ -237,6 +302,10 @@ int main( int argc, const char *argv[] )
 			"	nvram set variable=value [set ...]\n"
 			"	nvram unset variable [unset ...]\n"
 			"	nvram commit\n"
+			"	nvram batch < commands\n"
+			"\n"
+			"A batch reads 'set variable=value', 'unset variable' and\n"
+			"'commit' lines from stdin and applies them all at once.\n"
 		);
 
 		stat = 1;
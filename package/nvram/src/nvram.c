@@ -36,6 +36,19 @@ static uint32_t hash(const char *s)
 	return hash;
 }
 
+/* Free tuples which were replaced or unset. */
+static void _nvram_free_dead(nvram_handle_t *h)
+{
+	nvram_tuple_t *t, *next;
+
+	for (t = h->nvram_dead; t; t = next) {
+		next = t->next;
+		free(t);
+	}
+
+	h->nvram_dead = NULL;
+}
+
 /* Free all tuples. */
 static void _nvram_free(nvram_handle_t *h)
 {
@@ -52,12 +65,7 @@ static void _nvram_free(nvram_handle_t *h)
 	}
 
 	/* Free dead table */
-	for (t = h->nvram_dead; t; t = next) {
-		next = t->next;
-		free(t);
-	}
-
-	h->nvram_dead = NULL;
+	_nvram_free_dead(h);
 }
 
 /* (Re)allocate NVRAM tuples. */
@@ -91,26 +99,11 @@ static nvram_tuple_t * _nvram_realloc( nvram_handle_t *h, nvram_tuple_t *t,
 	return t;
 }
 
-/* (Re)initialize the hash table. */
-static int _nvram_rehash(nvram_handle_t *h)
+/* Fill in SDRAM parameters missing from the data area from the header. */
+static void _nvram_sdram_defaults(nvram_handle_t *h)
 {
 	nvram_header_t *header = nvram_header(h);
-	char buf[] = "0xXXXXXXXX", *name, *value, *eq;
-
-	/* (Re)initialize hash table */
-	_nvram_free(h);
-
-	/* Parse and set "name=value\0 ... \0\0" */
-	name = (char *) &header[1];
-
-	for (; *name; name = value + strlen(value) + 1) {
-		if (!(eq = strchr(name, '=')))
-			break;
-		*eq = '\0';
-		value = eq + 1;
-		nvram_set(h, name, value);
-		*eq = '=';
-	}
+	char buf[] = "0xXXXXXXXX";
 
 	/* Set special SDRAM parameters */
 	if (!nvram_get(h, "sdram_init")) {
@@ -130,6 +123,33 @@ static int _nvram_rehash(nvram_handle_t *h)
 		sprintf(buf, "0x%08X", header->config_ncdl);
 		nvram_set(h, "sdram_ncdl", buf);
 	}
+}
+
+/* (Re)initialize the hash table. */
+static int _nvram_rehash(nvram_handle_t *h)
+{
+	nvram_header_t *header = nvram_header(h);
+	char *name, *value, *eq;
+
+	/* (Re)initialize hash table */
+	_nvram_free(h);
+
+	/* Parse and set "name=value\0 ... \0\0" */
+	name = (char *) &header[1];
+
+	for (; *name; name = value + strlen(value) + 1) {
+		if (!(eq = strchr(name, '=')))
+			break;
+		*eq = '\0';
+		value = eq + 1;
+		nvram_set(h, name, value);
+		*eq = '=';
+	}
+
+	/* The table now matches the data area, SDRAM parameters missing
+	 * from it will be written out on the next commit */
+	h->dirty = 0;
+	_nvram_sdram_defaults(h);
 
 	return 0;
 }
@@ -179,10 +199,16 @@ int nvram_set(nvram_handle_t *h, const char *name, const char *value)
 	for (prev = &h->nvram_hash[i], t = *prev;
 		 t && strcmp(t->name, name); prev = &t->next, t = *prev);
 
+	/* Nothing to do if the value is unchanged */
+	if (t && !strcmp(t->value, value))
+		return 0;
+
 	/* (Re)allocate tuple */
 	if (!(u = _nvram_realloc(h, t, name, value)))
 		return -12; /* -ENOMEM */
 
+	h->dirty = 1;
+
 	/* Value reallocated */
 	if (t && t == u)
 		return 0;
@@ -194,9 +220,11 @@ int nvram_set(nvram_handle_t *h, const char *name, const char *value)
 		h->nvram_dead = t;
 	}
 
-	/* Add new tuple to the hash table */
-	u->next = h->nvram_hash[i];
-	h->nvram_hash[i] = u;
+	/* Append new tuple to the hash chain, keeping the chains in the
+	 * order of the data area so that an unchanged table is written
+	 * back byte for byte */
+	u->next = *prev;
+	*prev = u;
 
 	return 0;
 }
@@ -222,6 +250,7 @@ int nvram_unset(nvram_handle_t *h, const char *name)
 		*prev = t->next;
 		t->next = h->nvram_dead;
 		h->nvram_dead = t;
+		h->dirty = 1;
 	}
 
 	return 0;
@@ -258,44 +287,56 @@ nvram_tuple_t * nvram_getall(nvram_handle_t *h)
 int nvram_commit(nvram_handle_t *h)
 {
 	nvram_header_t *header = nvram_header(h);
+	nvram_header_t *image;
 	char *init, *config, *refresh, *ncdl;
-	char *ptr, *end;
-	int i;
+	char *ptr, *end, *area;
+	int i, first, last, truncated = 0;
+	long pagesize;
 	nvram_tuple_t *t;
 	nvram_header_t tmp;
 	uint8_t crc;
 
+	/* Nothing was set or unset since the table was last in sync */
+	if (!h->dirty)
+		return 0;
+
+	/* Build the new contents in memory first */
+	if (!(image = malloc(NVRAM_SPACE)))
+		return -12; /* -ENOMEM */
+
 	/* Regenerate header */
-	header->magic = NVRAM_MAGIC;
-	header->crc_ver_init = (NVRAM_VERSION << 8);
+	image->magic = NVRAM_MAGIC;
+	image->crc_ver_init = (NVRAM_VERSION << 8);
 	if (!(init = nvram_get(h, "sdram_init")) ||
 		!(config = nvram_get(h, "sdram_config")) ||
 		!(refresh = nvram_get(h, "sdram_refresh")) ||
 		!(ncdl = nvram_get(h, "sdram_ncdl"))) {
-		header->crc_ver_init |= SDRAM_INIT << 16;
-		header->config_refresh = SDRAM_CONFIG;
-		header->config_refresh |= SDRAM_REFRESH << 16;
-		header->config_ncdl = 0;
+		image->crc_ver_init |= SDRAM_INIT << 16;
+		image->config_refresh = SDRAM_CONFIG;
+		image->config_refresh |= SDRAM_REFRESH << 16;
+		image->config_ncdl = 0;
 	} else {
-		header->crc_ver_init |= (strtoul(init, NULL, 0) & 0xffff) << 16;
-		header->config_refresh = strtoul(config, NULL, 0) & 0xffff;
-		header->config_refresh |= (strtoul(refresh, NULL, 0) & 0xffff) << 16;
-		header->config_ncdl = strtoul(ncdl, NULL, 0);
+		image->crc_ver_init |= (strtoul(init, NULL, 0) & 0xffff) << 16;
+		image->config_refresh = strtoul(config, NULL, 0) & 0xffff;
+		image->config_refresh |= (strtoul(refresh, NULL, 0) & 0xffff) << 16;
+		image->config_ncdl = strtoul(ncdl, NULL, 0);
 	}
 
 	/* Clear data area */
-	ptr = (char *) header + sizeof(nvram_header_t);
+	ptr = (char *) image + sizeof(nvram_header_t);
 	memset(ptr, 0xFF, NVRAM_SPACE - sizeof(nvram_header_t));
 	memset(&tmp, 0, sizeof(nvram_header_t));
 
 	/* Leave space for a double NUL at the end */
-	end = (char *) header + NVRAM_SPACE - 2;
+	end = (char *) image + NVRAM_SPACE - 2;
 
 	/* Write out all tuples */
 	for (i = 0; i < NVRAM_ARRAYSIZE(h->nvram_hash); i++) {
 		for (t = h->nvram_hash[i]; t; t = t->next) {
-			if ((ptr + strlen(t->name) + 1 + strlen(t->value) + 1) > end)
+			if ((ptr + strlen(t->name) + 1 + strlen(t->value) + 1) > end) {
+				truncated = 1;
 				break;
+			}
 			ptr += sprintf(ptr, "%s=%s", t->name, t->value) + 1;
 		}
 	}
@@ -304,34 +345,70 @@ int nvram_commit(nvram_handle_t *h)
 	*ptr = '\0';
 	ptr++;
 
-	if( (int)ptr % 4 )
-		memset(ptr, 0, 4 - ((int)ptr % 4));
+	if( (ptr - (char *) image) % 4 )
+		memset(ptr, 0, 4 - ((ptr - (char *) image) % 4));
 
 	ptr++;
 
 	/* Set new length */
-	header->len = NVRAM_ROUNDUP(ptr - (char *) header, 4);
+	image->len = NVRAM_ROUNDUP(ptr - (char *) image, 4);
 
 	/* Little-endian CRC8 over the last 11 bytes of the header */
-	tmp.crc_ver_init   = header->crc_ver_init;
-	tmp.config_refresh = header->config_refresh;
-	tmp.config_ncdl    = header->config_ncdl;
+	tmp.crc_ver_init   = image->crc_ver_init;
+	tmp.config_refresh = image->config_refresh;
+	tmp.config_ncdl    = image->config_ncdl;
 	crc = hndcrc8((unsigned char *) &tmp + NVRAM_CRC_START_POSITION,
 		sizeof(nvram_header_t) - NVRAM_CRC_START_POSITION, 0xff);
 
 	/* Continue CRC8 over data bytes */
-	crc = hndcrc8((unsigned char *) &header[0] + sizeof(nvram_header_t),
-		header->len - sizeof(nvram_header_t), crc);
+	crc = hndcrc8((unsigned char *) &image[0] + sizeof(nvram_header_t),
+		image->len - sizeof(nvram_header_t), crc);
 
 	/* Set new CRC8 */
-	header->crc_ver_init |= crc;
+	image->crc_ver_init |= crc;
+
+	/* Only touch the part of the data area that actually differs */
+	area = (char *) header;
 
-	/* Write out */
-	msync(h->mmap, h->length, MS_SYNC);
-	fsync(h->fd);
+	for (first = sizeof(nvram_header_t); first < NVRAM_SPACE &&
+		 area[first] == ((char *) image)[first]; first++);
+
+	if (first < NVRAM_SPACE) {
+		for (last = NVRAM_SPACE - 1;
+			 area[last] == ((char *) image)[last]; last--);
+
+		memcpy(area + first, (char *) image + first, last - first + 1);
+	}
 
-	/* Reinitialize hash table */
-	return _nvram_rehash(h);
+	if (first < NVRAM_SPACE || memcmp(area, image, sizeof(nvram_header_t))) {
+		memcpy(area, image, sizeof(nvram_header_t));
+
+		/* Write out */
+		pagesize = sysconf(_SC_PAGESIZE);
+		msync(h->mmap + (h->offset & ~(pagesize - 1)),
+			sizeof(nvram_header_t) + (h->offset & (pagesize - 1)), MS_SYNC);
+
+		if (first < NVRAM_SPACE) {
+			first = (h->offset + first) & ~(pagesize - 1);
+			last += h->offset + 1;
+			msync(h->mmap + first, last - first, MS_SYNC);
+		}
+
+		fsync(h->fd);
+	}
+
+	free(image);
+
+	/* Tuples that did not fit are gone, start over from the data area */
+	if (truncated)
+		return _nvram_rehash(h);
+
+	/* The table is authoritative, no need to parse the data area again */
+	_nvram_free_dead(h);
+	h->dirty = 0;
+	_nvram_sdram_defaults(h);
+
+	return 0;
 }
 
 /* Open NVRAM and obtain a handle. */
@@ -526,6 +603,7 @@ int staging_to_nvram(void)
 	int fdmtd, fdstg, stat;
 	char *mtd = nvram_find_mtd();
 	char buf[nvram_erase_size];
+	char cur[nvram_erase_size];
 
 	stat = -1;
 
@@ -535,7 +613,17 @@ int staging_to_nvram(void)
 		{
 			if( read(fdstg, buf, sizeof(buf)) == sizeof(buf) )
 			{
-				if( (fdmtd = open(mtd, O_WRONLY | O_SYNC)) > -1 )
+				/* Don't erase and rewrite the flash for nothing */
+				if( (fdmtd = open(mtd, O_RDONLY)) > -1 )
+				{
+					if( read(fdmtd, cur, sizeof(cur)) == sizeof(cur) &&
+						!memcmp(buf, cur, sizeof(buf)) )
+						stat = 0;
+
+					close(fdmtd);
+				}
+
+				if( stat && (fdmtd = open(mtd, O_WRONLY | O_SYNC)) > -1 )
 				{
 					write(fdmtd, buf, sizeof(buf));
 					fsync(fdmtd);
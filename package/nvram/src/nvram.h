@@ -50,6 +50,7 @@ struct nvram_handle {
 	unsigned int offset;
 	struct nvram_tuple *nvram_hash[257];
 	struct nvram_tuple *nvram_dead;
+	int dirty;
 };
 
 typedef struct nvram_handle nvram_handle_t;
@@ -72,7 +73,8 @@ int nvram_unset(nvram_handle_t *h, const char *name);
 /* Get all NVRAM variables. */
 nvram_tuple_t * nvram_getall(nvram_handle_t *h);
 
-/* Regenerate NVRAM. */
+/* Regenerate NVRAM, only writing out what changed since the last commit.
+ * Any number of nvram_set() and nvram_unset() calls can be batched before. */
 int nvram_commit(nvram_handle_t *h);
 
 /* Open NVRAM and obtain a handle. */
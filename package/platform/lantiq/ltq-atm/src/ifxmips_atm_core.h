@@ -199,6 +199,10 @@ struct connection {
 	unsigned int aal5_vcc_crc_err; /* number of packets with CRC error */
 	unsigned int aal5_vcc_oversize_sdu; /* number of packets with oversize error */
 
+	unsigned int rx_poll_pdu;    /* packets delivered by the RX poll */
+	unsigned int tx_copy_pdu;    /* packets copied on TX to make room for the header */
+	unsigned int tx_copy_byte;   /* bytes copied on TX */
+
 	unsigned int port;
 };
 
@@ -227,6 +231,9 @@ struct atm_priv_data {
 	unsigned int wtx_err_oam;    /*  error during transmiting OAM cell       */
 	unsigned int wtx_drop_oam;   /*  OAM cell dropped by driver on TX        */
 
+	unsigned int rx_poll;        /*  RX poll runs                            */
+	unsigned int rx_poll_full;   /*  RX poll runs which used up the budget   */
+
 	ppe_u64_t wrx_total_byte;
 	ppe_u64_t wtx_total_byte;
 	unsigned int prev_wrx_total_byte;
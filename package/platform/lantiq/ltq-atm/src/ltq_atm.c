@@ -39,6 +39,7 @@
 #include <linux/atm.h>
 #include <linux/clk.h>
 #include <linux/interrupt.h>
+#include <linux/seq_file.h>
 #ifdef CONFIG_XFRM
   #include <net/xfrm.h>
 #endif
@@ -105,6 +106,10 @@ static int dma_tx_descriptor_length = 64;       /*  Number of descriptors per DM
   \brief PPE core clock cycles between descriptor write and effectiveness in external RAM
  */
 static int dma_rx_clp1_descriptor_threshold = 38;
+/*!
+  \brief Max number of AAL5 frames delivered per RX poll
+ */
+static int rx_poll_budget = 32;                 /*  Max number of AAL5 frames delivered per RX poll */
 /*@}*/
 
 MODULE_PARM(qsb_tau, "i");
@@ -136,6 +141,8 @@ MODULE_PARM(dma_tx_descriptor_length, "i");
 MODULE_PARM_DESC(dma_tx_descriptor_length, "Number of descriptor assigned to DMA TX channel (>16)");
 MODULE_PARM(dma_rx_clp1_descriptor_threshold, "i");
 MODULE_PARM_DESC(dma_rx_clp1_descriptor_threshold, "Descriptor threshold for cells with cell loss priority 1");
+MODULE_PARM(rx_poll_budget, "i");
+MODULE_PARM_DESC(rx_poll_budget, "Max number of AAL5 frames delivered per RX poll (>0)");
 
 
 
@@ -196,7 +203,8 @@ static struct sk_buff* skb_break_away_from_protocol(struct sk_buff *);
  *  mailbox handler and signal function
  */
 static inline void mailbox_oam_rx_handler(void);
-static inline void mailbox_aal_rx_handler(void);
+static inline int mailbox_aal_rx_handler(int);
+static void do_aal_rx_tasklet(unsigned long);
 static irqreturn_t mailbox_irq_handler(int, void *);
 static inline void mailbox_signal(unsigned int, int);
 
@@ -228,6 +236,11 @@ static inline void clear_priv_data(void);
 static inline void init_rx_tables(void);
 static inline void init_tx_tables(void);
 
+/*
+ *  Proc File
+ */
+static int proc_mib_open(struct inode *, struct file *);
+
 /*
  *  Exteranl Function
  */
@@ -259,10 +272,23 @@ EXPORT_SYMBOL(ifx_mei_atm_showtime_exit);
 
 #endif
 
-static struct sk_buff* (*ifx_atm_alloc_tx)(struct atm_vcc *, unsigned int) = NULL;
+/*  provided by the ATM core, see atm_alloc_tx()    */
+extern struct sk_buff* (*ifx_atm_alloc_tx)(struct atm_vcc *, unsigned int);
 
 static struct atm_priv_data g_atm_priv_data;
 
+static DECLARE_TASKLET(g_aal_rx_tasklet, do_aal_rx_tasklet, 0);
+
+static const struct file_operations g_proc_mib_fops = {
+	.owner = THIS_MODULE,
+	.open = proc_mib_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct proc_dir_entry *g_proc_dir = NULL;
+
 static struct atmdev_ops g_ifx_atm_ops = {
 	.open = ppe_open,
 	.close = ppe_close,
@@ -364,6 +390,10 @@ static int ppe_open(struct atm_vcc *vcc)
 	if ( vcc->qos.aal != ATM_AAL5 && vcc->qos.aal != ATM_AAL0 )
 		return -EPROTONOSUPPORT;
 
+	/*  let vcc_sendmsg() reject frames atm_alloc_tx() cannot take  */
+	if ( vcc->qos.aal == ATM_AAL5 && vcc->qos.txtp.max_sdu > aal5s_max_packet_size )
+		vcc->qos.txtp.max_sdu = aal5s_max_packet_size;
+
 #if !defined(DISABLE_QOS_WORKAROUND) || !DISABLE_QOS_WORKAROUND
 	/*  check bandwidth */
 	if ( (vcc->qos.txtp.traffic_class == ATM_CBR && vcc->qos.txtp.max_pcr > (port->tx_max_cell_rate - port->tx_current_cell_rate))
@@ -464,15 +494,21 @@ static void ppe_close(struct atm_vcc *vcc)
 	/*  clear htu   */
 	clear_htu_entry(conn);
 
-	/*  release connection  */
+	/*  release connection, the RX tasklet must not be using the vcc  */
+	tasklet_disable(&g_aal_rx_tasklet);
 	connection->vcc = NULL;
 	connection->aal5_vcc_crc_err = 0;
 	connection->aal5_vcc_oversize_sdu = 0;
+	connection->rx_poll_pdu = 0;
+	connection->tx_copy_pdu = 0;
+	connection->tx_copy_byte = 0;
 	clear_bit(conn, &g_atm_priv_data.conn_table);
+	tasklet_enable(&g_aal_rx_tasklet);
 
 	/*  disable irq */
 	if ( g_atm_priv_data.conn_table == 0 ) {
 		disable_irq(PPE_MAILBOX_IGU1_INT);
+		tasklet_kill(&g_aal_rx_tasklet);
 		ifx_atm_alloc_tx = NULL;
 	}
 
@@ -526,19 +562,28 @@ static int ppe_send(struct atm_vcc *vcc, struct sk_buff *skb)
 		int datalen;
 		struct tx_inband_header *header;
 
-		byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-		if ( skb_headroom(skb) < byteoff + TX_INBAND_HEADER_LENGTH )
-			new_skb = skb_duplicate(skb);
-		else
-			new_skb = skb_break_away_from_protocol(skb);
+		new_skb = skb_break_away_from_protocol(skb);
 		if ( new_skb == NULL ) {
-			pr_err("either skb_duplicate or skb_break_away_from_protocol fail\n");
+			pr_err("skb_break_away_from_protocol fail\n");
 			ret = -ENOMEM;
 			goto PPE_SEND_FAIL;
 		}
 		dev_kfree_skb_any(skb);
 		skb = new_skb;
 
+		/*  the header goes into the headroom, only copy the buffer if there  */
+		/*  is not enough of it or the header area is shared with a clone     */
+		byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
+		if ( skb_headroom(skb) < byteoff + TX_INBAND_HEADER_LENGTH || skb_header_cloned(skb) ) {
+			if ( skb_cow_head(skb, TX_INBAND_HEADER_LENGTH + DATA_BUFFER_ALIGNMENT) ) {
+				pr_err("skb_cow_head fail\n");
+				ret = -ENOMEM;
+				goto PPE_SEND_FAIL;
+			}
+			g_atm_priv_data.conn[conn].tx_copy_pdu++;
+			g_atm_priv_data.conn[conn].tx_copy_byte += skb_headlen(skb);
+		}
+
 		datalen = skb->len;
 		byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
 
@@ -569,6 +614,8 @@ static int ppe_send(struct atm_vcc *vcc, struct sk_buff *skb)
 		if ( ((unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1)) != 0 ) {
 			pr_err("skb->data not aligned\n");
 			new_skb = skb_duplicate(skb);
+			g_atm_priv_data.conn[conn].tx_copy_pdu++;
+			g_atm_priv_data.conn[conn].tx_copy_byte += skb->len;
 		} else
 			new_skb = skb_break_away_from_protocol(skb);
 		if ( new_skb == NULL ) {
@@ -719,6 +766,10 @@ static int ppe_change_qos(struct atm_vcc *vcc, struct atm_qos *qos, int flags)
 	if ( conn < 0 )
 		return -EINVAL;
 
+	/*  same limit as in ppe_open() */
+	if ( qos->aal == ATM_AAL5 && qos->txtp.max_sdu > aal5s_max_packet_size )
+		qos->txtp.max_sdu = aal5s_max_packet_size;
+
 	set_qsb(vcc, qos, conn);
 
 	return 0;
@@ -786,29 +837,34 @@ static inline struct sk_buff* alloc_skb_tx(unsigned int size)
 struct sk_buff* atm_alloc_tx(struct atm_vcc *vcc, unsigned int size)
 {
 	int conn;
+	unsigned int headroom = 0;
 	struct sk_buff *skb;
 
-	/*  oversize packet */
-	if ( size > aal5s_max_packet_size ) {
-		pr_err("atm_alloc_tx: oversize packet\n");
-		return NULL;
-	}
-	/*  send buffer overflow    */
+	/*  send buffer overflow, vcc_sendmsg() waits for room and retries  */
 	if ( atomic_read(&sk_atm(vcc)->sk_wmem_alloc) && !atm_may_send(vcc, size) ) {
-		pr_err("atm_alloc_tx: send buffer overflow\n");
+		pr_debug("atm_alloc_tx: send buffer overflow\n");
 		return NULL;
 	}
+
+	/*  VCCs of other ATM devices get what the generic alloc_tx() gives them  */
 	conn = find_vcc(vcc);
-	if ( conn < 0 ) {
-		pr_err("atm_alloc_tx: unknown VCC\n");
-		return NULL;
-	}
+	if ( conn >= 0 ) {
+		/*  oversize packet */
+		if ( size > aal5s_max_packet_size ) {
+			pr_err("atm_alloc_tx: oversize packet\n");
+			return NULL;
+		}
 
-	skb = dev_alloc_skb(size);
-	if ( skb == NULL ) {
-		pr_err("atm_alloc_tx: sk buffer is used up\n");
-		return NULL;
-	}
+		/*  room for the inband header, so ppe_send() never has to copy  */
+		BUILD_BUG_ON(NET_SKB_PAD < TX_INBAND_HEADER_LENGTH + DATA_BUFFER_ALIGNMENT);
+		headroom = NET_SKB_PAD;
+	} else
+		pr_debug("atm_alloc_tx: unknown VCC\n");
+
+	/*  called from vcc_sendmsg() in process context    */
+	while ( (skb = alloc_skb(headroom + size, GFP_KERNEL)) == NULL )
+		schedule();
+	skb_reserve(skb, headroom);
 
 	atomic_add(skb->truesize, &sk_atm(vcc)->sk_wmem_alloc);
 
@@ -947,7 +1003,7 @@ static inline void mailbox_oam_rx_handler(void)
 	}
 }
 
-static inline void mailbox_aal_rx_handler(void)
+static inline int mailbox_aal_rx_handler(int budget)
 {
 	unsigned int vlddes = WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes;
 	struct rx_descriptor reg_desc;
@@ -957,6 +1013,9 @@ static inline void mailbox_aal_rx_handler(void)
 	struct rx_inband_trailer *trailer;
 	unsigned int i;
 
+	if ( vlddes > budget )
+		vlddes = budget;
+
 	for ( i = 0; i < vlddes; i++ ) {
 		unsigned int loop_count = 0;
 
@@ -1006,6 +1065,7 @@ static inline void mailbox_aal_rx_handler(void)
 						g_atm_priv_data.wrx_pdu++;
 					if ( vcc->stats )
 						atomic_inc(&vcc->stats->rx);
+					g_atm_priv_data.conn[conn].rx_poll_pdu++;
 					adsl_led_flash();
 
 					reg_desc.dataptr = (unsigned int)new_skb->data >> 2;
@@ -1037,16 +1097,50 @@ static inline void mailbox_aal_rx_handler(void)
 
 		mailbox_signal(RX_DMA_CH_AAL, 0);
 	}
+
+	return i;
+}
+
+/*
+ *  Delivers the AAL5 frames outside of the interrupt handler. The AAL RX
+ *  interrupt stays masked while frames are left, a poll which uses up its
+ *  budget reschedules itself so other softirqs and processes get to run.
+ */
+static void do_aal_rx_tasklet(unsigned long arg)
+{
+	unsigned long sys_flag;
+
+	g_atm_priv_data.rx_poll++;
+	if ( mailbox_aal_rx_handler(rx_poll_budget) == rx_poll_budget ) {
+		g_atm_priv_data.rx_poll_full++;
+		tasklet_schedule(&g_aal_rx_tasklet);
+		return;
+	}
+
+	/*  frames arriving after the check raise the interrupt again   */
+	local_irq_save(sys_flag);
+	*MBOX_IGU1_ISRC = 1 << RX_DMA_CH_AAL;
+	if ( WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes )
+		tasklet_schedule(&g_aal_rx_tasklet);
+	else
+		*MBOX_IGU1_IER |= 1 << RX_DMA_CH_AAL;
+	local_irq_restore(sys_flag);
 }
 
 static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
 {
-	if ( !*MBOX_IGU1_ISR )
+	unsigned int isr = *MBOX_IGU1_ISR;
+
+	if ( !isr )
 		return IRQ_HANDLED;
 
-	*MBOX_IGU1_ISRC = *MBOX_IGU1_ISR;
+	*MBOX_IGU1_ISRC = isr;
 	mailbox_oam_rx_handler();
-	mailbox_aal_rx_handler();
+
+	if ( (isr & (1 << RX_DMA_CH_AAL)) && (*MBOX_IGU1_IER & (1 << RX_DMA_CH_AAL)) ) {
+		*MBOX_IGU1_IER &= ~(1 << RX_DMA_CH_AAL);
+		tasklet_schedule(&g_aal_rx_tasklet);
+	}
 
 	return IRQ_HANDLED;
 }
@@ -1396,6 +1490,9 @@ static inline void check_parameters(void)
 
 	if ( dma_tx_descriptor_length < 2 )
 		dma_tx_descriptor_length = 2;
+
+	if ( rx_poll_budget < 1 )
+		rx_poll_budget = 1;
 }
 
 static inline int init_priv_data(void)
@@ -1689,6 +1786,40 @@ static inline void init_tx_tables(void)
 	}
 }
 
+static int proc_mib_show(struct seq_file *m, void *v)
+{
+	struct connection *connection;
+	struct atm_vcc *vcc;
+	int conn;
+
+	seq_printf(m, "RX AAL5: pdu %u, drop %u\n", g_atm_priv_data.wrx_pdu, g_atm_priv_data.wrx_drop_pdu);
+	seq_printf(m, "TX AAL5: pdu %u, err %u, drop %u\n", g_atm_priv_data.wtx_pdu, g_atm_priv_data.wtx_err_pdu, g_atm_priv_data.wtx_drop_pdu);
+	seq_printf(m, "RX OAM:  cell %u, drop %u\n", g_atm_priv_data.wrx_oam, g_atm_priv_data.wrx_drop_oam);
+	seq_printf(m, "TX OAM:  cell %u, err %u, drop %u\n", g_atm_priv_data.wtx_oam, g_atm_priv_data.wtx_err_oam, g_atm_priv_data.wtx_drop_oam);
+	seq_printf(m, "RX poll: run %u, budget used up %u, budget %d\n", g_atm_priv_data.rx_poll, g_atm_priv_data.rx_poll_full, rx_poll_budget);
+
+	seq_printf(m, "\n conn  vpi   vci    rx_poll_pdu  tx_copy_pdu  tx_copy_byte  crc_err  oversize\n");
+	for ( conn = 0; conn < MAX_PVC_NUMBER; conn++ ) {
+		if ( !test_bit(conn, &g_atm_priv_data.conn_table) )
+			continue;
+		connection = &g_atm_priv_data.conn[conn];
+		vcc = connection->vcc;
+		if ( vcc == NULL )
+			continue;
+		seq_printf(m, " %4d  %3d  %5d  %11u  %11u  %12u  %7u  %8u\n", conn,
+			vcc->vpi, vcc->vci,
+			connection->rx_poll_pdu, connection->tx_copy_pdu, connection->tx_copy_byte,
+			connection->aal5_vcc_crc_err, connection->aal5_vcc_oversize_sdu);
+	}
+
+	return 0;
+}
+
+static int proc_mib_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_mib_show, NULL);
+}
+
 static int atm_showtime_enter(struct port_cell_info *port_cell, void *xdata_addr)
 {
 	int i, j;
@@ -1815,6 +1946,9 @@ static int __devinit ltq_atm_probe(struct platform_device *pdev)
 	}
 	disable_irq(PPE_MAILBOX_IGU1_INT);
 
+	g_proc_dir = proc_mkdir("driver/ifx_atm", NULL);
+	if ( g_proc_dir )
+		proc_create("mib", S_IRUGO, g_proc_dir, &g_proc_mib_fops);
 
 	ret = ops->start(0);
 	if ( ret ) {
@@ -1847,6 +1981,11 @@ static int __devinit ltq_atm_probe(struct platform_device *pdev)
 	return 0;
 
 PP32_START_FAIL:
+	if ( g_proc_dir ) {
+		remove_proc_entry("mib", g_proc_dir);
+		remove_proc_entry("driver/ifx_atm", NULL);
+		g_proc_dir = NULL;
+	}
 	free_irq(PPE_MAILBOX_IGU1_INT, &g_atm_priv_data);
 REQUEST_IRQ_PPE_MAILBOX_IGU1_INT_FAIL:
 ATM_DEV_REGISTER_FAIL:
@@ -1870,7 +2009,14 @@ static int __devexit ltq_atm_remove(struct platform_device *pdev)
 
 	ops->stop(0);
 
+	if ( g_proc_dir ) {
+		remove_proc_entry("mib", g_proc_dir);
+		remove_proc_entry("driver/ifx_atm", NULL);
+		g_proc_dir = NULL;
+	}
+
 	free_irq(PPE_MAILBOX_IGU1_INT, &g_atm_priv_data);
+	tasklet_kill(&g_aal_rx_tasklet);
 
 	for ( port_num = 0; port_num < ATM_PORT_NUMBER; port_num++ )
 		atm_dev_deregister(g_atm_priv_data.port[port_num].dev);
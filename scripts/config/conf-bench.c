@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2013 OpenWrt.org
+ * Released under the terms of the GNU GPL v2.0.
+ *
+ * Timing harness for the symbol value calculation. Run it from the top
+ * level directory once tmp/.config-package.in has been generated:
+ *
+ *   make prepare-tmpinfo
+ *   make -C scripts/config conf-bench
+ *   scripts/config/conf-bench [-f] [-v] [-n <count>] Config.in [.config]
+ *
+ * It measures loading a configuration and calculating every symbol (what
+ * "conf -D" does), followed by toggling single symbols, each time
+ * recalculating everything a frontend would show.
+ *
+ *   -f  throw away all values after every change, like before the
+ *       dependency tracking in symbol.c
+ *   -v  compare the result after every change with a full recalculation
+ *   -n  only toggle <count> symbols spread over the whole tree
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define LKC_DIRECT_LINK
+#include "lkc.h"
+
+struct sym_state {
+	struct symbol *sym;
+	char *val;
+	tristate visible, rev_dep;
+	int write;
+};
+
+static struct sym_state *state;
+static int state_count;
+
+static double now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* what a frontend redrawing everything or conf_write() looks at */
+static void calc_all(void)
+{
+	struct symbol *sym;
+	struct menu *menu;
+	int i;
+
+	for_all_symbols(i, sym)
+		sym_calc_value(sym);
+
+	menu = rootmenu.list;
+	while (menu) {
+		menu_is_visible(menu);
+		if (menu->list) {
+			menu = menu->list;
+			continue;
+		}
+		if (menu->next)
+			menu = menu->next;
+		else while ((menu = menu->parent)) {
+			if (menu->next) {
+				menu = menu->next;
+				break;
+			}
+		}
+	}
+}
+
+static void snapshot(struct sym_state *s)
+{
+	struct symbol *sym;
+	int i, n = 0;
+
+	for_all_symbols(i, sym) {
+		s[n].sym = sym;
+		s[n].val = strdup(sym_get_string_value(sym));
+		s[n].visible = sym->visible;
+		s[n].rev_dep = sym->rev_dep.tri;
+		s[n].write = !!(sym->flags & SYMBOL_WRITE);
+		n++;
+	}
+}
+
+static int compare(struct sym_state *a, struct sym_state *b,
+		   struct symbol *changed)
+{
+	int i, errors = 0;
+
+	for (i = 0; i < state_count; i++) {
+		if (!strcmp(a[i].val, b[i].val) &&
+		    a[i].visible == b[i].visible &&
+		    a[i].rev_dep == b[i].rev_dep &&
+		    a[i].write == b[i].write)
+			continue;
+		printf("after changing %s: %s is %s/%d/%d/%d, expected %s/%d/%d/%d\n",
+		       changed->name, a[i].sym->name,
+		       a[i].val, a[i].visible, a[i].rev_dep, a[i].write,
+		       b[i].val, b[i].visible, b[i].rev_dep, b[i].write);
+		errors++;
+	}
+	for (i = 0; i < state_count; i++) {
+		free(a[i].val);
+		free(b[i].val);
+	}
+	return errors;
+}
+
+static bool pick_value(struct symbol *sym, tristate *val)
+{
+	tristate cur = sym_get_tristate_value(sym);
+	tristate tri;
+
+	for (tri = no; tri <= yes; tri++) {
+		if (tri != cur && sym_tristate_within_range(sym, tri)) {
+			*val = tri;
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int ac, char **av)
+{
+	struct symbol *sym, **cand = NULL;
+	struct sym_state *check = NULL;
+	int i, opt, cand_count = 0, count = 0, step;
+	int changes = 0, errors = 0;
+	bool full = false, verify = false;
+	double t, t_load, t_parse, t_total = 0, t_max = 0;
+	tristate oldval, newval;
+
+	while ((opt = getopt(ac, av, "fvn:")) != -1) {
+		switch (opt) {
+		case 'f':
+			full = true;
+			break;
+		case 'v':
+			verify = true;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		default:
+			printf("%s [-f] [-v] [-n count] Kconfig [config]\n", av[0]);
+			exit(1);
+		}
+	}
+	if (optind >= ac) {
+		printf("%s: Kconfig file missing\n", av[0]);
+		exit(1);
+	}
+
+	t = now_ms();
+	conf_parse(av[optind]);
+	t_parse = now_ms() - t;
+
+	t = now_ms();
+	conf_read(av[optind + 1]);
+	calc_all();
+	t_load = now_ms() - t;
+
+	for_all_symbols(i, sym) {
+		state_count++;
+		if (sym->type != S_BOOLEAN && sym->type != S_TRISTATE)
+			continue;
+		if (sym_is_choice(sym) || sym_is_choice_value(sym) ||
+		    !sym_is_changable(sym))
+			continue;
+		cand = realloc(cand, (cand_count + 1) * sizeof(*cand));
+		cand[cand_count++] = sym;
+	}
+	state = malloc(state_count * sizeof(*state));
+	if (verify)
+		check = malloc(state_count * sizeof(*check));
+
+	step = (count > 0 && count < cand_count) ? cand_count / count : 1;
+	for (i = 0; i < cand_count; i += step) {
+		sym = cand[i];
+		oldval = sym_get_tristate_value(sym);
+		if (!pick_value(sym, &newval))
+			continue;
+
+		/* toggle and restore, both count as a change */
+		for (opt = 0; opt < 2; opt++) {
+			t = now_ms();
+			if (!sym_set_tristate_value(sym, opt ? oldval : newval))
+				break;
+			if (full)
+				sym_clear_all_valid();
+			calc_all();
+			t = now_ms() - t;
+
+			t_total += t;
+			if (t > t_max)
+				t_max = t;
+			changes++;
+
+			if (!verify)
+				continue;
+			snapshot(state);
+			sym_clear_all_valid();
+			calc_all();
+			snapshot(check);
+			errors += compare(state, check, sym);
+		}
+	}
+
+	printf("symbols:        %d (%d changeable)\n", state_count, cand_count);
+	printf("parse:          %.1f ms\n", t_parse);
+	printf("load+calculate: %.1f ms\n", t_load);
+	printf("changes:        %d, %.3f ms avg, %.3f ms max (%s)\n",
+	       changes, changes ? t_total / changes : 0, t_max,
+	       full ? "full" : "incremental");
+	if (verify)
+		printf("mismatches:     %d\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -75,6 +75,10 @@ struct symbol {
 	struct expr *dep, *dep2;
 	struct expr_value rev_dep;
 	struct expr_value rev_dep_inv;
+	/* symbols whose value is calculated from this one, see symbol.c */
+	struct symbol **dependents;
+	int dependents_count, dependents_size;
+	unsigned int dependents_gen;
 };
 
 #define for_all_symbols(i, sym) for (i = 0; i < SYMBOL_HASHSIZE; i++) for (sym = symbol_hash[i]; sym; sym = sym->next) if (sym->type != S_OTHER)
@@ -416,6 +416,123 @@ void sym_clear_all_valid(void)
 		sym_calc_value(modules_sym);
 }
 
+/*
+ * Changing a single symbol only invalidates the symbols which are calculated
+ * from it, directly or through other symbols, instead of recalculating all
+ * of them. Every symbol referenced by a property or a reverse dependency of
+ * a symbol is treated as one of its inputs, so the graph errs on the side of
+ * invalidating too much. A choice and its values are inputs of each other.
+ */
+static bool sym_dependents_valid;
+static unsigned int sym_dependents_gen;
+
+static void sym_add_dependent(struct symbol *sym, struct symbol *dep)
+{
+	if (!sym || sym == dep || (sym->flags & SYMBOL_CONST))
+		return;
+	/* all expressions of dep are walked in a row */
+	if (sym->dependents_count &&
+	    sym->dependents[sym->dependents_count - 1] == dep)
+		return;
+	if (sym->dependents_count == sym->dependents_size) {
+		sym->dependents_size = sym->dependents_size ? sym->dependents_size * 2 : 4;
+		sym->dependents = realloc(sym->dependents,
+			sym->dependents_size * sizeof(*sym->dependents));
+	}
+	sym->dependents[sym->dependents_count++] = dep;
+}
+
+static void expr_add_dependent(struct expr *e, struct symbol *dep)
+{
+	if (!e)
+		return;
+	switch (e->type) {
+	case E_OR:
+	case E_AND:
+		expr_add_dependent(e->left.expr, dep);
+		expr_add_dependent(e->right.expr, dep);
+		break;
+	case E_NOT:
+		expr_add_dependent(e->left.expr, dep);
+		break;
+	case E_CHOICE:
+		sym_add_dependent(e->right.sym, dep);
+		expr_add_dependent(e->left.expr, dep);
+		break;
+	case E_EQUAL:
+	case E_UNEQUAL:
+	case E_RANGE:
+		sym_add_dependent(e->left.sym, dep);
+		sym_add_dependent(e->right.sym, dep);
+		break;
+	case E_SYMBOL:
+		sym_add_dependent(e->left.sym, dep);
+		break;
+	default:
+		break;
+	}
+}
+
+static void sym_build_dependents(void)
+{
+	struct symbol *sym;
+	struct property *prop;
+	int i;
+
+	for_all_symbols(i, sym) {
+		expr_add_dependent(sym->rev_dep.expr, sym);
+		expr_add_dependent(sym->rev_dep_inv.expr, sym);
+		for (prop = sym->prop; prop; prop = prop->next) {
+			/* these only feed the reverse dependency of the target */
+			if (prop->type == P_SELECT || prop->type == P_DESELECT)
+				continue;
+			expr_add_dependent(prop->visible.expr, sym);
+			expr_add_dependent(prop->expr, sym);
+		}
+	}
+	sym_dependents_valid = true;
+}
+
+static void sym_clear_dependents_valid(struct symbol *sym)
+{
+	static struct symbol **stack;
+	static int stack_size;
+	struct symbol *dep;
+	int i, n = 0;
+
+	if (!sym_dependents_valid)
+		sym_build_dependents();
+
+	sym_dependents_gen++;
+	sym->dependents_gen = sym_dependents_gen;
+	if (!stack_size) {
+		stack_size = 256;
+		stack = malloc(stack_size * sizeof(*stack));
+	}
+	stack[n++] = sym;
+
+	while (n) {
+		sym = stack[--n];
+		sym->flags &= ~SYMBOL_VALID;
+		if (sym == modules_sym) {
+			sym_clear_all_valid();
+			return;
+		}
+		for (i = 0; i < sym->dependents_count; i++) {
+			dep = sym->dependents[i];
+			if (dep->dependents_gen == sym_dependents_gen)
+				continue;
+			dep->dependents_gen = sym_dependents_gen;
+			if (n == stack_size) {
+				stack_size *= 2;
+				stack = realloc(stack, stack_size * sizeof(*stack));
+			}
+			stack[n++] = dep;
+		}
+	}
+	sym_change_count++;
+}
+
 bool sym_tristate_within_range(struct symbol *sym, tristate val)
 {
 	int type = sym_get_type(sym);
@@ -466,7 +583,7 @@ bool sym_set_tristate_value(struct symbol *sym, tristate val)
 
 	sym->user.tri = val;
 	if (oldval != val) {
-		sym_clear_all_valid();
+		sym_clear_dependents_valid(sym);
 	}
 
 	return true;
@@ -624,7 +741,7 @@ bool sym_set_string_value(struct symbol *sym, const char *newval)
 
 	strcpy(val, newval);
 	free((void *)oldval);
-	sym_clear_all_valid();
+	sym_clear_dependents_valid(sym);
 
 	return true;
 }
@@ -11,6 +11,8 @@
 #ifndef _ATH79_DEV_NFC_H
 #define _ATH79_DEV_NFC_H
 
+#include <linux/platform/ar934x_nfc.h>
+
 struct mtd_partition;
 
 #ifdef CONFIG_ATH79_DEV_NFC
@@ -18,6 +20,7 @@ void ath79_nfc_set_parts(struct mtd_partition *parts, int nr_parts);
 void ath79_nfc_set_select_chip(void (*f)(int chip_no));
 void ath79_nfc_set_scan_fixup(int (*f)(struct mtd_info *mtd));
 void ath79_nfc_set_swap_dma(bool enable);
+void ath79_nfc_set_ecc_mode(enum ar934x_nfc_ecc_mode mode);
 void ath79_register_nfc(void);
 #else
 static inline void ath79_nfc_set_parts(struct mtd_partition *parts,
@@ -25,6 +28,7 @@ static inline void ath79_nfc_set_parts(struct mtd_partition *parts,
 static inline void ath79_nfc_set_select_chip(void (*f)(int chip_no)) {}
 static inline void ath79_nfc_set_scan_fixup(int (*f)(struct mtd_info *mtd)) {}
 static inline void ath79_nfc_set_swap_dma(bool enable) {}
+static inline void ath79_nfc_set_ecc_mode(enum ar934x_nfc_ecc_mode mode) {}
 static inline void ath79_register_nfc(void) {}
 #endif
 
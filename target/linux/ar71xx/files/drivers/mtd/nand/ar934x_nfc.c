@@ -21,6 +21,8 @@
 
 #include <linux/platform/ar934x_nfc.h>
 
+#include <asm/unaligned.h>
+
 #define AR934X_NFC_REG_CMD		0x00
 #define AR934X_NFC_REG_CTRL		0x04
 #define AR934X_NFC_REG_STATUS		0x08
@@ -119,6 +121,22 @@
 #define AR934X_NFC_DMA_CTRL_ERR_FLAG		BIT(1)
 #define AR934X_NFC_DMA_CTRL_DMA_READY		BIT(0)
 
+#define AR934X_NFC_ECC_CTRL_ERR_THRES_S		8
+#define AR934X_NFC_ECC_CTRL_ERR_THRES_M		0x1f
+#define AR934X_NFC_ECC_CTRL_ECC_CAP_S		5
+#define AR934X_NFC_ECC_CTRL_ECC_CAP_M		0x7
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_2		0
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_4		1
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_6		2
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_8		3
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_10	4
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_12	5
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_14	6
+#define   AR934X_NFC_ECC_CTRL_ECC_CAP_16	7
+#define AR934X_NFC_ECC_CTRL_ERR_OVER		BIT(2)
+#define AR934X_NFC_ECC_CTRL_ERR_UNCORRECT	BIT(1)
+#define AR934X_NFC_ECC_CTRL_ERR_CORRECT		BIT(0)
+
 #define AR934X_NFC_INT_DEV_RDY(_x)		BIT(4 + (_x))
 #define AR934X_NFC_INT_CMD_END			BIT(1)
 
@@ -182,6 +200,8 @@ struct ar934x_nfc {
 	u32 irq_status;
 
 	u32 ctrl_reg;
+	u32 ecc_ctrl_reg;
+	u32 ecc_offset_reg;
 	bool small_page;
 	unsigned int addr_count0;
 	unsigned int addr_count1;
@@ -192,6 +212,9 @@ struct ar934x_nfc {
 	int buf_index;
 
 	bool read_id;
+	bool read_pending;
+	bool ecc_write;
+	bool write_failed;
 
 	int erase1_page_addr;
 
@@ -412,7 +435,8 @@ ar934x_nfc_send_cmd(struct ar934x_nfc *nfc, unsigned command)
 
 static void
 ar934x_nfc_do_rw_command(struct ar934x_nfc *nfc, int column, int page_addr,
-			 int len, u32 cmd_reg, u32 ctrl_reg, bool write)
+			 int len, u32 cmd_reg, u32 ctrl_reg, dma_addr_t dma_addr,
+			 bool write)
 {
 	u32 addr0, addr1;
 	u32 dma_ctrl;
@@ -450,9 +474,15 @@ retry:
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_INT_STATUS, 0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_0, addr0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_1, addr1);
-	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, nfc->buf_dma);
+	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, dma_addr);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_COUNT, len);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DATA_SIZE, len);
+	if (ctrl_reg & AR934X_NFC_CTRL_ECC_EN) {
+		/* this also clears the status bits of the previous access */
+		ar934x_nfc_wr(nfc, AR934X_NFC_REG_ECC_OFFSET,
+			      nfc->ecc_offset_reg);
+		ar934x_nfc_wr(nfc, AR934X_NFC_REG_ECC_CTRL, nfc->ecc_ctrl_reg);
+	}
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_CTRL, ctrl_reg);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_CTRL, dma_ctrl);
 
@@ -488,19 +518,20 @@ ar934x_nfc_send_readid(struct ar934x_nfc *nfc, unsigned command)
 	cmd_reg |= (command & AR934X_NFC_CMD_CMD0_M) << AR934X_NFC_CMD_CMD0_S;
 
 	ar934x_nfc_do_rw_command(nfc, -1, -1, AR934X_NFC_ID_BUF_SIZE, cmd_reg,
-				 nfc->ctrl_reg, false);
+				 nfc->ctrl_reg, nfc->buf_dma, false);
 
 	nfc_debug_data("[id] ", nfc->buf, AR934X_NFC_ID_BUF_SIZE);
 }
 
 static void
-ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command, int column,
-		     int page_addr, int len)
+__ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command, int column,
+		       int page_addr, int len, u32 ctrl_reg,
+		       dma_addr_t dma_addr)
 {
 	u32 cmd_reg;
 
-	nfc_dbg(nfc, "read, column=%d page=%d len=%d\n",
-		column, page_addr, len);
+	nfc_dbg(nfc, "read, column=%d page=%d len=%d ecc=%d\n",
+		column, page_addr, len, !!(ctrl_reg & AR934X_NFC_CTRL_ECC_EN));
 
 	cmd_reg = (command & AR934X_NFC_CMD_CMD0_M) << AR934X_NFC_CMD_CMD0_S;
 
@@ -512,11 +543,38 @@ ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command, int column,
 	}
 
 	ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-				 cmd_reg, nfc->ctrl_reg, false);
+				 cmd_reg, ctrl_reg, dma_addr, false);
+}
+
+static void
+ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command, int column,
+		     int page_addr, int len)
+{
+	__ar934x_nfc_send_read(nfc, command, column, page_addr, len,
+			       nfc->ctrl_reg, nfc->buf_dma);
 
 	nfc_debug_data("[data] ", nfc->buf, len);
 }
 
+/*
+ * Large page reads are issued on the first access to the data, so
+ * ar934x_nfc_read_page() can read the page on its own without
+ * transferring it twice.
+ */
+static void
+ar934x_nfc_flush_read(struct ar934x_nfc *nfc)
+{
+	struct mtd_info *mtd = &nfc->mtd;
+
+	if (!nfc->read_pending)
+		return;
+
+	nfc->read_pending = false;
+	ar934x_nfc_send_read(nfc, nfc->rndout_read_cmd, 0,
+			     nfc->rndout_page_addr,
+			     mtd->writesize + mtd->oobsize);
+}
+
 static void
 ar934x_nfc_send_erase(struct ar934x_nfc *nfc, unsigned command, int column,
 		      int page_addr)
@@ -556,26 +614,35 @@ ar934x_nfc_send_erase(struct ar934x_nfc *nfc, unsigned command, int column,
 }
 
 static void
-ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command, int column,
-		     int page_addr, int len)
+__ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command, int column,
+			int page_addr, int len, u32 ctrl_reg,
+			dma_addr_t dma_addr)
 {
 	u32 cmd_reg;
 
-	nfc_dbg(nfc, "write, column=%d page=%d len=%d\n",
-		column, page_addr, len);
-
-	nfc_debug_data("[data] ", nfc->buf, len);
+	nfc_dbg(nfc, "write, column=%d page=%d len=%d ecc=%d\n",
+		column, page_addr, len, !!(ctrl_reg & AR934X_NFC_CTRL_ECC_EN));
 
 	cmd_reg = NAND_CMD_SEQIN << AR934X_NFC_CMD_CMD0_S;
 	cmd_reg |= command << AR934X_NFC_CMD_CMD1_S;
 	cmd_reg |= AR934X_NFC_CMD_SEQ_12;
 
 	ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-				 cmd_reg, nfc->ctrl_reg, true);
+				 cmd_reg, ctrl_reg, dma_addr, true);
 }
 
 static void
-ar934x_nfc_read_status(struct ar934x_nfc *nfc)
+ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command, int column,
+		     int page_addr, int len)
+{
+	nfc_debug_data("[data] ", nfc->buf, len);
+
+	__ar934x_nfc_send_write(nfc, command, column, page_addr, len,
+				nfc->ctrl_reg, nfc->buf_dma);
+}
+
+static u8
+__ar934x_nfc_read_status(struct ar934x_nfc *nfc)
 {
 	u32 cmd_reg;
 	u32 status;
@@ -594,12 +661,69 @@ ar934x_nfc_read_status(struct ar934x_nfc *nfc)
 	nfc_dbg(nfc, "read status, cmd:%08x status:%02x\n",
 		cmd_reg, (status & 0xff));
 
+	return status;
+}
+
+static void
+ar934x_nfc_read_status(struct ar934x_nfc *nfc)
+{
+	u8 status;
+
+	status = __ar934x_nfc_read_status(nfc);
+
+	/* report a failed spare area write of ar934x_nfc_send_write_hwecc */
+	if (nfc->write_failed) {
+		status |= NAND_STATUS_FAIL;
+		nfc->write_failed = false;
+	}
+
 	if (nfc->swap_dma)
 		nfc->buf[0 ^ 3] = status;
 	else
 		nfc->buf[0] = status;
 }
 
+static bool
+ar934x_nfc_is_all_ff(const u8 *buf, int len)
+{
+	for (; len > 0; len--)
+		if (*buf++ != 0xff)
+			return false;
+
+	return true;
+}
+
+/*
+ * Program a page written by nand_write_page_hwecc(). The ECC bytes are left
+ * erased in the spare area, the controller computes and stores them while
+ * the data is written with ECC enabled.
+ */
+static void
+ar934x_nfc_send_write_hwecc(struct ar934x_nfc *nfc)
+{
+	struct mtd_info *mtd = &nfc->mtd;
+	int page = nfc->seqin_page_addr;
+	int oob_len = nfc->buf_index - mtd->writesize;
+
+	if (oob_len > 0 &&
+	    !ar934x_nfc_is_all_ff(&nfc->buf[mtd->writesize], oob_len)) {
+		__ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG,
+					mtd->writesize, page, oob_len,
+					nfc->ctrl_reg,
+					nfc->buf_dma + mtd->writesize);
+
+		if (__ar934x_nfc_read_status(nfc) & NAND_STATUS_FAIL) {
+			nfc->write_failed = true;
+			return;
+		}
+	}
+
+	__ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
+				mtd->writesize,
+				nfc->ctrl_reg | AR934X_NFC_CTRL_ECC_EN,
+				nfc->buf_dma);
+}
+
 static void
 ar934x_nfc_cmdfunc(struct mtd_info *mtd, unsigned int command, int column,
 		   int page_addr)
@@ -607,6 +731,7 @@ ar934x_nfc_cmdfunc(struct mtd_info *mtd, unsigned int command, int column,
 	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
 
 	nfc->read_id = false;
+	nfc->read_pending = false;
 	if (command != NAND_CMD_PAGEPROG)
 		nfc->buf_index = 0;
 
@@ -626,8 +751,7 @@ ar934x_nfc_cmdfunc(struct mtd_info *mtd, unsigned int command, int column,
 			ar934x_nfc_send_read(nfc, command, column, page_addr,
 					     mtd->writesize + mtd->oobsize);
 		} else {
-			ar934x_nfc_send_read(nfc, command, 0, page_addr,
-					     mtd->writesize + mtd->oobsize);
+			nfc->read_pending = true;
 			nfc->buf_index = column;
 			nfc->rndout_page_addr = page_addr;
 			nfc->rndout_read_cmd = command;
@@ -650,9 +774,7 @@ ar934x_nfc_cmdfunc(struct mtd_info *mtd, unsigned int command, int column,
 			break;
 
 		/* emulate subpage read */
-		ar934x_nfc_send_read(nfc, nfc->rndout_read_cmd, 0,
-				     nfc->rndout_page_addr,
-				     mtd->writesize + mtd->oobsize);
+		nfc->read_pending = true;
 		nfc->buf_index = column;
 		break;
 
@@ -685,9 +807,17 @@ ar934x_nfc_cmdfunc(struct mtd_info *mtd, unsigned int command, int column,
 		}
 		nfc->seqin_column = column;
 		nfc->seqin_page_addr = page_addr;
+		nfc->ecc_write = false;
+		nfc->write_failed = false;
 		break;
 
 	case NAND_CMD_PAGEPROG:
+		if (nfc->ecc_write) {
+			nfc->ecc_write = false;
+			ar934x_nfc_send_write_hwecc(nfc);
+			break;
+		}
+
 		if (nfc->small_page)
 			ar934x_nfc_send_cmd(nfc, nfc->seqin_read_cmd);
 
@@ -721,12 +851,63 @@ ar934x_nfc_select_chip(struct mtd_info *mtd, int chip_no)
 		nfc->select_chip(chip_no);
 }
 
+/*
+ * With swap_dma the bytes of each 32-bit word are reversed in the DMA
+ * buffer, the byte at offset n is stored at n ^ 3. The buffer itself is
+ * word aligned, so the copies below only need byte accesses up to the first
+ * word boundary and after the last one, and use unaligned word accesses on
+ * the caller's side.
+ */
+static void
+ar934x_nfc_copy_from_buf(struct ar934x_nfc *nfc, u8 *dst, int index,
+			 int len, bool swap)
+{
+	const u8 *src = nfc->buf;
+
+	if (!swap) {
+		memcpy(dst, &src[index], len);
+		return;
+	}
+
+	for (; len > 0 && (index & 3); len--, index++)
+		*dst++ = src[index ^ 3];
+
+	for (; len >= 4; len -= 4, index += 4, dst += 4)
+		put_unaligned(swab32(*(const u32 *) &src[index]), (u32 *) dst);
+
+	for (; len > 0; len--, index++)
+		*dst++ = src[index ^ 3];
+}
+
+static void
+ar934x_nfc_copy_to_buf(struct ar934x_nfc *nfc, int index, const u8 *src,
+		       int len, bool swap)
+{
+	u8 *dst = nfc->buf;
+
+	if (!swap) {
+		memcpy(&dst[index], src, len);
+		return;
+	}
+
+	for (; len > 0 && (index & 3); len--, index++)
+		dst[index ^ 3] = *src++;
+
+	for (; len >= 4; len -= 4, index += 4, src += 4)
+		*(u32 *) &dst[index] = swab32(get_unaligned((const u32 *) src));
+
+	for (; len > 0; len--, index++)
+		dst[index ^ 3] = *src++;
+}
+
 static u8
 ar934x_nfc_read_byte(struct mtd_info *mtd)
 {
 	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
 	u8 data;
 
+	ar934x_nfc_flush_read(nfc);
+
 	WARN_ON(nfc->buf_index >= nfc->buf_size);
 
 	if (nfc->swap_dma || nfc->read_id)
@@ -743,21 +924,11 @@ static void
 ar934x_nfc_write_buf(struct mtd_info *mtd, const u8 *buf, int len)
 {
 	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
-	int i;
 
 	WARN_ON(nfc->buf_index + len > nfc->buf_size);
 
-	if (nfc->swap_dma) {
-		for (i = 0; i < len; i++) {
-			nfc->buf[nfc->buf_index ^ 3] = buf[i];
-			nfc->buf_index++;
-		}
-	} else {
-		for (i = 0; i < len; i++) {
-			nfc->buf[nfc->buf_index] = buf[i];
-			nfc->buf_index++;
-		}
-	}
+	ar934x_nfc_copy_to_buf(nfc, nfc->buf_index, buf, len, nfc->swap_dma);
+	nfc->buf_index += len;
 }
 
 static void
@@ -765,23 +936,16 @@ ar934x_nfc_read_buf(struct mtd_info *mtd, u8 *buf, int len)
 {
 	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
 	int buf_index;
-	int i;
+
+	ar934x_nfc_flush_read(nfc);
 
 	WARN_ON(nfc->buf_index + len > nfc->buf_size);
 
 	buf_index = nfc->buf_index;
 
-	if (nfc->swap_dma || nfc->read_id) {
-		for (i = 0; i < len; i++) {
-			buf[i] = nfc->buf[buf_index ^ 3];
-			buf_index++;
-		}
-	} else {
-		for (i = 0; i < len; i++) {
-			buf[i] = nfc->buf[buf_index];
-			buf_index++;
-		}
-	}
+	ar934x_nfc_copy_from_buf(nfc, buf, buf_index, len,
+				 nfc->swap_dma || nfc->read_id);
+	buf_index += len;
 
 	nfc->buf_index = buf_index;
 }
@@ -998,6 +1162,195 @@ ar934x_nfc_init_tail(struct mtd_info *mtd)
 	return err;
 }
 
+static void
+ar934x_nfc_swab_buf(u8 *buf, int len)
+{
+	u32 *p = (u32 *) buf;
+	int i;
+
+	for (i = 0; i < len / 4; i++)
+		swab32s(&p[i]);
+}
+
+/*
+ * The data can be transferred straight into the caller's buffer if it is
+ * in the linear mapping and does not share cache lines with anything else.
+ */
+static bool
+ar934x_nfc_can_dma(struct ar934x_nfc *nfc, const u8 *buf, int len)
+{
+	if (!virt_addr_valid(buf))
+		return false;
+
+	return IS_ALIGNED((unsigned long) buf | len,
+			  dma_get_cache_alignment());
+}
+
+static void
+ar934x_nfc_read_page_data(struct ar934x_nfc *nfc, u8 *buf, int page,
+			  u32 ctrl_reg)
+{
+	struct mtd_info *mtd = &nfc->mtd;
+	dma_addr_t dma_addr;
+
+	if (ar934x_nfc_can_dma(nfc, buf, mtd->writesize)) {
+		dma_addr = dma_map_single(nfc->parent, buf, mtd->writesize,
+					  DMA_FROM_DEVICE);
+		if (!dma_mapping_error(nfc->parent, dma_addr)) {
+			__ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page,
+					       mtd->writesize, ctrl_reg,
+					       dma_addr);
+			dma_unmap_single(nfc->parent, dma_addr, mtd->writesize,
+					 DMA_FROM_DEVICE);
+
+			if (nfc->swap_dma)
+				ar934x_nfc_swab_buf(buf, mtd->writesize);
+			return;
+		}
+	}
+
+	__ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page, mtd->writesize,
+			       ctrl_reg, nfc->buf_dma);
+	ar934x_nfc_copy_from_buf(nfc, buf, 0, mtd->writesize, nfc->swap_dma);
+}
+
+static int
+ar934x_nfc_read_page(struct mtd_info *mtd, struct nand_chip *chip,
+		     u8 *buf, int oob_required, int page)
+{
+	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
+	struct nand_ecclayout *layout = chip->ecc.layout;
+	u32 ecc_ctrl;
+	int bitflips;
+	int i;
+
+	/* the page is read here, drop the one issued by NAND_CMD_READ0 */
+	nfc->read_pending = false;
+
+	ar934x_nfc_read_page_data(nfc, buf, page,
+				  nfc->ctrl_reg | AR934X_NFC_CTRL_ECC_EN);
+
+	ecc_ctrl = ar934x_nfc_rr(nfc, AR934X_NFC_REG_ECC_CTRL);
+
+	if (oob_required || (ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_UNCORRECT)) {
+		ar934x_nfc_send_read(nfc, NAND_CMD_READ0, mtd->writesize,
+				     page, mtd->oobsize);
+		ar934x_nfc_copy_from_buf(nfc, chip->oob_poi, 0, mtd->oobsize,
+					 nfc->swap_dma);
+	}
+
+	if (ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_UNCORRECT) {
+		/* erased pages have no valid ECC, don't count them as failed */
+		for (i = 0; i < layout->eccbytes; i++)
+			if (chip->oob_poi[layout->eccpos[i]] != 0xff)
+				break;
+
+		if (i < layout->eccbytes ||
+		    !ar934x_nfc_is_all_ff(buf, mtd->writesize)) {
+			nfc_dbg(nfc, "uncorrectable ECC error on page %d\n",
+				page);
+			mtd->ecc_stats.failed++;
+		}
+
+		return 0;
+	}
+
+	if (!(ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_CORRECT))
+		return 0;
+
+	/*
+	 * The controller does not tell how many bits were corrected. Report
+	 * the full strength once the threshold is reached, so the upper
+	 * layers move the data away in time.
+	 */
+	if (ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_OVER)
+		bitflips = chip->ecc.strength;
+	else
+		bitflips = 1;
+
+	mtd->ecc_stats.corrected += bitflips;
+	return bitflips;
+}
+
+static void
+ar934x_nfc_hwctl(struct mtd_info *mtd, int mode)
+{
+	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
+
+	/* reads are handled completely by ar934x_nfc_read_page */
+	if (mode == NAND_ECC_WRITE)
+		nfc->ecc_write = true;
+}
+
+static int
+ar934x_nfc_calculate(struct mtd_info *mtd, const u8 *dat, u8 *ecc_code)
+{
+	struct ar934x_nfc *nfc = mtd_to_ar934x_nfc(mtd);
+
+	/* the controller stores the real ECC bytes while programming */
+	memset(ecc_code, 0xff, nfc->nand_chip.ecc.bytes);
+	return 0;
+}
+
+static int
+ar934x_nfc_correct(struct mtd_info *mtd, u8 *dat, u8 *read_ecc,
+		   u8 *calc_ecc)
+{
+	/* unused, errors are corrected by the controller */
+	return 0;
+}
+
+static struct nand_ecclayout ar934x_nfc_oob_64_hwecc = {
+	.eccbytes	= 28,
+	.eccpos		= {
+		20, 21, 22, 23, 24, 25, 26,
+		27, 28, 29, 30, 31, 32, 33,
+		34, 35, 36, 37, 38, 39, 40,
+		41, 42, 43, 44, 45, 46, 47,
+	},
+	.oobfree	= {
+		{ .offset = 4, .length = 16 },
+		{ .offset = 48, .length = 16 },
+	},
+};
+
+static int __devinit
+ar934x_nfc_setup_hwecc(struct ar934x_nfc *nfc)
+{
+	struct mtd_info *mtd = &nfc->mtd;
+	struct nand_chip *nand = &nfc->nand_chip;
+
+	if (mtd->writesize != 2048 || mtd->oobsize != 64) {
+		dev_err(nfc->parent,
+			"hardware ECC is not supported with %d+%d byte pages\n",
+			mtd->writesize, mtd->oobsize);
+		return -EINVAL;
+	}
+
+	/* 4 bit correction per 512 bytes, 28 ECC bytes at OOB offset 20..47 */
+	nand->ecc.mode = NAND_ECC_HW;
+	nand->ecc.size = 512;
+	nand->ecc.bytes = 7;
+	nand->ecc.strength = 4;
+	nand->ecc.layout = &ar934x_nfc_oob_64_hwecc;
+
+	nand->ecc.hwctl = ar934x_nfc_hwctl;
+	nand->ecc.calculate = ar934x_nfc_calculate;
+	nand->ecc.correct = ar934x_nfc_correct;
+	nand->ecc.read_page = ar934x_nfc_read_page;
+
+	/* the controller computes the ECC over full pages only */
+	nand->options |= NAND_NO_SUBPAGE_WRITE;
+
+	nfc->ecc_ctrl_reg = AR934X_NFC_ECC_CTRL_ECC_CAP_4 <<
+			    AR934X_NFC_ECC_CTRL_ECC_CAP_S;
+	/* matches the default bitflip threshold of MTD, 3/4 of the strength */
+	nfc->ecc_ctrl_reg |= 3 << AR934X_NFC_ECC_CTRL_ERR_THRES_S;
+	nfc->ecc_offset_reg = mtd->writesize + nand->ecc.layout->eccpos[0];
+
+	return 0;
+}
+
 static int __devinit
 ar934x_nfc_probe(struct platform_device *pdev)
 {
@@ -1094,6 +1447,12 @@ ar934x_nfc_probe(struct platform_device *pdev)
 		goto err_free_buf;
 	}
 
+	if (pdata->ecc_mode == AR934X_NFC_ECC_HW) {
+		ret = ar934x_nfc_setup_hwecc(nfc);
+		if (ret)
+			goto err_free_buf;
+	}
+
 	if (pdata->scan_fixup) {
 		ret = pdata->scan_fixup(mtd);
 		if (ret)
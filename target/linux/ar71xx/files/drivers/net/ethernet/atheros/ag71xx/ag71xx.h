@@ -38,11 +38,18 @@
 #include <asm/mach-ath79/ag71xx_platform.h>
 
 #define AG71XX_DRV_NAME		"ag71xx"
-#define AG71XX_DRV_VERSION	"0.5.35"
+#define AG71XX_DRV_VERSION	"0.5.37"
 
 #define AG71XX_NAPI_WEIGHT	64
 #define AG71XX_OOM_REFILL	(1 + HZ/10)
 
+/* refill the RX ring as soon as this many descriptors have been used */
+#define AG71XX_RX_REFILL_THRESH	(AG71XX_NAPI_WEIGHT / 4)
+
+/* defaults for the ethtool tx coalescing parameters */
+#define AG71XX_TX_KICK_FRAMES	16
+#define AG71XX_TX_RECLAIM_THRESH	8
+
 #define AG71XX_INT_ERR	(AG71XX_INT_RX_BE | AG71XX_INT_TX_BE)
 #define AG71XX_INT_TX	(AG71XX_INT_TX_PS)
 #define AG71XX_INT_RX	(AG71XX_INT_RX_PR | AG71XX_INT_RX_OF)
@@ -130,6 +137,9 @@ struct ag71xx_napi_stats {
 	unsigned long		tx_count;
 	unsigned long		tx_packets;
 	unsigned long		tx_packets_max;
+	unsigned long		rx_gro_merged;
+	unsigned long		rx_recycled;
+	unsigned long		rx_refills;
 
 	unsigned long		rx[AG71XX_NAPI_WEIGHT + 1];
 	unsigned long		tx[AG71XX_NAPI_WEIGHT + 1];
@@ -157,6 +167,10 @@ struct ag71xx {
 	struct ag71xx_ring	rx_ring;
 	struct ag71xx_ring	tx_ring;
 
+	unsigned int		tx_unkicked;
+	unsigned int		tx_kick_frames;
+	unsigned int		tx_reclaim_thresh;
+
 	struct mii_bus		*mii_bus;
 	struct phy_device	*phy_dev;
 	void			*phy_priv;
@@ -376,6 +390,24 @@ static inline void ag71xx_wr(struct ag71xx *ag, unsigned reg, u32 value)
 	(void) __raw_readl(ag->mac_base + reg);
 }
 
+/*
+ * Post a register write without reading it back, callers batching several
+ * writes to the same register must finish with ag71xx_wr_flush().
+ */
+static inline void ag71xx_wr_fast(struct ag71xx *ag, unsigned reg, u32 value)
+{
+	ag71xx_check_reg_offset(ag, reg);
+
+	__raw_writel(value, ag->mac_base + reg);
+}
+
+static inline void ag71xx_wr_flush(struct ag71xx *ag, unsigned reg)
+{
+	ag71xx_check_reg_offset(ag, reg);
+
+	(void) __raw_readl(ag->mac_base + reg);
+}
+
 static inline u32 ag71xx_rr(struct ag71xx *ag, unsigned reg)
 {
 	ag71xx_check_reg_offset(ag, reg);
@@ -450,6 +482,8 @@ int ag71xx_debugfs_init(struct ag71xx *ag);
 void ag71xx_debugfs_exit(struct ag71xx *ag);
 void ag71xx_debugfs_update_int_stats(struct ag71xx *ag, u32 status);
 void ag71xx_debugfs_update_napi_stats(struct ag71xx *ag, int rx, int tx);
+void ag71xx_debugfs_update_rx_stats(struct ag71xx *ag, int merged,
+				    int recycled, int refills);
 #else
 static inline int ag71xx_debugfs_root_init(void) { return 0; }
 static inline void ag71xx_debugfs_root_exit(void) {}
@@ -459,6 +493,9 @@ static inline void ag71xx_debugfs_update_int_stats(struct ag71xx *ag,
 						   u32 status) {}
 static inline void ag71xx_debugfs_update_napi_stats(struct ag71xx *ag,
 						    int rx, int tx) {}
+static inline void ag71xx_debugfs_update_rx_stats(struct ag71xx *ag,
+						  int merged, int recycled,
+						  int refills) {}
 #endif /* CONFIG_AG71XX_DEBUG_FS */
 
 void ag71xx_ar7240_start(struct ag71xx *ag);
@@ -94,6 +94,16 @@ void ag71xx_debugfs_update_napi_stats(struct ag71xx *ag, int rx, int tx)
 	}
 }
 
+void ag71xx_debugfs_update_rx_stats(struct ag71xx *ag, int merged,
+				    int recycled, int refills)
+{
+	struct ag71xx_napi_stats *stats = &ag->debug.napi_stats;
+
+	stats->rx_gro_merged += merged;
+	stats->rx_recycled += recycled;
+	stats->rx_refills += refills;
+}
+
 static ssize_t read_file_napi_stats(struct file *file, char __user *user_buf,
 				    size_t count, loff_t *ppos)
 {
@@ -107,7 +117,7 @@ static ssize_t read_file_napi_stats(struct file *file, char __user *user_buf,
 	int ret;
 	int i;
 
-	buflen = 2048;
+	buflen = 2560;
 	buf = kmalloc(buflen, GFP_KERNEL);
 	if (!buf)
 		return -ENOMEM;
@@ -137,6 +147,14 @@ static ssize_t read_file_napi_stats(struct file *file, char __user *user_buf,
 	len += snprintf(buf + len, buflen - len, "%3s: %10lu %10lu\n",
 			"pkt", stats->rx_packets, stats->tx_packets);
 
+	len += snprintf(buf + len, buflen - len, "\n");
+	len += snprintf(buf + len, buflen - len, "%-12s %10lu\n",
+			"gro merged:", stats->rx_gro_merged);
+	len += snprintf(buf + len, buflen - len, "%-12s %10lu\n",
+			"rx recycled:", stats->rx_recycled);
+	len += snprintf(buf + len, buflen - len, "%-12s %10lu\n",
+			"rx refills:", stats->rx_refills);
+
 	ret = simple_read_from_buffer(user_buf, count, ppos, buf, len);
 	kfree(buf);
 
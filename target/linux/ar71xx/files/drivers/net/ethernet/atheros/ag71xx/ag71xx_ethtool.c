@@ -106,12 +106,48 @@ static int ag71xx_ethtool_set_ringparam(struct net_device *dev,
 	ag->tx_ring.size = tx_size;
 	ag->rx_ring.size = rx_size;
 
+	ag->tx_kick_frames = clamp(ag->tx_kick_frames, 1U, tx_size);
+	ag->tx_reclaim_thresh = min(ag->tx_reclaim_thresh, tx_size / 2);
+
 	if (netif_running(dev))
 		err = dev->netdev_ops->ndo_open(dev);
 
 	return err;
 }
 
+/*
+ * tx-frames:     packets queued before the TX engine is kicked, as long
+ *                as earlier packets are still on the ring
+ * tx-frames-irq: pending descriptors before TX completions get reclaimed
+ *                while RX keeps NAPI busy
+ */
+static int ag71xx_ethtool_get_coalesce(struct net_device *dev,
+				       struct ethtool_coalesce *ec)
+{
+	struct ag71xx *ag = netdev_priv(dev);
+
+	ec->tx_max_coalesced_frames = ag->tx_kick_frames;
+	ec->tx_max_coalesced_frames_irq = ag->tx_reclaim_thresh;
+
+	return 0;
+}
+
+static int ag71xx_ethtool_set_coalesce(struct net_device *dev,
+				       struct ethtool_coalesce *ec)
+{
+	struct ag71xx *ag = netdev_priv(dev);
+
+	if (ec->tx_max_coalesced_frames == 0 ||
+	    ec->tx_max_coalesced_frames > ag->tx_ring.size ||
+	    ec->tx_max_coalesced_frames_irq > ag->tx_ring.size / 2)
+		return -EINVAL;
+
+	ag->tx_kick_frames = ec->tx_max_coalesced_frames;
+	ag->tx_reclaim_thresh = ec->tx_max_coalesced_frames_irq;
+
+	return 0;
+}
+
 struct ethtool_ops ag71xx_ethtool_ops = {
 	.set_settings	= ag71xx_ethtool_set_settings,
 	.get_settings	= ag71xx_ethtool_get_settings,
@@ -120,5 +156,7 @@ struct ethtool_ops ag71xx_ethtool_ops = {
 	.set_msglevel	= ag71xx_ethtool_set_msglevel,
 	.get_ringparam	= ag71xx_ethtool_get_ringparam,
 	.set_ringparam	= ag71xx_ethtool_set_ringparam,
+	.get_coalesce	= ag71xx_ethtool_get_coalesce,
+	.set_coalesce	= ag71xx_ethtool_set_coalesce,
 	.get_link	= ethtool_op_get_link,
 };
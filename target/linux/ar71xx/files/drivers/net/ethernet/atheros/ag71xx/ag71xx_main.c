@@ -177,6 +177,7 @@ static void ag71xx_ring_tx_init(struct ag71xx *ag)
 
 	ring->curr = 0;
 	ring->dirty = 0;
+	ag->tx_unkicked = 0;
 	netdev_reset_queue(ag->dev);
 }
 
@@ -230,6 +231,16 @@ static bool ag71xx_fill_rx_buf(struct ag71xx *ag, struct ag71xx_buf *buf,
 	return true;
 }
 
+/* give a buffer whose packet could not be passed up back to the hardware */
+static void ag71xx_recycle_rx_buf(struct ag71xx *ag, struct ag71xx_buf *buf,
+				  int offset)
+{
+	buf->dma_addr = dma_map_single(&ag->dev->dev, buf->rx_buf,
+				       AG71XX_RX_BUF_SIZE, DMA_FROM_DEVICE);
+	buf->desc->data = (u32) buf->dma_addr + offset;
+	wmb();
+}
+
 static int ag71xx_ring_rx_init(struct ag71xx *ag)
 {
 	struct ag71xx_ring *ring = &ag->rx_ring;
@@ -664,6 +675,7 @@ static netdev_tx_t ag71xx_hard_start_xmit(struct sk_buff *skb,
 	struct ag71xx_ring *ring = &ag->tx_ring;
 	struct ag71xx_desc *desc;
 	dma_addr_t dma_addr;
+	unsigned long flags;
 	int i;
 
 	i = ring->curr % ring->size;
@@ -702,8 +714,18 @@ static netdev_tx_t ag71xx_hard_start_xmit(struct sk_buff *skb,
 
 	DBG("%s: packet injected into TX queue\n", ag->dev->name);
 
-	/* enable TX engine */
-	ag71xx_wr(ag, AG71XX_REG_TX_CTRL, TX_CTRL_TXE);
+	/*
+	 * Enable the TX engine once per burst. A packet queued behind others
+	 * which are still on the ring may wait, their completion brings us
+	 * back to ag71xx_tx_packets() which enables it for the deferred ones.
+	 */
+	spin_lock_irqsave(&ag->lock, flags);
+	if (++ag->tx_unkicked >= ag->tx_kick_frames ||
+	    ring->curr - ring->dirty == 1 || netif_queue_stopped(dev)) {
+		ag->tx_unkicked = 0;
+		ag71xx_wr(ag, AG71XX_REG_TX_CTRL, TX_CTRL_TXE);
+	}
+	spin_unlock_irqrestore(&ag->lock, flags);
 
 	return NETDEV_TX_OK;
 
@@ -811,13 +833,25 @@ static bool ag71xx_check_dma_stuck(struct ag71xx *ag, unsigned long timestamp)
 	return false;
 }
 
-static int ag71xx_tx_packets(struct ag71xx *ag)
+static int ag71xx_tx_packets(struct ag71xx *ag, bool flush)
 {
 	struct ag71xx_ring *ring = &ag->tx_ring;
 	struct ag71xx_platform_data *pdata = ag71xx_get_pdata(ag);
+	unsigned long flags;
 	int sent = 0;
 	int bytes_compl = 0;
 
+	/* make sure no deferred packet is left behind */
+	spin_lock_irqsave(&ag->lock, flags);
+	if (unlikely(ag->tx_unkicked)) {
+		ag->tx_unkicked = 0;
+		ag71xx_wr(ag, AG71XX_REG_TX_CTRL, TX_CTRL_TXE);
+	}
+	spin_unlock_irqrestore(&ag->lock, flags);
+
+	if (!flush && ring->curr - ring->dirty < ag->tx_reclaim_thresh)
+		return 0;
+
 	DBG("%s: processing TX ring\n", ag->dev->name);
 
 	while (ring->dirty != ring->curr) {
@@ -832,7 +866,7 @@ static int ag71xx_tx_packets(struct ag71xx *ag)
 			break;
 		}
 
-		ag71xx_wr(ag, AG71XX_REG_TX_STATUS, TX_STATUS_PS);
+		ag71xx_wr_fast(ag, AG71XX_REG_TX_STATUS, TX_STATUS_PS);
 
 		bytes_compl += skb->len;
 		ag->dev->stats.tx_bytes += skb->len;
@@ -845,6 +879,9 @@ static int ag71xx_tx_packets(struct ag71xx *ag)
 		sent++;
 	}
 
+	if (sent)
+		ag71xx_wr_flush(ag, AG71XX_REG_TX_STATUS);
+
 	DBG("%s: %d packets sent out\n", ag->dev->name, sent);
 
 	netdev_completed_queue(ag->dev, sent, bytes_compl);
@@ -860,6 +897,10 @@ static int ag71xx_rx_packets(struct ag71xx *ag, int limit)
 	struct ag71xx_ring *ring = &ag->rx_ring;
 	int offset = ag71xx_buffer_offset(ag);
 	int done = 0;
+	int merged = 0;
+	int recycled = 0;
+	int refills = 0;
+	bool refill_failed = false;
 
 	DBG("%s: rx packets, limit=%d, curr=%u, dirty=%u\n",
 			dev->name, limit, ring->curr, ring->dirty);
@@ -879,7 +920,8 @@ static int ag71xx_rx_packets(struct ag71xx *ag, int limit)
 			break;
 		}
 
-		ag71xx_wr(ag, AG71XX_REG_RX_STATUS, RX_STATUS_PR);
+		/* each write acks one packet, flushed once for the batch */
+		ag71xx_wr_fast(ag, AG71XX_REG_RX_STATUS, RX_STATUS_PR);
 
 		pktlen = ag71xx_desc_pktlen(desc);
 		pktlen -= ETH_FCS_LEN;
@@ -893,10 +935,13 @@ static int ag71xx_rx_packets(struct ag71xx *ag, int limit)
 
 		skb = build_skb(ring->buf[i].rx_buf, 0);
 		if (!skb) {
-			kfree(ring->buf[i].rx_buf);
+			ag71xx_recycle_rx_buf(ag, &ring->buf[i], offset);
+			recycled++;
 			goto next;
 		}
 
+		ring->buf[i].rx_buf = NULL;
+
 		skb_reserve(skb, offset);
 		skb_put(skb, pktlen);
 
@@ -910,17 +955,43 @@ static int ag71xx_rx_packets(struct ag71xx *ag, int limit)
 			skb->dev = dev;
 			skb->ip_summed = CHECKSUM_NONE;
 			skb->protocol = eth_type_trans(skb, dev);
-			netif_receive_skb(skb);
+			switch (napi_gro_receive(&ag->napi, skb)) {
+			case GRO_MERGED:
+			case GRO_MERGED_FREE:
+				merged++;
+				break;
+			default:
+				break;
+			}
 		}
 
 next:
-		ring->buf[i].rx_buf = NULL;
 		done++;
 
 		ring->curr++;
+
+		/*
+		 * Don't let the hardware run dry during long bursts. After an
+		 * allocation failure leave it to the refill at the end of the
+		 * poll instead of retrying for every packet.
+		 */
+		if (!refill_failed &&
+		    ring->curr - ring->dirty >= AG71XX_RX_REFILL_THRESH) {
+			ag71xx_ring_rx_refill(ag);
+			refill_failed = ring->curr != ring->dirty;
+			refills++;
+		}
+	}
+
+	if (done)
+		ag71xx_wr_flush(ag, AG71XX_REG_RX_STATUS);
+
+	if (ring->curr != ring->dirty) {
+		ag71xx_ring_rx_refill(ag);
+		refills++;
 	}
 
-	ag71xx_ring_rx_refill(ag);
+	ag71xx_debugfs_update_rx_stats(ag, merged, recycled, refills);
 
 	DBG("%s: rx finish, curr=%u, dirty=%u, done=%d\n",
 		dev->name, ring->curr, ring->dirty, done);
@@ -940,11 +1011,13 @@ static int ag71xx_poll(struct napi_struct *napi, int limit)
 	int rx_done;
 
 	pdata->ddr_flush();
-	tx_done = ag71xx_tx_packets(ag);
 
 	DBG("%s: processing RX ring\n", dev->name);
 	rx_done = ag71xx_rx_packets(ag, limit);
 
+	/* while RX keeps us polling, TX completions may be coalesced */
+	tx_done = ag71xx_tx_packets(ag, rx_done < limit);
+
 	ag71xx_debugfs_update_napi_stats(ag, rx_done, tx_done);
 
 	rx_ring = &ag->rx_ring;
@@ -1150,6 +1223,9 @@ static int __devinit ag71xx_probe(struct platform_device *pdev)
 	ag->tx_ring.size = AG71XX_TX_RING_SIZE_DEFAULT;
 	ag->rx_ring.size = AG71XX_RX_RING_SIZE_DEFAULT;
 
+	ag->tx_kick_frames = AG71XX_TX_KICK_FRAMES;
+	ag->tx_reclaim_thresh = AG71XX_TX_RECLAIM_THRESH;
+
 	ag->stop_desc = dma_alloc_coherent(NULL,
 		sizeof(struct ag71xx_desc), &ag->stop_desc_dma, GFP_KERNEL);
 
@@ -123,7 +123,7 @@ static int			crypto_drivers_locked;		/* for non-SMP boxes */
  *
  * Synchronization:
  * (d) - protected by CRYPTO_DRIVER_LOCK()
- * (q) - protected by CRYPTO_Q_LOCK()
+ * (q) - protected by the CRYPTO_Q_LOCK() of the driver queue
  * Not tagged fields are read-only.
  */
 struct cryptocap {
@@ -143,66 +143,87 @@ struct cryptocap {
 	int		cc_qblocked;		/* (q) symmetric q blocked */
 	int		cc_kqblocked;		/* (q) asymmetric q blocked */
 
-	int		cc_unqblocked;		/* (q) symmetric q blocked */
-	int		cc_unkqblocked;		/* (q) asymmetric q blocked */
+	/*
+	 * Bumped by crypto_unblock.  A submitter samples the count before
+	 * handing an op to the driver and only marks the queue blocked on
+	 * ERESTART if no unblock has happened in the meantime.
+	 */
+	u_int32_t	cc_qgen;		/* (q) symmetric q unblock count */
+	u_int32_t	cc_kqgen;		/* (q) asymmetric q unblock count */
+
+	struct cryptoq	*cc_q;			/* request queues, see below */
 };
 static struct cryptocap *crypto_drivers = NULL;
 static int crypto_drivers_num = 0;
 
 /*
- * There are two queues for crypto requests; one for symmetric (e.g.
- * cipher) operations and one for asymmetric (e.g. MOD)operations.
- * A single mutex is used to lock access to both queues.  We could
- * have one per-queue but having one simplifies handling of block/unblock
- * operations.
+ * Each driver has two queues for crypto requests; one for symmetric
+ * (e.g. cipher) operations and one for asymmetric (e.g. MOD) operations,
+ * protected by a lock of its own.  A blocked driver therefore only holds
+ * up its own requests and the crypto threads never have to walk past
+ * them to find work for another driver.
+ *
+ * The queues are allocated along with the driver slot and survive the
+ * slot being cleared, as the driver table is copied when it grows and
+ * an unregistered driver may still have requests waiting for migration.
+ * They are only freed when the framework goes away.
  */
-static LIST_HEAD(crp_q);		/* crypto request queue */
-static LIST_HEAD(crp_kq);		/* asym request queue */
+struct cryptoq {
+	spinlock_t		cq_lock;
+	struct list_head	cq_q;		/* crypto request queue */
+	struct list_head	cq_kq;		/* asym request queue */
+};
 
-static spinlock_t crypto_q_lock;
+/* number of requests sitting on the driver queues */
+static atomic_t crypto_q_pending = ATOMIC_INIT(0);
+static atomic_t crypto_kq_pending = ATOMIC_INIT(0);
 
-int crypto_all_qblocked = 0;  /* protect with Q_LOCK */
+int crypto_all_qblocked = 0;
 module_param(crypto_all_qblocked, int, 0444);
 MODULE_PARM_DESC(crypto_all_qblocked, "Are all crypto queues blocked");
 
-int crypto_all_kqblocked = 0; /* protect with Q_LOCK */
+int crypto_all_kqblocked = 0;
 module_param(crypto_all_kqblocked, int, 0444);
 MODULE_PARM_DESC(crypto_all_kqblocked, "Are all asym crypto queues blocked");
 
-#define	CRYPTO_Q_LOCK() \
+#define	CRYPTO_Q_LOCK(q) \
 			({ \
-				spin_lock_irqsave(&crypto_q_lock, q_flags); \
-			 	dprintk("%s,%d: Q_LOCK()\n", __FILE__, __LINE__); \
+				spin_lock_irqsave(&(q)->cq_lock, q_flags); \
+			 	dprintk("%s,%d: Q_LOCK(%p)\n", __FILE__, __LINE__, (q)); \
 			 })
-#define	CRYPTO_Q_UNLOCK() \
+#define	CRYPTO_Q_UNLOCK(q) \
 			({ \
-			 	dprintk("%s,%d: Q_UNLOCK()\n", __FILE__, __LINE__); \
-				spin_unlock_irqrestore(&crypto_q_lock, q_flags); \
+			 	dprintk("%s,%d: Q_UNLOCK(%p)\n", __FILE__, __LINE__, (q)); \
+				spin_unlock_irqrestore(&(q)->cq_lock, q_flags); \
 			 })
 
 /*
  * There are two queues for processing completed crypto requests; one
  * for the symmetric and one for the asymmetric ops.  We only need one
- * but have two to avoid type futzing (cryptop vs. cryptkop).  A single
- * mutex is used to lock access to both queues.  Note that this lock
+ * but have two to avoid type futzing (cryptop vs. cryptkop).  Each CPU
+ * has its own pair, serviced by the return thread bound to that CPU,
+ * so completions never bounce a lock between CPUs.  Note that this lock
  * must be separate from the lock on request queues to insure driver
  * callbacks don't generate lock order reversals.
  */
-static LIST_HEAD(crp_ret_q);		/* callback queues */
-static LIST_HEAD(crp_ret_kq);
+struct cryptoretq {
+	spinlock_t		rq_lock;
+	struct list_head	rq_q;		/* callback queues */
+	struct list_head	rq_kq;
+	wait_queue_head_t	rq_wait;
+};
 
-static spinlock_t crypto_ret_q_lock;
-#define	CRYPTO_RETQ_LOCK() \
+#define	CRYPTO_RETQ_LOCK(rq) \
 			({ \
-				spin_lock_irqsave(&crypto_ret_q_lock, r_flags); \
+				spin_lock_irqsave(&(rq)->rq_lock, r_flags); \
 				dprintk("%s,%d: RETQ_LOCK\n", __FILE__, __LINE__); \
 			 })
-#define	CRYPTO_RETQ_UNLOCK() \
+#define	CRYPTO_RETQ_UNLOCK(rq) \
 			({ \
 			 	dprintk("%s,%d: RETQ_UNLOCK\n", __FILE__, __LINE__); \
-				spin_unlock_irqrestore(&crypto_ret_q_lock, r_flags); \
+				spin_unlock_irqrestore(&(rq)->rq_lock, r_flags); \
 			 })
-#define	CRYPTO_RETQ_EMPTY()	(list_empty(&crp_ret_q) && list_empty(&crp_ret_kq))
+#define	CRYPTO_RETQ_EMPTY(rq)	(list_empty(&(rq)->rq_q) && list_empty(&(rq)->rq_kq))
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,20)
 static kmem_cache_t *cryptop_zone;
@@ -229,8 +250,8 @@ EXPORT_SYMBOL(crypto_debug);
  * slow,  printing anything will just kill us
  */
 
-static int crypto_q_cnt = 0;
-module_param(crypto_q_cnt, int, 0444);
+static atomic_t crypto_q_cnt = ATOMIC_INIT(0);
+module_param_named(crypto_q_cnt, crypto_q_cnt.counter, int, 0444);
 MODULE_PARM_DESC(crypto_q_cnt,
 		"Current number of outstanding crypto requests");
 
@@ -272,6 +293,17 @@ module_param(crypto_max_loopcount, int, 0644);
 MODULE_PARM_DESC(crypto_max_loopcount,
 	   "Maximum number of crypto ops to do before yielding to other processes");
 
+/*
+ * The crypto thread hands drivers up to this many queued requests at a
+ * time.  Drivers with a cryptodev_process_batch method get them in one
+ * call, others still get them one by one with CRYPTO_HINT_MORE set.
+ * 1 turns batching off.
+ */
+int crypto_batch_max = 16;
+module_param(crypto_batch_max, int, 0644);
+MODULE_PARM_DESC(crypto_batch_max,
+	   "Maximum number of queued crypto ops handed to a driver at once");
+
 #ifndef CONFIG_NR_CPUS
 #define CONFIG_NR_CPUS 1
 #endif
@@ -279,11 +311,28 @@ MODULE_PARM_DESC(crypto_max_loopcount,
 static struct task_struct *cryptoproc[CONFIG_NR_CPUS];
 static struct task_struct *cryptoretproc[CONFIG_NR_CPUS];
 static DECLARE_WAIT_QUEUE_HEAD(cryptoproc_wait);
-static DECLARE_WAIT_QUEUE_HEAD(cryptoretproc_wait);
+static struct cryptoretq crypto_retq[CONFIG_NR_CPUS];
+
+/*
+ * The completion queue for the CPU we are running on.  Being migrated
+ * after the lookup is harmless, the request just completes on the
+ * neighbouring queue.
+ */
+static inline struct cryptoretq *
+crypto_this_retq(void)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,11) || !defined(CONFIG_SMP)
+	return &crypto_retq[0];
+#else
+	return &crypto_retq[raw_smp_processor_id()];
+#endif
+}
 
 static	int crypto_proc(void *arg);
 static	int crypto_ret_proc(void *arg);
 static	int crypto_invoke(struct cryptocap *cap, struct cryptop *crp, int hint);
+static	int crypto_invoke_batch(struct cryptocap *cap, struct list_head *batch,
+		int hint);
 static	int crypto_kinvoke(struct cryptkop *krp, int flags);
 static	void crypto_exit(void);
 static  int crypto_init(void);
@@ -429,9 +478,13 @@ crypto_newsession(u_int64_t *sid, struct cryptoini *cri, int crid)
 static void
 crypto_remove(struct cryptocap *cap)
 {
+	struct cryptoq *q = cap->cc_q;
+
 	CRYPTO_DRIVER_ASSERT();
-	if (cap->cc_sessions == 0 && cap->cc_koperations == 0)
+	if (cap->cc_sessions == 0 && cap->cc_koperations == 0) {
 		bzero(cap, sizeof(*cap));
+		cap->cc_q = q;
+	}
 }
 
 /*
@@ -536,6 +589,21 @@ crypto_get_driverid(device_t dev, int flags)
 		crypto_drivers = newdrv;
 	}
 
+	if (crypto_drivers[i].cc_q == NULL) {
+		struct cryptoq *q;
+
+		q = kmalloc(sizeof(*q), GFP_ATOMIC);
+		if (q == NULL) {
+			CRYPTO_DRIVER_UNLOCK();
+			printk("crypto: no space for driver queues!\n");
+			return -1;
+		}
+		spin_lock_init(&q->cq_lock);
+		INIT_LIST_HEAD(&q->cq_q);
+		INIT_LIST_HEAD(&q->cq_kq);
+		crypto_drivers[i].cc_q = q;
+	}
+
 	/* NB: state is zero'd on free */
 	crypto_drivers[i].cc_sessions = 1;	/* Mark */
 	crypto_drivers[i].cc_dev = dev;
@@ -682,6 +750,7 @@ crypto_register(u_int32_t driverid, int alg, u_int16_t maxoplen,
 static void
 driver_finis(struct cryptocap *cap)
 {
+	struct cryptoq *q = cap->cc_q;
 	u_int32_t ses, kops;
 
 	CRYPTO_DRIVER_ASSERT();
@@ -689,6 +758,7 @@ driver_finis(struct cryptocap *cap)
 	ses = cap->cc_sessions;
 	kops = cap->cc_koperations;
 	bzero(cap, sizeof(*cap));
+	cap->cc_q = q;
 	if (ses != 0 || kops != 0) {
 		/*
 		 * If there are pending sessions,
@@ -775,24 +845,24 @@ crypto_unblock(u_int32_t driverid, int what)
 	int err;
 	unsigned long q_flags;
 
-	CRYPTO_Q_LOCK();
 	cap = crypto_checkdriver(driverid);
-	if (cap != NULL) {
+	if (cap != NULL && cap->cc_q != NULL) {
+		CRYPTO_Q_LOCK(cap->cc_q);
 		if (what & CRYPTO_SYMQ) {
 			cap->cc_qblocked = 0;
-			cap->cc_unqblocked = 0;
+			cap->cc_qgen++;
 			crypto_all_qblocked = 0;
 		}
 		if (what & CRYPTO_ASYMQ) {
 			cap->cc_kqblocked = 0;
-			cap->cc_unkqblocked = 0;
+			cap->cc_kqgen++;
 			crypto_all_kqblocked = 0;
 		}
+		CRYPTO_Q_UNLOCK(cap->cc_q);
 		wake_up_interruptible(&cryptoproc_wait);
 		err = 0;
 	} else
 		err = EINVAL;
-	CRYPTO_Q_UNLOCK(); //DAVIDM should this be a driver lock
 
 	return err;
 }
@@ -804,46 +874,45 @@ int
 crypto_dispatch(struct cryptop *crp)
 {
 	struct cryptocap *cap;
-	int result = -1;
+	struct cryptoq *q;
+	int hid, result = -1;
+	u_int32_t gen = 0;
 	unsigned long q_flags;
 
 	dprintk("%s()\n", __FUNCTION__);
 
 	cryptostats.cs_ops++;
 
-	CRYPTO_Q_LOCK();
-	if (crypto_q_cnt >= crypto_q_max) {
+	if (atomic_inc_return(&crypto_q_cnt) > crypto_q_max) {
+		atomic_dec(&crypto_q_cnt);
 		cryptostats.cs_drops++;
-		CRYPTO_Q_UNLOCK();
 		return ENOMEM;
 	}
-	crypto_q_cnt++;
 
 	/* make sure we are starting a fresh run on this crp. */
 	crp->crp_flags &= ~CRYPTO_F_DONE;
 	crp->crp_etype = 0;
 
+	hid = CRYPTO_SESID2HID(crp->crp_sid);
+	cap = crypto_checkdriver(hid);
+	/* Driver cannot disappear when there is an active session. */
+	KASSERT(cap != NULL, ("%s: Driver disappeared.", __func__));
+	q = cap->cc_q;
+
 	/*
 	 * Caller marked the request to be processed immediately; dispatch
 	 * it directly to the driver unless the driver is currently blocked.
+	 * No lock is taken on this path, the queue lock is only needed when
+	 * the driver pushes back.
 	 */
-	if ((crp->crp_flags & CRYPTO_F_BATCH) == 0) {
-		int hid = CRYPTO_SESID2HID(crp->crp_sid);
-		cap = crypto_checkdriver(hid);
-		/* Driver cannot disappear when there is an active session. */
-		KASSERT(cap != NULL, ("%s: Driver disappeared.", __func__));
-		if (!cap->cc_qblocked) {
-			crypto_all_qblocked = 0;
-			crypto_drivers[hid].cc_unqblocked = 1;
-			CRYPTO_Q_UNLOCK();
-			result = crypto_invoke(cap, crp, 0);
-			CRYPTO_Q_LOCK();
-			if (result == ERESTART)
-				if (crypto_drivers[hid].cc_unqblocked)
-					crypto_drivers[hid].cc_qblocked = 1;
-			crypto_drivers[hid].cc_unqblocked = 0;
-		}
+	if ((crp->crp_flags & CRYPTO_F_BATCH) == 0 && !cap->cc_qblocked) {
+		gen = ACCESS_ONCE(cap->cc_qgen);
+		result = crypto_invoke(cap, crp, 0);
+		if (result != ERESTART)
+			return result;
 	}
+
+	CRYPTO_Q_LOCK(q);
 	if (result == ERESTART) {
 		/*
 		 * The driver ran out of resources, mark the
@@ -854,16 +923,18 @@ crypto_dispatch(struct cryptop *crp)
 		 * at the front.  This should be ok; putting
 		 * it at the end does not work.
 		 */
-		list_add(&crp->crp_next, &crp_q);
+		if (cap->cc_qgen == gen)
+			cap->cc_qblocked = 1;
+		list_add(&crp->crp_next, &q->cq_q);
 		cryptostats.cs_blocks++;
-		result = 0;
-	} else if (result == -1) {
-		TAILQ_INSERT_TAIL(&crp_q, crp, crp_next);
-		result = 0;
-	}
+	} else
+		TAILQ_INSERT_TAIL(&q->cq_q, crp, crp_next);
+	atomic_inc(&crypto_q_pending);
+	CRYPTO_Q_UNLOCK(q);
+
+	crypto_all_qblocked = 0;
 	wake_up_interruptible(&cryptoproc_wait);
-	CRYPTO_Q_UNLOCK();
-	return result;
+	return 0;
 }
 
 /*
@@ -873,6 +944,7 @@ crypto_dispatch(struct cryptop *crp)
 int
 crypto_kdispatch(struct cryptkop *krp)
 {
+	struct cryptocap *cap;
 	int error;
 	unsigned long q_flags;
 
@@ -880,10 +952,17 @@ crypto_kdispatch(struct cryptkop *krp)
 
 	error = crypto_kinvoke(krp, krp->krp_crid);
 	if (error == ERESTART) {
-		CRYPTO_Q_LOCK();
-		TAILQ_INSERT_TAIL(&crp_kq, krp, krp_next);
+		/*
+		 * crypto_kinvoke left krp_hid pointing at the busy driver
+		 * and has already marked it blocked.
+		 */
+		cap = crypto_checkdriver(krp->krp_hid);
+		KASSERT(cap != NULL, ("%s: Driver disappeared.", __func__));
+		CRYPTO_Q_LOCK(cap->cc_q);
+		TAILQ_INSERT_TAIL(&cap->cc_q->cq_kq, krp, krp_next);
+		atomic_inc(&crypto_kq_pending);
+		CRYPTO_Q_UNLOCK(cap->cc_q);
 		wake_up_interruptible(&cryptoproc_wait);
-		CRYPTO_Q_UNLOCK();
 		error = 0;
 	}
 	return error;
@@ -962,8 +1041,9 @@ static int
 crypto_kinvoke(struct cryptkop *krp, int crid)
 {
 	struct cryptocap *cap = NULL;
+	u_int32_t gen;
 	int error;
-	unsigned long d_flags;
+	unsigned long d_flags, q_flags;
 
 	KASSERT(krp != NULL, ("%s: krp == NULL", __func__));
 	KASSERT(krp->krp_callback != NULL,
@@ -994,12 +1074,21 @@ crypto_kinvoke(struct cryptkop *krp, int crid)
 	if (cap != NULL && !cap->cc_kqblocked) {
 		krp->krp_hid = cap - crypto_drivers;
 		cap->cc_koperations++;
+		gen = ACCESS_ONCE(cap->cc_kqgen);
 		CRYPTO_DRIVER_UNLOCK();
 		error = CRYPTODEV_KPROCESS(cap->cc_dev, krp, 0);
 		CRYPTO_DRIVER_LOCK();
 		if (error == ERESTART) {
 			cap->cc_koperations--;
 			CRYPTO_DRIVER_UNLOCK();
+			/*
+			 * Mark the driver blocked unless it called
+			 * crypto_unblock while we were in KPROCESS.
+			 */
+			CRYPTO_Q_LOCK(cap->cc_q);
+			if (cap->cc_kqgen == gen)
+				cap->cc_kqblocked = 1;
+			CRYPTO_Q_UNLOCK(cap->cc_q);
 			return (error);
 		}
 		/* return the actual device used */
@@ -1071,6 +1160,43 @@ crypto_invoke(struct cryptocap *cap, struct cryptop *crp, int hint)
 	}
 }
 
+/*
+ * Dispatch a list of crypto requests for the same driver.  Drivers with
+ * a batch method get the whole list in one call, take what they can and
+ * leave the rest on the list when they run out of resources.  Everybody
+ * else gets the requests one at a time, with CRYPTO_HINT_MORE set on all
+ * but the last.  Returns ERESTART if requests were left on the list.
+ */
+static int
+crypto_invoke_batch(struct cryptocap *cap, struct list_head *batch, int hint)
+{
+	struct cryptop *crp;
+	int result;
+
+	if (cap->cc_dev != NULL && (cap->cc_flags & CRYPTOCAP_F_CLEANUP) == 0 &&
+	    cap->cc_dev->methods.cryptodev_process_batch != NULL) {
+#ifdef CRYPTO_TIMING
+		/* same accounting as crypto_invoke() does for each request */
+		if (crypto_timing)
+			list_for_each_entry(crp, batch, crp_next)
+				crypto_tstat(&cryptostats.cs_invoke, &crp->crp_tstamp);
+#endif
+		return CRYPTODEV_PROCESS_BATCH(cap->cc_dev, batch, hint);
+	}
+
+	while (!list_empty(batch)) {
+		crp = list_entry(batch->next, struct cryptop, crp_next);
+		list_del(&crp->crp_next);
+		result = crypto_invoke(cap, crp,
+				list_empty(batch) ? hint : CRYPTO_HINT_MORE);
+		if (result == ERESTART) {
+			list_add(&crp->crp_next, batch);
+			return result;
+		}
+	}
+	return 0;
+}
+
 /*
  * Release a set of crypto descriptors.
  */
@@ -1085,22 +1211,33 @@ crypto_freereq(struct cryptop *crp)
 #ifdef DIAGNOSTIC
 	{
 		struct cryptop *crp2;
-		unsigned long q_flags;
-
-		CRYPTO_Q_LOCK();
-		TAILQ_FOREACH(crp2, &crp_q, crp_next) {
-			KASSERT(crp2 != crp,
-			    ("Freeing cryptop from the crypto queue (%p).",
-			    crp));
+		struct cryptoq *q;
+		struct cryptoretq *rq;
+		unsigned long q_flags, r_flags;
+		int i;
+
+		for (i = 0; i < crypto_drivers_num; i++) {
+			q = crypto_drivers[i].cc_q;
+			if (q == NULL)
+				continue;
+			CRYPTO_Q_LOCK(q);
+			TAILQ_FOREACH(crp2, &q->cq_q, crp_next) {
+				KASSERT(crp2 != crp,
+				    ("Freeing cryptop from the crypto queue (%p).",
+				    crp));
+			}
+			CRYPTO_Q_UNLOCK(q);
 		}
-		CRYPTO_Q_UNLOCK();
-		CRYPTO_RETQ_LOCK();
-		TAILQ_FOREACH(crp2, &crp_ret_q, crp_next) {
-			KASSERT(crp2 != crp,
-			    ("Freeing cryptop from the return queue (%p).",
-			    crp));
+		ocf_for_each_cpu(i) {
+			rq = &crypto_retq[i];
+			CRYPTO_RETQ_LOCK(rq);
+			TAILQ_FOREACH(crp2, &rq->rq_q, crp_next) {
+				KASSERT(crp2 != crp,
+				    ("Freeing cryptop from the return queue (%p).",
+				    crp));
+			}
+			CRYPTO_RETQ_UNLOCK(rq);
 		}
-		CRYPTO_RETQ_UNLOCK();
 	}
 #endif
 
@@ -1145,14 +1282,10 @@ crypto_getreq(int num)
 void
 crypto_done(struct cryptop *crp)
 {
-	unsigned long q_flags;
-
 	dprintk("%s()\n", __FUNCTION__);
 	if ((crp->crp_flags & CRYPTO_F_DONE) == 0) {
 		crp->crp_flags |= CRYPTO_F_DONE;
-		CRYPTO_Q_LOCK();
-		crypto_q_cnt--;
-		CRYPTO_Q_UNLOCK();
+		atomic_dec(&crypto_q_cnt);
 	} else
 		printk("crypto: crypto_done op already done, flags 0x%x",
 				crp->crp_flags);
@@ -1175,14 +1308,15 @@ crypto_done(struct cryptop *crp)
 		 */
 		crp->crp_callback(crp);
 	} else {
+		struct cryptoretq *rq = crypto_this_retq();
 		unsigned long r_flags;
 		/*
 		 * Normal case; queue the callback for the thread.
 		 */
-		CRYPTO_RETQ_LOCK();
-		wake_up_interruptible(&cryptoretproc_wait);/* shared wait channel */
-		TAILQ_INSERT_TAIL(&crp_ret_q, crp, crp_next);
-		CRYPTO_RETQ_UNLOCK();
+		CRYPTO_RETQ_LOCK(rq);
+		wake_up_interruptible(&rq->rq_wait);
+		TAILQ_INSERT_TAIL(&rq->rq_q, crp, crp_next);
+		CRYPTO_RETQ_UNLOCK(rq);
 	}
 }
 
@@ -1225,14 +1359,15 @@ crypto_kdone(struct cryptkop *krp)
 		 */
 		krp->krp_callback(krp);
 	} else {
+		struct cryptoretq *rq = crypto_this_retq();
 		unsigned long r_flags;
 		/*
 		 * Normal case; queue the callback for the thread.
 		 */
-		CRYPTO_RETQ_LOCK();
-		wake_up_interruptible(&cryptoretproc_wait);/* shared wait channel */
-		TAILQ_INSERT_TAIL(&crp_ret_kq, krp, krp_next);
-		CRYPTO_RETQ_UNLOCK();
+		CRYPTO_RETQ_LOCK(rq);
+		wake_up_interruptible(&rq->rq_wait);
+		TAILQ_INSERT_TAIL(&rq->rq_kq, krp, krp_next);
+		CRYPTO_RETQ_UNLOCK(rq);
 	}
 }
 
@@ -1265,80 +1400,83 @@ crypto_getfeat(int *featp)
 static int
 crypto_proc(void *arg)
 {
-	struct cryptop *crp, *submit;
-	struct cryptkop *krp, *krpp;
+	struct cryptop *submit;
+	struct cryptkop *krp;
 	struct cryptocap *cap;
-	u_int32_t hid;
-	int result, hint;
+	struct cryptoq *q;
+	struct list_head batch, *pos;
+	u_int32_t hid, n, start = 0, kstart = 0, gen = 0;
+	int result, hint, nbatch;
 	unsigned long q_flags;
 	int loopcount = 0;
 
 	set_current_state(TASK_INTERRUPTIBLE);
 
-	CRYPTO_Q_LOCK();
 	for (;;) {
 		/*
 		 * we need to make sure we don't get into a busy loop with nothing
 		 * to do,  the two crypto_all_*blocked vars help us find out when
 		 * we are all full and can do nothing on any driver or Q.  If so we
-		 * wait for an unblock.
+		 * wait for an unblock.  They are set before looking at the queues
+		 * so that a submission racing with the scan always clears them
+		 * after we did.
 		 */
-		crypto_all_qblocked  = !list_empty(&crp_q);
+		crypto_all_qblocked  = atomic_read(&crypto_q_pending) != 0;
+		crypto_all_kqblocked = atomic_read(&crypto_kq_pending) != 0;
+		smp_mb();
 
 		/*
-		 * Find the first element in the queue that can be
-		 * processed and look-ahead to see if multiple ops
-		 * are ready for the same driver.
+		 * Take the first requests of the first driver that can accept
+		 * them, starting after the driver served last so a busy driver
+		 * cannot starve the others.  If more ops are queued behind the
+		 * batch for the same driver, tell the driver so.
 		 */
 		submit = NULL;
 		hint = 0;
-		list_for_each_entry(crp, &crp_q, crp_next) {
-			hid = CRYPTO_SESID2HID(crp->crp_sid);
-			cap = crypto_checkdriver(hid);
+		nbatch = 0;
+		q = NULL;
+		INIT_LIST_HEAD(&batch);
+		for (n = 0; n < crypto_drivers_num; n++) {
+			hid = (start + n) % crypto_drivers_num;
+			cap = &crypto_drivers[hid];
+			q = cap->cc_q;
+			if (q == NULL || list_empty(&q->cq_q))
+				continue;
+			CRYPTO_Q_LOCK(q);
 			/*
-			 * Driver cannot disappear when there is an active
-			 * session.
+			 * An unregistered driver (cc_dev == NULL) still gets
+			 * its ops processed, crypto_invoke migrates them.
 			 */
-			KASSERT(cap != NULL, ("%s:%u Driver disappeared.",
-			    __func__, __LINE__));
-			if (cap == NULL || cap->cc_dev == NULL) {
-				/* Op needs to be migrated, process it. */
-				if (submit == NULL)
-					submit = crp;
-				break;
-			}
-			if (!cap->cc_qblocked) {
-				if (submit != NULL) {
-					/*
-					 * We stop on finding another op,
-					 * regardless whether its for the same
-					 * driver or not.  We could keep
-					 * searching the queue but it might be
-					 * better to just use a per-driver
-					 * queue instead.
-					 */
-					if (CRYPTO_SESID2HID(submit->crp_sid) == hid)
-						hint = CRYPTO_HINT_MORE;
-					break;
-				} else {
-					submit = crp;
-					if ((submit->crp_flags & CRYPTO_F_BATCH) == 0)
-						break;
-					/* keep scanning for more are q'd */
-				}
+			if (!list_empty(&q->cq_q) &&
+			    (cap->cc_dev == NULL || !cap->cc_qblocked)) {
+				do {
+					submit = list_entry(q->cq_q.next,
+							struct cryptop, crp_next);
+					list_move_tail(&submit->crp_next, &batch);
+					nbatch++;
+				} while (!list_empty(&q->cq_q) &&
+						nbatch < crypto_batch_max);
+				if (!list_empty(&q->cq_q))
+					hint = CRYPTO_HINT_MORE;
+				gen = cap->cc_qgen;
 			}
+			CRYPTO_Q_UNLOCK(q);
+			if (submit != NULL)
+				break;
 		}
 		if (submit != NULL) {
-			hid = CRYPTO_SESID2HID(submit->crp_sid);
+			start = hid + 1;
 			crypto_all_qblocked = 0;
-			list_del(&submit->crp_next);
-			crypto_drivers[hid].cc_unqblocked = 1;
-			cap = crypto_checkdriver(hid);
-			CRYPTO_Q_UNLOCK();
-			KASSERT(cap != NULL, ("%s:%u Driver disappeared.",
-			    __func__, __LINE__));
-			result = crypto_invoke(cap, submit, hint);
-			CRYPTO_Q_LOCK();
+			atomic_sub(nbatch, &crypto_q_pending);
+			if (nbatch == 1) {
+				list_del(&submit->crp_next);
+				result = crypto_invoke(cap, submit, hint);
+				if (result == ERESTART)
+					list_add(&submit->crp_next, &batch);
+			} else
+				result = crypto_invoke_batch(cap, &batch, hint);
+			cap = &crypto_drivers[hid];
+			CRYPTO_Q_LOCK(q);
 			if (result == ERESTART) {
 				/*
 				 * The driver ran out of resources, mark the
@@ -1350,62 +1488,76 @@ crypto_proc(void *arg)
 				 * it at the end does not work.
 				 */
 				/* XXX validate sid again? */
-				list_add(&submit->crp_next, &crp_q);
+				nbatch = 0;
+				list_for_each(pos, &batch)
+					nbatch++;
+				list_splice(&batch, &q->cq_q);
+				atomic_add(nbatch, &crypto_q_pending);
 				cryptostats.cs_blocks++;
-				if (crypto_drivers[hid].cc_unqblocked)
-					crypto_drivers[hid].cc_qblocked=0;
-				crypto_drivers[hid].cc_unqblocked=0;
+				if (cap->cc_qgen == gen)
+					cap->cc_qblocked = 1;
 			}
-			crypto_drivers[hid].cc_unqblocked = 0;
+			CRYPTO_Q_UNLOCK(q);
 		}
 
-		crypto_all_kqblocked = !list_empty(&crp_kq);
-
 		/* As above, but for key ops */
 		krp = NULL;
-		list_for_each_entry(krpp, &crp_kq, krp_next) {
-			cap = crypto_checkdriver(krpp->krp_hid);
-			if (cap == NULL || cap->cc_dev == NULL) {
-				/*
-				 * Operation needs to be migrated, invalidate
-				 * the assigned device so it will reselect a
-				 * new one below.  Propagate the original
-				 * crid selection flags if supplied.
-				 */
-				krp->krp_hid = krp->krp_crid &
-				    (CRYPTOCAP_F_SOFTWARE|CRYPTOCAP_F_HARDWARE);
-				if (krp->krp_hid == 0)
-					krp->krp_hid =
-				    CRYPTOCAP_F_SOFTWARE|CRYPTOCAP_F_HARDWARE;
-				break;
+		for (n = 0; n < crypto_drivers_num; n++) {
+			hid = (kstart + n) % crypto_drivers_num;
+			cap = &crypto_drivers[hid];
+			q = cap->cc_q;
+			if (q == NULL || list_empty(&q->cq_kq))
+				continue;
+			CRYPTO_Q_LOCK(q);
+			if (!list_empty(&q->cq_kq) &&
+			    (cap->cc_dev == NULL || !cap->cc_kqblocked)) {
+				krp = list_entry(q->cq_kq.next, struct cryptkop,
+						krp_next);
+				list_del(&krp->krp_next);
+				if (cap->cc_dev == NULL) {
+					/*
+					 * Operation needs to be migrated,
+					 * invalidate the assigned device so it
+					 * will reselect a new one below.
+					 * Propagate the original crid
+					 * selection flags if supplied.
+					 */
+					krp->krp_hid = krp->krp_crid &
+					    (CRYPTOCAP_F_SOFTWARE|CRYPTOCAP_F_HARDWARE);
+					if (krp->krp_hid == 0)
+						krp->krp_hid =
+					    CRYPTOCAP_F_SOFTWARE|CRYPTOCAP_F_HARDWARE;
+				}
 			}
-			if (!cap->cc_kqblocked) {
-				krp = krpp;
+			CRYPTO_Q_UNLOCK(q);
+			if (krp != NULL)
 				break;
-			}
 		}
 		if (krp != NULL) {
+			kstart = hid + 1;
 			crypto_all_kqblocked = 0;
-			list_del(&krp->krp_next);
-			crypto_drivers[krp->krp_hid].cc_kqblocked = 1;
-			CRYPTO_Q_UNLOCK();
+			atomic_dec(&crypto_kq_pending);
 			result = crypto_kinvoke(krp, krp->krp_hid);
-			CRYPTO_Q_LOCK();
 			if (result == ERESTART) {
 				/*
-				 * The driver ran out of resources, mark the
-				 * driver ``blocked'' for cryptkop's and put
-				 * the request back in the queue.  It would
-				 * best to put the request back where we got
-				 * it but that's hard so for now we put it
-				 * at the front.  This should be ok; putting
-				 * it at the end does not work.
+				 * The driver ran out of resources and
+				 * crypto_kinvoke has marked it ``blocked''
+				 * for cryptkop's, put the request back in
+				 * the queue.  It would best to put the
+				 * request back where we got it but that's
+				 * hard so for now we put it at the front.
+				 * This should be ok; putting it at the end
+				 * does not work.
 				 */
 				/* XXX validate sid again? */
-				list_add(&krp->krp_next, &crp_kq);
+				cap = &crypto_drivers[krp->krp_hid];
+				q = cap->cc_q;
+				CRYPTO_Q_LOCK(q);
+				list_add(&krp->krp_next, &q->cq_kq);
+				atomic_inc(&crypto_kq_pending);
 				cryptostats.cs_kblocks++;
-			} else
-				crypto_drivers[krp->krp_hid].cc_kqblocked = 0;
+				CRYPTO_Q_UNLOCK(q);
+			}
 		}
 
 		if (submit == NULL && krp == NULL) {
@@ -1421,15 +1573,14 @@ crypto_proc(void *arg)
 			 * out of order if dispatched to different devices
 			 * and some become blocked while others do not.
 			 */
-			dprintk("%s - sleeping (qe=%d qb=%d kqe=%d kqb=%d)\n",
+			dprintk("%s - sleeping (q=%d qb=%d kq=%d kqb=%d)\n",
 					__FUNCTION__,
-					list_empty(&crp_q), crypto_all_qblocked,
-					list_empty(&crp_kq), crypto_all_kqblocked);
+					atomic_read(&crypto_q_pending), crypto_all_qblocked,
+					atomic_read(&crypto_kq_pending), crypto_all_kqblocked);
 			loopcount = 0;
-			CRYPTO_Q_UNLOCK();
 			wait_event_interruptible(cryptoproc_wait,
-					!(list_empty(&crp_q) || crypto_all_qblocked) ||
-					!(list_empty(&crp_kq) || crypto_all_kqblocked) ||
+					(atomic_read(&crypto_q_pending) && !crypto_all_qblocked) ||
+					(atomic_read(&crypto_kq_pending) && !crypto_all_kqblocked) ||
 					kthread_should_stop());
 			if (signal_pending (current)) {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0)
@@ -1440,7 +1591,6 @@ crypto_proc(void *arg)
 				spin_unlock_irq(&current->sigmask_lock);
 #endif
 			}
-			CRYPTO_Q_LOCK();
 			dprintk("%s - awake\n", __FUNCTION__);
 			if (kthread_should_stop())
 				break;
@@ -1451,13 +1601,10 @@ crypto_proc(void *arg)
 			 * been using the CPU exclusively for a while.
 			 */
 			loopcount = 0;
-			CRYPTO_Q_UNLOCK();
 			schedule();
-			CRYPTO_Q_LOCK();
 		}
 		loopcount++;
 	}
-	CRYPTO_Q_UNLOCK();
 	return 0;
 }
 
@@ -1465,33 +1612,35 @@ crypto_proc(void *arg)
  * Crypto returns thread, does callbacks for processed crypto requests.
  * Callbacks are done here, rather than in the crypto drivers, because
  * callbacks typically are expensive and would slow interrupt handling.
+ * There is one of these per CPU, each draining the queue of its CPU.
  */
 static int
 crypto_ret_proc(void *arg)
 {
+	struct cryptoretq *rq = &crypto_retq[(unsigned long) arg];
 	struct cryptop *crpt;
 	struct cryptkop *krpt;
 	unsigned long  r_flags;
 
 	set_current_state(TASK_INTERRUPTIBLE);
 
-	CRYPTO_RETQ_LOCK();
+	CRYPTO_RETQ_LOCK(rq);
 	for (;;) {
 		/* Harvest return q's for completed ops */
 		crpt = NULL;
-		if (!list_empty(&crp_ret_q))
-			crpt = list_entry(crp_ret_q.next, typeof(*crpt), crp_next);
+		if (!list_empty(&rq->rq_q))
+			crpt = list_entry(rq->rq_q.next, typeof(*crpt), crp_next);
 		if (crpt != NULL)
 			list_del(&crpt->crp_next);
 
 		krpt = NULL;
-		if (!list_empty(&crp_ret_kq))
-			krpt = list_entry(crp_ret_kq.next, typeof(*krpt), krp_next);
+		if (!list_empty(&rq->rq_kq))
+			krpt = list_entry(rq->rq_kq.next, typeof(*krpt), krp_next);
 		if (krpt != NULL)
 			list_del(&krpt->krp_next);
 
 		if (crpt != NULL || krpt != NULL) {
-			CRYPTO_RETQ_UNLOCK();
+			CRYPTO_RETQ_UNLOCK(rq);
 			/*
 			 * Run callbacks unlocked.
 			 */
@@ -1499,17 +1648,16 @@ crypto_ret_proc(void *arg)
 				crpt->crp_callback(crpt);
 			if (krpt != NULL)
 				krpt->krp_callback(krpt);
-			CRYPTO_RETQ_LOCK();
+			CRYPTO_RETQ_LOCK(rq);
 		} else {
 			/*
 			 * Nothing more to be processed.  Sleep until we're
 			 * woken because there are more returns to process.
 			 */
 			dprintk("%s - sleeping\n", __FUNCTION__);
-			CRYPTO_RETQ_UNLOCK();
-			wait_event_interruptible(cryptoretproc_wait,
-					!list_empty(&crp_ret_q) ||
-					!list_empty(&crp_ret_kq) ||
+			CRYPTO_RETQ_UNLOCK(rq);
+			wait_event_interruptible(rq->rq_wait,
+					!CRYPTO_RETQ_EMPTY(rq) ||
 					kthread_should_stop());
 			if (signal_pending (current)) {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0)
@@ -1520,7 +1668,7 @@ crypto_ret_proc(void *arg)
 				spin_unlock_irq(&current->sigmask_lock);
 #endif
 			}
-			CRYPTO_RETQ_LOCK();
+			CRYPTO_RETQ_LOCK(rq);
 			dprintk("%s - awake\n", __FUNCTION__);
 			if (kthread_should_stop()) {
 				dprintk("%s - EXITING!\n", __FUNCTION__);
@@ -1529,7 +1677,7 @@ crypto_ret_proc(void *arg)
 			cryptostats.cs_rets++;
 		}
 	}
-	CRYPTO_RETQ_UNLOCK();
+	CRYPTO_RETQ_UNLOCK(rq);
 	return 0;
 }
 
@@ -1645,8 +1793,13 @@ crypto_init(void)
 	crypto_initted = 1;
 
 	spin_lock_init(&crypto_drivers_lock);
-	spin_lock_init(&crypto_q_lock);
-	spin_lock_init(&crypto_ret_q_lock);
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+		spin_lock_init(&crypto_retq[cpu].rq_lock);
+		INIT_LIST_HEAD(&crypto_retq[cpu].rq_q);
+		INIT_LIST_HEAD(&crypto_retq[cpu].rq_kq);
+		init_waitqueue_head(&crypto_retq[cpu].rq_wait);
+	}
 
 	cryptop_zone = kmem_cache_create("cryptop", sizeof(struct cryptop),
 				       0, SLAB_HWCACHE_ALIGN, NULL
@@ -1713,7 +1866,7 @@ bad:
 static void
 crypto_exit(void)
 {
-	int cpu;
+	int cpu, i;
 
 	dprintk("%s()\n", __FUNCTION__);
 
@@ -1728,8 +1881,11 @@ crypto_exit(void)
 	/* 
 	 * Reclaim dynamically allocated resources.
 	 */
-	if (crypto_drivers != NULL)
+	if (crypto_drivers != NULL) {
+		for (i = 0; i < crypto_drivers_num; i++)
+			kfree(crypto_drivers[i].cc_q);
 		kfree(crypto_drivers);
+	}
 
 	if (cryptodesc_zone != NULL)
 		kmem_cache_destroy(cryptodesc_zone);
@@ -1754,6 +1910,7 @@ EXPORT_SYMBOL(crypto_done);
 EXPORT_SYMBOL(crypto_kdone);
 EXPORT_SYMBOL(crypto_getfeat);
 EXPORT_SYMBOL(crypto_userasymcrypto);
+EXPORT_SYMBOL(crypto_batch_max);
 EXPORT_SYMBOL(crypto_getcaps);
 EXPORT_SYMBOL(crypto_find_driver);
 EXPORT_SYMBOL(crypto_find_device_byhid);
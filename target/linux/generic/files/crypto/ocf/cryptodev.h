@@ -450,6 +450,7 @@ extern	struct cryptop *crypto_getreq(int num);
 extern  int crypto_usercrypto;      /* userland may do crypto requests */
 extern  int crypto_userasymcrypto;  /* userland may do asym crypto reqs */
 extern  int crypto_devallowsoft;    /* only use hardware crypto */
+extern  int crypto_batch_max;       /* max ops per batched driver call */
 
 /*
  * random number support,  crypto_unregister_all will unregister
@@ -50,6 +50,8 @@
 #include <linux/random.h>
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,10)
 #include <linux/scatterlist.h>
 #endif
@@ -105,6 +107,7 @@ struct swcr_data {
 };
 
 struct swcr_req {
+	struct list_head	 list;
 	struct swcr_data	*sw_head;
 	struct swcr_data	*sw;
 	struct cryptop		*crp;
@@ -266,7 +269,45 @@ MODULE_PARM_DESC(swcr_no_ablk,
 static struct swcr_data **swcr_sessions = NULL;
 static u_int32_t swcr_sesnum = 0;
 
+#ifndef CONFIG_NR_CPUS
+#define CONFIG_NR_CPUS 1
+#endif
+
+/*
+ * Per-CPU worker pool.  Each session is tied to one worker, so requests
+ * on a session are processed in the order they were submitted while
+ * different sessions run in parallel on different CPUs.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,28) && defined(CONFIG_SMP)
+#define SWCR_WORKERS 1
+#endif
+
+int swcr_workers = 0;
+module_param(swcr_workers, int, 0444);
+MODULE_PARM_DESC(swcr_workers,
+		"Number of CPUs to process requests on (0 = all, 1 = process synchronously)");
+
+struct swcr_worker {
+	spinlock_t			lock;
+	struct list_head	q;
+	struct work_struct	work;
+	int					cpu;
+};
+
+static struct swcr_worker swcr_worker[CONFIG_NR_CPUS];
+static int swcr_nworkers = 0;
+static struct workqueue_struct *swcr_wq = NULL;
+
+/* what each CPU got through, see /proc/cryptosoft */
+static struct {
+	unsigned long		ops;
+	unsigned long long	bytes;
+} swcr_cpu_stats[CONFIG_NR_CPUS];
+
+static struct proc_dir_entry *swcr_proc = NULL;
+
 static	int swcr_process(device_t, struct cryptop *, int);
+static	int swcr_process_batch(device_t, struct list_head *, int);
 static	int swcr_newsession(device_t, u_int32_t *, struct cryptoini *);
 static	int swcr_freesession(device_t, u_int64_t);
 
@@ -275,6 +316,7 @@ static device_method_t swcr_methods = {
 	DEVMETHOD(cryptodev_newsession,	swcr_newsession),
 	DEVMETHOD(cryptodev_freesession,swcr_freesession),
 	DEVMETHOD(cryptodev_process,	swcr_process),
+	DEVMETHOD(cryptodev_process_batch,swcr_process_batch),
 };
 
 #define debug swcr_debug
@@ -1154,6 +1196,55 @@ done:
 }
 
 
+static void
+swcr_account(struct cryptop *crp)
+{
+	int cpu = get_cpu();
+
+	if (cpu < CONFIG_NR_CPUS) {
+		swcr_cpu_stats[cpu].ops++;
+		swcr_cpu_stats[cpu].bytes += crp->crp_ilen;
+	}
+	put_cpu();
+}
+
+#ifdef SWCR_WORKERS
+static void
+swcr_worker_run(struct work_struct *work)
+{
+	struct swcr_worker *w = container_of(work, struct swcr_worker, work);
+	struct swcr_req *req;
+	unsigned long flags;
+
+	spin_lock_irqsave(&w->lock, flags);
+	while (!list_empty(&w->q)) {
+		req = list_entry(w->q.next, struct swcr_req, list);
+		list_del(&req->list);
+		spin_unlock_irqrestore(&w->lock, flags);
+
+		swcr_account(req->crp);
+		swcr_process_req(req);
+
+		spin_lock_irqsave(&w->lock, flags);
+	}
+	spin_unlock_irqrestore(&w->lock, flags);
+}
+
+static void
+swcr_queue_req(struct swcr_req *req, u_int32_t lid)
+{
+	struct swcr_worker *w = &swcr_worker[lid % swcr_nworkers];
+	unsigned long flags;
+
+	spin_lock_irqsave(&w->lock, flags);
+	list_add_tail(&req->list, &w->q);
+	spin_unlock_irqrestore(&w->lock, flags);
+
+	/* if the worker is already queued it will pick this one up too */
+	queue_work_on(w->cpu, swcr_wq, &w->work);
+}
+#endif
+
 /*
  * Process a crypto request.
  */
@@ -1221,6 +1312,13 @@ swcr_process(device_t dev, struct cryptop *crp, int hint)
 	req->crp = crp;
 	req->crd = crp->crp_desc;
 
+#ifdef SWCR_WORKERS
+	if (swcr_nworkers > 1) {
+		swcr_queue_req(req, lid);
+		return 0;
+	}
+#endif
+	swcr_account(crp);
 	swcr_process_req(req);
 	return 0;
 
@@ -1231,6 +1329,85 @@ done:
 	return 0;
 }
 
+/*
+ * Process a batch of crypto requests.  We never run out of resources,
+ * so the whole list is consumed in one go.
+ */
+static int
+swcr_process_batch(device_t dev, struct list_head *batch, int hint)
+{
+	struct cryptop *crp, *next;
+
+	dprintk("%s()\n", __FUNCTION__);
+
+	list_for_each_entry_safe(crp, next, batch, crp_next) {
+		list_del(&crp->crp_next);
+		swcr_process(dev, crp, hint);
+	}
+	return 0;
+}
+
+
+static int
+swcr_read_proc(char *buf, char **start, off_t offset, int count, int *eof,
+		void *data)
+{
+	int cpu, len = 0;
+
+	len += sprintf(buf + len, "workers %d\n", swcr_nworkers);
+	len += sprintf(buf + len, "%-4s %12s %16s\n", "cpu", "ops", "bytes");
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+		if (!cpu_online(cpu) || len > PAGE_SIZE - 64)
+			continue;
+		len += sprintf(buf + len, "%-4d %12lu %16llu\n", cpu,
+				swcr_cpu_stats[cpu].ops, swcr_cpu_stats[cpu].bytes);
+	}
+
+	*eof = 1;
+	return len;
+}
+
+static void
+swcr_workers_init(void)
+{
+#ifdef SWCR_WORKERS
+	struct swcr_worker *w;
+	int cpu;
+
+	if (swcr_workers == 1 || num_online_cpus() < 2)
+		return;
+
+	swcr_wq = create_workqueue("cryptosoft");
+	if (!swcr_wq) {
+		printk("cryptosoft: no workqueue, processing synchronously\n");
+		return;
+	}
+
+	for_each_online_cpu(cpu) {
+		if (swcr_nworkers >= CONFIG_NR_CPUS ||
+				(swcr_workers > 0 && swcr_nworkers >= swcr_workers))
+			break;
+		w = &swcr_worker[swcr_nworkers++];
+		spin_lock_init(&w->lock);
+		INIT_LIST_HEAD(&w->q);
+		INIT_WORK(&w->work, swcr_worker_run);
+		w->cpu = cpu;
+	}
+#endif
+}
+
+static void
+swcr_workers_exit(void)
+{
+#ifdef SWCR_WORKERS
+	if (swcr_wq) {
+		flush_workqueue(swcr_wq);
+		destroy_workqueue(swcr_wq);
+		swcr_wq = NULL;
+	}
+	swcr_nworkers = 0;
+#endif
+}
 
 static int
 cryptosoft_init(void)
@@ -1251,12 +1428,24 @@ cryptosoft_init(void)
 		return -ENOENT;
 	}
 
+	swcr_workers_init();
+	swcr_proc = create_proc_read_entry("cryptosoft", 0, NULL,
+			swcr_read_proc, NULL);
+
 	softc_device_init(&swcr_softc, "cryptosoft", 0, swcr_methods);
 
+	/*
+	 * Requests handed to the worker pool complete from the workers,
+	 * so only claim to be synchronous when there is no pool.
+	 */
 	swcr_id = crypto_get_driverid(softc_get_device(&swcr_softc),
-			CRYPTOCAP_F_SOFTWARE | CRYPTOCAP_F_SYNC);
+			CRYPTOCAP_F_SOFTWARE |
+			(swcr_nworkers > 1 ? 0 : CRYPTOCAP_F_SYNC));
 	if (swcr_id < 0) {
 		printk("cryptosoft: Software crypto device cannot initialize!");
+		swcr_workers_exit();
+		if (swcr_proc)
+			remove_proc_entry("cryptosoft", NULL);
 		return -ENODEV;
 	}
 
@@ -1311,6 +1500,9 @@ cryptosoft_exit(void)
 	dprintk("%s()\n", __FUNCTION__);
 	crypto_unregister_all(swcr_id);
 	swcr_id = -1;
+	swcr_workers_exit();
+	if (swcr_proc)
+		remove_proc_entry("cryptosoft", NULL);
 	kmem_cache_destroy(swcr_req_cache);
 }
 
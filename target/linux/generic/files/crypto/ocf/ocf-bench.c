@@ -42,6 +42,9 @@
 #include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <linux/interrupt.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <asm/div64.h>
 #include <cryptodev.h>
 
 #ifdef I_HAVE_AN_XSCALE_WITH_INTEL_SDK
@@ -99,6 +102,32 @@ static int request_cbimm = 1;
 module_param(request_cbimm, int, 0);
 MODULE_PARM_DESC(request_cbimm, "enable OCF immediate callback on completion");
 
+/*
+ * run the OCF test a second time with batching disabled for comparison
+ */
+static int request_batch_cmp = 0;
+module_param(request_batch_cmp, int, 0);
+MODULE_PARM_DESC(request_batch_cmp, "also run OCF with crypto_batch_max=1");
+
+/*
+ * spread the requests over this many sessions, drivers may process
+ * different sessions in parallel
+ */
+static int request_sessions = 1;
+module_param(request_sessions, int, 0);
+MODULE_PARM_DESC(request_sessions, "number of sessions to use");
+
+/*
+ * the number of CPUs submitting requests concurrently, 0 for all of them
+ */
+static int request_cpus = 1;
+module_param(request_cpus, int, 0);
+MODULE_PARM_DESC(request_cpus, "number of CPUs submitting requests (0 = all)");
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,27) && defined(CONFIG_SMP)
+#define BENCH_CPUS 1
+#endif
+
 /*
  * a structure for each request
  */
@@ -108,6 +137,9 @@ typedef struct  {
 	IX_MBUF mbuf;
 #endif
 	unsigned char *buffer;
+	int cpu;			/* submitting CPU, -1 for any */
+	unsigned long long ns;		/* time spent in crypto_dispatch */
+	unsigned long dispatches;
 } request_t;
 
 static request_t *requests;
@@ -121,7 +153,8 @@ static int total;
  * OCF benchmark routines
  */
 
-static uint64_t ocf_cryptoid;
+#define MAX_SESSIONS 64
+static uint64_t ocf_cryptoid[MAX_SESSIONS];
 static unsigned long jstart, jstop;
 
 static int ocf_init(void);
@@ -131,10 +164,26 @@ static void ocf_request(void *arg);
 static void ocf_request_wq(struct work_struct *work);
 #endif
 
+/*
+ * resubmit a request from the CPU it was assigned to, so each of the
+ * request_cpus CPUs keeps its share of the requests in flight
+ */
+static void
+ocf_resubmit(request_t *r)
+{
+#ifdef BENCH_CPUS
+	if (r->cpu >= 0) {
+		schedule_work_on(r->cpu, &r->work);
+		return;
+	}
+#endif
+	schedule_work(&r->work);
+}
+
 static int
 ocf_init(void)
 {
-	int error;
+	int error, i;
 	struct cryptoini crie, cria;
 	struct cryptodesc crda, crde;
 
@@ -154,11 +203,15 @@ ocf_init(void)
 
 	crie.cri_next = &cria;
 
-	error = crypto_newsession(&ocf_cryptoid, &crie,
-				CRYPTOCAP_F_HARDWARE | CRYPTOCAP_F_SOFTWARE);
-	if (error) {
-		printk("crypto_newsession failed %d\n", error);
-		return -1;
+	for (i = 0; i < request_sessions; i++) {
+		error = crypto_newsession(&ocf_cryptoid[i], &crie,
+					CRYPTOCAP_F_HARDWARE | CRYPTOCAP_F_SOFTWARE);
+		if (error) {
+			printk("crypto_newsession failed %d\n", error);
+			while (i-- > 0)
+				crypto_freesession(ocf_cryptoid[i]);
+			return -1;
+		}
 	}
 	return 0;
 }
@@ -184,7 +237,7 @@ ocf_cb(struct cryptop *crp)
 	}
 	spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
 
-	schedule_work(&r->work);
+	ocf_resubmit(r);
 	return 0;
 }
 
@@ -196,6 +249,7 @@ ocf_request(void *arg)
 	struct cryptop *crp = crypto_getreq(2);
 	struct cryptodesc *crde, *crda;
 	unsigned long flags;
+	ktime_t start;
 
 	if (!crp) {
 		spin_lock_irqsave(&ocfbench_counter_lock, flags);
@@ -232,9 +286,17 @@ ocf_request(void *arg)
 		crp->crp_flags |= CRYPTO_F_CBIMM;
 	crp->crp_buf = (caddr_t) r->buffer;
 	crp->crp_callback = ocf_cb;
-	crp->crp_sid = ocf_cryptoid;
+	crp->crp_sid = ocf_cryptoid[(r - requests) % request_sessions];
 	crp->crp_opaque = (caddr_t) r;
+
+	/*
+	 * with a synchronous driver and CBIMM this includes the crypto
+	 * work itself, compare runs with the same driver only
+	 */
+	start = ktime_get();
 	crypto_dispatch(crp);
+	r->ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	r->dispatches++;
 }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,20)
@@ -249,7 +311,80 @@ ocf_request_wq(struct work_struct *work)
 static void
 ocf_done(void)
 {
-	crypto_freesession(ocf_cryptoid);
+	int i;
+
+	for (i = 0; i < request_sessions; i++)
+		crypto_freesession(ocf_cryptoid[i]);
+}
+
+static int
+ocf_run(const char *name, int ncpus)
+{
+	int i;
+	unsigned long mbps;
+	unsigned long flags;
+	unsigned long long ns;
+	unsigned long dispatches;
+	ktime_t tstart, tstop;
+
+	printk("%s: testing ...\n", name);
+	if (ocf_init() == -1)
+		return -1;
+
+	for (i = 0; i < request_q_len; i++) {
+		requests[i].ns = 0;
+		requests[i].dispatches = 0;
+	}
+
+	total = outstanding = 0;
+	jstart = jiffies;
+	tstart = ktime_get();
+	for (i = 0; i < request_q_len; i++) {
+		spin_lock_irqsave(&ocfbench_counter_lock, flags);
+		outstanding++;
+		spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
+		/* start every request on its own CPU as well */
+		if (requests[i].cpu >= 0)
+			ocf_resubmit(&requests[i]);
+		else
+			ocf_request(&requests[i]);
+	}
+	while (outstanding > 0)
+		schedule();
+	jstop = jiffies;
+	tstop = ktime_get();
+#ifdef BENCH_CPUS
+	flush_scheduled_work();
+#endif
+
+	mbps = 0;
+	if (jstop > jstart) {
+		mbps = (unsigned long) total * (unsigned long) request_size * 8;
+		mbps /= ((jstop - jstart) * 1000) / HZ;
+	}
+	printk("%s: %d requests of %d bytes in %d jiffies (%d.%03d Mbps)\n",
+			name, total, request_size, (int)(jstop - jstart),
+			((int)mbps) / 1000, ((int)mbps) % 1000);
+
+	if (total) {
+		ns = ktime_to_ns(ktime_sub(tstop, tstart));
+		do_div(ns, total);
+		printk("%s: %llu ns per request\n", name, ns);
+	}
+
+	ns = 0;
+	dispatches = 0;
+	for (i = 0; i < request_q_len; i++) {
+		ns += requests[i].ns;
+		dispatches += requests[i].dispatches;
+	}
+	if (dispatches) {
+		do_div(ns, dispatches);
+		printk("%s: %d submitting CPUs, %llu ns per crypto_dispatch\n",
+				name, ncpus ? ncpus : 1, ns);
+	}
+	ocf_done();
+	return 0;
 }
 
 /*************************************************************************/
@@ -405,19 +540,44 @@ ixp_done(void)
 int
 ocfbench_init(void)
 {
-	int i;
+	int i, ncpus;
+#ifdef BENCH_IXP_ACCESS_LIB
 	unsigned long mbps;
 	unsigned long flags;
+#endif
+#ifdef BENCH_CPUS
+	static int cpus[NR_CPUS];
+	int cpu;
+#endif
 
 	printk("Crypto Speed tests\n");
 
+	if (request_sessions < 1 || request_sessions > MAX_SESSIONS) {
+		printk("request_sessions must be 1..%d\n", MAX_SESSIONS);
+		return -EINVAL;
+	}
+
 	requests = kmalloc(sizeof(request_t) * request_q_len, GFP_KERNEL);
 	if (!requests) {
 		printk("malloc failed\n");
 		return -EINVAL;
 	}
 
+	ncpus = 0;
+#ifdef BENCH_CPUS
+	for_each_online_cpu(cpu) {
+		if (request_cpus > 0 && ncpus >= request_cpus)
+			break;
+		cpus[ncpus++] = cpu;
+	}
+#endif
+
 	for (i = 0; i < request_q_len; i++) {
+#ifdef BENCH_CPUS
+		requests[i].cpu = ncpus ? cpus[i % ncpus] : -1;
+#else
+		requests[i].cpu = -1;
+#endif
 		/* +64 for return data */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,20)
 		INIT_WORK(&requests[i].work, ocf_request_wq);
@@ -435,32 +595,18 @@ ocfbench_init(void)
 	/*
 	 * OCF benchmark
 	 */
-	printk("OCF: testing ...\n");
-	if (ocf_init() == -1)
-		return -EINVAL;
-
 	spin_lock_init(&ocfbench_counter_lock);
-	total = outstanding = 0;
-	jstart = jiffies;
-	for (i = 0; i < request_q_len; i++) {
-		spin_lock_irqsave(&ocfbench_counter_lock, flags);
-		outstanding++;
-		spin_unlock_irqrestore(&ocfbench_counter_lock, flags);
-		ocf_request(&requests[i]);
-	}
-	while (outstanding > 0)
-		schedule();
-	jstop = jiffies;
+	if (request_batch && request_batch_cmp) {
+		int batch_max = crypto_batch_max;
 
-	mbps = 0;
-	if (jstop > jstart) {
-		mbps = (unsigned long) total * (unsigned long) request_size * 8;
-		mbps /= ((jstop - jstart) * 1000) / HZ;
+		crypto_batch_max = 1;
+		i = ocf_run("OCF unbatched", ncpus);
+		crypto_batch_max = batch_max;
+		if (i)
+			return -EINVAL;
 	}
-	printk("OCF: %d requests of %d bytes in %d jiffies (%d.%03d Mbps)\n",
-			total, request_size, (int)(jstop - jstart),
-			((int)mbps) / 1000, ((int)mbps) % 1000);
-	ocf_done();
+	if (ocf_run("OCF", ncpus))
+		return -EINVAL;
 
 #ifdef BENCH_IXP_ACCESS_LIB
 	/*
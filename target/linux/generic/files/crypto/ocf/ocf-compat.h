@@ -50,6 +50,7 @@ typedef struct {
 	int (*cryptodev_freesession)(device_t dev, u_int64_t tid);
 	int (*cryptodev_process)(device_t dev, struct cryptop *crp, int hint);
 	int (*cryptodev_kprocess)(device_t dev, struct cryptkop *krp, int hint);
+	int (*cryptodev_process_batch)(device_t dev, struct list_head *batch, int hint);
 } device_method_t;
 #define DEVMETHOD(id, func)	id: func
 
@@ -69,6 +70,8 @@ struct ocf_device {
 	((*(dev)->methods.cryptodev_process)(dev, crp, hint))
 #define CRYPTODEV_KPROCESS(dev, krp, hint) \
 	((*(dev)->methods.cryptodev_kprocess)(dev, krp, hint))
+#define CRYPTODEV_PROCESS_BATCH(dev, batch, hint) \
+	((*(dev)->methods.cryptodev_process_batch)(dev, batch, hint))
 
 #define device_get_name(dev)	((dev)->name)
 #define device_get_nameunit(dev)	((dev)->nameunit)
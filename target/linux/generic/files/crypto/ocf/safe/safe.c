@@ -93,7 +93,7 @@ module_param(safe_debug, int, 0644);
 MODULE_PARM_DESC(safe_debug, "Enable debug");
 
 static	void safe_callback(struct safe_softc *, struct safe_ringentry *);
-static	void safe_feed(struct safe_softc *, struct safe_ringentry *);
+static	void safe_feed(struct safe_softc *, struct safe_ringentry *, int);
 #if defined(CONFIG_OCF_RANDOMHARVEST) && !defined(SAFE_NO_RNG)
 static	void safe_rng_init(struct safe_softc *);
 int safe_rngbufsize = 8;		/* 32 bytes each read  */
@@ -119,6 +119,7 @@ static void safe_kload_reg(struct safe_softc *sc, u_int32_t off,
 static	int safe_newsession(device_t, u_int32_t *, struct cryptoini *);
 static	int safe_freesession(device_t, u_int64_t);
 static	int safe_process(device_t, struct cryptop *, int);
+static	int safe_process_batch(device_t, struct list_head *, int);
 
 static device_method_t safe_methods = {
 	/* crypto device methods */
@@ -126,8 +127,12 @@ static device_method_t safe_methods = {
 	DEVMETHOD(cryptodev_freesession,safe_freesession),
 	DEVMETHOD(cryptodev_process,	safe_process),
 	DEVMETHOD(cryptodev_kprocess,	safe_kprocess),
+	DEVMETHOD(cryptodev_process_batch,safe_process_batch),
 };
 
+/* private hint: a batch is loading the ring, don't poke the PE yet */
+#define	SAFE_HINT_NOFEED	0x80000000
+
 #define	READ_REG(sc,r)			readl((sc)->sc_base_addr + (r))
 #define WRITE_REG(sc,r,val)		writel((val), (sc)->sc_base_addr + (r))
 
@@ -346,7 +351,7 @@ safe_intr(int irq, void *arg, struct pt_regs *regs)
  * safe_feed() - post a request to chip
  */
 static void
-safe_feed(struct safe_softc *sc, struct safe_ringentry *re)
+safe_feed(struct safe_softc *sc, struct safe_ringentry *re, int hint)
 {
 	DPRINTF(("%s()\n", __FUNCTION__));
 #ifdef SAFE_DEBUG
@@ -359,7 +364,8 @@ safe_feed(struct safe_softc *sc, struct safe_ringentry *re)
 	if (sc->sc_nqchip > safestats.st_maxqchip)
 		safestats.st_maxqchip = sc->sc_nqchip;
 	/* poke h/w to check descriptor ring, any value can be written */
-	WRITE_REG(sc, SAFE_HI_RD_DESCR, 0);
+	if ((hint & SAFE_HINT_NOFEED) == 0)
+		WRITE_REG(sc, SAFE_HI_RD_DESCR, 0);
 }
 
 #define	N(a)	(sizeof(a) / sizeof (a[0]))
@@ -1039,8 +1045,7 @@ safe_process(device_t dev, struct cryptop *crp, int hint)
 	if (++(sc->sc_front) == sc->sc_ringtop)
 		sc->sc_front = sc->sc_ring;
 
-	/* XXX honor batching */
-	safe_feed(sc, re);
+	safe_feed(sc, re, hint);
 	spin_unlock_irqrestore(&sc->sc_ringmtx, flags);
 	return (0);
 
@@ -1059,6 +1064,40 @@ errout:
 	return (err);
 }
 
+/*
+ * Load a batch of requests onto the ring and poke the PE once for all
+ * of them.  Whatever does not fit is left on the list for the caller
+ * to requeue.
+ */
+static int
+safe_process_batch(device_t dev, struct list_head *batch, int hint)
+{
+	struct safe_softc *sc = device_get_softc(dev);
+	struct cryptop *crp, *next;
+	unsigned long flags;
+	int err = 0, fed = 0;
+
+	DPRINTF(("%s()\n", __FUNCTION__));
+
+	list_for_each_entry_safe(crp, next, batch, crp_next) {
+		list_del(&crp->crp_next);
+		err = safe_process(dev, crp, hint | SAFE_HINT_NOFEED);
+		if (err == ERESTART) {
+			list_add(&crp->crp_next, batch);
+			break;
+		}
+		if (err == 0)
+			fed++;
+	}
+
+	if (fed) {
+		spin_lock_irqsave(&sc->sc_ringmtx, flags);
+		WRITE_REG(sc, SAFE_HI_RD_DESCR, 0);
+		spin_unlock_irqrestore(&sc->sc_ringmtx, flags);
+	}
+	return (err == ERESTART ? ERESTART : 0);
+}
+
 static void
 safe_callback(struct safe_softc *sc, struct safe_ringentry *re)
 {
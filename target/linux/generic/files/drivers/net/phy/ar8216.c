@@ -33,6 +33,7 @@
 #include <linux/lockdep.h>
 #include <linux/ar8216_platform.h>
 #include <linux/workqueue.h>
+#include <linux/debugfs.h>
 #include "ar8216.h"
 
 /* size of the vlan table */
@@ -42,8 +43,14 @@
 
 #define AR8XXX_MIB_WORK_DELAY	2000 /* msecs */
 
+/* max. number of registers handled by a single batch pass */
+#define AR8XXX_REG_BATCH_MAX	128
+#define AR8XXX_RMW_BATCH_MAX	4
+
 struct ar8216_priv;
 
+static struct phy_driver ar8216_driver;
+
 #define AR8XXX_CAP_GIGE			BIT(0)
 #define AR8XXX_CAP_MIB_COUNTERS		BIT(1)
 
@@ -77,11 +84,21 @@ struct ar8xxx_chip {
 	unsigned num_mibs;
 };
 
+struct ar8xxx_mii_stats {
+	u32 xfers;		/* MDIO bus transactions */
+	u32 page_switches;	/* page register writes */
+	u32 page_hits;		/* accesses to the already selected page */
+};
+
 struct ar8216_priv {
 	struct switch_dev dev;
 	struct phy_device *phy;
 	u32 (*read)(struct ar8216_priv *priv, int reg);
 	void (*write)(struct ar8216_priv *priv, int reg, u32 val);
+	void (*read_regs)(struct ar8216_priv *priv, const u32 *regs, u32 *vals,
+			  unsigned int n);
+	void (*write_regs)(struct ar8216_priv *priv, const u32 *regs,
+			   const u32 *vals, unsigned int n);
 	const struct net_device_ops *ndo_old;
 	struct net_device_ops ndo;
 	struct mutex reg_mutex;
@@ -95,10 +112,18 @@ struct ar8216_priv {
 	bool init;
 	bool mii_lo_first;
 
+	/* currently selected register page, -1 if unknown;
+	 * protected by the mdio bus lock */
+	int mii_page;
+	struct ar8xxx_mii_stats mii_stats;
+	struct dentry *debugfs_root;
+
 	struct mutex mib_lock;
 	struct delayed_work mib_work;
 	int mib_next_port;
 	u64 *mib_stats;
+	u32 *mib_regs;
+	u32 *mib_vals;
 
 	/* all fields below are cleared on reset */
 	bool vlan;
@@ -242,44 +267,58 @@ split_addr(u32 regaddr, u16 *r1, u16 *r2, u16 *page)
 	*page = regaddr & 0x1ff;
 }
 
-static u32
-ar8216_mii_read(struct ar8216_priv *priv, int reg)
+static inline u16
+ar8216_reg_page(u32 regaddr)
 {
-	struct phy_device *phy = priv->phy;
-	struct mii_bus *bus = phy->bus;
-	u16 r1, r2, page;
-	u16 lo, hi;
+	return (regaddr >> 9) & 0x1ff;
+}
 
-	split_addr((u32) reg, &r1, &r2, &page);
+static void
+ar8216_mii_select_page(struct ar8216_priv *priv, struct mii_bus *bus,
+		       u16 page)
+{
+	lockdep_assert_held(&bus->mdio_lock);
 
-	mutex_lock(&bus->mdio_lock);
+	if (priv->mii_page == page) {
+		priv->mii_stats.page_hits++;
+		return;
+	}
 
 	bus->write(bus, 0x18, 0, page);
 	usleep_range(1000, 2000); /* wait for the page switch to propagate */
+	priv->mii_page = page;
+	priv->mii_stats.page_switches++;
+	priv->mii_stats.xfers++;
+}
+
+static u32
+__ar8216_mii_read(struct ar8216_priv *priv, struct mii_bus *bus, u32 reg)
+{
+	u16 r1, r2, page;
+	u16 lo, hi;
+
+	split_addr(reg, &r1, &r2, &page);
+
+	ar8216_mii_select_page(priv, bus, page);
 	lo = bus->read(bus, 0x10 | r2, r1);
 	hi = bus->read(bus, 0x10 | r2, r1 + 1);
-
-	mutex_unlock(&bus->mdio_lock);
+	priv->mii_stats.xfers += 2;
 
 	return (hi << 16) | lo;
 }
 
 static void
-ar8216_mii_write(struct ar8216_priv *priv, int reg, u32 val)
+__ar8216_mii_write(struct ar8216_priv *priv, struct mii_bus *bus, u32 reg,
+		   u32 val)
 {
-	struct phy_device *phy = priv->phy;
-	struct mii_bus *bus = phy->bus;
 	u16 r1, r2, r3;
 	u16 lo, hi;
 
-	split_addr((u32) reg, &r1, &r2, &r3);
+	split_addr(reg, &r1, &r2, &r3);
 	lo = val & 0xffff;
 	hi = (u16) (val >> 16);
 
-	mutex_lock(&bus->mdio_lock);
-
-	bus->write(bus, 0x18, 0, r3);
-	usleep_range(1000, 2000); /* wait for the page switch to propagate */
+	ar8216_mii_select_page(priv, bus, r3);
 	if (priv->mii_lo_first) {
 		bus->write(bus, 0x10 | r2, r1, lo);
 		bus->write(bus, 0x10 | r2, r1 + 1, hi);
@@ -287,7 +326,93 @@ ar8216_mii_write(struct ar8216_priv *priv, int reg, u32 val)
 		bus->write(bus, 0x10 | r2, r1 + 1, hi);
 		bus->write(bus, 0x10 | r2, r1, lo);
 	}
+	priv->mii_stats.xfers += 2;
+}
+
+static u32
+ar8216_mii_read(struct ar8216_priv *priv, int reg)
+{
+	struct mii_bus *bus = priv->phy->bus;
+	u32 val;
+
+	mutex_lock(&bus->mdio_lock);
+	val = __ar8216_mii_read(priv, bus, reg);
+	mutex_unlock(&bus->mdio_lock);
+
+	return val;
+}
+
+static void
+ar8216_mii_write(struct ar8216_priv *priv, int reg, u32 val)
+{
+	struct mii_bus *bus = priv->phy->bus;
 
+	mutex_lock(&bus->mdio_lock);
+	__ar8216_mii_write(priv, bus, reg, val);
+	mutex_unlock(&bus->mdio_lock);
+}
+
+/*
+ * Read a set of registers while holding the bus lock only once. The
+ * registers are visited page by page, starting with the page which is
+ * currently selected, so every page is switched to at most once.
+ */
+static void
+ar8216_mii_read_regs(struct ar8216_priv *priv, const u32 *regs, u32 *vals,
+		     unsigned int n)
+{
+	struct mii_bus *bus = priv->phy->bus;
+	DECLARE_BITMAP(done, AR8XXX_REG_BATCH_MAX);
+	unsigned int first, left, i;
+	int page;
+
+	while (n > AR8XXX_REG_BATCH_MAX) {
+		ar8216_mii_read_regs(priv, regs, vals, AR8XXX_REG_BATCH_MAX);
+		regs += AR8XXX_REG_BATCH_MAX;
+		vals += AR8XXX_REG_BATCH_MAX;
+		n -= AR8XXX_REG_BATCH_MAX;
+	}
+
+	bitmap_zero(done, n);
+
+	mutex_lock(&bus->mdio_lock);
+
+	page = priv->mii_page;
+	first = 0;
+	for (left = n; left; ) {
+		for (i = first; i < n; i++) {
+			if (test_bit(i, done) ||
+			    ar8216_reg_page(regs[i]) != page)
+				continue;
+
+			vals[i] = __ar8216_mii_read(priv, bus, regs[i]);
+			__set_bit(i, done);
+			left--;
+		}
+
+		first = find_first_zero_bit(done, n);
+		if (first < n)
+			page = ar8216_reg_page(regs[first]);
+	}
+
+	mutex_unlock(&bus->mdio_lock);
+}
+
+/*
+ * Write a set of registers while holding the bus lock only once. Unlike
+ * reads, writes are issued in the given order because the switch
+ * latches some operations (VTU, ATU, MIB) on the last register written.
+ */
+static void
+ar8216_mii_write_regs(struct ar8216_priv *priv, const u32 *regs,
+		      const u32 *vals, unsigned int n)
+{
+	struct mii_bus *bus = priv->phy->bus;
+	unsigned int i;
+
+	mutex_lock(&bus->mdio_lock);
+	for (i = 0; i < n; i++)
+		__ar8216_mii_write(priv, bus, regs[i], vals[i]);
 	mutex_unlock(&bus->mdio_lock);
 }
 
@@ -329,6 +454,24 @@ ar8216_rmw(struct ar8216_priv *priv, int reg, u32 mask, u32 val)
 	return v;
 }
 
+static void
+ar8216_rmw_regs(struct ar8216_priv *priv, const u32 *regs, const u32 *masks,
+		const u32 *vals, unsigned int n)
+{
+	u32 v[AR8XXX_RMW_BATCH_MAX];
+	unsigned int i;
+
+	lockdep_assert_held(&priv->reg_mutex);
+
+	if (WARN_ON(n > AR8XXX_RMW_BATCH_MAX))
+		n = AR8XXX_RMW_BATCH_MAX;
+
+	priv->read_regs(priv, regs, v, n);
+	for (i = 0; i < n; i++)
+		v[i] = (v[i] & ~masks[i]) | vals[i];
+	priv->write_regs(priv, regs, v, n);
+}
+
 static inline void
 ar8216_reg_set(struct ar8216_priv *priv, int reg, u32 val)
 {
@@ -406,6 +549,7 @@ ar8216_mib_fetch_port_stat(struct ar8216_priv *priv, int port, bool flush)
 {
 	unsigned int base;
 	u64 *mib_stats;
+	unsigned int n;
 	int i;
 
 	WARN_ON(port >= priv->dev.ports);
@@ -420,17 +564,28 @@ ar8216_mib_fetch_port_stat(struct ar8216_priv *priv, int port, bool flush)
 	else
 		base = AR8216_REG_PORT_STATS_BASE(port);
 
+	/* fetch all counters of the port in a single pass */
+	for (i = 0, n = 0; i < priv->chip->num_mibs; i++) {
+		const struct ar8xxx_mib_desc *mib;
+
+		mib = &priv->chip->mib_decs[i];
+		priv->mib_regs[n++] = base + mib->offset;
+		if (mib->size == 2)
+			priv->mib_regs[n++] = base + mib->offset + 4;
+	}
+	priv->read_regs(priv, priv->mib_regs, priv->mib_vals, n);
+
 	mib_stats = &priv->mib_stats[port * priv->chip->num_mibs];
-	for (i = 0; i < priv->chip->num_mibs; i++) {
+	for (i = 0, n = 0; i < priv->chip->num_mibs; i++) {
 		const struct ar8xxx_mib_desc *mib;
 		u64 t;
 
 		mib = &priv->chip->mib_decs[i];
-		t = priv->read(priv, base + mib->offset);
+		t = priv->mib_vals[n++];
 		if (mib->size == 2) {
 			u64 hi;
 
-			hi = priv->read(priv, base + mib->offset + 4);
+			hi = priv->mib_vals[n++];
 			t |= hi << 32;
 		}
 
@@ -575,15 +730,20 @@ ar8216_wait_bit(struct ar8216_priv *priv, int reg, u32 mask, u32 val)
 static void
 ar8216_vtu_op(struct ar8216_priv *priv, u32 op, u32 val)
 {
+	u32 regs[2], vals[2];
+	unsigned int n = 0;
+
 	if (ar8216_wait_bit(priv, AR8216_REG_VTU, AR8216_VTU_ACTIVE, 0))
 		return;
 	if ((op & AR8216_VTU_OP) == AR8216_VTU_OP_LOAD) {
 		val &= AR8216_VTUDATA_MEMBER;
 		val |= AR8216_VTUDATA_VALID;
-		priv->write(priv, AR8216_REG_VTU_DATA, val);
+		regs[n] = AR8216_REG_VTU_DATA;
+		vals[n++] = val;
 	}
-	op |= AR8216_VTU_ACTIVE;
-	priv->write(priv, AR8216_REG_VTU, op);
+	regs[n] = AR8216_REG_VTU;
+	vals[n++] = op | AR8216_VTU_ACTIVE;
+	priv->write_regs(priv, regs, vals, n);
 }
 
 static void
@@ -623,6 +783,7 @@ static void
 ar8216_setup_port(struct ar8216_priv *priv, int port, u32 egress, u32 ingress,
 		  u32 members, u32 pvid)
 {
+	u32 regs[2], masks[2], vals[2];
 	u32 header;
 
 	if (chip_is_ar8216(priv) && priv->vlan && port == AR8216_PORT_CPU)
@@ -630,20 +791,22 @@ ar8216_setup_port(struct ar8216_priv *priv, int port, u32 egress, u32 ingress,
 	else
 		header = 0;
 
-	ar8216_rmw(priv, AR8216_REG_PORT_CTRL(port),
-		   AR8216_PORT_CTRL_LEARN | AR8216_PORT_CTRL_VLAN_MODE |
+	regs[0] = AR8216_REG_PORT_CTRL(port);
+	masks[0] = AR8216_PORT_CTRL_LEARN | AR8216_PORT_CTRL_VLAN_MODE |
 		   AR8216_PORT_CTRL_SINGLE_VLAN | AR8216_PORT_CTRL_STATE |
-		   AR8216_PORT_CTRL_HEADER | AR8216_PORT_CTRL_LEARN_LOCK,
-		   AR8216_PORT_CTRL_LEARN | header |
-		   (egress << AR8216_PORT_CTRL_VLAN_MODE_S) |
-		   (AR8216_PORT_STATE_FORWARD << AR8216_PORT_CTRL_STATE_S));
+		   AR8216_PORT_CTRL_HEADER | AR8216_PORT_CTRL_LEARN_LOCK;
+	vals[0] = AR8216_PORT_CTRL_LEARN | header |
+		  (egress << AR8216_PORT_CTRL_VLAN_MODE_S) |
+		  (AR8216_PORT_STATE_FORWARD << AR8216_PORT_CTRL_STATE_S);
 
-	ar8216_rmw(priv, AR8216_REG_PORT_VLAN(port),
-		   AR8216_PORT_VLAN_DEST_PORTS | AR8216_PORT_VLAN_MODE |
-		   AR8216_PORT_VLAN_DEFAULT_ID,
-		   (members << AR8216_PORT_VLAN_DEST_PORTS_S) |
-		   (ingress << AR8216_PORT_VLAN_MODE_S) |
-		   (pvid << AR8216_PORT_VLAN_DEFAULT_ID_S));
+	regs[1] = AR8216_REG_PORT_VLAN(port);
+	masks[1] = AR8216_PORT_VLAN_DEST_PORTS | AR8216_PORT_VLAN_MODE |
+		   AR8216_PORT_VLAN_DEFAULT_ID;
+	vals[1] = (members << AR8216_PORT_VLAN_DEST_PORTS_S) |
+		  (ingress << AR8216_PORT_VLAN_MODE_S) |
+		  (pvid << AR8216_PORT_VLAN_DEFAULT_ID_S);
+
+	ar8216_rmw_regs(priv, regs, masks, vals, 2);
 }
 
 static int
@@ -708,23 +871,26 @@ static void
 ar8236_setup_port(struct ar8216_priv *priv, int port, u32 egress, u32 ingress,
 		  u32 members, u32 pvid)
 {
-	ar8216_rmw(priv, AR8216_REG_PORT_CTRL(port),
-		   AR8216_PORT_CTRL_LEARN | AR8216_PORT_CTRL_VLAN_MODE |
+	u32 regs[3], masks[3], vals[3];
+
+	regs[0] = AR8216_REG_PORT_CTRL(port);
+	masks[0] = AR8216_PORT_CTRL_LEARN | AR8216_PORT_CTRL_VLAN_MODE |
 		   AR8216_PORT_CTRL_SINGLE_VLAN | AR8216_PORT_CTRL_STATE |
-		   AR8216_PORT_CTRL_HEADER | AR8216_PORT_CTRL_LEARN_LOCK,
-		   AR8216_PORT_CTRL_LEARN |
-		   (egress << AR8216_PORT_CTRL_VLAN_MODE_S) |
-		   (AR8216_PORT_STATE_FORWARD << AR8216_PORT_CTRL_STATE_S));
+		   AR8216_PORT_CTRL_HEADER | AR8216_PORT_CTRL_LEARN_LOCK;
+	vals[0] = AR8216_PORT_CTRL_LEARN |
+		  (egress << AR8216_PORT_CTRL_VLAN_MODE_S) |
+		  (AR8216_PORT_STATE_FORWARD << AR8216_PORT_CTRL_STATE_S);
 
-	ar8216_rmw(priv, AR8236_REG_PORT_VLAN(port),
-		   AR8236_PORT_VLAN_DEFAULT_ID,
-		   (pvid << AR8236_PORT_VLAN_DEFAULT_ID_S));
+	regs[1] = AR8236_REG_PORT_VLAN(port);
+	masks[1] = AR8236_PORT_VLAN_DEFAULT_ID;
+	vals[1] = (pvid << AR8236_PORT_VLAN_DEFAULT_ID_S);
 
-	ar8216_rmw(priv, AR8236_REG_PORT_VLAN2(port),
-		   AR8236_PORT_VLAN2_VLAN_MODE |
-		   AR8236_PORT_VLAN2_MEMBER,
-		   (ingress << AR8236_PORT_VLAN2_VLAN_MODE_S) |
-		   (members << AR8236_PORT_VLAN2_MEMBER_S));
+	regs[2] = AR8236_REG_PORT_VLAN2(port);
+	masks[2] = AR8236_PORT_VLAN2_VLAN_MODE | AR8236_PORT_VLAN2_MEMBER;
+	vals[2] = (ingress << AR8236_PORT_VLAN2_VLAN_MODE_S) |
+		  (members << AR8236_PORT_VLAN2_MEMBER_S);
+
+	ar8216_rmw_regs(priv, regs, masks, vals, 3);
 }
 
 static int
@@ -1163,15 +1329,21 @@ ar8327_atu_flush(struct ar8216_priv *priv)
 static void
 ar8327_vtu_op(struct ar8216_priv *priv, u32 op, u32 val)
 {
+	u32 regs[2], vals[2];
+	unsigned int n = 0;
+
 	if (ar8216_wait_bit(priv, AR8327_REG_VTU_FUNC1,
 			    AR8327_VTU_FUNC1_BUSY, 0))
 		return;
 
-	if ((op & AR8327_VTU_FUNC1_OP) == AR8327_VTU_FUNC1_OP_LOAD)
-		priv->write(priv, AR8327_REG_VTU_FUNC0, val);
+	if ((op & AR8327_VTU_FUNC1_OP) == AR8327_VTU_FUNC1_OP_LOAD) {
+		regs[n] = AR8327_REG_VTU_FUNC0;
+		vals[n++] = val;
+	}
 
-	op |= AR8327_VTU_FUNC1_BUSY;
-	priv->write(priv, AR8327_REG_VTU_FUNC1, op);
+	regs[n] = AR8327_REG_VTU_FUNC1;
+	vals[n++] = op | AR8327_VTU_FUNC1_BUSY;
+	priv->write_regs(priv, regs, vals, n);
 }
 
 static void
@@ -1210,12 +1382,14 @@ static void
 ar8327_setup_port(struct ar8216_priv *priv, int port, u32 egress, u32 ingress,
 		  u32 members, u32 pvid)
 {
+	u32 regs[3], vals[3];
 	u32 t;
 	u32 mode;
 
 	t = pvid << AR8327_PORT_VLAN0_DEF_SVID_S;
 	t |= pvid << AR8327_PORT_VLAN0_DEF_CVID_S;
-	priv->write(priv, AR8327_REG_PORT_VLAN0(port), t);
+	regs[0] = AR8327_REG_PORT_VLAN0(port);
+	vals[0] = t;
 
 	mode = AR8327_PORT_VLAN1_OUT_MODE_UNMOD;
 	switch (egress) {
@@ -1232,13 +1406,17 @@ ar8327_setup_port(struct ar8216_priv *priv, int port, u32 egress, u32 ingress,
 
 	t = AR8327_PORT_VLAN1_PORT_VLAN_PROP;
 	t |= mode << AR8327_PORT_VLAN1_OUT_MODE_S;
-	priv->write(priv, AR8327_REG_PORT_VLAN1(port), t);
+	regs[1] = AR8327_REG_PORT_VLAN1(port);
+	vals[1] = t;
 
 	t = members;
 	t |= AR8327_PORT_LOOKUP_LEARN;
 	t |= ingress << AR8327_PORT_LOOKUP_IN_MODE_S;
 	t |= AR8216_PORT_STATE_FORWARD << AR8327_PORT_LOOKUP_STATE_S;
-	priv->write(priv, AR8327_REG_PORT_LOOKUP(port), t);
+	regs[2] = AR8327_REG_PORT_LOOKUP(port);
+	vals[2] = t;
+
+	priv->write_regs(priv, regs, vals, 3);
 }
 
 static const struct ar8xxx_chip ar8327_chip = {
@@ -1643,6 +1821,32 @@ static const struct switch_dev_ops ar8216_sw_ops = {
 	.get_port_link = ar8216_sw_get_port_link,
 };
 
+/*
+ * Chip detection may run on a temporary priv while the switch is already
+ * registered on the same bus. Always select the page explicitly and make
+ * the registered switch forget the page it has cached.
+ */
+static u32
+ar8216_id_read(struct ar8216_priv *priv, int reg)
+{
+	struct mii_bus *bus = priv->phy->bus;
+	struct phy_device *phy = bus->phy_map[0];
+	struct ar8216_priv *live = NULL;
+	u32 val;
+
+	if (phy && phy->drv == &ar8216_driver)
+		live = phy->priv;
+
+	mutex_lock(&bus->mdio_lock);
+	priv->mii_page = -1;
+	val = __ar8216_mii_read(priv, bus, reg);
+	if (live)
+		live->mii_page = -1;
+	mutex_unlock(&bus->mdio_lock);
+
+	return val;
+}
+
 static int
 ar8216_id_chip(struct ar8216_priv *priv)
 {
@@ -1650,7 +1854,7 @@ ar8216_id_chip(struct ar8216_priv *priv)
 	u16 id;
 	int i;
 
-	val = ar8216_mii_read(priv, AR8216_REG_CTRL);
+	val = ar8216_id_read(priv, AR8216_REG_CTRL);
 	if (val == ~0)
 		return -ENODEV;
 
@@ -1658,7 +1862,7 @@ ar8216_id_chip(struct ar8216_priv *priv)
 	for (i = 0; i < AR8X16_PROBE_RETRIES; i++) {
 		u16 t;
 
-		val = ar8216_mii_read(priv, AR8216_REG_CTRL);
+		val = ar8216_id_read(priv, AR8216_REG_CTRL);
 		if (val == ~0)
 			return -ENODEV;
 
@@ -1740,6 +1944,15 @@ ar8xxx_mib_init(struct ar8216_priv *priv)
 	if (!priv->mib_stats)
 		return -ENOMEM;
 
+	/* scratch space for fetching the 32 bit words of one port */
+	len = 2 * priv->chip->num_mibs * sizeof(u32);
+	priv->mib_regs = kzalloc(2 * len, GFP_KERNEL);
+	if (!priv->mib_regs) {
+		kfree(priv->mib_stats);
+		return -ENOMEM;
+	}
+	priv->mib_vals = priv->mib_regs + 2 * priv->chip->num_mibs;
+
 	mutex_init(&priv->mib_lock);
 	INIT_DELAYED_WORK(&priv->mib_work, ar8xxx_mib_work_func);
 
@@ -1763,9 +1976,43 @@ ar8xxx_mib_cleanup(struct ar8216_priv *priv)
 		return;
 
 	cancel_delayed_work(&priv->mib_work);
+	kfree(priv->mib_regs);
 	kfree(priv->mib_stats);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static void
+ar8xxx_debugfs_init(struct ar8216_priv *priv)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir(dev_name(&priv->phy->dev), NULL);
+	if (IS_ERR_OR_NULL(root)) {
+		dev_err(&priv->phy->dev, "Unable to create debugfs dir\n");
+		return;
+	}
+	priv->debugfs_root = root;
+
+	/* writable, so that the counters can be reset */
+	debugfs_create_u32("mdio_xfers", S_IRUGO | S_IWUSR, root,
+			   &priv->mii_stats.xfers);
+	debugfs_create_u32("page_switches", S_IRUGO | S_IWUSR, root,
+			   &priv->mii_stats.page_switches);
+	debugfs_create_u32("page_hits", S_IRUGO | S_IWUSR, root,
+			   &priv->mii_stats.page_hits);
+}
+
+static void
+ar8xxx_debugfs_cleanup(struct ar8216_priv *priv)
+{
+	debugfs_remove_recursive(priv->debugfs_root);
+	priv->debugfs_root = NULL;
+}
+#else
+static inline void ar8xxx_debugfs_init(struct ar8216_priv *priv) {}
+static inline void ar8xxx_debugfs_cleanup(struct ar8216_priv *priv) {}
+#endif /* CONFIG_DEBUG_FS */
+
 static int
 ar8216_config_init(struct phy_device *pdev)
 {
@@ -1831,6 +2078,8 @@ ar8216_config_init(struct phy_device *pdev)
 	mutex_init(&priv->reg_mutex);
 	priv->read = ar8216_mii_read;
 	priv->write = ar8216_mii_write;
+	priv->read_regs = ar8216_mii_read_regs;
+	priv->write_regs = ar8216_mii_write_regs;
 
 	pdev->priv = priv;
 
@@ -1892,6 +2141,7 @@ ar8216_config_init(struct phy_device *pdev)
 
 	priv->init = false;
 
+	ar8xxx_debugfs_init(priv);
 	ar8xxx_mib_start(priv);
 
 	return 0;
@@ -1988,6 +2238,7 @@ ar8216_remove(struct phy_device *pdev)
 	if (pdev->addr == 0)
 		unregister_switch(&priv->dev);
 
+	ar8xxx_debugfs_cleanup(priv);
 	ar8xxx_mib_cleanup(priv);
 	kfree(priv);
 }
@@ -314,6 +314,9 @@ static const struct nla_policy switch_policy[SWITCH_ATTR_MAX+1] = {
 	[SWITCH_ATTR_OP_VALUE_STR] = { .type = NLA_NUL_STRING },
 	[SWITCH_ATTR_OP_VALUE_PORTS] = { .type = NLA_NESTED },
 	[SWITCH_ATTR_TYPE] = { .type = NLA_U32 },
+	[SWITCH_ATTR_DUMP_GROUPS] = { .type = NLA_U32 },
+	[SWITCH_ATTR_OP_PORT_LAST] = { .type = NLA_U32 },
+	[SWITCH_ATTR_OP_VLAN_LAST] = { .type = NLA_U32 },
 };
 
 static const struct nla_policy port_policy[SWITCH_PORT_ATTR_MAX+1] = {
@@ -334,16 +337,11 @@ swconfig_unlock(void)
 }
 
 static struct switch_dev *
-swconfig_get_dev(struct genl_info *info)
+swconfig_get_dev_by_id(int id)
 {
 	struct switch_dev *dev = NULL;
 	struct switch_dev *p;
-	int id;
-
-	if (!info->attrs[SWITCH_ATTR_ID])
-		goto done;
 
-	id = nla_get_u32(info->attrs[SWITCH_ATTR_ID]);
 	swconfig_lock();
 	list_for_each_entry(p, &swdevs, dev_list) {
 		if (id != p->id)
@@ -357,10 +355,19 @@ swconfig_get_dev(struct genl_info *info)
 	else
 		DPRINTF("device %d not found\n", id);
 	swconfig_unlock();
-done:
+
 	return dev;
 }
 
+static struct switch_dev *
+swconfig_get_dev(struct genl_info *info)
+{
+	if (!info->attrs[SWITCH_ATTR_ID])
+		return NULL;
+
+	return swconfig_get_dev_by_id(nla_get_u32(info->attrs[SWITCH_ATTR_ID]));
+}
+
 static inline void
 swconfig_put_dev(struct switch_dev *dev)
 {
@@ -894,6 +901,212 @@ static int swconfig_dump_switches(struct sk_buff *skb,
 	return skb->len;
 }
 
+/* attribute groups walked by SWITCH_CMD_GET_ALL, in dump order */
+enum {
+	SWCONFIG_DUMP_GLOBAL,
+	SWCONFIG_DUMP_PORT,
+	SWCONFIG_DUMP_VLAN,
+	__SWCONFIG_DUMP_MAX
+};
+
+static int
+swconfig_dump_value(struct sk_buff *skb, struct netlink_callback *cb,
+		struct switch_dev *dev, int group, int id,
+		const struct switch_attr *attr, int port_vlan)
+{
+	struct nlattr *n, *p;
+	struct switch_val val;
+	void *hdr;
+	int i;
+
+	if (attr->disabled || !attr->get || attr->type == SWITCH_TYPE_NOVAL)
+		return 0;
+
+	memset(&val, 0, sizeof(val));
+	val.attr = attr;
+	val.port_vlan = port_vlan;
+	if (attr->type == SWITCH_TYPE_PORTS) {
+		val.value.ports = dev->portbuf;
+		memset(dev->portbuf, 0,
+			sizeof(struct switch_port) * dev->ports);
+	}
+
+	/* values which can't be read are left out of the dump */
+	if (attr->get(dev, attr, &val))
+		return 0;
+
+	hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid, cb->nlh->nlmsg_seq,
+			&switch_fam, NLM_F_MULTI, SWITCH_CMD_NEW_ATTR);
+	if (!hdr)
+		return -EMSGSIZE;
+
+	if (nla_put_u32(skb, SWITCH_ATTR_OP_ID, id))
+		goto nla_put_failure;
+	if (group == SWCONFIG_DUMP_PORT &&
+	    nla_put_u32(skb, SWITCH_ATTR_OP_PORT, port_vlan))
+		goto nla_put_failure;
+	if (group == SWCONFIG_DUMP_VLAN &&
+	    nla_put_u32(skb, SWITCH_ATTR_OP_VLAN, port_vlan))
+		goto nla_put_failure;
+
+	switch(attr->type) {
+	case SWITCH_TYPE_INT:
+		if (nla_put_u32(skb, SWITCH_ATTR_OP_VALUE_INT, val.value.i))
+			goto nla_put_failure;
+		break;
+	case SWITCH_TYPE_STRING:
+		if (nla_put_string(skb, SWITCH_ATTR_OP_VALUE_STR, val.value.s))
+			goto nla_put_failure;
+		break;
+	case SWITCH_TYPE_PORTS:
+		n = nla_nest_start(skb, SWITCH_ATTR_OP_VALUE_PORTS);
+		if (!n)
+			goto nla_put_failure;
+		for (i = 0; i < val.len; i++) {
+			const struct switch_port *port = &val.value.ports[i];
+
+			p = nla_nest_start(skb, SWITCH_ATTR_PORT);
+			if (!p)
+				goto nla_put_failure;
+			if (nla_put_u32(skb, SWITCH_PORT_ID, port->id))
+				goto nla_put_failure;
+			if ((port->flags & (1 << SWITCH_PORT_FLAG_TAGGED)) &&
+			    nla_put_flag(skb, SWITCH_PORT_FLAG_TAGGED))
+				goto nla_put_failure;
+			nla_nest_end(skb, p);
+		}
+		nla_nest_end(skb, n);
+		break;
+	default:
+		genlmsg_cancel(skb, hdr);
+		return 0;
+	}
+
+	return genlmsg_end(skb, hdr);
+
+nla_put_failure:
+	genlmsg_cancel(skb, hdr);
+	return -EMSGSIZE;
+}
+
+/*
+ * Stream the values of all readable attributes of a switch. The global
+ * attributes come first, followed by the port and vlan attributes for
+ * the requested port and vlan ranges. The position is kept in cb->args
+ * so the dump can continue in the next message buffer.
+ */
+static int
+swconfig_dump_all(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct nlattr *tb[SWITCH_ATTR_MAX+1];
+	const struct switch_attrlist *alist;
+	const struct switch_attr *attr;
+	struct switch_dev *dev;
+	u32 groups = SWITCH_DUMP_GLOBAL | SWITCH_DUMP_PORT | SWITCH_DUMP_VLAN;
+	int group = cb->args[0];
+	int idx = cb->args[1];
+	int i = cb->args[2];
+	int first, last, id;
+	int err;
+
+	/* defaults */
+	struct switch_attr *def_list;
+	unsigned long *def_active;
+	int n_def;
+
+	err = nlmsg_parse(cb->nlh, GENL_HDRLEN + switch_fam.hdrsize, tb,
+			SWITCH_ATTR_MAX, switch_policy);
+	if (err < 0)
+		return err;
+
+	if (!tb[SWITCH_ATTR_ID])
+		return -EINVAL;
+
+	dev = swconfig_get_dev_by_id(nla_get_u32(tb[SWITCH_ATTR_ID]));
+	if (!dev)
+		return -EINVAL;
+
+	if (tb[SWITCH_ATTR_DUMP_GROUPS])
+		groups = nla_get_u32(tb[SWITCH_ATTR_DUMP_GROUPS]);
+
+	for (; group < __SWCONFIG_DUMP_MAX; group++, idx = 0, i = 0) {
+		if (!(groups & (1 << group)))
+			continue;
+
+		switch (group) {
+		case SWCONFIG_DUMP_GLOBAL:
+			alist = &dev->ops->attr_global;
+			def_list = default_global;
+			def_active = &dev->def_global;
+			n_def = ARRAY_SIZE(default_global);
+			first = last = 0;
+			break;
+		case SWCONFIG_DUMP_PORT:
+			alist = &dev->ops->attr_port;
+			def_list = default_port;
+			def_active = &dev->def_port;
+			n_def = ARRAY_SIZE(default_port);
+			first = 0;
+			last = dev->ports - 1;
+			if (tb[SWITCH_ATTR_OP_PORT])
+				first = nla_get_u32(tb[SWITCH_ATTR_OP_PORT]);
+			if (tb[SWITCH_ATTR_OP_PORT_LAST])
+				last = min_t(int, last,
+					nla_get_u32(tb[SWITCH_ATTR_OP_PORT_LAST]));
+			break;
+		case SWCONFIG_DUMP_VLAN:
+			alist = &dev->ops->attr_vlan;
+			def_list = default_vlan;
+			def_active = &dev->def_vlan;
+			n_def = ARRAY_SIZE(default_vlan);
+			first = 0;
+			last = dev->vlans - 1;
+			if (tb[SWITCH_ATTR_OP_VLAN])
+				first = nla_get_u32(tb[SWITCH_ATTR_OP_VLAN]);
+			if (tb[SWITCH_ATTR_OP_VLAN_LAST])
+				last = min_t(int, last,
+					nla_get_u32(tb[SWITCH_ATTR_OP_VLAN_LAST]));
+			break;
+		default:
+			continue;
+		}
+
+		if (idx < first)
+			idx = first;
+
+		for (; idx <= last; idx++, i = 0) {
+			for (; i < alist->n_attr + n_def; i++) {
+				if (i < alist->n_attr) {
+					attr = &alist->attr[i];
+					id = i;
+				} else {
+					id = i - alist->n_attr;
+					if (!test_bit(id, def_active))
+						continue;
+					attr = &def_list[id];
+					id += SWITCH_ATTR_DEFAULTS_OFFSET;
+				}
+
+				err = swconfig_dump_value(skb, cb, dev, group,
+						id, attr, idx);
+
+				/* continue in the next buffer, unless the
+				 * value does not even fit into an empty one */
+				if (err < 0 && skb->len)
+					goto out;
+			}
+		}
+	}
+
+out:
+	cb->args[0] = group;
+	cb->args[1] = idx;
+	cb->args[2] = i;
+	swconfig_put_dev(dev);
+
+	return skb->len;
+}
+
 static int
 swconfig_done(struct netlink_callback *cb)
 {
@@ -951,6 +1164,12 @@ static struct genl_ops swconfig_ops[] = {
 		.dumpit = swconfig_dump_switches,
 		.policy = switch_policy,
 		.done = swconfig_done,
+	},
+	{
+		.cmd = SWITCH_CMD_GET_ALL,
+		.dumpit = swconfig_dump_all,
+		.policy = switch_policy,
+		.done = swconfig_done,
 	}
 };
 
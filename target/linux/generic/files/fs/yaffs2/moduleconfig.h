@@ -38,6 +38,11 @@
 /*          CONFIG_YAFFS_DOES_ECC is set */
 /* #define CONFIG_YAFFS_ECC_WRONG_ORDER */
 
+/* Default: Not selected */
+/* Meaning: Check the ECC code against the original implementation and */
+/*          log its throughput when the module is loaded */
+/* #define CONFIG_YAFFS_ECC_SELFTEST */
+
 /* Default: Not selected */
 /* Meaning: Always test whether chunks are erased before writing to them.
 	    Use during mtd debugging and init. */
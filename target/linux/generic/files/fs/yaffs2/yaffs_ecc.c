@@ -91,26 +91,152 @@ static int yaffs_count_bits32(unsigned x)
 	return r;
 }
 
-/* Calculate the ECC for a 256-byte block of data */
-void yaffs_ecc_cacl(const unsigned char *data, unsigned char *ecc)
+/*
+ * Parity of a 32 bit word.
+ */
+static unsigned yaffs_parity32(__u32 x)
 {
-	unsigned int i;
+	x ^= x >> 16;
+	x ^= x >> 8;
+	x ^= x >> 4;
+	x ^= x >> 2;
+	x ^= x >> 1;
+	return x & 1;
+}
 
-	unsigned char col_parity = 0;
-	unsigned char line_parity = 0;
-	unsigned char line_parity_prime = 0;
-	unsigned char t;
+/*
+ * Masks for bytes 1 and 3, and for bytes 2 and 3 of a word as it is laid
+ * out in memory, whatever the endianness.
+ */
+static const union {
+	unsigned char b[4];
+	__u32 w;
+} yaffs_ecc_lane1 = { { 0x00, 0xff, 0x00, 0xff } },
+  yaffs_ecc_lane2 = { { 0x00, 0x00, 0xff, 0xff } };
+
+/*
+ * Accumulate the parity of data[i..end-1] a byte at a time.
+ * col is the xor of the table entries, line the xor of the indices of the
+ * bytes with an odd number of bits set and odd the number of such bytes
+ * (only bit 0 matters).
+ */
+static void yaffs_ecc_parity_bytes(const unsigned char *data, unsigned i,
+				unsigned end, unsigned char *col,
+				unsigned *line, unsigned *odd)
+{
 	unsigned char b;
 
-	for (i = 0; i < 256; i++) {
-		b = column_parity_table[*data++];
-		col_parity ^= b;
+	for (; i < end; i++) {
+		b = column_parity_table[data[i]];
+		*col ^= b;
 
 		if (b & 0x01) {		/* odd number of bits in the byte */
-			line_parity ^= i;
-			line_parity_prime ^= ~i;
+			*line ^= i;
+			*odd ^= 1;
 		}
 	}
+}
+
+/*
+ * Same as yaffs_ecc_parity_bytes() for n_words aligned words.
+ *
+ * Bit k of the line parity is the parity of all the bytes whose index has
+ * bit k set. Bits 0 and 1 select the byte within a word, so they come from
+ * the xor of all words masked to the right bytes. The other bits select
+ * the word, and for those the words are xor-ed into one accumulator per
+ * word index bit, so the parity is only taken once per bit at the end
+ * instead of once per byte. The column parity is linear too, it is the
+ * table entry for the xor of all bytes.
+ */
+static void yaffs_ecc_parity_words(const __u32 *w, unsigned n_words,
+				unsigned char *col, unsigned *line,
+				unsigned *odd)
+{
+	__u32 acc[30];	/* word index bits 2 and up */
+	__u32 all = 0;
+	__u32 a0 = 0;	/* word index bit 0 */
+	__u32 a1 = 0;	/* word index bit 1 */
+	__u32 s;
+	__u32 x;
+	unsigned n_acc = 0;
+	unsigned j;
+	unsigned q;
+	unsigned b;
+	unsigned l;
+
+	if (!n_words)
+		return;
+
+	for (q = (n_words - 1) >> 2; q; q >>= 1)
+		acc[n_acc++] = 0;
+
+	/* Four words at a time, they share the upper index bits */
+	for (j = 0; j < n_words; j += 4) {
+		if (j + 4 <= n_words) {
+			s = w[j] ^ w[j + 1];
+			x = w[j + 2] ^ w[j + 3];
+			a0 ^= w[j + 1] ^ w[j + 3];
+		} else {
+			s = w[j];
+			x = 0;
+			if (j + 1 < n_words) {
+				s ^= w[j + 1];
+				a0 ^= w[j + 1];
+			}
+			if (j + 2 < n_words)
+				x = w[j + 2];
+		}
+		a1 ^= x;
+		s ^= x;
+		all ^= s;
+
+		for (q = j >> 2, b = 0; q; q >>= 1, b++)
+			if (q & 1)
+				acc[b] ^= s;
+	}
+
+	l = yaffs_parity32(all & yaffs_ecc_lane1.w) |
+	    yaffs_parity32(all & yaffs_ecc_lane2.w) << 1 |
+	    yaffs_parity32(a0) << 2 |
+	    yaffs_parity32(a1) << 3;
+	for (b = 0; b < n_acc; b++)
+		l |= yaffs_parity32(acc[b]) << (b + 4);
+
+	x = all ^ (all >> 16);
+	x ^= x >> 8;
+
+	*col ^= column_parity_table[x & 0xff];
+	*line ^= l;
+	*odd ^= yaffs_parity32(all);
+}
+
+static void yaffs_ecc_parity(const unsigned char *data, unsigned n_bytes,
+				unsigned char *col, unsigned *line,
+				unsigned *odd)
+{
+	unsigned n_words = 0;
+
+	*col = 0;
+	*line = 0;
+	*odd = 0;
+
+	if (((unsigned long)data & (sizeof(__u32) - 1)) == 0) {
+		n_words = n_bytes / sizeof(__u32);
+		yaffs_ecc_parity_words((const __u32 *)data, n_words,
+					col, line, odd);
+	}
+
+	yaffs_ecc_parity_bytes(data, n_words * sizeof(__u32), n_bytes,
+				col, line, odd);
+}
+
+/* Pack the parities of a 256-byte block into the ECC bytes */
+static void yaffs_ecc_pack(unsigned char col_parity, unsigned line,
+			unsigned odd, unsigned char *ecc)
+{
+	unsigned char line_parity = line;
+	unsigned char line_parity_prime = odd ? ~line : line;
+	unsigned char t;
 
 	ecc[2] = (~col_parity) | 0x03;
 
@@ -160,6 +286,17 @@ void yaffs_ecc_cacl(const unsigned char *data, unsigned char *ecc)
 #endif
 }
 
+/* Calculate the ECC for a 256-byte block of data */
+void yaffs_ecc_cacl(const unsigned char *data, unsigned char *ecc)
+{
+	unsigned char col_parity;
+	unsigned line_parity;
+	unsigned odd;
+
+	yaffs_ecc_parity(data, 256, &col_parity, &line_parity, &odd);
+	yaffs_ecc_pack(col_parity, line_parity, odd, ecc);
+}
+
 
 /* Correct the ECC on a 256 byte block of data */
 
@@ -248,28 +385,15 @@ int yaffs_ecc_correct(unsigned char *data, unsigned char *read_ecc,
 void yaffs_ecc_calc_other(const unsigned char *data, unsigned n_bytes,
 				yaffs_ECCOther *eccOther)
 {
-	unsigned int i;
-
-	unsigned char col_parity = 0;
-	unsigned line_parity = 0;
-	unsigned line_parity_prime = 0;
-	unsigned char b;
-
-	for (i = 0; i < n_bytes; i++) {
-		b = column_parity_table[*data++];
-		col_parity ^= b;
-
-		if (b & 0x01)	 {
-			/* odd number of bits in the byte */
-			line_parity ^= i;
-			line_parity_prime ^= ~i;
-		}
+	unsigned char col_parity;
+	unsigned line_parity;
+	unsigned odd;
 
-	}
+	yaffs_ecc_parity(data, n_bytes, &col_parity, &line_parity, &odd);
 
 	eccOther->colParity = (col_parity >> 2) & 0x3f;
 	eccOther->lineParity = line_parity;
-	eccOther->lineParityPrime = line_parity_prime;
+	eccOther->lineParityPrime = odd ? ~line_parity : line_parity;
 }
 
 int yaffs_ecc_correct_other(unsigned char *data, unsigned n_bytes,
@@ -321,3 +445,277 @@ int yaffs_ecc_correct_other(unsigned char *data, unsigned n_bytes,
 
 	return -1;
 }
+
+#ifdef CONFIG_YAFFS_ECC_SELFTEST
+
+#include "yaffs_trace.h"
+
+/*
+ * Self test, run when the module is loaded. The word at a time parity is
+ * compared against the byte at a time loop the ECC used to be calculated
+ * with, and every single bit error must be corrected.
+ */
+
+#define YAFFS_ECC_TEST_SIZE	512
+#define YAFFS_ECC_TEST_LOOPS	4096
+
+static __u32 yaffs_ecc_test_buf[(YAFFS_ECC_TEST_SIZE + 8) / 4];
+static __u32 yaffs_ecc_test_copy[YAFFS_ECC_TEST_SIZE / 4];
+
+/* Results of the original code for the data from yaffs_ecc_test_fill() */
+static const unsigned char yaffs_ecc_test_kat[3][3] = {
+	{ 0xff, 0xc3, 0x03 },
+	{ 0x30, 0xf0, 0xff },
+	{ 0xc0, 0x3c, 0xff },
+};
+
+static const yaffs_ECCOther yaffs_ecc_test_kat_other[3] = {
+	{ 0x03, 0x00000077, 0x00000077 },
+	{ 0x29, 0x00000188, 0xfffffe77 },
+	{ 0x3c, 0x0000002f, 0x0000002f },
+};
+
+static void yaffs_ecc_test_fill(unsigned char *data, unsigned n_bytes,
+				__u32 seed)
+{
+	while (n_bytes--) {
+		seed = seed * 1103515245 + 12345;
+		*data++ = seed >> 16;
+	}
+}
+
+static void yaffs_ecc_test_ref(const unsigned char *data, unsigned n_bytes,
+				unsigned char *ecc, yaffs_ECCOther *eccOther)
+{
+	unsigned char col_parity = 0;
+	unsigned line_parity = 0;
+	unsigned odd = 0;
+
+	yaffs_ecc_parity_bytes(data, 0, n_bytes,
+				&col_parity, &line_parity, &odd);
+
+	if (ecc)
+		yaffs_ecc_pack(col_parity, line_parity, odd, ecc);
+
+	eccOther->colParity = (col_parity >> 2) & 0x3f;
+	eccOther->lineParity = line_parity;
+	eccOther->lineParityPrime = odd ? ~line_parity : line_parity;
+}
+
+static int yaffs_ecc_test_other_eq(const yaffs_ECCOther *a,
+				const yaffs_ECCOther *b)
+{
+	return a->colParity == b->colParity &&
+		a->lineParity == b->lineParity &&
+		a->lineParityPrime == b->lineParityPrime;
+}
+
+static int yaffs_ecc_test_calc(void)
+{
+	unsigned char *buf = (unsigned char *)yaffs_ecc_test_buf;
+	unsigned char ecc[3];
+	unsigned char ref[3];
+	yaffs_ECCOther other;
+	yaffs_ECCOther ref_other;
+	unsigned i;
+	unsigned v;
+	unsigned n;
+	unsigned char t;
+
+	for (i = 0; i < 3; i++) {
+		yaffs_ecc_test_fill(buf, YAFFS_ECC_TEST_SIZE, i + 1);
+
+		memcpy(ref, yaffs_ecc_test_kat[i], 3);
+#ifdef CONFIG_YAFFS_ECC_WRONG_ORDER
+		t = ref[0];
+		ref[0] = ref[1];
+		ref[1] = t;
+#endif
+		yaffs_ecc_cacl(buf, ecc);
+		yaffs_ecc_calc_other(buf, 509, &other);
+		if (memcmp(ecc, ref, 3) ||
+		    !yaffs_ecc_test_other_eq(&other,
+					&yaffs_ecc_test_kat_other[i])) {
+			T(YAFFS_TRACE_ALWAYS,
+			  (TSTR("yaffs ecc: wrong result for pattern %u" TENDSTR),
+			  i));
+			return -1;
+		}
+	}
+
+	/* Every value of every byte */
+	yaffs_ecc_test_fill(buf, 256, 4);
+	for (i = 0; i < 256; i++) {
+		t = buf[i];
+		for (v = 0; v < 256; v++) {
+			buf[i] = v;
+			yaffs_ecc_cacl(buf, ecc);
+			yaffs_ecc_test_ref(buf, 256, ref, &ref_other);
+			if (memcmp(ecc, ref, 3)) {
+				T(YAFFS_TRACE_ALWAYS,
+				  (TSTR("yaffs ecc: mismatch for byte %u = %02x"
+				  TENDSTR), i, v));
+				return -1;
+			}
+		}
+		buf[i] = t;
+	}
+
+	/* Every length at every alignment */
+	yaffs_ecc_test_fill(buf, YAFFS_ECC_TEST_SIZE + 8, 5);
+	for (i = 0; i < 4; i++) {
+		for (n = 0; n <= YAFFS_ECC_TEST_SIZE; n++) {
+			yaffs_ecc_calc_other(buf + i, n, &other);
+			yaffs_ecc_test_ref(buf + i, n, n == 256 ? ref : NULL,
+					&ref_other);
+			if (!yaffs_ecc_test_other_eq(&other, &ref_other)) {
+				T(YAFFS_TRACE_ALWAYS,
+				  (TSTR("yaffs ecc: mismatch for %u bytes at offset %u"
+				  TENDSTR), n, i));
+				return -1;
+			}
+			if (n != 256)
+				continue;
+			yaffs_ecc_cacl(buf + i, ecc);
+			if (memcmp(ecc, ref, 3)) {
+				T(YAFFS_TRACE_ALWAYS,
+				  (TSTR("yaffs ecc: mismatch at offset %u" TENDSTR),
+				  i));
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int yaffs_ecc_test_correct(void)
+{
+	unsigned char *buf = (unsigned char *)yaffs_ecc_test_buf;
+	unsigned char *copy = (unsigned char *)yaffs_ecc_test_copy;
+	unsigned char ecc[3];
+	unsigned char read_ecc[3];
+	unsigned char test_ecc[3];
+	yaffs_ECCOther other;
+	yaffs_ECCOther read_other;
+	yaffs_ECCOther test_other;
+	unsigned i;
+	unsigned n;
+
+	yaffs_ecc_test_fill(buf, 256, 6);
+	memcpy(copy, buf, 256);
+	yaffs_ecc_cacl(buf, ecc);
+
+	for (i = 0; i < 256 * 8; i++) {
+		buf[i / 8] ^= 1 << (i % 8);
+		memcpy(read_ecc, ecc, 3);
+		yaffs_ecc_cacl(buf, test_ecc);
+		if (yaffs_ecc_correct(buf, read_ecc, test_ecc) != 1 ||
+		    memcmp(buf, copy, 256)) {
+			T(YAFFS_TRACE_ALWAYS,
+			  (TSTR("yaffs ecc: data bit %u not corrected" TENDSTR),
+			  i));
+			return -1;
+		}
+	}
+
+	for (i = 0; i < 3 * 8; i++) {
+		memcpy(read_ecc, ecc, 3);
+		read_ecc[i / 8] ^= 1 << (i % 8);
+		if (yaffs_ecc_correct(buf, read_ecc, ecc) != 1 ||
+		    memcmp(read_ecc, ecc, 3) || memcmp(buf, copy, 256)) {
+			T(YAFFS_TRACE_ALWAYS,
+			  (TSTR("yaffs ecc: ecc bit %u not corrected" TENDSTR),
+			  i));
+			return -1;
+		}
+	}
+
+	/* 16 bytes is the size of the yaffs2 tags */
+	for (n = 16; n <= 256; n += 240) {
+		yaffs_ecc_calc_other(buf, n, &other);
+
+		for (i = 0; i < n * 8; i++) {
+			buf[i / 8] ^= 1 << (i % 8);
+			read_other = other;
+			yaffs_ecc_calc_other(buf, n, &test_other);
+			if (yaffs_ecc_correct_other(buf, n, &read_other,
+						&test_other) != 1 ||
+			    memcmp(buf, copy, n)) {
+				T(YAFFS_TRACE_ALWAYS,
+				  (TSTR("yaffs ecc: data bit %u of %u not corrected"
+				  TENDSTR), i, n));
+				return -1;
+			}
+		}
+
+		for (i = 0; i < 6 + 32 + 32; i++) {
+			read_other = other;
+			if (i < 6)
+				read_other.colParity ^= 1 << i;
+			else if (i < 6 + 32)
+				read_other.lineParity ^= 1 << (i - 6);
+			else
+				read_other.lineParityPrime ^= 1 << (i - 6 - 32);
+			if (yaffs_ecc_correct_other(buf, n, &read_other,
+						&other) != 1 ||
+			    !yaffs_ecc_test_other_eq(&read_other, &other)) {
+				T(YAFFS_TRACE_ALWAYS,
+				  (TSTR("yaffs ecc: ecc bit %u of %u not corrected"
+				  TENDSTR), i, n));
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static unsigned yaffs_ecc_test_rate(__u32 start)
+{
+	__u32 us = Y_CLOCK_US() - start;
+
+	if (!us)
+		us = 1;
+
+	/* kB/s */
+	return (YAFFS_ECC_TEST_LOOPS * 256 / 1024) * 1000000 / us;
+}
+
+int yaffs_ecc_selftest(void)
+{
+	unsigned char *buf = (unsigned char *)yaffs_ecc_test_buf;
+	unsigned char ecc[3];
+	yaffs_ECCOther other;
+	unsigned bytewise;
+	unsigned wordwise;
+	__u32 start;
+	unsigned i;
+
+	if (yaffs_ecc_test_calc() || yaffs_ecc_test_correct())
+		return -1;
+
+	yaffs_ecc_test_fill(buf, 256, 7);
+
+	start = Y_CLOCK_US();
+	for (i = 0; i < YAFFS_ECC_TEST_LOOPS; i++) {
+		yaffs_ecc_test_ref(buf, 256, ecc, &other);
+		buf[0] = ecc[0];
+	}
+	bytewise = yaffs_ecc_test_rate(start);
+
+	start = Y_CLOCK_US();
+	for (i = 0; i < YAFFS_ECC_TEST_LOOPS; i++) {
+		yaffs_ecc_cacl(buf, ecc);
+		buf[0] = ecc[0];
+	}
+	wordwise = yaffs_ecc_test_rate(start);
+
+	T(YAFFS_TRACE_ALWAYS,
+	  (TSTR("yaffs ecc: self test passed, %u kB/s byte wise, %u kB/s word wise"
+	  TENDSTR), bytewise, wordwise));
+
+	return 0;
+}
+
+#endif
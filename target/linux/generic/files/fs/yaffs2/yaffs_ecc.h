@@ -41,4 +41,8 @@ void yaffs_ecc_calc_other(const unsigned char *data, unsigned n_bytes,
 int yaffs_ecc_correct_other(unsigned char *data, unsigned n_bytes,
 			yaffs_ECCOther *read_ecc,
 			const yaffs_ECCOther *test_ecc);
+
+#ifdef CONFIG_YAFFS_ECC_SELFTEST
+int yaffs_ecc_selftest(void);
+#endif
 #endif
@@ -32,9 +32,8 @@
 
 #include "yaffs_nameval.h"
 #include "yaffs_allocator.h"
+#include "yaffs_qsort.h"
 
-/* Note YAFFS_GC_GOOD_ENOUGH must be <= YAFFS_GC_PASSIVE_THRESHOLD */
-#define YAFFS_GC_GOOD_ENOUGH 2
 #define YAFFS_GC_PASSIVE_THRESHOLD 4
 
 #include "yaffs_ecc.h"
@@ -526,6 +525,7 @@ static void yaffs_retire_block(yaffs_dev_t *dev, int flash_block)
 	bi->block_state = YAFFS_BLOCK_STATE_DEAD;
 	bi->gc_prioritise = 0;
 	bi->needs_retiring = 0;
+	yaffs_gc_index_update(dev, bi);
 
 	dev->n_retired_blocks++;
 }
@@ -558,6 +558,7 @@ void yaffs_handle_chunk_error(yaffs_dev_t *dev, yaffs_block_info_t *bi)
 	if (!bi->gc_prioritise) {
 		bi->gc_prioritise = 1;
 		dev->has_pending_prioritised_gc = 1;
+		yaffs_gc_index_update(dev, bi);
 		bi->chunk_error_strikes++;
 
 		if (bi->chunk_error_strikes > 3) {
@@ -1024,6 +1025,7 @@ static void yaffs_soft_del_chunk(yaffs_dev_t *dev, int chunk)
 	theBlock = yaffs_get_block_info(dev, block_no);
 	if (theBlock) {
 		theBlock->soft_del_pages++;
+		yaffs_gc_index_update(dev, theBlock);
 		dev->n_free_chunks++;
 		yaffs2_update_oldest_dirty_seq(dev, block_no, theBlock);
 	}
@@ -1819,9 +1821,12 @@ int yaffs_rename_obj(yaffs_obj_t *old_dir, const YCHAR *old_name,
 static int yaffs_init_blocks(yaffs_dev_t *dev)
 {
 	int nBlocks = dev->internal_end_block - dev->internal_start_block + 1;
+	int i;
 
 	dev->block_info = NULL;
 	dev->chunk_bits = NULL;
+	dev->gc_entries = NULL;
+	dev->gc_buckets = NULL;
 
 	dev->alloc_block = -1;	/* force it to get a new one */
 
@@ -1844,9 +1849,27 @@ static int yaffs_init_blocks(yaffs_dev_t *dev)
 			dev->chunk_bits_alt = 0;
 	}
 
-	if (dev->block_info && dev->chunk_bits) {
+	if (dev->chunk_bits) {
+		dev->gc_entries = YMALLOC(nBlocks * sizeof(yaffs_gc_entry_t));
+		if (!dev->gc_entries) {
+			dev->gc_entries = YMALLOC_ALT(nBlocks * sizeof(yaffs_gc_entry_t));
+			dev->gc_entries_alt = 1;
+		} else
+			dev->gc_entries_alt = 0;
+		dev->gc_buckets = YMALLOC((dev->param.chunks_per_block + 2) *
+					  sizeof(struct ylist_head));
+	}
+
+	if (dev->block_info && dev->chunk_bits &&
+	    dev->gc_entries && dev->gc_buckets) {
 		memset(dev->block_info, 0, nBlocks * sizeof(yaffs_block_info_t));
 		memset(dev->chunk_bits, 0, dev->chunk_bit_stride * nBlocks);
+		for (i = 0; i < nBlocks; i++) {
+			YINIT_LIST_HEAD(&dev->gc_entries[i].list);
+			dev->gc_entries[i].bucket = -1;
+		}
+		for (i = 0; i < dev->param.chunks_per_block + 2; i++)
+			YINIT_LIST_HEAD(&dev->gc_buckets[i]);
 		return YAFFS_OK;
 	}
 
@@ -1870,6 +1893,95 @@ static void yaffs_deinit_blocks(yaffs_dev_t *dev)
 		YFREE(dev->chunk_bits);
 	dev->chunk_bits_alt = 0;
 	dev->chunk_bits = NULL;
+
+	if (dev->gc_entries_alt && dev->gc_entries)
+		YFREE_ALT(dev->gc_entries);
+	else if (dev->gc_entries)
+		YFREE(dev->gc_entries);
+	dev->gc_entries_alt = 0;
+	dev->gc_entries = NULL;
+
+	if (dev->gc_buckets)
+		YFREE(dev->gc_buckets);
+	dev->gc_buckets = NULL;
+}
+
+/*
+ * GC victim index.
+ * Every full block sits on the list for its number of live (neither deleted
+ * nor soft deleted) pages, or on the prioritised list if it had errors. The
+ * index is updated whenever the state or the page counts of a block change,
+ * so the dirtiest block is found without walking block_info.
+ */
+static int yaffs_gc_bucket(yaffs_dev_t *dev, yaffs_block_info_t *bi)
+{
+	int pagesUsed;
+
+	if (bi->block_state != YAFFS_BLOCK_STATE_FULL)
+		return -1;
+
+	if (bi->gc_prioritise)
+		return dev->param.chunks_per_block + 1;
+
+	pagesUsed = bi->pages_in_use - bi->soft_del_pages;
+	if (pagesUsed < 0)
+		pagesUsed = 0;
+	if (pagesUsed > dev->param.chunks_per_block)
+		pagesUsed = dev->param.chunks_per_block;
+
+	return pagesUsed;
+}
+
+void yaffs_gc_index_update(yaffs_dev_t *dev, yaffs_block_info_t *bi)
+{
+	yaffs_gc_entry_t *entry;
+	int bucket;
+
+	if (!dev->gc_entries)
+		return;
+
+	entry = &dev->gc_entries[bi - dev->block_info];
+	bucket = yaffs_gc_bucket(dev, bi);
+	if (entry->bucket == bucket)
+		return;
+
+	ylist_del_init(&entry->list);
+	entry->bucket = bucket;
+	if (bucket < 0)
+		return;
+
+	/* Oldest first, those are the least likely to be held up by
+	 * shrink headers.
+	 */
+	ylist_add_tail(&entry->list, &dev->gc_buckets[bucket]);
+	if (bucket > dev->param.chunks_per_block)
+		dev->has_pending_prioritised_gc = 1;
+}
+
+/* The scanners and checkpoint restore set up block_info directly */
+static void yaffs_gc_index_rebuild(yaffs_dev_t *dev)
+{
+	int i;
+
+	for (i = dev->internal_start_block; i <= dev->internal_end_block; i++)
+		yaffs_gc_index_update(dev, yaffs_get_block_info(dev, i));
+}
+
+/* First block in a bucket which may be collected now, 0 if none */
+static unsigned yaffs_gc_index_find(yaffs_dev_t *dev, int bucket)
+{
+	struct ylist_head *i;
+	yaffs_gc_entry_t *entry;
+	int block_no;
+
+	ylist_for_each(i, &dev->gc_buckets[bucket]) {
+		entry = ylist_entry(i, yaffs_gc_entry_t, list);
+		block_no = entry - dev->gc_entries + dev->internal_start_block;
+		if (yaffs_block_ok_for_gc(dev, yaffs_get_block_info(dev, block_no)))
+			return block_no;
+	}
+
+	return 0;
 }
 
 void yaffs_block_became_dirty(yaffs_dev_t *dev, int block_no)
@@ -1889,6 +2001,7 @@ void yaffs_block_became_dirty(yaffs_dev_t *dev, int block_no)
 	yaffs2_clear_oldest_dirty_seq(dev,bi);
 
 	bi->block_state = YAFFS_BLOCK_STATE_DIRTY;
+	yaffs_gc_index_update(dev, bi);
 
 	/* If this is the block being garbage collected then stop gc'ing this block */
 	if(block_no == dev->gc_block)
@@ -2052,6 +2165,7 @@ static int yaffs_alloc_chunk(yaffs_dev_t *dev, int useReserve,
 		/* If the block is full set the state to full */
 		if (dev->alloc_page >= dev->param.chunks_per_block) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
+			yaffs_gc_index_update(dev, bi);
 			dev->alloc_block = -1;
 		}
 
@@ -2090,6 +2204,7 @@ void yaffs_skip_rest_of_block(yaffs_dev_t *dev)
 		yaffs_block_info_t *bi = yaffs_get_block_info(dev, dev->alloc_block);
 		if(bi->block_state == YAFFS_BLOCK_STATE_ALLOCATING){
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
+			yaffs_gc_index_update(dev, bi);
 			dev->alloc_block = -1;
 		}
 	}
@@ -2135,6 +2250,7 @@ static int yaffs_gc_block(yaffs_dev_t *dev, int block,
 	bi->has_shrink_hdr = 0;	/* clear the flag so that the block can erase */
 
 	dev->gc_disable = 1;
+	yaffs_gc_index_update(dev, bi);
 
 	if (isCheckpointBlock ||
 			!yaffs_still_some_chunks(dev, block)) {
@@ -2327,6 +2443,7 @@ static int yaffs_gc_block(yaffs_dev_t *dev, int block,
 		 * because checkpointing does not restore gc.
 		 */
 		bi->block_state = YAFFS_BLOCK_STATE_FULL;
+		yaffs_gc_index_update(dev, bi);
 	} else {
 		/* The gc completed. */
 		/* Do any required cleanups */
@@ -2369,8 +2486,9 @@ static int yaffs_gc_block(yaffs_dev_t *dev, int block,
 }
 
 /*
- * FindBlockForgarbageCollection is used to select the dirtiest block (or close enough)
- * for garbage collection.
+ * FindBlockForgarbageCollection is used to select the dirtiest block
+ * for garbage collection. Full blocks are indexed by the number of pages
+ * still in use, so this only looks at the buckets up to the threshold.
  */
 
 static unsigned yaffs_find_gc_block(yaffs_dev_t *dev,
@@ -2378,59 +2496,42 @@ static unsigned yaffs_find_gc_block(yaffs_dev_t *dev,
 					int background)
 {
 	int i;
-	int iterations;
 	unsigned selected = 0;
 	int prioritised = 0;
-	int prioritisedExists = 0;
 	yaffs_block_info_t *bi;
 	int threshold;
+	int prioritisedBucket = dev->param.chunks_per_block + 1;
 
 	/* First let's see if we need to grab a prioritised block */
 	if (dev->has_pending_prioritised_gc && !aggressive) {
 		dev->gc_dirtiest = 0;
-		bi = dev->block_info;
-		for (i = dev->internal_start_block;
-			i <= dev->internal_end_block && !selected;
-			i++) {
-
-			if (bi->gc_prioritise) {
-				prioritisedExists = 1;
-				if (bi->block_state == YAFFS_BLOCK_STATE_FULL &&
-				   yaffs_block_ok_for_gc(dev, bi)) {
-					selected = i;
-					prioritised = 1;
-				}
-			}
-			bi++;
-		}
-
-		/*
-		 * If there is a prioritised block and none was selected then
-		 * this happened because there is at least one old dirty block gumming
-		 * up the works. Let's gc the oldest dirty block.
-		 */
-
-		if(prioritisedExists &&
-			!selected &&
-			dev->oldest_dirty_block > 0)
-			selected = dev->oldest_dirty_block;
 
-		if (!prioritisedExists) /* None found, so we can clear this */
+		if (ylist_empty(&dev->gc_buckets[prioritisedBucket])) {
+			/* None found, so we can clear this */
 			dev->has_pending_prioritised_gc = 0;
+		} else {
+			selected = yaffs_gc_index_find(dev, prioritisedBucket);
+			if (selected)
+				prioritised = 1;
+
+			/*
+			 * If there is a prioritised block and none was selected then
+			 * this happened because there is at least one old dirty block gumming
+			 * up the works. Let's gc the oldest dirty block.
+			 */
+			else if (dev->oldest_dirty_block > 0)
+				selected = dev->oldest_dirty_block;
+		}
 	}
 
-	/* If we're doing aggressive GC then we are happy to take a less-dirty block, and
-	 * search harder.
+	/* If we're doing aggressive GC then we are happy to take a less-dirty block.
 	 * else (we're doing a leasurely gc), then we only bother to do this if the
 	 * block has only a few pages in use.
 	 */
 
 	if (!selected){
-		int pagesUsed;
-		int nBlocks = dev->internal_end_block - dev->internal_start_block + 1;
 		if (aggressive){
 			threshold = dev->param.chunks_per_block;
-			iterations = nBlocks;
 		} else {
 			int maxThreshold;
 
@@ -2448,36 +2549,19 @@ static unsigned yaffs_find_gc_block(yaffs_dev_t *dev,
 				threshold = YAFFS_GC_PASSIVE_THRESHOLD;
 			if(threshold > maxThreshold)
 				threshold = maxThreshold;
-
-			iterations = nBlocks / 16 + 1;
-			if (iterations > 100)
-				iterations = 100;
 		}
 
-		for (i = 0;
-			i < iterations &&
-			(dev->gc_dirtiest < 1 ||
-				dev->gc_pages_in_use > YAFFS_GC_GOOD_ENOUGH);
-			i++) {
-			dev->gc_block_finder++;
-			if (dev->gc_block_finder < dev->internal_start_block ||
-				dev->gc_block_finder > dev->internal_end_block)
-				dev->gc_block_finder = dev->internal_start_block;
-
-			bi = yaffs_get_block_info(dev, dev->gc_block_finder);
-
-			pagesUsed = bi->pages_in_use - bi->soft_del_pages;
-
-			if (bi->block_state == YAFFS_BLOCK_STATE_FULL &&
-				pagesUsed < dev->param.chunks_per_block &&
-				(dev->gc_dirtiest < 1 || pagesUsed < dev->gc_pages_in_use) &&
-				yaffs_block_ok_for_gc(dev, bi)) {
-				dev->gc_dirtiest = dev->gc_block_finder;
-				dev->gc_pages_in_use = pagesUsed;
-			}
+		/* Blocks without any free page are never worth collecting */
+		if (threshold >= dev->param.chunks_per_block)
+			threshold = dev->param.chunks_per_block - 1;
+
+		dev->gc_dirtiest = 0;
+		for (i = 0; i <= threshold && !dev->gc_dirtiest; i++) {
+			dev->gc_dirtiest = yaffs_gc_index_find(dev, i);
+			dev->gc_pages_in_use = i;
 		}
 
-		if(dev->gc_dirtiest > 0 && dev->gc_pages_in_use <= threshold)
+		if(dev->gc_dirtiest > 0)
 			selected = dev->gc_dirtiest;
 	}
 
@@ -2518,8 +2602,8 @@ static unsigned yaffs_find_gc_block(yaffs_dev_t *dev,
 	} else{
 		dev->gc_not_done++;
 		T(YAFFS_TRACE_GC,
-		  (TSTR("GC none: finder %d skip %d threshold %d dirtiest %d using %d oldest %d%s" TENDSTR),
-		  dev->gc_block_finder, dev->gc_not_done,
+		  (TSTR("GC none: skip %d threshold %d dirtiest %d using %d oldest %d%s" TENDSTR),
+		  dev->gc_not_done,
 		  threshold,
 		  dev->gc_dirtiest, dev->gc_pages_in_use,
 		  dev->oldest_dirty_block,
@@ -2529,6 +2613,19 @@ static unsigned yaffs_find_gc_block(yaffs_dev_t *dev,
 	return selected;
 }
 
+/* Foreground gc passes stall the writer, keep a histogram of their duration */
+static void yaffs_gc_account(yaffs_dev_t *dev, __u32 us)
+{
+	int i;
+
+	for (i = 0; i < YAFFS_GC_LATENCY_BUCKETS - 1 && us >= (64U << i); i++)
+		;
+	dev->gc_latency[i]++;
+
+	if (us > dev->gc_latency_max)
+		dev->gc_latency_max = us;
+}
+
 /* New garbage collector
  * If we're very low on erased blocks then we do aggressive garbage collection
  * otherwise we do "leasurely" garbage collection.
@@ -2546,6 +2643,7 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 	int minErased;
 	int erasedChunks;
 	int checkpointBlockAdjust;
+	__u32 gcStart;
 
 	if(dev->param.gc_control &&
 		(dev->param.gc_control(dev) & 1) == 0)
@@ -2589,6 +2687,8 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 
 		dev->gc_skip = 5;
 
+		gcStart = Y_CLOCK_US();
+
                 /* If we don't already have a block being gc'd then see if we should start another */
 
 		if (dev->gc_block < 1 && !aggressive) {
@@ -2615,6 +2715,9 @@ static int yaffs_check_gc(yaffs_dev_t *dev, int background)
 			gcOk = yaffs_gc_block(dev, dev->gc_block, aggressive);
 		}
 
+		if (!background)
+			yaffs_gc_account(dev, Y_CLOCK_US() - gcStart);
+
 		if (dev->n_erased_blocks < (dev->param.n_reserved_blocks) && dev->gc_block > 0) {
 			T(YAFFS_TRACE_GC,
 			  (TSTR
@@ -2918,6 +3021,7 @@ void yaffs_chunk_del(yaffs_dev_t *dev, int chunk_id, int mark_flash, int lyn)
 		yaffs_clear_chunk_bit(dev, block, page);
 
 		bi->pages_in_use--;
+		yaffs_gc_index_update(dev, bi);
 
 		if (bi->pages_in_use == 0 &&
 		    !bi->has_shrink_hdr &&
@@ -3176,10 +3280,40 @@ int yaffs_update_oh(yaffs_obj_t *in, const YCHAR *name, int force,
  *   In Linux, the page cache provides read buffering aand the short op cache provides write
  *   buffering.
  *
- *   There are a limited number (~10) of cache chunks per device so that we don't
- *   need a very intelligent search.
+ *   Cache entries are found through a small hash table keyed on object id and
+ *   chunk id and are recycled in LRU order, so the number of cache chunks can
+ *   be raised well beyond the old ~10 without slowing down every access.
  */
 
+static struct ylist_head *yaffs_cache_bucket(yaffs_dev_t *dev,
+					const yaffs_obj_t *obj, int chunk_id)
+{
+	return &dev->cache_hash[(obj->obj_id * 31 + chunk_id) &
+				dev->cache_hash_mask];
+}
+
+/* Attach a cache entry to a chunk of an object */
+static void yaffs_set_chunk_cache(yaffs_dev_t *dev, yaffs_cache_t *cache,
+				yaffs_obj_t *obj, int chunk_id)
+{
+	ylist_del_init(&cache->hash_link);
+	cache->object = obj;
+	cache->chunk_id = chunk_id;
+	cache->dirty = 0;
+	cache->locked = 0;
+	ylist_add(&cache->hash_link, yaffs_cache_bucket(dev, obj, chunk_id));
+}
+
+/* Free up a cache entry and make it the first candidate for reuse */
+static void yaffs_release_chunk_cache(yaffs_dev_t *dev, yaffs_cache_t *cache)
+{
+	cache->object = NULL;
+	cache->dirty = 0;
+	ylist_del_init(&cache->hash_link);
+	ylist_del(&cache->lru_link);
+	ylist_add_tail(&cache->lru_link, &dev->cache_lru);
+}
+
 static int yaffs_obj_cache_dirty(yaffs_obj_t *obj)
 {
 	yaffs_dev_t *dev = obj->my_dev;
@@ -3197,56 +3331,61 @@ static int yaffs_obj_cache_dirty(yaffs_obj_t *obj)
 	return 0;
 }
 
+static int yaffs_cache_chunk_cmp(const void *a, const void *b)
+{
+	const yaffs_cache_t *ca = *(const yaffs_cache_t **)a;
+	const yaffs_cache_t *cb = *(const yaffs_cache_t **)b;
+
+	return ca->chunk_id - cb->chunk_id;
+}
 
 static void yaffs_flush_file_cache(yaffs_obj_t *obj)
 {
 	yaffs_dev_t *dev = obj->my_dev;
-	int lowest = -99;	/* Stop compiler whining. */
 	int i;
+	int n = 0;
 	yaffs_cache_t *cache;
-	int chunkWritten = 0;
+	int chunkWritten;
 	int nCaches = obj->my_dev->param.n_caches;
 
-	if (nCaches > 0) {
-		do {
-			cache = NULL;
-
-			/* Find the dirty cache for this object with the lowest chunk id. */
-			for (i = 0; i < nCaches; i++) {
-				if (dev->cache[i].object == obj &&
-				    dev->cache[i].dirty) {
-					if (!cache
-					    || dev->cache[i].chunk_id <
-					    lowest) {
-						cache = &dev->cache[i];
-						lowest = cache->chunk_id;
-					}
-				}
-			}
+	if (nCaches < 1)
+		return;
 
-			if (cache && !cache->locked) {
-				/* Write it out and free it up */
+	/* Collect the dirty caches for this object and write them out in
+	 * chunk id order.
+	 */
+	for (i = 0; i < nCaches; i++) {
+		if (dev->cache[i].object == obj &&
+		    dev->cache[i].dirty)
+			dev->cache_flush[n++] = &dev->cache[i];
+	}
 
-				chunkWritten =
-				    yaffs_wr_data_obj(cache->object,
-								 cache->chunk_id,
-								 cache->data,
-								 cache->n_bytes,
-								 1);
-				cache->dirty = 0;
-				cache->object = NULL;
-			}
+	if (n > 1)
+		yaffs_qsort(dev->cache_flush, n, sizeof(yaffs_cache_t *),
+				yaffs_cache_chunk_cmp);
 
-		} while (cache && chunkWritten > 0);
+	for (i = 0; i < n; i++) {
+		cache = dev->cache_flush[i];
+		if (cache->locked)
+			break;
 
-		if (cache) {
-			/* Hoosterman, disk full while writing cache out. */
-			T(YAFFS_TRACE_ERROR,
-			  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
+		/* Write it out and free it up */
+		chunkWritten = yaffs_wr_data_obj(cache->object,
+						cache->chunk_id,
+						cache->data,
+						cache->n_bytes,
+						1);
+		yaffs_release_chunk_cache(dev, cache);
 
-		}
+		if (chunkWritten <= 0)
+			break;
 	}
 
+	if (i < n) {
+		/* Hoosterman, disk full while writing cache out. */
+		T(YAFFS_TRACE_ERROR,
+		  (TSTR("yaffs tragedy: no space during cache write" TENDSTR)));
+	}
 }
 
 /*yaffs_flush_whole_cache(dev)
@@ -3256,44 +3395,35 @@ static void yaffs_flush_file_cache(yaffs_obj_t *obj)
 
 void yaffs_flush_whole_cache(yaffs_dev_t *dev)
 {
-	yaffs_obj_t *obj;
 	int nCaches = dev->param.n_caches;
 	int i;
 
-	/* Find a dirty object in the cache and flush it...
-	 * until there are no further dirty objects.
+	/* Flushing an object writes out all of its dirty caches, so one
+	 * pass over the caches is enough.
 	 */
-	do {
-		obj = NULL;
-		for (i = 0; i < nCaches && !obj; i++) {
-			if (dev->cache[i].object &&
-			    dev->cache[i].dirty)
-				obj = dev->cache[i].object;
-
-		}
-		if (obj)
-			yaffs_flush_file_cache(obj);
-
-	} while (obj);
-
+	for (i = 0; i < nCaches; i++) {
+		if (dev->cache[i].object &&
+		    dev->cache[i].dirty)
+			yaffs_flush_file_cache(dev->cache[i].object);
+	}
 }
 
 
 /* Grab us a cache chunk for use.
- * First look for an empty one.
- * Then look for the least recently used non-dirty one.
- * Then look for the least recently used dirty one...., flush and look again.
+ * Free entries are kept at the tail of the LRU list, so look there first.
+ * Then take the least recently used unlocked one, flushing its object if
+ * it is dirty.
  */
 static yaffs_cache_t *yaffs_grab_chunk_worker(yaffs_dev_t *dev)
 {
-	int i;
+	yaffs_cache_t *cache;
 
-	if (dev->param.n_caches > 0) {
-		for (i = 0; i < dev->param.n_caches; i++) {
-			if (!dev->cache[i].object)
-				return &dev->cache[i];
-		}
-	}
+	if (ylist_empty(&dev->cache_lru))
+		return NULL;
+
+	cache = ylist_entry(dev->cache_lru.prev, yaffs_cache_t, lru_link);
+	if (!cache->object)
+		return cache;
 
 	return NULL;
 }
@@ -3301,44 +3431,28 @@ static yaffs_cache_t *yaffs_grab_chunk_worker(yaffs_dev_t *dev)
 static yaffs_cache_t *yaffs_grab_chunk_cache(yaffs_dev_t *dev)
 {
 	yaffs_cache_t *cache;
-	yaffs_obj_t *theObj;
-	int usage;
-	int i;
-	int pushout;
+	struct ylist_head *lh;
 
 	if (dev->param.n_caches > 0) {
-		/* Try find a non-dirty one... */
+		/* Try find a free one... */
 
 		cache = yaffs_grab_chunk_worker(dev);
 
 		if (!cache) {
-			/* They were all dirty, find the last recently used object and flush
-			 * its cache, then  find again.
-			 * NB what's here is not very accurate, we actually flush the object
-			 * the last recently used page.
+			/* None free, find the least recently used entry.
+			 * With locking we can't assume we can use the tail.
 			 */
-
-			/* With locking we can't assume we can use entry zero */
-
-			theObj = NULL;
-			usage = -1;
-			cache = NULL;
-			pushout = -1;
-
-			for (i = 0; i < dev->param.n_caches; i++) {
-				if (dev->cache[i].object &&
-				    !dev->cache[i].locked &&
-				    (dev->cache[i].last_use < usage || !cache)) {
-					usage = dev->cache[i].last_use;
-					theObj = dev->cache[i].object;
-					cache = &dev->cache[i];
-					pushout = i;
-				}
+			for (lh = dev->cache_lru.prev; lh != &dev->cache_lru;
+			     lh = lh->prev) {
+				cache = ylist_entry(lh, yaffs_cache_t, lru_link);
+				if (!cache->locked)
+					break;
+				cache = NULL;
 			}
 
-			if (!cache || cache->dirty) {
+			if (cache && cache->dirty) {
 				/* Flush and try again */
-				yaffs_flush_file_cache(theObj);
+				yaffs_flush_file_cache(cache->object);
 				cache = yaffs_grab_chunk_worker(dev);
 			}
 
@@ -3349,43 +3463,54 @@ static yaffs_cache_t *yaffs_grab_chunk_cache(yaffs_dev_t *dev)
 
 }
 
-/* Find a cached chunk */
-static yaffs_cache_t *yaffs_find_chunk_cache(const yaffs_obj_t *obj,
-					      int chunk_id)
+/* Look up a cached chunk */
+static yaffs_cache_t *yaffs_lookup_chunk_cache(const yaffs_obj_t *obj,
+						int chunk_id)
 {
 	yaffs_dev_t *dev = obj->my_dev;
-	int i;
-	if (dev->param.n_caches > 0) {
-		for (i = 0; i < dev->param.n_caches; i++) {
-			if (dev->cache[i].object == obj &&
-			    dev->cache[i].chunk_id == chunk_id) {
-				dev->cache_hits++;
+	struct ylist_head *bucket;
+	struct ylist_head *lh;
+	yaffs_cache_t *cache;
 
-				return &dev->cache[i];
-			}
+	if (dev->param.n_caches > 0) {
+		bucket = yaffs_cache_bucket(dev, obj, chunk_id);
+		ylist_for_each(lh, bucket) {
+			cache = ylist_entry(lh, yaffs_cache_t, hash_link);
+			if (cache->object == obj &&
+			    cache->chunk_id == chunk_id)
+				return cache;
 		}
 	}
 	return NULL;
 }
 
-/* Mark the chunk for the least recently used algorithym */
-static void yaffs_use_cache(yaffs_dev_t *dev, yaffs_cache_t *cache,
-				int isAWrite)
+/* Find a cached chunk for a read or write, keeping the hit statistics */
+static yaffs_cache_t *yaffs_find_chunk_cache(const yaffs_obj_t *obj,
+					      int chunk_id)
 {
+	yaffs_dev_t *dev = obj->my_dev;
+	yaffs_cache_t *cache;
 
-	if (dev->param.n_caches > 0) {
-		if (dev->cache_last_use < 0 || dev->cache_last_use > 100000000) {
-			/* Reset the cache usages */
-			int i;
-			for (i = 1; i < dev->param.n_caches; i++)
-				dev->cache[i].last_use = 0;
+	if (dev->param.n_caches < 1)
+		return NULL;
 
-			dev->cache_last_use = 0;
-		}
+	cache = yaffs_lookup_chunk_cache(obj, chunk_id);
+	if (cache)
+		dev->cache_hits++;
+	else
+		dev->cache_misses++;
 
-		dev->cache_last_use++;
+	return cache;
+}
 
-		cache->last_use = dev->cache_last_use;
+/* Mark the chunk as the most recently used */
+static void yaffs_use_cache(yaffs_dev_t *dev, yaffs_cache_t *cache,
+				int isAWrite)
+{
+
+	if (dev->param.n_caches > 0) {
+		ylist_del(&cache->lru_link);
+		ylist_add(&cache->lru_link, &dev->cache_lru);
 
 		if (isAWrite)
 			cache->dirty = 1;
@@ -3398,11 +3523,13 @@ static void yaffs_use_cache(yaffs_dev_t *dev, yaffs_cache_t *cache,
  */
 static void yaffs_invalidate_chunk_cache(yaffs_obj_t *object, int chunk_id)
 {
-	if (object->my_dev->param.n_caches > 0) {
-		yaffs_cache_t *cache = yaffs_find_chunk_cache(object, chunk_id);
+	yaffs_dev_t *dev = object->my_dev;
+
+	if (dev->param.n_caches > 0) {
+		yaffs_cache_t *cache = yaffs_lookup_chunk_cache(object, chunk_id);
 
 		if (cache)
-			cache->object = NULL;
+			yaffs_release_chunk_cache(dev, cache);
 	}
 }
 
@@ -3418,7 +3545,7 @@ static void yaffs_invalidate_whole_cache(yaffs_obj_t *in)
 		/* Invalidate it. */
 		for (i = 0; i < dev->param.n_caches; i++) {
 			if (dev->cache[i].object == in)
-				dev->cache[i].object = NULL;
+				yaffs_release_chunk_cache(dev, &dev->cache[i]);
 		}
 	}
 }
@@ -3476,10 +3603,7 @@ int yaffs_file_rd(yaffs_obj_t *in, __u8 *buffer, loff_t offset,
 
 				if (!cache) {
 					cache = yaffs_grab_chunk_cache(in->my_dev);
-					cache->object = in;
-					cache->chunk_id = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_set_chunk_cache(dev, cache, in, chunk);
 					yaffs_rd_data_obj(in, chunk,
 								      cache->
 								      data);
@@ -3603,10 +3727,7 @@ int yaffs_do_file_wr(yaffs_obj_t *in, const __u8 *buffer, loff_t offset,
 				if (!cache
 				    && yaffs_check_alloc_available(dev, 1)) {
 					cache = yaffs_grab_chunk_cache(dev);
-					cache->object = in;
-					cache->chunk_id = chunk;
-					cache->dirty = 0;
-					cache->locked = 0;
+					yaffs_set_chunk_cache(dev, cache, in, chunk);
 					yaffs_rd_data_obj(in, chunk,
 								      cache->data);
 				} else if (cache &&
@@ -5117,6 +5238,7 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 {
 	int init_failed = 0;
 	unsigned x;
+	__u32 start;
 	int bits;
 
 	T(YAFFS_TRACE_TRACING, (TSTR("yaffs: yaffs_guts_initialise()" TENDSTR)));
@@ -5270,7 +5392,6 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 	dev->passive_gc_count = 0;
 	dev->oldest_dirty_gc_count = 0;
 	dev->bg_gcs = 0;
-	dev->gc_block_finder = 0;
 	dev->buffered_block = -1;
 	dev->doing_buffered_block_rewrite = 0;
 	dev->n_deleted_files = 0;
@@ -5293,6 +5414,8 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 		init_failed = 1;
 
 	dev->cache = NULL;
+	dev->cache_hash = NULL;
+	dev->cache_flush = NULL;
 	dev->gc_cleanup_list = NULL;
 
 
@@ -5300,31 +5423,53 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 	    dev->param.n_caches > 0) {
 		int i;
 		void *buf;
-		int cacheBytes = dev->param.n_caches * sizeof(yaffs_cache_t);
+		int cacheBytes;
+		unsigned nBuckets;
 
 		if (dev->param.n_caches > YAFFS_MAX_SHORT_OP_CACHES)
 			dev->param.n_caches = YAFFS_MAX_SHORT_OP_CACHES;
 
-		dev->cache =  YMALLOC(cacheBytes);
+		cacheBytes = dev->param.n_caches * sizeof(yaffs_cache_t);
 
-		buf = (__u8 *) dev->cache;
+		/* Power of two number of buckets, about one per cache */
+		for (nBuckets = 1; nBuckets < dev->param.n_caches; nBuckets <<= 1)
+			;
+
+		dev->cache =  YMALLOC(cacheBytes);
+		dev->cache_hash = YMALLOC(nBuckets * sizeof(struct ylist_head));
+		dev->cache_flush = YMALLOC(dev->param.n_caches * sizeof(yaffs_cache_t *));
 
 		if (dev->cache)
 			memset(dev->cache, 0, cacheBytes);
 
+		buf = NULL;
+		if (dev->cache && dev->cache_hash && dev->cache_flush) {
+			buf = (__u8 *) dev->cache;
+			dev->cache_hash_mask = nBuckets - 1;
+			for (i = 0; i < nBuckets; i++)
+				YINIT_LIST_HEAD(&dev->cache_hash[i]);
+			YINIT_LIST_HEAD(&dev->cache_lru);
+		}
+
 		for (i = 0; i < dev->param.n_caches && buf; i++) {
 			dev->cache[i].object = NULL;
-			dev->cache[i].last_use = 0;
 			dev->cache[i].dirty = 0;
+			YINIT_LIST_HEAD(&dev->cache[i].hash_link);
+			ylist_add_tail(&dev->cache[i].lru_link, &dev->cache_lru);
 			dev->cache[i].data = buf = YMALLOC_DMA(dev->param.total_bytes_per_chunk);
 		}
 		if (!buf)
 			init_failed = 1;
-
-		dev->cache_last_use = 0;
 	}
 
 	dev->cache_hits = 0;
+	dev->cache_misses = 0;
+	memset(dev->gc_latency, 0, sizeof(dev->gc_latency));
+	dev->gc_latency_max = 0;
+	dev->mount_query_us = 0;
+	dev->mount_sort_us = 0;
+	dev->mount_scan_us = 0;
+	dev->mount_fixup_us = 0;
 
 	if (!init_failed) {
 		dev->gc_cleanup_list = YMALLOC(dev->param.chunks_per_block * sizeof(__u32));
@@ -5379,13 +5524,29 @@ int yaffs_guts_initialise(yaffs_dev_t *dev)
 				if (!init_failed && !yaffs2_scan_backwards(dev))
 					init_failed = 1;
 			}
-		} else if (!yaffs1_scan(dev))
+		} else {
+			start = Y_CLOCK_US();
+			if (!yaffs1_scan(dev))
 				init_failed = 1;
+			dev->mount_scan_us = Y_CLOCK_US() - start;
+		}
 
+		start = Y_CLOCK_US();
 		yaffs_strip_deleted_objs(dev);
 		yaffs_fix_hanging_objs(dev);
 		if(dev->param.empty_lost_n_found)
 			yaffs_empty_l_n_f(dev);
+		yaffs_gc_index_rebuild(dev);
+		dev->mount_fixup_us += Y_CLOCK_US() - start;
+
+		if (!init_failed && !dev->is_checkpointed)
+			T(YAFFS_TRACE_ALWAYS,
+			  (TSTR("yaffs: scanned in %u ms (query %u sort %u scan %u fixup %u us)"
+			  TENDSTR),
+			  (dev->mount_query_us + dev->mount_sort_us +
+			   dev->mount_scan_us + dev->mount_fixup_us) / 1000,
+			  dev->mount_query_us, dev->mount_sort_us,
+			  dev->mount_scan_us, dev->mount_fixup_us));
 	}
 
 	if (init_failed) {
@@ -5439,6 +5600,13 @@ void yaffs_deinitialise(yaffs_dev_t *dev)
 			dev->cache = NULL;
 		}
 
+		if (dev->cache_hash)
+			YFREE(dev->cache_hash);
+		dev->cache_hash = NULL;
+		if (dev->cache_flush)
+			YFREE(dev->cache_flush);
+		dev->cache_flush = NULL;
+
 		YFREE(dev->gc_cleanup_list);
 
 		for (i = 0; i < YAFFS_N_TEMP_BUFFERS; i++)
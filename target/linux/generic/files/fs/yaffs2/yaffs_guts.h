@@ -88,10 +88,13 @@
 #define YAFFS_SEQUENCE_CHECKPOINT_DATA  0x21
 
 
-#define YAFFS_MAX_SHORT_OP_CACHES	20
+#define YAFFS_MAX_SHORT_OP_CACHES	1024
 
 #define YAFFS_N_TEMP_BUFFERS		6
 
+/* Foreground gc latency histogram, bucket n counts passes below 64us << n */
+#define YAFFS_GC_LATENCY_BUCKETS	12
+
 /* We limit the number attempts at sucessfully saving a chunk of data.
  * Small-page devices have 32 pages per block; large-page devices have 64.
  * Default to something in the order of 5 to 10 blocks worth of chunks.
@@ -111,11 +114,15 @@
 /* Special sequence number for bad block that failed to be marked bad */
 #define YAFFS_SEQUENCE_BAD_BLOCK	0xFFFF0000
 
-/* ChunkCache is used for short read/write operations.*/
+/* ChunkCache is used for short read/write operations.
+ * Entries are hashed on object and chunk id for lookup and kept on an LRU
+ * list, most recently used first. Unused entries sit at the tail.
+ */
 typedef struct {
+	struct ylist_head hash_link;
+	struct ylist_head lru_link;
 	struct yaffs_obj_s *object;
 	int chunk_id;
-	int last_use;
 	int dirty;
 	int n_bytes;		/* Only valid if the cache is dirty */
 	int locked;		/* Can't push out or flush while locked. */
@@ -274,6 +281,14 @@ typedef enum {
 
 #define	YAFFS_NUMBER_OF_BLOCK_STATES (YAFFS_BLOCK_STATE_DEAD + 1)
 
+/* Per block entry of the gc victim index. Kept out of yaffs_block_info_t
+ * because that gets written to the checkpoint as it is.
+ */
+typedef struct {
+	struct ylist_head list;
+	int bucket;		/* Bucket this block is filed in, -1 if none */
+} yaffs_gc_entry_t;
+
 
 typedef struct {
 
@@ -534,8 +549,8 @@ struct yaffs_param_s {
 
 
 	int n_caches;	/* If <= 0, then short op caching is disabled, else
-				 * the number of short op caches (don't use too many).
-                                 * 10 to 20 is a good bet.
+				 * the number of short op caches, at most
+				 * YAFFS_MAX_SHORT_OP_CACHES.
 				 */
 	int use_nand_ecc;		/* Flag to decide whether or not to use NANDECC on data (yaffs1) */
 	int no_tags_ecc;		/* Flag to decide whether or not to do ECC on packed tags (yaffs2) */ 
@@ -575,6 +590,14 @@ struct yaffs_param_s {
 	int (*bad_block_fn) (struct yaffs_dev_s *dev, int block_no);
 	int (*query_block_fn) (struct yaffs_dev_s *dev, int block_no,
 			       yaffs_block_state_t *state, __u32 *seq_number);
+
+	/* Optional. Reads the tags of n_chunks consecutive chunks in one go,
+	 * the scan uses it to read a whole block ahead. If it fails the tags
+	 * are read one chunk at a time with read_chunk_tags_fn.
+	 */
+	int (*read_tags_batch_fn) (struct yaffs_dev_s *dev,
+				   int nand_chunk, int n_chunks,
+				   yaffs_ext_tags *tags);
 #endif
 
 	/* The remove_obj_fn function must be supplied by OS flavours that
@@ -671,6 +694,7 @@ struct yaffs_dev_s {
 	__u8 *chunk_bits;	/* bitmap of chunks in use */
 	unsigned block_info_alt:1;	/* was allocated using alternative strategy */
 	unsigned chunk_bits_alt:1;	/* was allocated using alternative strategy */
+	unsigned gc_entries_alt:1;	/* was allocated using alternative strategy */
 	int chunk_bit_stride;	/* Number of bytes of chunk_bits per block.
 				 * Must be consistent with chunks_per_block.
 				 */
@@ -698,7 +722,8 @@ struct yaffs_dev_s {
 
 	unsigned has_pending_prioritised_gc; /* We think this device might have pending prioritised gcs */
 	unsigned gc_disable;
-	unsigned gc_block_finder;
+	yaffs_gc_entry_t *gc_entries;	/* Full blocks by number of live pages */
+	struct ylist_head *gc_buckets;	/* chunks_per_block + 1 buckets, then prioritised */
 	unsigned gc_dirtiest;
 	unsigned gc_pages_in_use;
 	unsigned gc_not_done;
@@ -719,7 +744,10 @@ struct yaffs_dev_s {
 	int doing_buffered_block_rewrite;
 
 	yaffs_cache_t *cache;
-	int cache_last_use;
+	struct ylist_head *cache_hash;	/* Cache lookup buckets */
+	unsigned cache_hash_mask;
+	struct ylist_head cache_lru;	/* Caches, most recently used first */
+	yaffs_cache_t **cache_flush;	/* Scratch array for ordered flushing */
 
 	/* Stuff for background deletion and unlinked files.*/
 	yaffs_obj_t *unlinked_dir;	/* Directory where unlinked and deleted files live. */
@@ -769,6 +797,15 @@ struct yaffs_dev_s {
 	__u32 n_unmarked_deletions;
 	__u32 refresh_count;
 	__u32 cache_hits;
+	__u32 cache_misses;
+	__u32 gc_latency[YAFFS_GC_LATENCY_BUCKETS];
+	__u32 gc_latency_max;
+
+	/* Where the time went in the last mount, in microseconds */
+	__u32 mount_query_us;
+	__u32 mount_sort_us;
+	__u32 mount_scan_us;
+	__u32 mount_fixup_us;
 
 };
 
@@ -925,6 +962,7 @@ void yaffs_guts_test(yaffs_dev_t *dev);
 void yaffs_chunk_del(yaffs_dev_t *dev, int chunk_id, int mark_flash, int lyn);
 int yaffs_check_ff(__u8 *buffer, int n_bytes);
 void yaffs_handle_chunk_error(yaffs_dev_t *dev, yaffs_block_info_t *bi);
+void yaffs_gc_index_update(yaffs_dev_t *dev, yaffs_block_info_t *bi);
 
 __u8 *yaffs_get_temp_buffer(yaffs_dev_t *dev, int line_no);
 void yaffs_release_temp_buffer(yaffs_dev_t *dev, __u8 *buffer, int line_no);
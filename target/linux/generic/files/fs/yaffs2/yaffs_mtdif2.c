@@ -255,3 +255,60 @@ int nandmtd2_QueryNANDBlock(struct yaffs_dev_s *dev, int block_no,
 		return YAFFS_FAIL;
 }
 
+/* Read only the tags of a run of chunks, with a single OOB read */
+int nandmtd2_ReadTagsBatchFromNAND(yaffs_dev_t *dev, int nand_chunk,
+				   int n_chunks, yaffs_ext_tags *tags)
+{
+#if (MTD_VERSION_CODE > MTD_VERSION(2, 6, 17))
+	struct mtd_info *mtd = yaffs_dev_to_mtd(dev);
+	struct mtd_oob_ops ops;
+	int retval;
+	int i;
+	__u8 *oob;
+
+	loff_t addr = ((loff_t) nand_chunk) * dev->param.total_bytes_per_chunk;
+
+	yaffs_PackedTags2 pt;
+
+	int packed_tags_size = dev->param.no_tags_ecc ? sizeof(pt.t) : sizeof(pt);
+	void * packed_tags_ptr = dev->param.no_tags_ecc ? (void *) &pt.t: (void *)&pt;
+
+	T(YAFFS_TRACE_MTD,
+	  (TSTR
+	   ("nandmtd2_ReadTagsBatchFromNAND chunk %d count %d"
+	    TENDSTR), nand_chunk, n_chunks));
+
+	if (dev->param.inband_tags || mtd->oobavail < packed_tags_size)
+		return YAFFS_FAIL;
+
+	oob = YMALLOC(n_chunks * mtd->oobavail);
+	if (!oob)
+		return YAFFS_FAIL;
+
+	/* In auto mode the free bytes of each page follow each other */
+	ops.mode = MTD_OOB_AUTO;
+	ops.ooblen = n_chunks * mtd->oobavail;
+	ops.len = 0;
+	ops.ooboffs = 0;
+	ops.datbuf = NULL;
+	ops.oobbuf = oob;
+	retval = mtd->read_oob(mtd, addr, &ops);
+
+	if (retval == 0 && ops.oobretlen == ops.ooblen) {
+		for (i = 0; i < n_chunks; i++) {
+			memcpy(packed_tags_ptr, oob + i * mtd->oobavail, packed_tags_size);
+			yaffs_unpack_tags2(&tags[i], &pt, !dev->param.no_tags_ecc);
+		}
+	} else
+		retval = -EIO;
+
+	YFREE(oob);
+
+	if (retval == 0)
+		return YAFFS_OK;
+	else
+		return YAFFS_FAIL;
+#else
+	return YAFFS_FAIL;
+#endif
+}
@@ -22,6 +22,8 @@ int nandmtd2_WriteChunkWithTagsToNAND(yaffs_dev_t *dev, int nand_chunk,
 				const yaffs_ext_tags *tags);
 int nandmtd2_ReadChunkWithTagsFromNAND(yaffs_dev_t *dev, int nand_chunk,
 				__u8 *data, yaffs_ext_tags *tags);
+int nandmtd2_ReadTagsBatchFromNAND(yaffs_dev_t *dev, int nand_chunk,
+				int n_chunks, yaffs_ext_tags *tags);
 int nandmtd2_MarkNANDBlockBad(struct yaffs_dev_s *dev, int block_no);
 int nandmtd2_QueryNANDBlock(struct yaffs_dev_s *dev, int block_no,
 			yaffs_block_state_t *state, __u32 *seq_number);
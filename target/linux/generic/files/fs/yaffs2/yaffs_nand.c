@@ -51,6 +51,45 @@ int yaffs_rd_chunk_tags_nand(yaffs_dev_t *dev, int nand_chunk,
 	return result;
 }
 
+/*
+ * Read the tags of n_chunks consecutive chunks, in a single request if the
+ * driver can do that.
+ */
+int yaffs_rd_tags_batch_nand(yaffs_dev_t *dev, int nand_chunk,
+					int n_chunks,
+					yaffs_ext_tags *tags)
+{
+	int result = YAFFS_FAIL;
+	int i;
+	yaffs_block_info_t *bi;
+
+	if (dev->param.read_tags_batch_fn && !dev->param.inband_tags)
+		result = dev->param.read_tags_batch_fn(dev,
+						nand_chunk - dev->chunk_offset,
+						n_chunks, tags);
+
+	if (result != YAFFS_OK) {
+		result = YAFFS_OK;
+		for (i = 0; i < n_chunks; i++)
+			if (!yaffs_rd_chunk_tags_nand(dev, nand_chunk + i,
+						NULL, &tags[i]))
+				result = YAFFS_FAIL;
+		return result;
+	}
+
+	dev->n_page_reads += n_chunks;
+
+	for (i = 0; i < n_chunks; i++) {
+		if (tags[i].ecc_result > YAFFS_ECC_RESULT_NO_ERROR) {
+			bi = yaffs_get_block_info(dev,
+				(nand_chunk + i) / dev->param.chunks_per_block);
+			yaffs_handle_chunk_error(dev, bi);
+		}
+	}
+
+	return result;
+}
+
 int yaffs_wr_chunk_tags_nand(yaffs_dev_t *dev,
 						   int nand_chunk,
 						   const __u8 *buffer,
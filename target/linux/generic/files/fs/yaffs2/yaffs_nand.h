@@ -23,6 +23,10 @@ int yaffs_rd_chunk_tags_nand(yaffs_dev_t *dev, int nand_chunk,
 					__u8 *buffer,
 					yaffs_ext_tags *tags);
 
+int yaffs_rd_tags_batch_nand(yaffs_dev_t *dev, int nand_chunk,
+					int n_chunks,
+					yaffs_ext_tags *tags);
+
 int yaffs_wr_chunk_tags_nand(yaffs_dev_t *dev,
 						int nand_chunk,
 						const __u8 *buffer,
@@ -20,7 +20,7 @@
 #ifdef __KERNEL__
 #include <linux/sort.h>
 
-extern void yaffs_qsort(void *const base, size_t total_elems, size_t size,
+static inline void yaffs_qsort(void *const base, size_t total_elems, size_t size,
 			int (*cmp)(const void *, const void *)){
 	sort(base, total_elems, size, cmp, NULL);
 }
@@ -163,6 +163,7 @@ static uint32_t YCALCBLOCKS(uint64_t partition_size, uint32_t block_size)
 #include "yportenv.h"
 #include "yaffs_trace.h"
 #include "yaffs_guts.h"
+#include "yaffs_ecc.h"
 
 #include "yaffs_linux.h"
 
@@ -175,6 +176,7 @@ unsigned int yaffs_wr_attempts = YAFFS_WR_ATTEMPTS;
 unsigned int yaffs_auto_checkpoint = 1;
 unsigned int yaffs_gc_control = 1;
 unsigned int yaffs_bg_enable = 1;
+unsigned int yaffs_n_caches = 10;
 
 /* Module Parameters */
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 5, 0))
@@ -183,11 +185,13 @@ module_param(yaffs_wr_attempts, uint, 0644);
 module_param(yaffs_auto_checkpoint, uint, 0644);
 module_param(yaffs_gc_control, uint, 0644);
 module_param(yaffs_bg_enable, uint, 0644);
+module_param(yaffs_n_caches, uint, 0644);
 #else
 MODULE_PARM(yaffs_trace_mask, "i");
 MODULE_PARM(yaffs_wr_attempts, "i");
 MODULE_PARM(yaffs_auto_checkpoint, "i");
 MODULE_PARM(yaffs_gc_control, "i");
+MODULE_PARM(yaffs_n_caches, "i");
 #endif
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 25))
@@ -2606,6 +2610,8 @@ typedef struct {
 	int skip_checkpoint_read;
 	int skip_checkpoint_write;
 	int no_cache;
+	int n_caches;
+	int n_caches_overridden;
 	int tags_ecc_on;
 	int tags_ecc_overridden;
 	int lazy_loading_enabled;
@@ -2660,6 +2666,10 @@ static int yaffs_parse_options(yaffs_options *options, const char *options_str)
 			options->empty_lost_and_found_overridden=1;
 		} else if (!strcmp(cur_opt, "no-cache"))
 			options->no_cache = 1;
+		else if (!strncmp(cur_opt, "cache=", 6)) {
+			options->n_caches = simple_strtoul(cur_opt + 6, NULL, 0);
+			options->n_caches_overridden = 1;
+		}
 		else if (!strcmp(cur_opt, "no-checkpoint-read"))
 			options->skip_checkpoint_read = 1;
 		else if (!strcmp(cur_opt, "no-checkpoint-write"))
@@ -2916,7 +2926,9 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	param->chunks_per_block = YAFFS_CHUNKS_PER_BLOCK;
 	param->total_bytes_per_chunk = YAFFS_BYTES_PER_CHUNK;
 	param->n_reserved_blocks = 5;
-	param->n_caches = (options.no_cache) ? 0 : 10;
+	param->n_caches = (options.no_cache) ? 0 : yaffs_n_caches;
+	if (options.n_caches_overridden && !options.no_cache)
+		param->n_caches = options.n_caches;
 	param->inband_tags = options.inband_tags;
 
 #ifdef CONFIG_YAFFS_DISABLE_LAZY_LOAD
@@ -2965,6 +2977,7 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 		    nandmtd2_ReadChunkWithTagsFromNAND;
 		param->bad_block_fn = nandmtd2_MarkNANDBlockBad;
 		param->query_block_fn = nandmtd2_QueryNANDBlock;
+		param->read_tags_batch_fn = nandmtd2_ReadTagsBatchFromNAND;
 		yaffs_dev_to_lc(dev)->spareBuffer = YMALLOC(mtd->oobsize);
 		param->is_yaffs2 = 1;
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(2, 6, 17))
@@ -3207,6 +3220,27 @@ static char *yaffs_dump_dev_part0(char *buf, yaffs_dev_t * dev)
 }
 
 
+static char *yaffs_dump_gc_latency(char *buf, yaffs_dev_t *dev)
+{
+	char name[22];
+	int i;
+	int n;
+
+	for (i = 0; i < YAFFS_GC_LATENCY_BUCKETS; i++) {
+		if (i < YAFFS_GC_LATENCY_BUCKETS - 1)
+			n = sprintf(name, "gc_latency_<%uus", 64U << i);
+		else
+			n = sprintf(name, "gc_latency_>=%uus", 64U << (i - 1));
+		while (n < 21)
+			name[n++] = '.';
+		name[n] = 0;
+		buf += sprintf(buf, "%s %u\n", name, dev->gc_latency[i]);
+	}
+	buf += sprintf(buf, "gc_latency_max_us.... %u\n", dev->gc_latency_max);
+
+	return buf;
+}
+
 static char *yaffs_dump_dev_part1(char *buf, yaffs_dev_t * dev)
 {
 	buf += sprintf(buf, "data_bytes_per_chunk. %d\n", dev->data_bytes_per_chunk);
@@ -3235,10 +3269,18 @@ static char *yaffs_dump_dev_part1(char *buf, yaffs_dev_t * dev)
 	buf += sprintf(buf, "n_tags_ecc_fixed..... %u\n", dev->n_tags_ecc_fixed);
 	buf += sprintf(buf, "n_tags_ecc_unfixed... %u\n", dev->n_tags_ecc_unfixed);
 	buf += sprintf(buf, "cache_hits........... %u\n", dev->cache_hits);
+	buf += sprintf(buf, "cache_misses......... %u\n", dev->cache_misses);
 	buf += sprintf(buf, "n_deleted_files...... %u\n", dev->n_deleted_files);
 	buf += sprintf(buf, "n_unlinked_files..... %u\n", dev->n_unlinked_files);
 	buf += sprintf(buf, "refresh_count........ %u\n", dev->refresh_count);
 	buf += sprintf(buf, "n_bg_deletions....... %u\n", dev->n_bg_deletions);
+	buf += sprintf(buf, "\n");
+	buf += sprintf(buf, "mount_query_us....... %u\n", dev->mount_query_us);
+	buf += sprintf(buf, "mount_sort_us........ %u\n", dev->mount_sort_us);
+	buf += sprintf(buf, "mount_scan_us........ %u\n", dev->mount_scan_us);
+	buf += sprintf(buf, "mount_fixup_us....... %u\n", dev->mount_fixup_us);
+	buf += sprintf(buf, "\n");
+	buf = yaffs_dump_gc_latency(buf, dev);
 
 	return buf;
 }
@@ -3491,6 +3533,11 @@ static int __init init_yaffs_fs(void)
 	  (TSTR(" \n\n\n\nYAFFS-WARNING CONFIG_YAFFS_ALWAYS_CHECK_CHUNK_ERASED selected.\n\n\n\n")));
 #endif
 
+#ifdef CONFIG_YAFFS_ECC_SELFTEST
+	if (yaffs_ecc_selftest())
+		return -EIO;
+#endif
+
 
 
 
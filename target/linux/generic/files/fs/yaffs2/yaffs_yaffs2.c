@@ -943,6 +943,10 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 	yaffs_BlockIndex *blockIndex = NULL;
 	int altBlockIndex = 0;
 
+	yaffs_ext_tags *blockTags = NULL;
+	int altBlockTags = 0;
+	__u32 start;
+
 	T(YAFFS_TRACE_SCAN,
 	  (TSTR
 	   ("yaffs2_scan_backwards starts  intstartblk %d intendblk %d..."
@@ -964,10 +968,30 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 		return YAFFS_FAIL;
 	}
 
+	/* The tags of a whole block are read ahead in one go */
+	blockTags = YMALLOC(dev->param.chunks_per_block * sizeof(yaffs_ext_tags));
+
+	if (!blockTags) {
+		blockTags = YMALLOC_ALT(dev->param.chunks_per_block * sizeof(yaffs_ext_tags));
+		altBlockTags = 1;
+	}
+
+	if (!blockTags) {
+		T(YAFFS_TRACE_SCAN,
+		  (TSTR("yaffs2_scan_backwards() could not allocate block tags!" TENDSTR)));
+		if (altBlockIndex)
+			YFREE_ALT(blockIndex);
+		else
+			YFREE(blockIndex);
+		return YAFFS_FAIL;
+	}
+
 	dev->blocks_in_checkpt = 0;
 
 	chunkData = yaffs_get_temp_buffer(dev, __LINE__);
 
+	start = Y_CLOCK_US();
+
 	/* Scan all the blocks to determine their state */
 	bi = dev->block_info;
 	for (blk = dev->internal_start_block; blk <= dev->internal_end_block; blk++) {
@@ -1026,6 +1050,8 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 		bi++;
 	}
 
+	dev->mount_query_us = Y_CLOCK_US() - start;
+
 	T(YAFFS_TRACE_SCAN,
 	(TSTR("%d blocks to be sorted..." TENDSTR), nBlocksToScan));
 
@@ -1033,13 +1059,19 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 	YYIELD();
 
+	start = Y_CLOCK_US();
+
 	/* Sort the blocks by sequence number*/
 	yaffs_qsort(blockIndex, nBlocksToScan, sizeof(yaffs_BlockIndex), yaffs2_ybicmp);
 
+	dev->mount_sort_us = Y_CLOCK_US() - start;
+
 	YYIELD();
 
 	T(YAFFS_TRACE_SCAN, (TSTR("...done" TENDSTR)));
 
+	start = Y_CLOCK_US();
+
 	/* Now scan the blocks looking at the data. */
 	startIterator = 0;
 	endIterator = nBlocksToScan - 1;
@@ -1063,6 +1095,13 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 		deleted = 0;
 
+		if (state == YAFFS_BLOCK_STATE_NEEDS_SCANNING ||
+		    state == YAFFS_BLOCK_STATE_ALLOCATING)
+			yaffs_rd_tags_batch_nand(dev,
+					blk * dev->param.chunks_per_block,
+					dev->param.chunks_per_block,
+					blockTags);
+
 		/* For each chunk in each block that needs scanning.... */
 		foundChunksInBlock = 0;
 		for (c = dev->param.chunks_per_block - 1;
@@ -1075,8 +1114,7 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 
 			chunk = blk * dev->param.chunks_per_block + c;
 
-			result = yaffs_rd_chunk_tags_nand(dev, chunk, NULL,
-							&tags);
+			tags = blockTags[c];
 
 			/* Let's have a good look at this chunk... */
 
@@ -1516,17 +1554,26 @@ int yaffs2_scan_backwards(yaffs_dev_t *dev)
 	
 	yaffs_skip_rest_of_block(dev);
 
+	dev->mount_scan_us = Y_CLOCK_US() - start;
+
 	if (altBlockIndex)
 		YFREE_ALT(blockIndex);
 	else
 		YFREE(blockIndex);
 
+	if (altBlockTags)
+		YFREE_ALT(blockTags);
+	else
+		YFREE(blockTags);
+
 	/* Ok, we've done all the scanning.
 	 * Fix up the hard link chains.
 	 * We should now have scanned all the objects, now it's time to add these
 	 * hardlinks.
 	 */
+	start = Y_CLOCK_US();
 	yaffs_link_fixup(dev, hard_list);
+	dev->mount_fixup_us += Y_CLOCK_US() - start;
 
 
 	yaffs_release_temp_buffer(dev, chunkData, __LINE__);
@@ -45,6 +45,7 @@
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/sched.h>
+#include <linux/ktime.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -87,6 +88,8 @@
 #define Y_TIME_CONVERT(x) (x)
 #endif
 
+#define Y_CLOCK_US() ((__u32) ktime_to_us(ktime_get()))
+
 #define yaffs_sum_cmp(x, y) ((x) == (y))
 #define yaffs_strcmp(a, b) strcmp(a, b)
 
@@ -316,6 +319,10 @@
 
 #endif
 
+#ifndef Y_CLOCK_US
+#define Y_CLOCK_US() 0
+#endif
+
 #ifndef Y_DUMP_STACK
 #define Y_DUMP_STACK() do { } while (0)
 #endif
@@ -52,6 +52,10 @@ enum {
 	SWITCH_ATTR_OP_DESCRIPTION,
 	/* port lists */
 	SWITCH_ATTR_PORT,
+	/* bulk dump */
+	SWITCH_ATTR_DUMP_GROUPS,
+	SWITCH_ATTR_OP_PORT_LAST,
+	SWITCH_ATTR_OP_VLAN_LAST,
 	SWITCH_ATTR_MAX
 };
 
@@ -68,9 +72,15 @@ enum {
 	SWITCH_CMD_SET_PORT,
 	SWITCH_CMD_LIST_VLAN,
 	SWITCH_CMD_GET_VLAN,
-	SWITCH_CMD_SET_VLAN
+	SWITCH_CMD_SET_VLAN,
+	SWITCH_CMD_GET_ALL
 };
 
+/* attribute groups returned by SWITCH_CMD_GET_ALL */
+#define SWITCH_DUMP_GLOBAL	(1 << 0)
+#define SWITCH_DUMP_PORT	(1 << 1)
+#define SWITCH_DUMP_VLAN	(1 << 2)
+
 /* data types */
 enum switch_val_type {
 	SWITCH_TYPE_UNSPEC,
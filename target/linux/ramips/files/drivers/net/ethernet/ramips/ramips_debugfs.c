@@ -90,6 +90,63 @@ static const struct file_operations raeth_fops_int_stats = {
 	.owner	= THIS_MODULE
 };
 
+void raeth_debugfs_update_napi_stats(struct raeth_priv *re, int rx, int tx,
+				     int budget, int oom)
+{
+	struct raeth_napi_stats *stats = &re->debug.napi_stats;
+
+	stats->polls++;
+	stats->rx_packets += rx;
+	stats->tx_packets += tx;
+	stats->rx_oom += oom;
+
+	if (rx > stats->rx_packets_max)
+		stats->rx_packets_max = rx;
+	if (tx > stats->tx_packets_max)
+		stats->tx_packets_max = tx;
+	if (rx >= budget)
+		stats->rx_budget_exhausted++;
+}
+
+static ssize_t read_file_napi_stats(struct file *file, char __user *user_buf,
+				    size_t count, loff_t *ppos)
+{
+#define PR_NAPI_STAT(_label, _val)					\
+	len += snprintf(buf + len, sizeof(buf) - len,			\
+		"%-18s: %10lu\n", _label, _val);
+
+	struct raeth_priv *re = file->private_data;
+	struct raeth_napi_stats *stats = &re->debug.napi_stats;
+	char buf[512];
+	unsigned int len = 0;
+	unsigned long polls;
+
+	polls = stats->polls ? stats->polls : 1;
+
+	PR_NAPI_STAT("Polls", stats->polls);
+	PR_NAPI_STAT("Budget exhausted", stats->rx_budget_exhausted);
+	PR_NAPI_STAT("RX OOM", stats->rx_oom);
+
+	len += snprintf(buf + len, sizeof(buf) - len, "\n");
+	PR_NAPI_STAT("RX packets", stats->rx_packets);
+	PR_NAPI_STAT("RX per poll avg", stats->rx_packets / polls);
+	PR_NAPI_STAT("RX per poll max", stats->rx_packets_max);
+
+	len += snprintf(buf + len, sizeof(buf) - len, "\n");
+	PR_NAPI_STAT("TX packets", stats->tx_packets);
+	PR_NAPI_STAT("TX per poll avg", stats->tx_packets / polls);
+	PR_NAPI_STAT("TX per poll max", stats->tx_packets_max);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+#undef PR_NAPI_STAT
+}
+
+static const struct file_operations raeth_fops_napi_stats = {
+	.open	= raeth_debugfs_generic_open,
+	.read	= read_file_napi_stats,
+	.owner	= THIS_MODULE
+};
+
 void raeth_debugfs_exit(struct raeth_priv *re)
 {
 	debugfs_remove_recursive(re->debug.debugfs_dir);
@@ -104,6 +161,8 @@ int raeth_debugfs_init(struct raeth_priv *re)
 
 	debugfs_create_file("int_stats", S_IRUGO, re->debug.debugfs_dir,
 			    re, &raeth_fops_int_stats);
+	debugfs_create_file("napi_stats", S_IRUGO, re->debug.debugfs_dir,
+			    re, &raeth_fops_napi_stats);
 
 	return 0;
 }
@@ -24,8 +24,13 @@
 #include <linux/netdevice.h>
 #include <linux/dma-mapping.h>
 
-#define NUM_RX_DESC     256
-#define NUM_TX_DESC     256
+#define RAMIPS_NAPI_WEIGHT		64
+
+#define RAMIPS_RX_RING_SIZE_DEFAULT	256
+#define RAMIPS_TX_RING_SIZE_DEFAULT	256
+#define RAMIPS_RX_RING_SIZE_MAX		1024
+#define RAMIPS_TX_RING_SIZE_MAX		1024
+#define RAMIPS_RING_SIZE_MIN		16
 
 #define RAMIPS_DELAY_EN_INT		0x80
 #define RAMIPS_DELAY_MAX_INT		0x04
@@ -274,7 +279,7 @@ struct raeth_tx_info {
 
 struct raeth_rx_info {
 	struct ramips_rx_dma	*rx_desc;
-	struct sk_buff		*rx_skb;
+	void			*rx_buf;
 	dma_addr_t		rx_dma;
 	unsigned int		pad;
 };
@@ -299,23 +304,36 @@ struct raeth_int_stats {
 	unsigned long		total;
 };
 
+struct raeth_napi_stats {
+	unsigned long		polls;
+	unsigned long		rx_packets;
+	unsigned long		rx_packets_max;
+	unsigned long		rx_budget_exhausted;
+	unsigned long		tx_packets;
+	unsigned long		tx_packets_max;
+	unsigned long		rx_oom;
+};
+
 struct raeth_debug {
 	struct dentry		*debugfs_dir;
 
 	struct raeth_int_stats	int_stats;
+	struct raeth_napi_stats	napi_stats;
 };
 
 struct raeth_priv
 {
+	struct napi_struct	napi;
+
 	struct raeth_rx_info	*rx_info;
 	dma_addr_t		rx_desc_dma;
-	struct tasklet_struct	rx_tasklet;
 	struct ramips_rx_dma	*rx;
+	unsigned int		rx_ring_size;
 
 	struct raeth_tx_info	*tx_info;
 	dma_addr_t		tx_desc_dma;
-	struct tasklet_struct	tx_housekeeping_tasklet;
 	struct ramips_tx_dma	*tx;
+	unsigned int		tx_ring_size;
 
 	unsigned int		skb_free_idx;
 
@@ -346,6 +364,8 @@ void raeth_debugfs_root_exit(void);
 int raeth_debugfs_init(struct raeth_priv *re);
 void raeth_debugfs_exit(struct raeth_priv *re);
 void raeth_debugfs_update_int_stats(struct raeth_priv *re, u32 status);
+void raeth_debugfs_update_napi_stats(struct raeth_priv *re, int rx, int tx,
+				     int budget, int oom);
 #else
 static inline int raeth_debugfs_root_init(void) { return 0; }
 static inline void raeth_debugfs_root_exit(void) {}
@@ -353,6 +373,9 @@ static inline int raeth_debugfs_init(struct raeth_priv *re) { return 0; }
 static inline void raeth_debugfs_exit(struct raeth_priv *re) {}
 static inline void raeth_debugfs_update_int_stats(struct raeth_priv *re,
 						  u32 status) {}
+static inline void raeth_debugfs_update_napi_stats(struct raeth_priv *re,
+						   int rx, int tx, int budget,
+						   int oom) {}
 #endif /* CONFIG_NET_RAMIPS_DEBUG_FS */
 
 #endif /* RAMIPS_ETH_H */
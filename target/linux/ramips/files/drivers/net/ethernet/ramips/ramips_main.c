@@ -31,6 +31,9 @@
 
 #define TX_TIMEOUT (20 * HZ / 100)
 #define	MAX_RX_LENGTH	1600
+#define RX_BUF_OFFSET	(NET_SKB_PAD + NET_IP_ALIGN)
+#define RX_BUF_SIZE	(SKB_DATA_ALIGN(RX_BUF_OFFSET + MAX_RX_LENGTH) + \
+			 SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
 
 #ifdef CONFIG_RALINK_RT305X
 #include <rt305x.h>
@@ -166,18 +169,18 @@ ramips_hw_set_macaddr(unsigned char *mac)
 	}
 }
 
-static struct sk_buff *
-ramips_alloc_skb(struct raeth_priv *re)
+/* rx buffers are plain allocations, the skb is built around them on rx */
+static inline void *
+ramips_alloc_rx_buf(void)
 {
-	struct sk_buff *skb;
-
-	skb = netdev_alloc_skb(re->netdev, MAX_RX_LENGTH + NET_IP_ALIGN);
-	if (!skb)
-		return NULL;
-
-	skb_reserve(skb, NET_IP_ALIGN);
+	return kmalloc(RX_BUF_SIZE, GFP_ATOMIC);
+}
 
-	return skb;
+static inline dma_addr_t
+ramips_map_rx_buf(struct raeth_priv *re, void *buf)
+{
+	return dma_map_single(&re->netdev->dev, buf + RX_BUF_OFFSET,
+			      MAX_RX_LENGTH, DMA_FROM_DEVICE);
 }
 
 static void
@@ -186,12 +189,12 @@ ramips_ring_setup(struct raeth_priv *re)
 	int len;
 	int i;
 
-	memset(re->tx_info, 0, NUM_TX_DESC * sizeof(struct raeth_tx_info));
+	memset(re->tx_info, 0, re->tx_ring_size * sizeof(struct raeth_tx_info));
 
-	len = NUM_TX_DESC * sizeof(struct ramips_tx_dma);
+	len = re->tx_ring_size * sizeof(struct ramips_tx_dma);
 	memset(re->tx, 0, len);
 
-	for (i = 0; i < NUM_TX_DESC; i++) {
+	for (i = 0; i < re->tx_ring_size; i++) {
 		struct raeth_tx_info *txi;
 		struct ramips_tx_dma *txd;
 
@@ -208,19 +211,20 @@ ramips_ring_setup(struct raeth_priv *re)
 		}
 	}
 
-	len = NUM_RX_DESC * sizeof(struct ramips_rx_dma);
+	re->skb_free_idx = 0;
+
+	len = re->rx_ring_size * sizeof(struct ramips_rx_dma);
 	memset(re->rx, 0, len);
 
-	for (i = 0; i < NUM_RX_DESC; i++) {
+	for (i = 0; i < re->rx_ring_size; i++) {
 		struct raeth_rx_info *rxi;
 		struct ramips_rx_dma *rxd;
 		dma_addr_t dma_addr;
 
 		rxd = &re->rx[i];
 		rxi = &re->rx_info[i];
-		BUG_ON(rxi->rx_skb == NULL);
-		dma_addr = dma_map_single(&re->netdev->dev, rxi->rx_skb->data,
-					  MAX_RX_LENGTH, DMA_FROM_DEVICE);
+		BUG_ON(rxi->rx_buf == NULL);
+		dma_addr = ramips_map_rx_buf(re, rxi->rx_buf);
 		rxi->rx_dma = dma_addr;
 		rxi->rx_desc = rxd;
 
@@ -237,16 +241,16 @@ ramips_ring_cleanup(struct raeth_priv *re)
 {
 	int i;
 
-	for (i = 0; i < NUM_RX_DESC; i++) {
+	for (i = 0; i < re->rx_ring_size; i++) {
 		struct raeth_rx_info *rxi;
 
 		rxi = &re->rx_info[i];
-		if (rxi->rx_skb)
+		if (rxi->rx_buf)
 			dma_unmap_single(&re->netdev->dev, rxi->rx_dma,
 					 MAX_RX_LENGTH, DMA_FROM_DEVICE);
 	}
 
-	for (i = 0; i < NUM_TX_DESC; i++) {
+	for (i = 0; i < re->tx_ring_size; i++) {
 		struct raeth_tx_info *txi;
 
 		txi = &re->tx_info[i];
@@ -644,29 +648,32 @@ ramips_ring_free(struct raeth_priv *re)
 	int i;
 
 	if (re->rx_info) {
-		for (i = 0; i < NUM_RX_DESC; i++) {
+		for (i = 0; i < re->rx_ring_size; i++) {
 			struct raeth_rx_info *rxi;
 
 			rxi = &re->rx_info[i];
-			if (rxi->rx_skb)
-				dev_kfree_skb_any(rxi->rx_skb);
+			kfree(rxi->rx_buf);
 		}
 		kfree(re->rx_info);
+		re->rx_info = NULL;
 	}
 
 	if (re->rx) {
-		len = NUM_RX_DESC * sizeof(struct ramips_rx_dma);
+		len = re->rx_ring_size * sizeof(struct ramips_rx_dma);
 		dma_free_coherent(&re->netdev->dev, len, re->rx,
 				  re->rx_desc_dma);
+		re->rx = NULL;
 	}
 
 	if (re->tx) {
-		len = NUM_TX_DESC * sizeof(struct ramips_tx_dma);
+		len = re->tx_ring_size * sizeof(struct ramips_tx_dma);
 		dma_free_coherent(&re->netdev->dev, len, re->tx,
 				  re->tx_desc_dma);
+		re->tx = NULL;
 	}
 
 	kfree(re->tx_info);
+	re->tx_info = NULL;
 }
 
 static int
@@ -676,38 +683,38 @@ ramips_ring_alloc(struct raeth_priv *re)
 	int err = -ENOMEM;
 	int i;
 
-	re->tx_info = kzalloc(NUM_TX_DESC * sizeof(struct raeth_tx_info),
+	re->tx_info = kzalloc(re->tx_ring_size * sizeof(struct raeth_tx_info),
 			      GFP_ATOMIC);
 	if (!re->tx_info)
 		goto err_cleanup;
 
-	re->rx_info = kzalloc(NUM_RX_DESC * sizeof(struct raeth_rx_info),
+	re->rx_info = kzalloc(re->rx_ring_size * sizeof(struct raeth_rx_info),
 			      GFP_ATOMIC);
 	if (!re->rx_info)
 		goto err_cleanup;
 
 	/* allocate tx ring */
-	len = NUM_TX_DESC * sizeof(struct ramips_tx_dma);
+	len = re->tx_ring_size * sizeof(struct ramips_tx_dma);
 	re->tx = dma_alloc_coherent(&re->netdev->dev, len,
 					  &re->tx_desc_dma, GFP_ATOMIC);
 	if (!re->tx)
 		goto err_cleanup;
 
 	/* allocate rx ring */
-	len = NUM_RX_DESC * sizeof(struct ramips_rx_dma);
+	len = re->rx_ring_size * sizeof(struct ramips_rx_dma);
 	re->rx = dma_alloc_coherent(&re->netdev->dev, len,
 				    &re->rx_desc_dma, GFP_ATOMIC);
 	if (!re->rx)
 		goto err_cleanup;
 
-	for (i = 0; i < NUM_RX_DESC; i++) {
-		struct sk_buff *skb;
+	for (i = 0; i < re->rx_ring_size; i++) {
+		void *buf;
 
-		skb = ramips_alloc_skb(re);
-		if (!skb)
+		buf = ramips_alloc_rx_buf();
+		if (!buf)
 			goto err_cleanup;
 
-		re->rx_info[i].rx_skb = skb;
+		re->rx_info[i].rx_buf = buf;
 	}
 
 	return 0;
@@ -721,13 +728,13 @@ static void
 ramips_setup_dma(struct raeth_priv *re)
 {
 	ramips_fe_twr(re->tx_desc_dma, RAETH_REG_TX_BASE_PTR0);
-	ramips_fe_twr(NUM_TX_DESC, RAETH_REG_TX_MAX_CNT0);
+	ramips_fe_twr(re->tx_ring_size, RAETH_REG_TX_MAX_CNT0);
 	ramips_fe_twr(0, RAETH_REG_TX_CTX_IDX0);
 	ramips_fe_twr(RAMIPS_PST_DTX_IDX0, RAETH_REG_PDMA_RST_CFG);
 
 	ramips_fe_twr(re->rx_desc_dma, RAETH_REG_RX_BASE_PTR0);
-	ramips_fe_twr(NUM_RX_DESC, RAETH_REG_RX_MAX_CNT0);
-	ramips_fe_twr((NUM_RX_DESC - 1), RAETH_REG_RX_CALC_IDX0);
+	ramips_fe_twr(re->rx_ring_size, RAETH_REG_RX_MAX_CNT0);
+	ramips_fe_twr((re->rx_ring_size - 1), RAETH_REG_RX_CALC_IDX0);
 	ramips_fe_twr(RAMIPS_PST_DRX_IDX0, RAETH_REG_PDMA_RST_CFG);
 }
 
@@ -759,7 +766,7 @@ ramips_eth_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	spin_lock(&re->page_lock);
 	tx = ramips_fe_trr(RAETH_REG_TX_CTX_IDX0);
-	tx_next = (tx + 1) % NUM_TX_DESC;
+	tx_next = (tx + 1) % re->tx_ring_size;
 
 	txi = &re->tx_info[tx];
 	txd = txi->tx_desc;
@@ -790,77 +797,79 @@ ramips_eth_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	return NETDEV_TX_OK;
 }
 
-static void
-ramips_eth_rx_hw(unsigned long ptr)
+static int
+ramips_eth_rx_hw(struct raeth_priv *re, int budget, int *oom)
 {
-	struct net_device *dev = (struct net_device *) ptr;
-	struct raeth_priv *re = netdev_priv(dev);
-	int rx;
-	int max_rx = 16;
+	struct net_device *dev = re->netdev;
+	int rx, rx_done;
+	int done = 0;
 
 	rx = ramips_fe_trr(RAETH_REG_RX_CALC_IDX0);
+	rx_done = rx;
 
-	while (max_rx) {
+	while (done < budget) {
 		struct raeth_rx_info *rxi;
 		struct ramips_rx_dma *rxd;
-		struct sk_buff *rx_skb, *new_skb;
+		struct sk_buff *skb;
+		void *new_buf;
 		int pktlen;
 
-		rx = (rx + 1) % NUM_RX_DESC;
+		rx = (rx + 1) % re->rx_ring_size;
 
 		rxi = &re->rx_info[rx];
 		rxd = rxi->rx_desc;
 		if (!(rxd->rxd2 & RX_DMA_DONE))
 			break;
 
-		rx_skb = rxi->rx_skb;
 		pktlen = RX_DMA_PLEN0(rxd->rxd2);
 
-		new_skb = ramips_alloc_skb(re);
+		new_buf = ramips_alloc_rx_buf();
 		/* Reuse the buffer on allocation failures */
-		if (new_skb) {
-			dma_addr_t dma_addr;
-
+		if (new_buf) {
 			dma_unmap_single(&re->netdev->dev, rxi->rx_dma,
 					 MAX_RX_LENGTH, DMA_FROM_DEVICE);
 
-			skb_put(rx_skb, pktlen);
-			rx_skb->dev = dev;
-			rx_skb->protocol = eth_type_trans(rx_skb, dev);
-			rx_skb->ip_summed = CHECKSUM_NONE;
-			dev->stats.rx_packets++;
-			dev->stats.rx_bytes += pktlen;
-			netif_rx(rx_skb);
-
-			rxi->rx_skb = new_skb;
-
-			dma_addr = dma_map_single(&re->netdev->dev,
-						  new_skb->data,
-						  MAX_RX_LENGTH,
-						  DMA_FROM_DEVICE);
-			rxi->rx_dma = dma_addr;
-			rxd->rxd1 = (unsigned int) dma_addr;
-			wmb();
+			skb = build_skb(rxi->rx_buf, 0);
+			if (skb) {
+				skb_reserve(skb, RX_BUF_OFFSET);
+				skb_put(skb, pktlen);
+				skb->dev = dev;
+				skb->protocol = eth_type_trans(skb, dev);
+				skb->ip_summed = CHECKSUM_NONE;
+				dev->stats.rx_packets++;
+				dev->stats.rx_bytes += pktlen;
+				netif_receive_skb(skb);
+			} else {
+				kfree(rxi->rx_buf);
+				dev->stats.rx_dropped++;
+			}
+
+			rxi->rx_buf = new_buf;
+			rxi->rx_dma = ramips_map_rx_buf(re, new_buf);
+			rxd->rxd1 = (unsigned int) rxi->rx_dma;
 		} else {
 			dev->stats.rx_dropped++;
+			(*oom)++;
 		}
 
 		rxd->rxd2 = RX_DMA_LSO;
-		ramips_fe_twr(rx, RAETH_REG_RX_CALC_IDX0);
-		max_rx--;
+		rx_done = rx;
+		done++;
 	}
 
-	if (max_rx == 0)
-		tasklet_schedule(&re->rx_tasklet);
-	else
-		ramips_fe_int_enable(RX_DLY_INT);
+	/* hand the whole batch back to the hardware at once */
+	if (done) {
+		wmb();
+		ramips_fe_twr(rx_done, RAETH_REG_RX_CALC_IDX0);
+	}
+
+	return done;
 }
 
-static void
-ramips_eth_tx_housekeeping(unsigned long ptr)
+static int
+ramips_eth_tx_housekeeping(struct raeth_priv *re)
 {
-	struct net_device *dev = (struct net_device*)ptr;
-	struct raeth_priv *re = netdev_priv(dev);
+	struct net_device *dev = re->netdev;
 	unsigned int bytes_compl = 0, pkts_compl = 0;
 
 	spin_lock(&re->page_lock);
@@ -877,16 +886,36 @@ ramips_eth_tx_housekeeping(unsigned long ptr)
 		pkts_compl++;
 		bytes_compl += txi->tx_skb->len;
 
-		dev_kfree_skb_irq(txi->tx_skb);
+		dev_kfree_skb_any(txi->tx_skb);
 		txi->tx_skb = NULL;
 		re->skb_free_idx++;
-		if (re->skb_free_idx >= NUM_TX_DESC)
+		if (re->skb_free_idx >= re->tx_ring_size)
 			re->skb_free_idx = 0;
 	}
 	netdev_completed_queue(dev, pkts_compl, bytes_compl);
 	spin_unlock(&re->page_lock);
 
-	ramips_fe_int_enable(TX_DLY_INT);
+	return pkts_compl;
+}
+
+static int
+ramips_eth_poll(struct napi_struct *napi, int budget)
+{
+	struct raeth_priv *re = container_of(napi, struct raeth_priv, napi);
+	int tx_done, rx_done;
+	int oom = 0;
+
+	tx_done = ramips_eth_tx_housekeeping(re);
+	rx_done = ramips_eth_rx_hw(re, budget, &oom);
+
+	raeth_debugfs_update_napi_stats(re, rx_done, tx_done, budget, oom);
+
+	if (rx_done < budget) {
+		napi_complete(napi);
+		ramips_fe_int_enable(TX_DLY_INT | RX_DLY_INT);
+	}
+
+	return rx_done;
 }
 
 static void
@@ -894,7 +923,7 @@ ramips_eth_timeout(struct net_device *dev)
 {
 	struct raeth_priv *re = netdev_priv(dev);
 
-	tasklet_schedule(&re->tx_housekeeping_tasklet);
+	napi_schedule(&re->napi);
 }
 
 static irqreturn_t
@@ -911,14 +940,10 @@ ramips_eth_irq(int irq, void *dev)
 
 	ramips_fe_twr(status, RAETH_REG_FE_INT_STATUS);
 
-	if (status & RX_DLY_INT) {
-		ramips_fe_int_disable(RX_DLY_INT);
-		tasklet_schedule(&re->rx_tasklet);
-	}
-
-	if (status & TX_DLY_INT) {
-		ramips_fe_int_disable(TX_DLY_INT);
-		tasklet_schedule(&re->tx_housekeeping_tasklet);
+	/* both rings are serviced by the poll loop, keep quiet until it is done */
+	if (status & (RX_DLY_INT | TX_DLY_INT)) {
+		ramips_fe_int_disable(TX_DLY_INT | RX_DLY_INT);
+		napi_schedule(&re->napi);
 	}
 
 	raeth_debugfs_update_int_stats(re, status);
@@ -950,11 +975,6 @@ ramips_eth_hw_init(struct net_device *dev)
 		((re->plat->sys_freq / RAMIPS_US_CYC_CNT_DIVISOR) << RAMIPS_US_CYC_CNT_SHIFT),
 		RAMIPS_FE_GLO_CFG);
 
-	tasklet_init(&re->tx_housekeeping_tasklet, ramips_eth_tx_housekeeping,
-		     (unsigned long)dev);
-	tasklet_init(&re->rx_tasklet, ramips_eth_rx_hw, (unsigned long)dev);
-
-
 	ramips_fe_twr(RAMIPS_DELAY_INIT, RAETH_REG_DLY_INT_CFG);
 	ramips_fe_twr(TX_DLY_INT | RX_DLY_INT, RAETH_REG_FE_INT_ENABLE);
 	if (soc_is_rt5350()) {
@@ -989,6 +1009,8 @@ ramips_eth_open(struct net_device *dev)
 		(RAMIPS_TX_WB_DDONE | RAMIPS_RX_DMA_EN |
 		RAMIPS_TX_DMA_EN | RAMIPS_PDMA_SIZE_4DWORDS),
 		RAETH_REG_PDMA_GLO_CFG);
+	napi_enable(&re->napi);
+	ramips_fe_int_enable(TX_DLY_INT | RX_DLY_INT);
 	ramips_phy_start(re);
 	netif_start_queue(dev);
 	return 0;
@@ -1004,6 +1026,8 @@ ramips_eth_stop(struct net_device *dev)
 		     RAETH_REG_PDMA_GLO_CFG);
 
 	netif_stop_queue(dev);
+	ramips_fe_int_disable(TX_DLY_INT | RX_DLY_INT);
+	napi_disable(&re->napi);
 	ramips_phy_stop(re);
 	RADEBUG("ramips_eth: stopped\n");
 	return 0;
@@ -1025,6 +1049,7 @@ ramips_eth_probe(struct net_device *dev)
 	dev->watchdog_timeo = TX_TIMEOUT;
 	spin_lock_init(&re->page_lock);
 	spin_lock_init(&re->phy_lock);
+	netif_napi_add(dev, &re->napi, ramips_eth_poll, RAMIPS_NAPI_WEIGHT);
 
 	err = ramips_mdio_init(re);
 	if (err)
@@ -1063,12 +1088,117 @@ ramips_eth_uninit(struct net_device *dev)
 	ramips_mdio_cleanup(re);
 	ramips_fe_twr(0, RAETH_REG_FE_INT_ENABLE);
 	free_irq(dev->irq, dev);
-	tasklet_kill(&re->tx_housekeeping_tasklet);
-	tasklet_kill(&re->rx_tasklet);
+	netif_napi_del(&re->napi);
 	ramips_ring_cleanup(re);
 	ramips_ring_free(re);
 }
 
+static void
+ramips_eth_get_ringparam(struct net_device *dev,
+			 struct ethtool_ringparam *er)
+{
+	struct raeth_priv *re = netdev_priv(dev);
+
+	er->rx_max_pending = RAMIPS_RX_RING_SIZE_MAX;
+	er->tx_max_pending = RAMIPS_TX_RING_SIZE_MAX;
+	er->rx_pending = re->rx_ring_size;
+	er->tx_pending = re->tx_ring_size;
+}
+
+static int
+ramips_eth_resize_rings(struct raeth_priv *re, unsigned rx_size,
+			unsigned tx_size)
+{
+	struct raeth_rx_info *rx_info = re->rx_info;
+	struct ramips_rx_dma *rx = re->rx;
+	dma_addr_t rx_desc_dma = re->rx_desc_dma;
+	unsigned int rx_ring_size = re->rx_ring_size;
+	struct raeth_tx_info *tx_info = re->tx_info;
+	struct ramips_tx_dma *tx = re->tx;
+	dma_addr_t tx_desc_dma = re->tx_desc_dma;
+	unsigned int tx_ring_size = re->tx_ring_size;
+	int err;
+
+	/* allocate the new rings first, a failure keeps the old ones */
+	re->rx_info = NULL;
+	re->rx = NULL;
+	re->rx_ring_size = rx_size;
+	re->tx_info = NULL;
+	re->tx = NULL;
+	re->tx_ring_size = tx_size;
+
+	err = ramips_ring_alloc(re);
+
+	swap(re->rx_info, rx_info);
+	swap(re->rx, rx);
+	swap(re->rx_desc_dma, rx_desc_dma);
+	swap(re->rx_ring_size, rx_ring_size);
+	swap(re->tx_info, tx_info);
+	swap(re->tx, tx);
+	swap(re->tx_desc_dma, tx_desc_dma);
+	swap(re->tx_ring_size, tx_ring_size);
+
+	if (err)
+		return err;
+
+	if (re->rx_info)
+		ramips_ring_cleanup(re);
+	ramips_ring_free(re);
+
+	re->rx_info = rx_info;
+	re->rx = rx;
+	re->rx_desc_dma = rx_desc_dma;
+	re->rx_ring_size = rx_ring_size;
+	re->tx_info = tx_info;
+	re->tx = tx;
+	re->tx_desc_dma = tx_desc_dma;
+	re->tx_ring_size = tx_ring_size;
+
+	ramips_ring_setup(re);
+	ramips_setup_dma(re);
+
+	return 0;
+}
+
+static int
+ramips_eth_set_ringparam(struct net_device *dev,
+			 struct ethtool_ringparam *er)
+{
+	struct raeth_priv *re = netdev_priv(dev);
+	bool running = netif_running(dev);
+	int err;
+
+	if (er->rx_mini_pending || er->rx_jumbo_pending ||
+	    er->rx_pending < RAMIPS_RING_SIZE_MIN ||
+	    er->tx_pending < RAMIPS_RING_SIZE_MIN ||
+	    er->rx_pending > RAMIPS_RX_RING_SIZE_MAX ||
+	    er->tx_pending > RAMIPS_TX_RING_SIZE_MAX)
+		return -EINVAL;
+
+	if (er->rx_pending == re->rx_ring_size &&
+	    er->tx_pending == re->tx_ring_size)
+		return 0;
+
+	if (running)
+		dev->netdev_ops->ndo_stop(dev);
+
+	/* on failure the old rings are still set up and can be reused */
+	err = ramips_eth_resize_rings(re, er->rx_pending, er->tx_pending);
+	if (err)
+		netdev_err(dev, "unable to resize rings\n");
+
+	if (running)
+		dev->netdev_ops->ndo_open(dev);
+
+	return err;
+}
+
+static const struct ethtool_ops ramips_eth_ethtool_ops = {
+	.get_link		= ethtool_op_get_link,
+	.get_ringparam		= ramips_eth_get_ringparam,
+	.set_ringparam		= ramips_eth_set_ringparam,
+};
+
 static const struct net_device_ops ramips_eth_netdev_ops = {
 	.ndo_init		= ramips_eth_probe,
 	.ndo_uninit		= ramips_eth_uninit,
@@ -1121,6 +1251,7 @@ ramips_eth_plat_probe(struct platform_device *plat)
 	ramips_dev->addr_len = ETH_ALEN;
 	ramips_dev->base_addr = (unsigned long)ramips_fe_base;
 	ramips_dev->netdev_ops = &ramips_eth_netdev_ops;
+	ramips_dev->ethtool_ops = &ramips_eth_ethtool_ops;
 
 	re = netdev_priv(ramips_dev);
 
@@ -1131,6 +1262,8 @@ ramips_eth_plat_probe(struct platform_device *plat)
 	re->rx_fc = data->rx_fc;
 	re->tx_fc = data->tx_fc;
 	re->plat = data;
+	re->rx_ring_size = RAMIPS_RX_RING_SIZE_DEFAULT;
+	re->tx_ring_size = RAMIPS_TX_RING_SIZE_DEFAULT;
 
 	err = register_netdev(ramips_dev);
 	if (err) {
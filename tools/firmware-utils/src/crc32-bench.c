@@ -0,0 +1,164 @@
+/*
+ * crc32-bench - compare the slice-by-8 CRC32 with the byte-at-a-time table
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "cyg_crc.h"
+
+#define DEFAULT_SIZE	(16 * 1024 * 1024)
+#define DEFAULT_LOOPS	8
+
+static uint32_t byte_tab[256];
+
+static void byte_tab_init(void)
+{
+	uint32_t c;
+	int n, k;
+
+	for (n = 0; n < 256; n++) {
+		c = n;
+		for (k = 0; k < 8; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		byte_tab[n] = c;
+	}
+}
+
+/* the loop used by trx.c and cyg_crc32.c before slice-by-8 */
+static uint32_t crc32_bytewise(uint32_t crc, const unsigned char *s, size_t len)
+{
+	while (len--)
+		crc = byte_tab[(crc ^ *s++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int verify(unsigned char *buf, size_t size)
+{
+	uint32_t a, b, c;
+	size_t ofs, len, split;
+
+	/* every alignment and short tail */
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len < 64; len++) {
+			a = crc32_bytewise(0xffffffff, buf + ofs, len);
+			b = cyg_crc32_accumulate(0xffffffff, buf + ofs, len);
+			if (a != b) {
+				fprintf(stderr, "mismatch at ofs=%zu len=%zu: "
+					"%08x != %08x\n", ofs, len, a, b);
+				return -1;
+			}
+		}
+	}
+
+	a = crc32_bytewise(0xffffffff, buf, size);
+	b = cyg_crc32_accumulate(0xffffffff, buf, size);
+	if (a != b) {
+		fprintf(stderr, "mismatch over %zu bytes: %08x != %08x\n",
+			size, a, b);
+		return -1;
+	}
+
+	for (split = 0; split <= size; split += size / 7 + 1) {
+		b = cyg_crc32_accumulate(0xffffffff, buf, split);
+		c = cyg_crc32_accumulate(0, buf + split, size - split);
+		c = cyg_crc32_combine(b, c, size - split);
+		if (a != c) {
+			fprintf(stderr, "combine mismatch at split=%zu: "
+				"%08x != %08x\n", split, a, c);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void bench(const char *name, unsigned char *buf, size_t size,
+		  int loops, int sliced)
+{
+	volatile uint32_t crc = 0;
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < loops; i++) {
+		if (sliced)
+			crc = cyg_crc32_accumulate(0xffffffff, buf, size);
+		else
+			crc = crc32_bytewise(0xffffffff, buf, size);
+	}
+	t = now() - t;
+
+	printf("%-12s %08x %8.1f MB/s\n", name, (uint32_t) crc,
+	       (double) size * loops / (1024 * 1024) / t);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-s <size>] [-l <loops>]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *buf;
+	size_t size = DEFAULT_SIZE;
+	int loops = DEFAULT_LOOPS;
+	size_t i;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:l:")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (size < 72 || loops < 1)
+		usage(argv[0]);
+
+	buf = malloc(size);
+	if (!buf) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+
+	byte_tab_init();
+	if (verify(buf, size))
+		return EXIT_FAILURE;
+
+	printf("%zu bytes, %d loops\n", size, loops);
+	bench("bytewise", buf, size, loops, 0);
+	bench("slice-by-8", buf, size, loops, 1);
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -87,6 +87,12 @@ cyg_crc32(unsigned char *s, int len);
 __externC cyg_uint32
 cyg_crc32_accumulate(cyg_uint32 crc, unsigned char *s, int len);
 
+// Combine two Gary S. Brown CRCs: crc1 over A and crc2 over B
+// (started from 0) into the CRC over A followed by B
+
+__externC cyg_uint32
+cyg_crc32_combine(cyg_uint32 crc1, cyg_uint32 crc2, unsigned long len2);
+
 // Ethernet FCS Algorithm
 
 __externC cyg_uint32
@@ -124,19 +124,129 @@ static const cyg_uint32 crc32_tab[] = {
       0x2d02ef8dL
    };
 
+/* Slice-by-8 tables: crc32_slice[k][n] is the CRC of byte n followed
+   by k zero bytes, so eight input bytes can be folded with independent
+   table lookups instead of a serial chain of eight.  The input words are
+   assembled from bytes, which keeps this independent of host endianness
+   and buffer alignment. */
+static cyg_uint32 crc32_slice[8][256];
+static int crc32_slice_ready;
+
+static void
+crc32_slice_init(void)
+{
+  cyg_uint32 val;
+  int i, k;
+
+  for (i = 0;  i < 256;  i++) {
+    val = crc32_tab[i];
+    crc32_slice[0][i] = val;
+    for (k = 1;  k < 8;  k++) {
+      val = crc32_tab[val & 0xff] ^ (val >> 8);
+      crc32_slice[k][i] = val;
+    }
+  }
+  crc32_slice_ready = 1;
+}
+
 /* This is the standard Gary S. Brown's 32 bit CRC algorithm, but
    accumulate the CRC into the result of a previous CRC. */
 cyg_uint32 
 cyg_crc32_accumulate(cyg_uint32 crc32val, unsigned char *s, int len)
 {
+  cyg_uint32 lo, hi;
   int i;
 
+  if (!crc32_slice_ready)
+    crc32_slice_init();
+
+  for (;  len >= 8;  len -= 8, s += 8) {
+    lo = crc32val ^ (s[0] | (s[1] << 8) | (s[2] << 16) | ((cyg_uint32)s[3] << 24));
+    hi = s[4] | (s[5] << 8) | (s[6] << 16) | ((cyg_uint32)s[7] << 24);
+    crc32val = crc32_slice[7][lo & 0xff] ^
+               crc32_slice[6][(lo >> 8) & 0xff] ^
+               crc32_slice[5][(lo >> 16) & 0xff] ^
+               crc32_slice[4][lo >> 24] ^
+               crc32_slice[3][hi & 0xff] ^
+               crc32_slice[2][(hi >> 8) & 0xff] ^
+               crc32_slice[1][(hi >> 16) & 0xff] ^
+               crc32_slice[0][hi >> 24];
+  }
+
   for (i = 0;  i < len;  i++) {
     crc32val = crc32_tab[(crc32val ^ s[i]) & 0xff] ^ (crc32val >> 8);
   }
   return crc32val;
 }
 
+/* Multiply the 32x32 GF(2) matrix mat by the vector vec. */
+static cyg_uint32
+gf2_matrix_times(const cyg_uint32 *mat, cyg_uint32 vec)
+{
+  cyg_uint32 sum = 0;
+
+  while (vec) {
+    if (vec & 1)
+      sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+static void
+gf2_matrix_square(cyg_uint32 *square, const cyg_uint32 *mat)
+{
+  int n;
+
+  for (n = 0;  n < 32;  n++)
+    square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/* Given crc1 = cyg_crc32_accumulate(x, A, len1) and
+   crc2 = cyg_crc32_accumulate(0, B, len2), return the CRC of A followed
+   by B started from x, without touching the data again.  Since the
+   pre/post inversions cancel out, this also combines two
+   cyg_ether_crc32() values. */
+cyg_uint32
+cyg_crc32_combine(cyg_uint32 crc1, cyg_uint32 crc2, unsigned long len2)
+{
+  cyg_uint32 even[32], odd[32];
+  cyg_uint32 row = 1;
+  int n;
+
+  if (len2 == 0)
+    return crc1;
+
+  /* operator for one zero bit */
+  odd[0] = 0xedb88320;
+  for (n = 1;  n < 32;  n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  /* operators for two and four zero bits */
+  gf2_matrix_square(even, odd);
+  gf2_matrix_square(odd, even);
+
+  /* apply len2 zero bytes to crc1, squaring the operator as we go */
+  do {
+    gf2_matrix_square(even, odd);
+    if (len2 & 1)
+      crc1 = gf2_matrix_times(even, crc1);
+    len2 >>= 1;
+    if (len2 == 0)
+      break;
+
+    gf2_matrix_square(odd, even);
+    if (len2 & 1)
+      crc1 = gf2_matrix_times(odd, crc1);
+    len2 >>= 1;
+  } while (len2);
+
+  return crc1 ^ crc2;
+}
+
 /* This is the standard Gary S. Brown's 32 bit CRC algorithm */
 cyg_uint32
 cyg_crc32(unsigned char *s, int len)
@@ -150,14 +260,9 @@ cyg_crc32(unsigned char *s, int len)
 cyg_uint32
 cyg_ether_crc32_accumulate(cyg_uint32 crc32val, unsigned char *s, int len)
 {
-  int i;
-
   if (s == 0) return 0L;
   
-  crc32val = crc32val ^ 0xffffffff;
-  for (i = 0;  i < len;  i++) {
-      crc32val = crc32_tab[(crc32val ^ s[i]) & 0xff] ^ (crc32val >> 8);
-  }
+  crc32val = cyg_crc32_accumulate(crc32val ^ 0xffffffff, s, len);
   return crc32val ^ 0xffffffff;
 }
 
@@ -0,0 +1,359 @@
+/*
+ * fwimage-bench - compare whole-file buffering with the libfwimage writer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "cyg_crc.h"
+#include "fwimage.h"
+
+#define DEFAULT_KERNEL_SIZE	(2 * 1024 * 1024)
+#define DEFAULT_ROOTFS_SIZE	(14 * 1024 * 1024)
+#define DEFAULT_LOOPS		8
+#define ROOTFS_ALIGN		0x10000
+#define HEADER_SIZE		512
+
+/* header layout shared by both builders, loosely modelled on mktplinkfw */
+struct bench_header {
+	uint32_t	kernel_len;
+	uint32_t	rootfs_ofs;
+	uint32_t	rootfs_len;
+	uint32_t	crc32;
+	uint8_t		md5sum[16];
+	uint8_t		sha1sum[20];
+	uint8_t		pad[HEADER_SIZE - 52];
+} __attribute__ ((packed));
+
+struct result {
+	uint32_t	crc32;
+	uint8_t		md5sum[16];
+	uint8_t		sha1sum[20];
+};
+
+static char kernel_name[256];
+static char rootfs_name[256];
+static char buffered_name[256];
+static char streamed_name[256];
+static unsigned int digests;
+static size_t kernel_size = DEFAULT_KERNEL_SIZE;
+static size_t rootfs_size = DEFAULT_ROOTFS_SIZE;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int make_input(const char *name, size_t size)
+{
+	unsigned char buf[4096];
+	FILE *f;
+	size_t i, n;
+
+	f = fopen(name, "w");
+	if (!f) {
+		perror(name);
+		return -1;
+	}
+
+	for (; size; size -= n) {
+		n = size < sizeof(buf) ? size : sizeof(buf);
+		for (i = 0; i < n; i++)
+			buf[i] = rand();
+		if (fwrite(buf, n, 1, f) != 1) {
+			perror(name);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	return fclose(f);
+}
+
+static size_t image_size(void)
+{
+	size_t ofs = HEADER_SIZE + kernel_size;
+
+	ofs = (ofs + ROOTFS_ALIGN - 1) & ~(ROOTFS_ALIGN - 1);
+	return ofs + rootfs_size;
+}
+
+static void fill_header(struct bench_header *hdr)
+{
+	size_t ofs = image_size() - rootfs_size;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->kernel_len = htonl(kernel_size);
+	hdr->rootfs_ofs = htonl(ofs);
+	hdr->rootfs_len = htonl(rootfs_size);
+}
+
+static int read_file(const char *name, char *buf, size_t size)
+{
+	FILE *f;
+	int ret = 0;
+
+	f = fopen(name, "r");
+	if (!f)
+		return -1;
+
+	if (fread(buf, size, 1, f) != 1)
+		ret = -1;
+
+	fclose(f);
+	return ret;
+}
+
+/* the way most builders work: slurp everything, then hash it pass by pass */
+static int build_buffered(struct result *res)
+{
+	struct bench_header *hdr;
+	MD5_CTX md5;
+	sha1_context sha1;
+	size_t len = image_size();
+	char *buf;
+	FILE *f;
+	int ret = -1;
+
+	buf = malloc(len);
+	if (!buf)
+		return -1;
+
+	memset(buf, 0xff, len);
+	hdr = (struct bench_header *) buf;
+	fill_header(hdr);
+
+	if (read_file(kernel_name, buf + HEADER_SIZE, kernel_size) ||
+	    read_file(rootfs_name, buf + len - rootfs_size, rootfs_size))
+		goto out;
+
+	memset(res, 0, sizeof(*res));
+
+	if (digests & FWIMAGE_CRC32)
+		res->crc32 = cyg_crc32_accumulate(0xffffffff,
+						  (unsigned char *) buf, len);
+
+	if (digests & FWIMAGE_MD5) {
+		MD5_Init(&md5);
+		MD5_Update(&md5, buf, len);
+		MD5_Final(res->md5sum, &md5);
+	}
+
+	if (digests & FWIMAGE_SHA1) {
+		sha1_starts(&sha1);
+		sha1_update(&sha1, (unsigned char *) buf, len);
+		sha1_finish(&sha1, res->sha1sum);
+	}
+
+	hdr->crc32 = htonl(res->crc32);
+	memcpy(hdr->md5sum, res->md5sum, sizeof(hdr->md5sum));
+	memcpy(hdr->sha1sum, res->sha1sum, sizeof(hdr->sha1sum));
+
+	f = fopen(buffered_name, "w");
+	if (!f)
+		goto out;
+
+	if (fwrite(buf, len, 1, f) == 1)
+		ret = 0;
+
+	if (fclose(f))
+		ret = -1;
+
+out:
+	free(buf);
+	return ret;
+}
+
+/* mapped inputs, all digests in the same pass as the write */
+static int build_streamed(struct result *res)
+{
+	struct fwimage_file kernel, rootfs;
+	struct fwimage_writer w;
+	struct fwimage_range range;
+	struct bench_header hdr;
+	int ret = -1;
+
+	if (fwimage_map(&kernel, kernel_name))
+		return -1;
+
+	if (fwimage_map(&rootfs, rootfs_name))
+		goto out_kernel;
+
+	if (fwimage_open(&w, streamed_name))
+		goto out_rootfs;
+
+	fwimage_add_range(&w, &range, 0, FWIMAGE_END, digests, 0xffffffff);
+
+	fill_header(&hdr);
+	if (fwimage_write(&w, &hdr, sizeof(hdr)) ||
+	    fwimage_write_file(&w, &kernel) ||
+	    fwimage_pad_to(&w, 0xff, image_size() - rootfs_size) ||
+	    fwimage_write_file(&w, &rootfs)) {
+		fwimage_abort(&w);
+		goto out_rootfs;
+	}
+
+	fwimage_digest_final(&range.digest);
+	memset(res, 0, sizeof(*res));
+	if (digests & FWIMAGE_CRC32)
+		res->crc32 = range.digest.crc32;
+	memcpy(res->md5sum, range.digest.md5sum, sizeof(res->md5sum));
+	memcpy(res->sha1sum, range.digest.sha1sum, sizeof(res->sha1sum));
+
+	hdr.crc32 = htonl(res->crc32);
+	memcpy(hdr.md5sum, res->md5sum, sizeof(hdr.md5sum));
+	memcpy(hdr.sha1sum, res->sha1sum, sizeof(hdr.sha1sum));
+
+	if (fwimage_pwrite(&w, &hdr, offsetof(struct bench_header, pad), 0)) {
+		fwimage_abort(&w);
+		goto out_rootfs;
+	}
+
+	ret = fwimage_close(&w);
+
+out_rootfs:
+	fwimage_unmap(&rootfs);
+out_kernel:
+	fwimage_unmap(&kernel);
+	return ret;
+}
+
+static int bench(const char *name, int (*build)(struct result *),
+		 struct result *res, int loops)
+{
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < loops; i++) {
+		if (build(res)) {
+			perror(name);
+			return -1;
+		}
+	}
+	t = now() - t;
+
+	printf("  %-10s %7.1f ms/image %8.1f MB/s\n", name, t * 1000 / loops,
+	       (double) image_size() * loops / (1024 * 1024) / t);
+
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-d <dir>] [-k <kernel size>] "
+		"[-r <rootfs size>] [-l <loops>]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+static int compare(unsigned int flags, const char *name, int loops)
+{
+	struct result a, b;
+
+	digests = flags;
+	printf("%s:\n", name);
+
+	if (bench("buffered", build_buffered, &a, loops) ||
+	    bench("streamed", build_streamed, &b, loops))
+		return -1;
+
+	if (a.crc32 != b.crc32 ||
+	    memcmp(a.md5sum, b.md5sum, sizeof(a.md5sum)) ||
+	    memcmp(a.sha1sum, b.sha1sum, sizeof(a.sha1sum))) {
+		fprintf(stderr, "%s: digest mismatch\n", name);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/tmp";
+	int loops = DEFAULT_LOOPS;
+	int ret = EXIT_FAILURE;
+	int c;
+
+	while ((c = getopt(argc, argv, "d:k:r:l:")) != -1) {
+		switch (c) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 'k':
+			kernel_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rootfs_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (loops < 1)
+		usage(argv[0]);
+
+	snprintf(kernel_name, sizeof(kernel_name), "%s/fwimage-bench.%d.kernel",
+		 dir, getpid());
+	snprintf(rootfs_name, sizeof(rootfs_name), "%s/fwimage-bench.%d.rootfs",
+		 dir, getpid());
+	snprintf(buffered_name, sizeof(buffered_name),
+		 "%s/fwimage-bench.%d.buffered", dir, getpid());
+	snprintf(streamed_name, sizeof(streamed_name),
+		 "%s/fwimage-bench.%d.streamed", dir, getpid());
+
+	srand(1);
+	if (make_input(kernel_name, kernel_size) ||
+	    make_input(rootfs_name, rootfs_size))
+		goto out;
+
+	printf("kernel %zu bytes, rootfs %zu bytes, image %zu bytes, %d loops\n",
+	       kernel_size, rootfs_size, image_size(), loops);
+
+	if (compare(FWIMAGE_CRC32, "crc32", loops) ||
+	    compare(FWIMAGE_MD5, "md5", loops) ||
+	    compare(FWIMAGE_CRC32 | FWIMAGE_MD5 | FWIMAGE_SHA1,
+		    "crc32+md5+sha1", loops))
+		goto out;
+
+	/* both builders must have produced the very same image */
+	{
+		struct fwimage_file a, b;
+
+		if (fwimage_map(&a, buffered_name) ||
+		    fwimage_map(&b, streamed_name))
+			goto out;
+
+		if (a.size != b.size || memcmp(a.data, b.data, a.size))
+			fprintf(stderr, "image mismatch\n");
+		else
+			ret = EXIT_SUCCESS;
+
+		fwimage_unmap(&a);
+		fwimage_unmap(&b);
+	}
+
+out:
+	unlink(kernel_name);
+	unlink(rootfs_name);
+	unlink(buffered_name);
+	unlink(streamed_name);
+	return ret;
+}
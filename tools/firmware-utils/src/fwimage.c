@@ -0,0 +1,327 @@
+/*
+ * libfwimage - shared input/output helpers for the firmware image builders
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cyg_crc.h"
+#include "fwimage.h"
+
+/*
+ * All enabled digests are fed the same block before moving on.  This does
+ * not make hashing itself any cheaper, fwimage-bench shows it within 10%
+ * of separate passes over a buffer; it just lets a single pass over the
+ * data serve every digest.
+ */
+#define FWIMAGE_BLOCK	(32 * 1024)
+
+int fwimage_map(struct fwimage_file *f, const char *name)
+{
+	struct stat st;
+	int fd;
+
+	f->name = name;
+	f->data = NULL;
+	f->size = 0;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0)
+		goto err_close;
+
+	f->size = st.st_size;
+
+	/* mmap() refuses empty mappings */
+	if (f->size) {
+		f->data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (f->data == MAP_FAILED) {
+			f->data = NULL;
+			goto err_close;
+		}
+		madvise(f->data, f->size, MADV_SEQUENTIAL);
+	}
+
+	close(fd);
+	return 0;
+
+err_close:
+	close(fd);
+	return -1;
+}
+
+void fwimage_unmap(struct fwimage_file *f)
+{
+	if (f->data)
+		munmap(f->data, f->size);
+
+	f->data = NULL;
+	f->size = 0;
+}
+
+void fwimage_digest_init(struct fwimage_digest *d, unsigned int flags,
+			 uint32_t crc_init)
+{
+	memset(d, 0, sizeof(*d));
+	d->flags = flags;
+	d->crc32 = crc_init;
+
+	if (flags & FWIMAGE_MD5)
+		MD5_Init(&d->md5);
+	if (flags & FWIMAGE_SHA1)
+		sha1_starts(&d->sha1);
+}
+
+void fwimage_digest_update(struct fwimage_digest *d, const void *buf,
+			   size_t len)
+{
+	unsigned char *p = (unsigned char *) buf;
+	size_t n;
+
+	while (len) {
+		n = len > FWIMAGE_BLOCK ? FWIMAGE_BLOCK : len;
+
+		if (d->flags & FWIMAGE_CRC32)
+			d->crc32 = cyg_crc32_accumulate(d->crc32, p, n);
+		if (d->flags & FWIMAGE_MD5)
+			MD5_Update(&d->md5, p, n);
+		if (d->flags & FWIMAGE_SHA1)
+			sha1_update(&d->sha1, p, n);
+
+		p += n;
+		len -= n;
+	}
+}
+
+void fwimage_digest_final(struct fwimage_digest *d)
+{
+	if (d->flags & FWIMAGE_MD5)
+		MD5_Final(d->md5sum, &d->md5);
+	if (d->flags & FWIMAGE_SHA1)
+		sha1_finish(&d->sha1, d->sha1sum);
+}
+
+int fwimage_open(struct fwimage_writer *w, const char *name)
+{
+	memset(w, 0, sizeof(*w));
+	w->name = name;
+
+	w->buf = malloc(FWIMAGE_BUF_SIZE);
+	if (!w->buf)
+		return -1;
+
+	w->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0) {
+		free(w->buf);
+		w->buf = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* remember the first error, errno is restored when it is reported */
+static int fwimage_fail(struct fwimage_writer *w)
+{
+	if (!w->err)
+		w->err = errno ? errno : EIO;
+
+	return -1;
+}
+
+static int fwimage_flush(struct fwimage_writer *w)
+{
+	size_t fill = w->fill;
+
+	w->fill = 0;
+	if (write_all(w->fd, w->buf, fill))
+		return fwimage_fail(w);
+
+	return 0;
+}
+
+int fwimage_close(struct fwimage_writer *w)
+{
+	int ret = 0;
+
+	if (!w->err)
+		fwimage_flush(w);
+	if (close(w->fd) < 0)
+		fwimage_fail(w);
+
+	if (w->err) {
+		errno = w->err;
+		ret = -1;
+	}
+
+	free(w->buf);
+	w->buf = NULL;
+	w->fd = -1;
+
+	return ret;
+}
+
+void fwimage_abort(struct fwimage_writer *w)
+{
+	close(w->fd);
+	unlink(w->name);
+
+	free(w->buf);
+	w->buf = NULL;
+	w->fd = -1;
+}
+
+void fwimage_add_range(struct fwimage_writer *w, struct fwimage_range *r,
+		       off_t start, off_t end, unsigned int flags,
+		       uint32_t crc_init)
+{
+	r->start = start;
+	r->end = end;
+	fwimage_digest_init(&r->digest, flags, crc_init);
+
+	r->next = w->ranges;
+	w->ranges = r;
+}
+
+static void update_ranges(struct fwimage_writer *w, const char *data,
+			  size_t len)
+{
+	struct fwimage_range *r;
+	off_t start = w->offset;
+	off_t end = w->offset + len;
+	off_t s, e;
+
+	for (r = w->ranges; r; r = r->next) {
+		s = (r->start > start) ? r->start : start;
+		e = (r->end != FWIMAGE_END && r->end < end) ? r->end : end;
+
+		if (s < e)
+			fwimage_digest_update(&r->digest, data + (s - start),
+					      e - s);
+	}
+}
+
+int fwimage_write(struct fwimage_writer *w, const void *data, size_t len)
+{
+	if (w->err) {
+		errno = w->err;
+		return -1;
+	}
+
+	if (!len)
+		return 0;
+
+	update_ranges(w, data, len);
+	w->offset += len;
+
+	/* large blocks straight from the input mapping skip the buffer */
+	if (w->fill + len > FWIMAGE_BUF_SIZE) {
+		if (fwimage_flush(w))
+			return -1;
+
+		if (len >= FWIMAGE_BUF_SIZE) {
+			if (write_all(w->fd, data, len))
+				return fwimage_fail(w);
+			return 0;
+		}
+	}
+
+	memcpy(w->buf + w->fill, data, len);
+	w->fill += len;
+
+	return 0;
+}
+
+int fwimage_fill(struct fwimage_writer *w, int c, size_t len)
+{
+	size_t n;
+
+	if (w->err) {
+		errno = w->err;
+		return -1;
+	}
+
+	while (len) {
+		if (w->fill == FWIMAGE_BUF_SIZE && fwimage_flush(w))
+			return -1;
+
+		n = FWIMAGE_BUF_SIZE - w->fill;
+		if (n > len)
+			n = len;
+
+		memset(w->buf + w->fill, c, n);
+		update_ranges(w, w->buf + w->fill, n);
+		w->offset += n;
+		w->fill += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int fwimage_pad_to(struct fwimage_writer *w, int c, off_t offset)
+{
+	if (offset <= w->offset)
+		return 0;
+
+	return fwimage_fill(w, c, offset - w->offset);
+}
+
+int fwimage_pwrite(struct fwimage_writer *w, const void *data, size_t len,
+		   off_t offset)
+{
+	const char *p = data;
+	ssize_t n;
+
+	if (w->err) {
+		errno = w->err;
+		return -1;
+	}
+
+	if (fwimage_flush(w))
+		return -1;
+
+	while (len) {
+		n = pwrite(w->fd, p, len, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return fwimage_fail(w);
+		}
+		p += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
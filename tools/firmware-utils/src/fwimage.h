@@ -0,0 +1,112 @@
+/*
+ * libfwimage - shared input/output helpers for the firmware image builders
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#ifndef _FWIMAGE_H
+#define _FWIMAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "md5.h"
+#include "sha1.h"
+
+/*
+ * Input files are mapped read-only instead of being copied into a buffer,
+ * so the same kernel or rootfs used by several images only ever lives in
+ * the page cache.
+ */
+struct fwimage_file {
+	const char	*name;
+	void		*data;
+	size_t		size;
+};
+
+int fwimage_map(struct fwimage_file *f, const char *name);
+void fwimage_unmap(struct fwimage_file *f);
+
+/*
+ * Digests which can be computed together in a single pass over the data.
+ * The CRC32 is the raw Gary S. Brown register as returned by
+ * cyg_crc32_accumulate(), it is neither pre- nor post-inverted.
+ */
+#define FWIMAGE_CRC32	0x01
+#define FWIMAGE_MD5	0x02
+#define FWIMAGE_SHA1	0x04
+
+struct fwimage_digest {
+	unsigned int	flags;
+	uint32_t	crc32;
+	MD5_CTX		md5;
+	sha1_context	sha1;
+	uint8_t		md5sum[16];
+	uint8_t		sha1sum[20];
+};
+
+void fwimage_digest_init(struct fwimage_digest *d, unsigned int flags,
+			 uint32_t crc_init);
+void fwimage_digest_update(struct fwimage_digest *d, const void *buf,
+			   size_t len);
+void fwimage_digest_final(struct fwimage_digest *d);
+
+/*
+ * A digest over the output range [start, end). Ranges attached to a writer
+ * are updated while the data is written, bytes which are never written do
+ * not contribute.
+ */
+#define FWIMAGE_END	((off_t) -1)
+
+struct fwimage_range {
+	off_t			start;
+	off_t			end;
+	struct fwimage_digest	digest;
+	struct fwimage_range	*next;
+};
+
+/*
+ * Streaming writer. Output is written strictly in order; headers whose
+ * contents depend on the digest of the data are written as placeholders
+ * first and patched with fwimage_pwrite() once the data is out.
+ *
+ * The first failed write is latched: every later call fails as well and
+ * fwimage_close() reports it, so callers may check only the close.
+ */
+#define FWIMAGE_BUF_SIZE	(64 * 1024)
+
+struct fwimage_writer {
+	const char		*name;
+	int			fd;
+	off_t			offset;
+	size_t			fill;
+	char			*buf;
+	struct fwimage_range	*ranges;
+	int			err;
+};
+
+int fwimage_open(struct fwimage_writer *w, const char *name);
+int fwimage_close(struct fwimage_writer *w);
+void fwimage_abort(struct fwimage_writer *w);
+
+void fwimage_add_range(struct fwimage_writer *w, struct fwimage_range *r,
+		       off_t start, off_t end, unsigned int flags,
+		       uint32_t crc_init);
+
+int fwimage_write(struct fwimage_writer *w, const void *data, size_t len);
+int fwimage_fill(struct fwimage_writer *w, int c, size_t len);
+int fwimage_pad_to(struct fwimage_writer *w, int c, off_t offset);
+int fwimage_pwrite(struct fwimage_writer *w, const void *data, size_t len,
+		   off_t offset);
+
+static inline int fwimage_write_file(struct fwimage_writer *w,
+				     struct fwimage_file *f)
+{
+	return fwimage_write(w, f->data, f->size);
+}
+
+#endif /* _FWIMAGE_H */
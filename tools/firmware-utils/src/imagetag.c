@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <stdint.h>
 #include <time.h>
 #include <unistd.h>
@@ -18,6 +19,7 @@
 
 #include "bcm_tag.h"
 #include "imagetag_cmdline.h"
+#include "fwimage.h"
 
 #define DEADCODE			0xDEADC0DE
 
@@ -78,44 +80,6 @@ uint32_t crc32(uint32_t crc, uint8_t *data, size_t len)
 	return crc;
 }
 
-uint32_t compute_crc32(uint32_t crc, FILE *binfile, size_t compute_start, size_t compute_len)
-{
-	uint8_t readbuf[1024];
-	size_t read;
-
-	fseek(binfile, compute_start, SEEK_SET);
-
-	/* read block of 1024 bytes */
-	while (binfile && !feof(binfile) && !ferror(binfile) && (compute_len >= sizeof(readbuf))) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), binfile);
-		crc = crc32(crc, readbuf, read);
-		compute_len = compute_len - read;
-	}
-
-	/* Less than 1024 bytes remains, read compute_len bytes */
-	if (binfile && !feof(binfile) && !ferror(binfile) && (compute_len > 0)) {
-		read = fread(readbuf, sizeof(uint8_t), compute_len, binfile);
-		crc = crc32(crc, readbuf, read);
-	}
-
-	return crc;
-}
-
-size_t getlen(FILE *fp)
-{
-	size_t retval, curpos;
-
-	if (!fp)
-		return 0;
-
-	curpos = ftell(fp);
-	fseek(fp, 0, SEEK_END);
-	retval = ftell(fp);
-	fseek(fp, curpos, SEEK_SET);
-
-	return retval;
-}
-
 int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 			const struct gengetopt_args_info *args, \
 			uint32_t flash_start, uint32_t image_offset, \
@@ -123,14 +87,12 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 {
 	struct bcm_tag tag;
 	struct kernelhdr khdr;
-	FILE *kernelfile = NULL, *rootfsfile = NULL, *binfile = NULL, *cfefile = NULL;
+	struct fwimage_file kernelfile, rootfsfile, cfefile = { NULL };
+	struct fwimage_writer binfile;
+	struct fwimage_range kernelcrc, rootfscrc, kernelfscrc;
 	size_t cfeoff, cfelen, kerneloff, kernellen, rootfsoff, rootfslen, \
-	  read, imagelen, rootfsoffpadlen = 0, kernelfslen, kerneloffpadlen = 0, oldrootfslen;
-	uint8_t readbuf[1024];
-	uint32_t imagecrc = IMAGETAG_CRC_START;
-	uint32_t kernelcrc = IMAGETAG_CRC_START;
-	uint32_t rootfscrc = IMAGETAG_CRC_START;
-	uint32_t kernelfscrc = IMAGETAG_CRC_START;
+	  imagelen, rootfsoffpadlen = 0, kernelfslen, kerneloffpadlen = 0, oldrootfslen;
+	size_t kernelpos, rootfspos, padlen = 0;
 	uint32_t fwaddr = 0;
 	uint8_t crc_val;
 	const uint32_t deadcode = htonl(DEADCODE);
@@ -139,45 +101,43 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 
 
 	memset(&tag, 0, sizeof(struct bcm_tag));
+	memset(&khdr, 0, sizeof(khdr));
 
 	if (!kernel || !rootfs) {
 		fprintf(stderr, "imagetag can't create an image without both kernel and rootfs\n");
+		return 1;
 	}
 
-	if (kernel && !(kernelfile = fopen(kernel, "rb"))) {
+	if (fwimage_map(&kernelfile, kernel)) {
 		fprintf(stderr, "Unable to open kernel \"%s\"\n", kernel);
 		return 1;
 	}
 
-	if (rootfs && !(rootfsfile = fopen(rootfs, "rb"))) {
+	if (fwimage_map(&rootfsfile, rootfs)) {
 		fprintf(stderr, "Unable to open rootfs \"%s\"\n", rootfs);
 		return 1;
 	}
 
-	if (!bin || !(binfile = fopen(bin, "wb+"))) {
+	if (!bin || fwimage_open(&binfile, bin)) {
 		fprintf(stderr, "Unable to open output file \"%s\"\n", bin);
 		return 1;
 	}
 
 	if ((args->cfe_given) && (args->cfe_arg)) {
-	  if (!(cfefile = fopen(args->cfe_arg, "rb"))) {
+	  if (fwimage_map(&cfefile, args->cfe_arg)) {
 		fprintf(stderr, "Unable to open CFE file \"%s\"\n", args->cfe_arg);
 	  }
 	}
 
+	/*
+	 * The image is written front to back in a single pass, the checksums
+	 * are collected on the way over the ranges the loader verifies. The
+	 * tag goes first as a placeholder and is filled in at the end.
+	 */
 	fwaddr = flash_start + image_offset;
-	if (cfefile) {
-	  cfeoff = flash_start;		  
-	  cfelen = getlen(cfefile);
-	  /* Seek to the start of the file after tag */
-	  fseek(binfile, sizeof(tag), SEEK_SET);
-	  
-	  /* Write the cfe */
-	  while (cfefile && !feof(cfefile) && !ferror(cfefile)) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), cfefile);
-		fwrite(readbuf, sizeof(uint8_t), read, binfile);
-	  }
-
+	if (cfefile.data) {
+	  cfeoff = flash_start;
+	  cfelen = cfefile.size;
 	} else {
 	  cfeoff = 0;
 	  cfelen = 0;
@@ -187,7 +147,7 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 	  /* Build the kernel address and length (doesn't need to be aligned, read only) */
 	  kerneloff = fwaddr + sizeof(tag);
 	  
-	  kernellen = getlen(kernelfile);
+	  kernellen = kernelfile.size;
 	  
 	  if (!args->kernel_file_has_header_flag) {
 		/* Build the kernel header */
@@ -202,59 +162,31 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 	  /* Build the rootfs address and length (start and end do need to be aligned on flash erase block boundaries */
 	  rootfsoff = kerneloff + kernellen;
 	  rootfsoff = (rootfsoff % block_size) > 0 ? (((rootfsoff / block_size) + 1) * block_size) : rootfsoff;
-	  rootfslen = getlen(rootfsfile);
+	  rootfslen = rootfsfile.size;
 	  rootfslen = ( (rootfslen % block_size) > 0 ? (((rootfslen / block_size) + 1) * block_size) : rootfslen );
 	  imagelen = rootfsoff + rootfslen - kerneloff + sizeof(deadcode);
 	  rootfsoffpadlen = rootfsoff - (kerneloff + kernellen);
-	  
-	  /* Seek to the start of the kernel */
-	  fseek(binfile, kerneloff - fwaddr + cfelen, SEEK_SET);
-	  
-	  /* Write the kernel header */
-	  fwrite(&khdr, sizeof(khdr), 1, binfile);
-	  
-	  /* Write the kernel */
-	  while (kernelfile && !feof(kernelfile) && !ferror(kernelfile)) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), kernelfile);
-		fwrite(readbuf, sizeof(uint8_t), read, binfile);
-	  }
-
-	  /* Write the RootFS */
-	  fseek(binfile, rootfsoff - fwaddr + cfelen, SEEK_SET);
-	  while (rootfsfile && !feof(rootfsfile) && !ferror(rootfsfile)) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), rootfsfile);
-		fwrite(readbuf, sizeof(uint8_t), read, binfile);
-	  }
-
-	  /* Align image to specified erase block size and append deadc0de */
-	  printf("Data alignment to %dk with 'deadc0de' appended\n", block_size/1024);
-	  fseek(binfile, rootfsoff + rootfslen - fwaddr + cfelen, SEEK_SET);
-	  fwrite(&deadcode, sizeof(uint32_t), 1, binfile);
 
 	  oldrootfslen = rootfslen;
 	  if (args->pad_given) {
-		uint32_t allfs = 0xffffffff;
 		uint32_t pad_size = args->pad_arg * 1024 * 1024;
 
 		printf("Padding image to %d bytes ...\n", pad_size);
-		while (imagelen < pad_size) {
-			fwrite(&allfs, sizeof(uint32_t), 1, binfile);
-			imagelen += 4;
-			rootfslen += 4;
-		}
+		if (imagelen < pad_size)
+			padlen = (pad_size - imagelen + 3) & ~3;
+		imagelen += padlen;
+		rootfslen += padlen;
 	  }
 
-	  /* Flush the binfile buffer so that when we read from file, it contains
-	   * everything in the buffer
-	   */
-	  fflush(binfile);
+	  kernelpos = kerneloff - fwaddr + cfelen;
+	  rootfspos = rootfsoff - fwaddr + cfelen;
 
-	  /* Compute the crc32 of the entire image (deadC0de included) */
-	  imagecrc = compute_crc32(imagecrc, binfile, kerneloff - fwaddr + cfelen, imagelen);
-	  /* Compute the crc32 of the kernel and padding between kernel and rootfs) */
-	  kernelcrc = compute_crc32(kernelcrc, binfile, kerneloff - fwaddr + cfelen, kernellen + rootfsoffpadlen);
 	  /* Compute the crc32 of the kernel and padding between kernel and rootfs) */
-	  kernelfscrc = compute_crc32(kernelfscrc, binfile, kerneloff - fwaddr + cfelen, kernellen + rootfsoffpadlen + rootfslen + sizeof(deadcode));
+	  fwimage_add_range(&binfile, &kernelcrc, kernelpos, kernelpos + kernellen + rootfsoffpadlen,
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
+	  /* Compute the crc32 of the kernel, the rootfs and the padding in between */
+	  fwimage_add_range(&binfile, &kernelfscrc, kernelpos, kernelpos + kernellen + rootfsoffpadlen + rootfslen + sizeof(deadcode),
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
 	  /* Compute the crc32 of the flashImageStart to rootLength.
 	   * The broadcom firmware assumes the rootfs starts the image,
 	   * therefore uses the rootfs start to determine where to flash
@@ -264,70 +196,86 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 	   * length to determine the length of image to flash and thus
 	   * needs to be rootfs + deadcode
 	   */
-	  rootfscrc = compute_crc32(rootfscrc, binfile, kerneloff - fwaddr + cfelen, rootfslen + sizeof(deadcode));
+	  fwimage_add_range(&binfile, &rootfscrc, kernelpos, kernelpos + rootfslen + sizeof(deadcode),
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
+
+	  /* Write the tag placeholder and the cfe */
+	  fwimage_fill(&binfile, 0, sizeof(tag));
+	  fwimage_write_file(&binfile, &cfefile);
+
+	  /* Write the kernel header and the kernel */
+	  fwimage_write(&binfile, &khdr, sizeof(khdr));
+	  fwimage_write(&binfile, kernelfile.data,
+			(kernelpos + sizeof(khdr) + kernelfile.size > rootfspos) ?
+			rootfspos - kernelpos - sizeof(khdr) : kernelfile.size);
+
+	  /* Write the RootFS */
+	  fwimage_pad_to(&binfile, 0, rootfspos);
+	  fwimage_write_file(&binfile, &rootfsfile);
+
+	  /* Align image to specified erase block size and append deadc0de */
+	  printf("Data alignment to %dk with 'deadc0de' appended\n", block_size/1024);
+	  fwimage_pad_to(&binfile, 0, rootfspos + oldrootfslen);
+	  fwimage_write(&binfile, &deadcode, sizeof(uint32_t));
+	  fwimage_fill(&binfile, 0xff, padlen);
 
 	} else {
 	  /* Build the kernel address and length (doesn't need to be aligned, read only) */
 	  rootfsoff = fwaddr + sizeof(tag);
-	  oldrootfslen = getlen(rootfsfile);
+	  oldrootfslen = rootfsfile.size;
 	  rootfslen = oldrootfslen;
 	  rootfslen = ( (rootfslen % block_size) > 0 ? (((rootfslen / block_size) + 1) * block_size) : rootfslen );
 	  kerneloffpadlen = rootfslen - oldrootfslen;
 	  oldrootfslen = rootfslen;
 
 	  kerneloff = rootfsoff + rootfslen;
-	  kernellen = getlen(kernelfile);
+	  kernellen = kernelfile.size;
 
 	  imagelen = cfelen + rootfslen + kernellen;
 	  
-	  /* Seek to the start of the kernel */
-	  fseek(binfile, kerneloff - fwaddr + cfelen, SEEK_SET);
-	  
 	  if (!args->kernel_file_has_header_flag) {
 		/* Build the kernel header */
 		khdr.loadaddr	= htonl(load_address);
 		khdr.entry	= htonl(entry);
 		khdr.lzmalen	= htonl(kernellen);
 		
-		/* Write the kernel header */
-		fwrite(&khdr, sizeof(khdr), 1, binfile);
-	  
 		/* Increase the kernel size by the header size */
 		kernellen += sizeof(khdr);	  
 	  }
-	  
-	  /* Write the kernel */
-	  while (kernelfile && !feof(kernelfile) && !ferror(kernelfile)) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), kernelfile);
-		fwrite(readbuf, sizeof(uint8_t), read, binfile);
-	  }
 
-	  /* Write the RootFS */
-	  fseek(binfile, rootfsoff - fwaddr + cfelen, SEEK_SET);
-	  while (rootfsfile && !feof(rootfsfile) && !ferror(rootfsfile)) {
-		read = fread(readbuf, sizeof(uint8_t), sizeof(readbuf), rootfsfile);
-		fwrite(readbuf, sizeof(uint8_t), read, binfile);
-	  }
+	  kernelpos = kerneloff - fwaddr + cfelen;
+	  rootfspos = rootfsoff - fwaddr + cfelen;
 
-	  /* Flush the binfile buffer so that when we read from file, it contains
-	   * everything in the buffer
-	   */
-	  fflush(binfile);
-
-	  /* Compute the crc32 of the entire image (deadC0de included) */
-	  imagecrc = compute_crc32(imagecrc, binfile, sizeof(tag), imagelen);
 	  /* Compute the crc32 of the kernel and padding between kernel and rootfs) */
-	  kernelcrc = compute_crc32(kernelcrc, binfile, kerneloff - fwaddr + cfelen, kernellen + rootfsoffpadlen);
-	  kernelfscrc = compute_crc32(kernelfscrc, binfile, rootfsoff - fwaddr + cfelen, kernellen + rootfslen);
-	  rootfscrc = compute_crc32(rootfscrc, binfile, rootfsoff - fwaddr + cfelen, rootfslen);
-	}
+	  fwimage_add_range(&binfile, &kernelcrc, kernelpos, kernelpos + kernellen + rootfsoffpadlen,
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
+	  fwimage_add_range(&binfile, &kernelfscrc, rootfspos, rootfspos + kernellen + rootfslen,
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
+	  fwimage_add_range(&binfile, &rootfscrc, rootfspos, rootfspos + rootfslen,
+			    FWIMAGE_CRC32, IMAGETAG_CRC_START);
+
+	  /* Write the tag placeholder and the cfe */
+	  fwimage_fill(&binfile, 0, sizeof(tag));
+	  fwimage_write_file(&binfile, &cfefile);
 
-	/* Close the files */
-	if (cfefile) {
-	  fclose(cfefile);
+	  /* Write the RootFS */
+	  fwimage_write_file(&binfile, &rootfsfile);
+
+	  /* Write the kernel header and the kernel */
+	  fwimage_pad_to(&binfile, 0, kernelpos);
+	  if (!args->kernel_file_has_header_flag)
+		fwimage_write(&binfile, &khdr, sizeof(khdr));
+	  fwimage_write_file(&binfile, &kernelfile);
 	}
-	fclose(kernelfile);
-	fclose(rootfsfile);
+
+	fwimage_digest_final(&kernelcrc.digest);
+	fwimage_digest_final(&rootfscrc.digest);
+	fwimage_digest_final(&kernelfscrc.digest);
+
+	/* Release the input files */
+	fwimage_unmap(&cfefile);
+	fwimage_unmap(&kernelfile);
+	fwimage_unmap(&rootfsfile);
 
 	/* Build the tag */
 	strncpy(tag.tagVersion, args->tag_version_arg, sizeof(tag.tagVersion) - 1);
@@ -403,21 +351,23 @@ int tagfile(const char *kernel, const char *rootfs, const char *bin, \
 	}
 
 	if ( !is_pirelli ) {
-	  int2tag(tag.imageCRC, kernelfscrc);
+	  int2tag(tag.imageCRC, kernelfscrc.digest.crc32);
 	} else {
-	  int2tag(tag.imageCRC, kernelcrc);
+	  int2tag(tag.imageCRC, kernelcrc.digest.crc32);
 	}
 
-	int2tag(&(tag.rootfsCRC[0]), rootfscrc);
-	int2tag(tag.kernelCRC, kernelcrc);
-	int2tag(tag.fskernelCRC, kernelfscrc);
+	int2tag(&(tag.rootfsCRC[0]), rootfscrc.digest.crc32);
+	int2tag(tag.kernelCRC, kernelcrc.digest.crc32);
+	int2tag(tag.fskernelCRC, kernelfscrc.digest.crc32);
 	int2tag(tag.headerCRC, crc32(IMAGETAG_CRC_START, (uint8_t*)&tag, sizeof(tag) - 20));
 
-	fseek(binfile, 0L, SEEK_SET);
-	fwrite(&tag, sizeof(uint8_t), sizeof(tag), binfile);
-
-    fflush(binfile);
-	fclose(binfile);
+	/* write errors are latched by the writer, the close reports them */
+	fwimage_pwrite(&binfile, &tag, sizeof(tag), 0);
+	if (fwimage_close(&binfile)) {
+		fprintf(stderr, "Unable to write output file \"%s\": %s\n", bin, strerror(errno));
+		unlink(bin);
+		return 1;
+	}
 
 	return 0;
 }
@@ -20,12 +20,14 @@
 #include <getopt.h>     /* for getopt() */
 #include <stdarg.h>
 #include <errno.h>
+#include <stddef.h>
 #include <sys/stat.h>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
 #include "md5.h"
+#include "fwimage.h"
 
 #define ALIGN(x,a) ({ typeof(a) __a = (a); (((x) + __a - 1) & ~(__a - 1)); })
 
@@ -580,10 +582,8 @@ static int check_options(void)
 	return 0;
 }
 
-static void fill_header(char *buf, int len)
+static void fill_header(struct fw_header *hdr)
 {
-	struct fw_header *hdr = (struct fw_header *)buf;
-
 	memset(hdr, 0, sizeof(struct fw_header));
 
 	hdr->version = htonl(HEADER_VERSION_V1);
@@ -592,6 +592,7 @@ static void fill_header(char *buf, int len)
 	hdr->hw_id = htonl(hw_id);
 	hdr->hw_rev = htonl(hw_rev);
 
+	/* the salt is replaced by the final md5sum once the image is written */
 	if (boot_info.file_size == 0)
 		memcpy(hdr->md5sum1, md5salt_normal, sizeof(hdr->md5sum1));
 	else
@@ -610,16 +611,14 @@ static void fill_header(char *buf, int len)
 	hdr->ver_hi = htons(fw_ver_hi);
 	hdr->ver_mid = htons(fw_ver_mid);
 	hdr->ver_lo = htons(fw_ver_lo);
-
-	get_md5(buf, len, hdr->md5sum1);
 }
 
-static int pad_jffs2(char *buf, int currlen)
+static int pad_jffs2(struct fwimage_writer *w)
 {
-	int len;
+	uint32_t len;
 	uint32_t pad_mask;
 
-	len = currlen;
+	len = w->offset;
 	pad_mask = (64 * 1024);
 	while ((len < layout->fw_max_len) && (pad_mask != 0)) {
 		uint32_t mask;
@@ -639,102 +638,89 @@ static int pad_jffs2(char *buf, int currlen)
 				pad_mask &= ~mask;
 		}
 
-		for (i = 0; i < sizeof(jffs2_eof_mark); i++)
-			buf[len + i] = jffs2_eof_mark[i];
+		if (fwimage_pad_to(w, 0xff, len) ||
+		    fwimage_write(w, jffs2_eof_mark, sizeof(jffs2_eof_mark)))
+			return -1;
 
 		len += sizeof(jffs2_eof_mark);
 	}
 
-	return len;
+	return 0;
 }
 
-static int write_fw(char *data, int len)
+static int build_fw(void)
 {
-	FILE *f;
+	struct fwimage_writer w;
+	struct fwimage_range md5;
+	struct fwimage_file kernel;
+	struct fwimage_file rootfs = { NULL };
+	struct fw_header hdr;
 	int ret = EXIT_FAILURE;
+	uint32_t writelen;
 
-	f = fopen(ofname, "w");
-	if (f == NULL) {
-		ERRS("could not open \"%s\" for writing", ofname);
+	if (fwimage_map(&kernel, kernel_info.file_name)) {
+		ERRS("could not open \"%s\" for reading", kernel_info.file_name);
 		goto out;
 	}
 
-	errno = 0;
-	fwrite(data, len, 1, f);
-	if (errno) {
-		ERRS("unable to write output file");
-		goto out_flush;
+	if (!combined && fwimage_map(&rootfs, rootfs_info.file_name)) {
+		ERRS("could not open \"%s\" for reading", rootfs_info.file_name);
+		goto out_unmap;
 	}
 
-	DBG("firmware file \"%s\" completed", ofname);
-
-	ret = EXIT_SUCCESS;
-
- out_flush:
-	fflush(f);
-	fclose(f);
-	if (ret != EXIT_SUCCESS) {
-		unlink(ofname);
+	if (fwimage_open(&w, ofname)) {
+		ERRS("could not open \"%s\" for writing", ofname);
+		goto out_unmap;
 	}
- out:
-	return ret;
-}
-
-static int build_fw(void)
-{
-	int buflen;
-	char *buf;
-	char *p;
-	int ret = EXIT_FAILURE;
-	int writelen = 0;
-
-	buflen = layout->fw_max_len;
 
-	buf = malloc(buflen);
-	if (!buf) {
-		ERR("no memory for buffer\n");
-		goto out;
-	}
+	/* the md5sum covers everything, including the salted header */
+	fwimage_add_range(&w, &md5, 0, FWIMAGE_END, FWIMAGE_MD5, 0);
 
-	memset(buf, 0xff, buflen);
-	p = buf + sizeof(struct fw_header);
-	ret = read_to_buf(&kernel_info, p);
-	if (ret)
-		goto out_free_buf;
+	fill_header(&hdr);
+	if (fwimage_write(&w, &hdr, sizeof(hdr)) ||
+	    fwimage_write_file(&w, &kernel))
+		goto out_write;
 
 	writelen = sizeof(struct fw_header) + kernel_len;
 
 	if (!combined) {
-		if (rootfs_align)
-			p = buf + writelen;
-		else
-			p = buf + rootfs_ofs;
+		if (!rootfs_align)
+			writelen = rootfs_ofs;
 
-		ret = read_to_buf(&rootfs_info, p);
-		if (ret)
-			goto out_free_buf;
-
-		if (rootfs_align)
-			writelen += rootfs_info.file_size;
-		else
-			writelen = rootfs_ofs + rootfs_info.file_size;
+		if (fwimage_pad_to(&w, 0xff, writelen) ||
+		    fwimage_write_file(&w, &rootfs))
+			goto out_write;
 
-		if (add_jffs2_eof)
-			writelen = pad_jffs2(buf, writelen);
+		if (add_jffs2_eof && pad_jffs2(&w))
+			goto out_write;
 	}
 
-	if (!strip_padding)
-		writelen = buflen;
+	if (!strip_padding &&
+	    fwimage_pad_to(&w, 0xff, layout->fw_max_len))
+		goto out_write;
 
-	fill_header(buf, writelen);
-	ret = write_fw(buf, writelen);
-	if (ret)
-		goto out_free_buf;
+	fwimage_digest_final(&md5.digest);
+	if (fwimage_pwrite(&w, md5.digest.md5sum, sizeof(hdr.md5sum1),
+			   offsetof(struct fw_header, md5sum1)))
+		goto out_write;
 
-	ret = EXIT_SUCCESS;
+	if (fwimage_close(&w)) {
+		ERRS("unable to write output file");
+		unlink(ofname);
+		goto out_unmap;
+	}
 
- out_free_buf:
-	free(buf);
+	DBG("firmware file \"%s\" completed", ofname);
+
+	ret = EXIT_SUCCESS;
+	goto out_unmap;
+
+ out_write:
+	ERRS("unable to write output file");
+	fwimage_abort(&w);
+ out_unmap:
+	fwimage_unmap(&rootfs);
+	fwimage_unmap(&kernel);
  out:
 	return ret;
 }
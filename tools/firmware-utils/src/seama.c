@@ -50,6 +50,7 @@
 
 #include "md5.h"
 #include "seama.h"
+#include "fwimage.h"
 
 #define PROGNAME			"seama"
 #define VERSION				"0.20"
@@ -164,24 +165,6 @@ static size_t calculate_digest(FILE * fh, size_t size, uint8_t * digest)
 	return bytes_read;
 }
 
-#define READ_BUFF_SIZE 8*1024
-static size_t copy_file(FILE * to, FILE * from)
-{
-	size_t i, fsize = 0;
-	uint8_t buf[READ_BUFF_SIZE];
-
-	while (!feof(from) && !ferror(from))
-	{
-		i = fread(buf, sizeof(uint8_t), READ_BUFF_SIZE, from);
-		if (i > 0)
-		{
-			fsize += i;
-			fwrite(buf, sizeof(uint8_t), i, to);
-		}
-	}
-	return fsize;
-}
-
 static int verify_seama(const char * fname, int msg)
 {
 	FILE * fh = NULL;
@@ -270,7 +253,7 @@ static int verify_seama(const char * fname, int msg)
 	return ret;
 }
 
-static size_t write_seama_header(FILE * fh, char * meta[], size_t msize, size_t size)
+static size_t write_seama_header(struct fwimage_writer * w, char * meta[], size_t msize, size_t size)
 {
 	seamahdr_t shdr;
 	size_t i;
@@ -289,15 +272,15 @@ static size_t write_seama_header(FILE * fh, char * meta[], size_t msize, size_t
 	shdr.size		= htonl(size);
 
 	/* Write the header */
-	return fwrite(&shdr, sizeof(seamahdr_t), 1, fh);
+	return fwimage_write(w, &shdr, sizeof(seamahdr_t)) ? 0 : 1;
 }
 
-static size_t write_checksum(FILE * fh, uint8_t * checksum)
+static size_t write_checksum(struct fwimage_writer * w, uint8_t * checksum)
 {
-	return fwrite(checksum, sizeof(uint8_t), 16, fh);
+	return fwimage_write(w, checksum, 16) ? 0 : 16;
 }
 
-static size_t write_meta_data(FILE * fh, char * meta[], size_t size)
+static size_t write_meta_data(struct fwimage_writer * w, char * meta[], size_t size)
 {
 	size_t i,j;
 	size_t ret = 0;
@@ -305,16 +288,15 @@ static size_t write_meta_data(FILE * fh, char * meta[], size_t size)
 	for (i=0; i<size; i++)
 	{
 		verbose("SEAMA META data : %s\n", meta[i]);
-		j = fwrite(meta[i], sizeof(char), strlen(meta[i])+1, fh);
-		if (j != strlen(meta[i])+1) return 0;
+		j = strlen(meta[i])+1;
+		if (fwimage_write(w, meta[i], j)) return 0;
 		ret += j;
 	}
 	//+++ let meta data end on 4 alignment by siyou. 2010/3/1 03:58pm
 	j = ((ret+3)/4)*4;
-	for ( ; ret < j; ret++)
-		fwrite("", sizeof(char), 1, fh);
+	if (fwimage_fill(w, 0, j - ret)) return 0;
 
-	return ret;
+	return j;
 }
 
 /*******************************************************************/
@@ -326,8 +308,8 @@ static void dump_seama(const char * fname)
 
 static void seal_files(const char * file)
 {
-	FILE * fh;
-	FILE * ifh;
+	struct fwimage_writer w;
+	struct fwimage_file in;
 	size_t i;
 
 	/* Each image should be seama. */
@@ -341,58 +323,59 @@ static void seal_files(const char * file)
 	}
 
 	/* Open file for write */
-	fh = fopen(file, "w+");
-	if (fh)
+	if (fwimage_open(&w, file) == 0)
 	{
 		/* Write the header. */
-		write_seama_header(fh, o_meta, o_msize, 0);
-		write_meta_data(fh, o_meta, o_msize);
+		write_seama_header(&w, o_meta, o_msize, 0);
+		write_meta_data(&w, o_meta, o_msize);
 
 		/* Write image files */
 		for (i=0; i<o_isize; i++)
 		{
-			ifh = fopen(o_images[i], "r+");
-			if (ifh)
+			if (fwimage_map(&in, o_images[i]) == 0)
 			{
-				copy_file(fh, ifh);
-				fclose(ifh);
+				fwimage_write_file(&w, &in);
+				fwimage_unmap(&in);
 			}
 		}
 
-		fclose(fh);
+		fwimage_close(&w);
 	}
 }
 
 static void pack_files(void)
 {
-	FILE * fh;
-	FILE * ifh;
-	size_t i, fsize;
+	struct fwimage_writer w;
+	struct fwimage_range md5;
+	struct fwimage_file in;
+	size_t i;
 	char filename[512];
 	uint8_t digest[16];
 
 	for (i=0; i<o_isize; i++)
 	{
-		/* Open the input file. */
-		ifh = fopen(o_images[i], "r+");
-		if (ifh)
+		/* Map the input file. */
+		if (fwimage_map(&in, o_images[i]) == 0)
 		{
-			fsize = calculate_digest(ifh, 0, digest);
-			verbose("file size (%s) : %d\n", o_images[i], fsize);
-			rewind(ifh);
+			verbose("file size (%s) : %d\n", o_images[i], in.size);
 
 			/* Open the output file. */
 			sprintf(filename, "%s.seama", o_images[i]);
-			fh = fopen(filename, "w+");
-			if (fh)
+			if (fwimage_open(&w, filename) == 0)
 			{
-				write_seama_header(fh, o_meta, o_msize, fsize);
-				write_checksum(fh, digest);
-				write_meta_data(fh, o_meta, o_msize);
-				copy_file(fh, ifh);
-				fclose(fh);
+				/* The checksum is filled in once the image went by. */
+				memset(digest, 0, sizeof(digest));
+				write_seama_header(&w, o_meta, o_msize, in.size);
+				write_checksum(&w, digest);
+				write_meta_data(&w, o_meta, o_msize);
+
+				fwimage_add_range(&w, &md5, w.offset, FWIMAGE_END, FWIMAGE_MD5, 0);
+				fwimage_write_file(&w, &in);
+				fwimage_digest_final(&md5.digest);
+				fwimage_pwrite(&w, md5.digest.md5sum, sizeof(digest), sizeof(seamahdr_t));
+				fwimage_close(&w);
 			}
-			fclose(ifh);
+			fwimage_unmap(&in);
 		}
 		else
 		{
@@ -0,0 +1,835 @@
+/*
+ * ipkg-index - generate an opkg Packages index for a directory of packages
+ *
+ * Copyright (C) 2013 OpenWrt.org
+ *
+ * Produces exactly the same output as scripts/ipkg-make-index.sh, but reads
+ * every package only once: the MD5 sum is computed over the mapped file and
+ * the control file is pulled out of the nested tar.gz archives in memory,
+ * without forking ls, md5sum, tar and sed for each package. Packages are
+ * indexed by a pool of worker threads and the result of each package can be
+ * kept in a cache file, so unchanged packages are not read at all on the
+ * next run.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include "md5.h"
+
+static char *progname;
+
+#define ERR(fmt, ...) do { \
+	fflush(0); \
+	fprintf(stderr, "[%s] *** error: " fmt "\n", \
+			progname, ## __VA_ARGS__ ); \
+} while (0)
+
+#define ERRS(fmt, ...) do { \
+	int save = errno; \
+	fflush(0); \
+	fprintf(stderr, "[%s] *** error: " fmt ", %s\n", \
+			progname, ## __VA_ARGS__, strerror(save)); \
+} while (0)
+
+#define TAR_BLOCK	512
+#define ALIGN(_x,_y)	(((_x) + ((_y) - 1)) & ~((_y) - 1))
+
+#define MAX_JOBS	64
+#define CACHE_MAGIC	"ipkg-index-cache 1\n"
+
+struct buf {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct pkg {
+	char *path;		/* as printed by find */
+	char *key;		/* absolute path, used as cache key */
+
+	long long mtime_sec;
+	long mtime_nsec;
+	long long size;
+
+	int valid;		/* control file found */
+	char md5[33];
+	char *control;
+	size_t control_len;
+	int control_owned;
+
+	struct buf out;
+	int done;
+};
+
+struct cache_entry {
+	const char *key;
+	long long mtime_sec;
+	long mtime_nsec;
+	long long size;
+	const char *md5;
+	const char *control;
+	size_t control_len;
+};
+
+static struct pkg *pkgs;
+static size_t n_pkgs;
+static size_t pkgs_size;
+static size_t next_pkg;
+
+static struct cache_entry *cache;
+static size_t n_cache;
+static char *cache_data;
+static int cache_misses;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+
+	if (!p) {
+		ERR("Out of memory");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		ERR("Out of memory");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void buf_add(struct buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->size) {
+		b->size = ALIGN(b->len + len + 1, 1024);
+		b->data = xrealloc(b->data, b->size);
+	}
+
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void buf_add_str(struct buf *b, const char *s)
+{
+	buf_add(b, s, strlen(s));
+}
+
+/*
+ * gzip decompression straight from memory
+ */
+struct gz_reader {
+	z_stream z;
+	int eof;
+};
+
+static int gz_open(struct gz_reader *r, const void *data, size_t len)
+{
+	memset(r, 0, sizeof(*r));
+
+	if (len > UINT_MAX)
+		return -1;
+
+	r->z.next_in = (Bytef *) data;
+	r->z.avail_in = len;
+
+	return inflateInit2(&r->z, 16 + MAX_WBITS) == Z_OK ? 0 : -1;
+}
+
+static void gz_close(struct gz_reader *r)
+{
+	inflateEnd(&r->z);
+}
+
+static size_t gz_read(struct gz_reader *r, void *data, size_t len)
+{
+	int ret;
+
+	r->z.next_out = data;
+	r->z.avail_out = len;
+
+	while (r->z.avail_out && !r->eof) {
+		ret = inflate(&r->z, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END) {
+			/* concatenated gzip members are one stream for gzip(1) */
+			if (r->z.avail_in && r->z.next_in[0] == 0x1f &&
+			    inflateReset(&r->z) == Z_OK)
+				continue;
+
+			r->eof = 1;
+		} else if (ret != Z_OK) {
+			r->eof = 1;
+		}
+	}
+
+	return len - r->z.avail_out;
+}
+
+static int gz_skip(struct gz_reader *r, size_t len)
+{
+	char scratch[16 * 1024];
+	size_t n;
+
+	while (len) {
+		n = len > sizeof(scratch) ? sizeof(scratch) : len;
+		if (gz_read(r, scratch, n) != n)
+			return -1;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Just enough of a tar reader to pull a single regular file out of the
+ * archives written by ipkg-build, including GNU long names.
+ */
+static unsigned long long tar_number(const unsigned char *p, size_t len)
+{
+	unsigned long long val = 0;
+
+	while (len && (*p == ' ' || *p == '\0')) {
+		p++;
+		len--;
+	}
+
+	while (len && *p >= '0' && *p <= '7') {
+		val = (val << 3) | (*p++ - '0');
+		len--;
+	}
+
+	return val;
+}
+
+static const char *strip_dot_slash(const char *name)
+{
+	while (name[0] == '.' && name[1] == '/')
+		name += 2;
+
+	return name;
+}
+
+static char *tar_find(struct gz_reader *r, const char *name, size_t *len)
+{
+	unsigned char hdr[TAR_BLOCK];
+	char member[256 + 1];
+	char *longname = NULL;
+	const char *cur;
+	unsigned long long size;
+	char *data;
+
+	name = strip_dot_slash(name);
+
+	while (gz_read(r, hdr, TAR_BLOCK) == TAR_BLOCK && hdr[0]) {
+		size = tar_number(hdr + 124, 12);
+
+		if (hdr[156] == 'L') {
+			free(longname);
+			longname = xmalloc(size + 1);
+			if (gz_read(r, longname, size) != size ||
+			    gz_skip(r, ALIGN(size, TAR_BLOCK) - size))
+				break;
+			longname[size] = 0;
+			continue;
+		}
+
+		if (longname) {
+			cur = longname;
+		} else if (!memcmp(hdr + 257, "ustar", 5) && hdr[345]) {
+			snprintf(member, sizeof(member), "%.155s/%.100s",
+				 (char *) hdr + 345, (char *) hdr);
+			cur = member;
+		} else {
+			snprintf(member, sizeof(member), "%.100s", (char *) hdr);
+			cur = member;
+		}
+
+		if ((hdr[156] == '0' || hdr[156] == '\0' || hdr[156] == '7') &&
+		    !strcmp(strip_dot_slash(cur), name)) {
+			free(longname);
+
+			data = xmalloc(size + 1);
+			if (gz_read(r, data, size) != size) {
+				free(data);
+				return NULL;
+			}
+
+			*len = size;
+			return data;
+		}
+
+		free(longname);
+		longname = NULL;
+
+		if (gz_skip(r, ALIGN(size, TAR_BLOCK)))
+			break;
+	}
+
+	free(longname);
+	return NULL;
+}
+
+static char *extract_control(const void *data, size_t len, size_t *control_len)
+{
+	struct gz_reader r;
+	char *inner, *control = NULL;
+	size_t inner_len;
+
+	if (gz_open(&r, data, len))
+		return NULL;
+
+	inner = tar_find(&r, "./control.tar.gz", &inner_len);
+	gz_close(&r);
+
+	if (!inner)
+		return NULL;
+
+	if (!gz_open(&r, inner, inner_len)) {
+		control = tar_find(&r, "./control", control_len);
+		gz_close(&r);
+	}
+
+	free(inner);
+	return control;
+}
+
+static void md5_hex(const void *data, size_t len, char *hex)
+{
+	static const char digits[] = "0123456789abcdef";
+	struct md5_ctx ctx;
+	uint8_t digest[16];
+	int i;
+
+	md5_init(&ctx);
+	md5_update(&ctx, data, len);
+	md5_final(&ctx, digest);
+
+	for (i = 0; i < 16; i++) {
+		hex[i * 2] = digits[digest[i] >> 4];
+		hex[i * 2 + 1] = digits[digest[i] & 0xf];
+	}
+	hex[32] = 0;
+}
+
+/*
+ * Cache of previously indexed packages, keyed on path, mtime and size.
+ *
+ * Each entry is a tab separated header line followed by the raw control
+ * file and a newline:
+ *
+ *   <path> TAB <mtime> TAB <size> TAB <md5> TAB <control length> LF
+ */
+static int cache_cmp(const void *a, const void *b)
+{
+	const struct cache_entry *ca = a, *cb = b;
+
+	return strcmp(ca->key, cb->key);
+}
+
+static void cache_load(const char *name)
+{
+	struct cache_entry *e;
+	size_t size = 0, len = 0, alloc = 0;
+	char *p, *end, *field[5];
+	int fd, i;
+	ssize_t n = 0;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	for (;;) {
+		if (len == alloc) {
+			alloc = alloc ? alloc * 2 : 256 * 1024;
+			cache_data = xrealloc(cache_data, alloc + 1);
+		}
+
+		n = read(fd, cache_data + len, alloc - len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+	}
+	close(fd);
+
+	if (n < 0 || len < strlen(CACHE_MAGIC) ||
+	    memcmp(cache_data, CACHE_MAGIC, strlen(CACHE_MAGIC)))
+		goto invalid;
+
+	cache_data[len] = 0;
+	p = cache_data + strlen(CACHE_MAGIC);
+	end = cache_data + len;
+
+	while (p < end) {
+		for (i = 0; i < 5; i++) {
+			field[i] = p;
+			p += strcspn(p, i < 4 ? "\t\n" : "\n");
+			if (p >= end || *p != (i < 4 ? '\t' : '\n'))
+				goto invalid;
+			*p++ = 0;
+		}
+
+		if (n_cache == size) {
+			size = size ? size * 2 : 256;
+			cache = xrealloc(cache, size * sizeof(*cache));
+		}
+
+		e = &cache[n_cache];
+		e->key = field[0];
+		if (sscanf(field[1], "%lld.%ld", &e->mtime_sec,
+			   &e->mtime_nsec) != 2)
+			goto invalid;
+		e->size = strtoll(field[2], NULL, 10);
+		e->md5 = field[3];
+		e->control = p;
+		e->control_len = strtoul(field[4], NULL, 10);
+
+		if (strlen(e->md5) != 32 ||
+		    e->control_len >= (size_t) (end - p) ||
+		    p[e->control_len] != '\n')
+			goto invalid;
+
+		p += e->control_len + 1;
+		n_cache++;
+	}
+
+	qsort(cache, n_cache, sizeof(*cache), cache_cmp);
+	return;
+
+invalid:
+	/* start over with an empty cache */
+	free(cache);
+	free(cache_data);
+	cache = NULL;
+	cache_data = NULL;
+	n_cache = 0;
+}
+
+static struct cache_entry *cache_lookup(struct pkg *p)
+{
+	struct cache_entry key, *e;
+
+	if (!n_cache)
+		return NULL;
+
+	key.key = p->key;
+	e = bsearch(&key, cache, n_cache, sizeof(*cache), cache_cmp);
+	if (!e || e->mtime_sec != p->mtime_sec ||
+	    e->mtime_nsec != p->mtime_nsec || e->size != p->size)
+		return NULL;
+
+	return e;
+}
+
+static int cache_save(const char *name)
+{
+	char tmp[PATH_MAX];
+	struct pkg *p;
+	size_t i, n = 0;
+	FILE *f;
+
+	for (i = 0; i < n_pkgs; i++)
+		n += pkgs[i].valid;
+
+	/* nothing changed, nothing was removed */
+	if (!cache_misses && n == n_cache)
+		return 0;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", name, (int) getpid());
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		ERRS("Unable to create cache file %s", tmp);
+		return -1;
+	}
+
+	fputs(CACHE_MAGIC, f);
+	for (i = 0; i < n_pkgs; i++) {
+		p = &pkgs[i];
+		if (!p->valid)
+			continue;
+
+		fprintf(f, "%s\t%lld.%09ld\t%lld\t%s\t%lu\n", p->key,
+			p->mtime_sec, p->mtime_nsec, p->size, p->md5,
+			(unsigned long) p->control_len);
+		fwrite(p->control, 1, p->control_len, f);
+		fputc('\n', f);
+	}
+
+	if (ferror(f) | fclose(f)) {
+		ERRS("Unable to write cache file %s", tmp);
+		unlink(tmp);
+		return -1;
+	}
+
+	if (rename(tmp, name)) {
+		ERRS("Unable to rename %s to %s", tmp, name);
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Indexing a single package
+ */
+static void read_pkg(struct pkg *p)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(p->path, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+		goto out_close;
+
+	p->mtime_sec = st.st_mtim.tv_sec;
+	p->mtime_nsec = st.st_mtim.tv_nsec;
+
+	if (!st.st_size)
+		goto out_close;
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		goto out_close;
+
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	p->control = extract_control(data, st.st_size, &p->control_len);
+	if (p->control) {
+		md5_hex(data, st.st_size, p->md5);
+		p->control_owned = 1;
+		p->valid = 1;
+	}
+
+	munmap(data, st.st_size);
+
+out_close:
+	close(fd);
+}
+
+static void format_pkg(struct pkg *p)
+{
+	const char *line, *next, *end;
+	char size[32];
+
+	if (!p->valid)
+		goto out;
+
+	snprintf(size, sizeof(size), "%lld", p->size);
+
+	line = p->control;
+	end = p->control + p->control_len;
+
+	for (; line < end; line = next) {
+		next = memchr(line, '\n', end - line);
+		next = next ? next + 1 : end;
+
+		if (next - line >= 12 && !memcmp(line, "Description:", 12)) {
+			buf_add_str(&p->out, "Filename: ");
+			buf_add_str(&p->out, !strncmp(p->path, "./", 2) ?
+					     p->path + 2 : p->path);
+			buf_add_str(&p->out, "\nSize: ");
+			buf_add_str(&p->out, size);
+			buf_add_str(&p->out, "\nMD5Sum: ");
+			buf_add_str(&p->out, p->md5);
+			buf_add_str(&p->out, "\n");
+		}
+
+		buf_add(&p->out, line, next - line);
+	}
+
+out:
+	buf_add(&p->out, "\n", 1);
+}
+
+static void index_pkg(struct pkg *p)
+{
+	struct cache_entry *e;
+	struct stat st;
+
+	/* the Size: field is what ls -l shows, symlinks are not followed */
+	if (lstat(p->path, &st) == 0)
+		p->size = st.st_size;
+
+	if (stat(p->path, &st) == 0) {
+		p->mtime_sec = st.st_mtim.tv_sec;
+		p->mtime_nsec = st.st_mtim.tv_nsec;
+
+		e = cache_lookup(p);
+		if (e) {
+			memcpy(p->md5, e->md5, sizeof(p->md5));
+			p->control = (char *) e->control;
+			p->control_len = e->control_len;
+			p->valid = 1;
+			goto out;
+		}
+	}
+
+	read_pkg(p);
+
+	pthread_mutex_lock(&lock);
+	cache_misses++;
+	pthread_mutex_unlock(&lock);
+
+out:
+	format_pkg(p);
+}
+
+static void *worker(void *arg)
+{
+	struct pkg *p;
+
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		p = next_pkg < n_pkgs ? &pkgs[next_pkg++] : NULL;
+		pthread_mutex_unlock(&lock);
+
+		if (!p)
+			break;
+
+		index_pkg(p);
+
+		pthread_mutex_lock(&lock);
+		p->done = 1;
+		pthread_cond_broadcast(&done_cond);
+		pthread_mutex_unlock(&lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Collecting the package list, the same as
+ * find <dir> -name '*.ipk' | sort
+ */
+static int skip_pkg(const char *name)
+{
+	size_t len = strcspn(name, "_");
+
+	return (len == 6 && !strncmp(name, "kernel", 6)) ||
+	       (len == 4 && !strncmp(name, "libc", 4));
+}
+
+static void add_pkg(const char *path, const char *name, const char *cwd)
+{
+	struct pkg *p;
+
+	if (fnmatch("*.ipk", name, 0) || skip_pkg(name))
+		return;
+
+	if (n_pkgs == pkgs_size) {
+		pkgs_size = pkgs_size ? pkgs_size * 2 : 256;
+		pkgs = xrealloc(pkgs, pkgs_size * sizeof(*pkgs));
+	}
+
+	p = &pkgs[n_pkgs++];
+	memset(p, 0, sizeof(*p));
+	p->path = strdup(path);
+
+	if (path[0] == '/') {
+		p->key = strdup(path);
+	} else {
+		path = strip_dot_slash(path);
+		p->key = xmalloc(strlen(cwd) + strlen(path) + 2);
+		sprintf(p->key, "%s/%s", cwd, path);
+	}
+
+	if (!p->path || !p->key) {
+		ERR("Out of memory");
+		exit(1);
+	}
+}
+
+static void scan_dir(const char *dir, const char *cwd)
+{
+	struct dirent *de;
+	struct stat st;
+	char *path;
+	int is_dir;
+	size_t len = strlen(dir);
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d) {
+		ERRS("Unable to open directory %s", dir);
+		return;
+	}
+
+	while ((de = readdir(d)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+
+		path = xmalloc(len + strlen(de->d_name) + 2);
+		sprintf(path, "%s%s%s", dir,
+			(len && dir[len - 1] == '/') ? "" : "/", de->d_name);
+
+		add_pkg(path, de->d_name, cwd);
+
+		if (de->d_type == DT_UNKNOWN)
+			is_dir = !lstat(path, &st) && S_ISDIR(st.st_mode);
+		else
+			is_dir = de->d_type == DT_DIR;
+
+		if (is_dir)
+			scan_dir(path, cwd);
+
+		free(path);
+	}
+
+	closedir(d);
+}
+
+static int pkg_cmp(const void *a, const void *b)
+{
+	const struct pkg *pa = a, *pb = b;
+
+	return strcmp(pa->path, pb->path);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: %s [-j <jobs>] [-c <cache file>] <package_directory>\n"
+		"\n"
+		"Options:\n"
+		"  -j <jobs>       number of packages indexed in parallel\n"
+		"  -c <file>       keep the results in <file> and reuse them for\n"
+		"                  packages whose mtime and size did not change\n",
+		progname);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[MAX_JOBS];
+	const char *cache_file = NULL;
+	char cwd[PATH_MAX];
+	struct stat st;
+	struct pkg *p;
+	long jobs;
+	size_t i;
+	int c, ret = 0;
+
+	progname = argv[0];
+
+	jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((c = getopt(argc, argv, "c:j:h")) != -1) {
+		switch (c) {
+		case 'c':
+			cache_file = optarg;
+			break;
+		case 'j':
+			jobs = strtol(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc - 1 || stat(argv[optind], &st) ||
+	    !S_ISDIR(st.st_mode))
+		usage();
+
+	if (jobs < 1)
+		jobs = 1;
+	if (jobs > MAX_JOBS)
+		jobs = MAX_JOBS;
+
+	if (!getcwd(cwd, sizeof(cwd))) {
+		ERRS("Unable to get current directory");
+		return 1;
+	}
+
+	scan_dir(argv[optind], cwd);
+	qsort(pkgs, n_pkgs, sizeof(*pkgs), pkg_cmp);
+
+	if (cache_file)
+		cache_load(cache_file);
+
+	if ((size_t) jobs > n_pkgs)
+		jobs = n_pkgs;
+
+	for (i = 0; i < (size_t) jobs; i++) {
+		errno = pthread_create(&threads[i], NULL, worker, NULL);
+		if (errno) {
+			ERRS("Unable to create worker thread");
+			return 1;
+		}
+	}
+
+	/* results are written strictly in the sorted order */
+	for (i = 0; i < n_pkgs; i++) {
+		p = &pkgs[i];
+
+		pthread_mutex_lock(&lock);
+		while (!p->done)
+			pthread_cond_wait(&done_cond, &lock);
+		pthread_mutex_unlock(&lock);
+
+		fprintf(stderr, "Generating index for package %s\n", p->path);
+		if (!p->valid)
+			ERR("Unable to read the control file of %s", p->path);
+		fwrite(p->out.data, 1, p->out.len, stdout);
+
+		free(p->out.data);
+		p->out.data = NULL;
+	}
+
+	for (i = 0; i < (size_t) jobs; i++)
+		pthread_join(threads[i], NULL);
+
+	if (fflush(stdout) || ferror(stdout)) {
+		ERRS("Unable to write index");
+		ret = 1;
+	}
+
+	if (cache_file && cache_save(cache_file))
+		ret = 1;
+
+	for (i = 0; i < n_pkgs; i++) {
+		if (pkgs[i].control_owned)
+			free(pkgs[i].control);
+		free(pkgs[i].path);
+		free(pkgs[i].key);
+	}
+	free(pkgs);
+	free(cache);
+	free(cache_data);
+
+	return ret;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2013 OpenWrt.org
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ *
+ */
+
+#ifndef __IPKG_INDEX_MD5_H
+#define __IPKG_INDEX_MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct md5_ctx {
+	uint32_t state[4];
+	uint64_t len;
+	uint8_t block[64];
+};
+
+void md5_init(struct md5_ctx *ctx);
+void md5_update(struct md5_ctx *ctx, const void *data, size_t len);
+void md5_final(struct md5_ctx *ctx, uint8_t digest[16]);
+
+#endif